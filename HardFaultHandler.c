@@ -11,7 +11,8 @@
 #include <inc/hw_nvic.h>
 #include <driverlib/uart.h>
 
-#include "utils/ustdlib.h"
+#include "fmt.h"
+#include "uarttx.h"
 
 // declare these static so that they have dedicated storage,
 // and we don't have to do any stack operations
@@ -90,41 +91,47 @@ __attribute__ ((naked)) void  HardFaultHandler(void)   {
 
     }
 
-char buffer[64];
+static void fault_putc(char c) {
+    UARTCharPut(UART0_BASE, c);
+    }
 
+// Straight to the UART.   No format strings, no varargs, no divides,
+// and only a few words of the fault stack.   If the console is
+// buffered, what's queued goes out first.
 void FaultISRnice(void) {
-    // strcpy(buffer,buf0);
-    // for ( p = buffer; *p != '\0'; p++) UARTCharPut(UART0_BASE,*p);
-
-    usprintf(buffer, "Fault %d\r\n", (fh_xpsr & 0x1FF));
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
-
-    usprintf(buffer, "XFSR: 0x%08x PC: 0x%08x ", fh_xpsr, fh_oldpc);
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
-
-    usprintf(buffer, "SP: 0x%08x LR: 0x%08x\r\n", fh_oldsp, fh_oldlr);
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
-
-    usprintf(buffer, "MMSR: %02x BFSR: %02x\r\n", fh_mmsr, fh_bfsr);
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
-
-    usprintf(buffer, "UFSR: %02x HFSR: %02x\r\n\0", fh_ufsr, fh_hfsr);
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
-
-    usprintf(buffer, "DFSR: %02x AFSR: %02x\r\n\0", fh_dfsr, fh_afsr);
-
-    for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
+    FMTOUT o;
+
+    fmt_to_func(&o, uarttx_console ? uarttx_panic_putc : fault_putc);
+
+    fmt_str(&o, "Fault ");
+    fmt_udec(&o, fh_xpsr & 0x1FF, 0, ' ');
+    fmt_str(&o, "\r\nXFSR: 0x");
+    fmt_hex(&o, fh_xpsr, 8);
+    fmt_str(&o, " PC: 0x");
+    fmt_hex(&o, fh_oldpc, 8);
+    fmt_str(&o, " SP: 0x");
+    fmt_hex(&o, fh_oldsp, 8);
+    fmt_str(&o, " LR: 0x");
+    fmt_hex(&o, fh_oldlr, 8);
+    fmt_str(&o, "\r\nMMSR: ");
+    fmt_hex(&o, fh_mmsr, 2);
+    fmt_str(&o, " BFSR: ");
+    fmt_hex(&o, fh_bfsr, 2);
+    fmt_str(&o, "\r\nUFSR: ");
+    fmt_hex(&o, fh_ufsr, 2);
+    fmt_str(&o, " HFSR: ");
+    fmt_hex(&o, fh_hfsr, 2);
+    fmt_str(&o, "\r\nDFSR: ");
+    fmt_hex(&o, fh_dfsr, 2);
+    fmt_str(&o, " AFSR: ");
+    fmt_hex(&o, fh_afsr, 2);
+    fmt_str(&o, "\r\n");
 
     // See if there's good data in there
     if ( fh_bfsr & 0x80 ) {
-        usprintf(buffer, "BFAR: %02x\r\n\0", fh_bfar);
-
-        for ( char* p = buffer; *p != '\0'; p++ ) UARTCharPut(UART0_BASE, *p);
+        fmt_str(&o, "BFAR: 0x");
+        fmt_hex(&o, fh_bfar, 8);
+        fmt_str(&o, "\r\n");
         }
 
     // Spin forever, wait for help.
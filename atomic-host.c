@@ -0,0 +1,43 @@
+/// @file atomic-host.c
+///
+/// @brief Host versions of the atomic operators in atomic.c
+/// Same semantics, built on the C11 atomics so that code using them
+/// can be tested with threads on Linux.
+
+#include <stdint.h>
+
+#include "atomic.h"
+
+/// @brief Atomic add.
+/// @return the new value
+/// @param *sem pointer to the underlying value
+/// @param delta how much to add
+int32_t atomic_add(uint32_t *sem, int32_t delta) {
+    return( __atomic_add_fetch(sem, delta, __ATOMIC_SEQ_CST) );
+    }
+
+/// @brief Atomic OR
+/// @return the new value
+/// @param *sem pointer to the underlying value
+/// @param mask
+uint32_t atomic_mask_or(uint32_t *sem, uint32_t mask) {
+    return( __atomic_or_fetch(sem, mask, __ATOMIC_SEQ_CST) );
+    }
+
+/// @brief Atomic AND
+/// @return the new value
+/// @param *sem pointer to the underlying value
+/// @param mask
+uint32_t atomic_mask_and(uint32_t *sem, uint32_t mask) {
+    return( __atomic_and_fetch(sem, mask, __ATOMIC_SEQ_CST) );
+    }
+
+/// @brief Atomic compare and swap
+/// @return 1 if the value was expect, and is now update.  0 otherwise.
+/// @param *sem pointer to the underlying value
+/// @param expect what it has to be
+/// @param update what to replace it with
+int atomic_cas(uint32_t *sem, uint32_t expect, uint32_t update) {
+    return( __atomic_compare_exchange_n(sem, &expect, update, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) );
+    }
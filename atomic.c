@@ -11,6 +11,8 @@
 
 #include <stdint.h>
 
+#include "atomic.h"
+
 /// @brief Atomic add.
 /// @return the new value
 /// @param *sem pointer to the underlying value
@@ -21,8 +23,8 @@ int32_t atomic_add(uint32_t *sem, int32_t delta) {
           "1: ldrex  %[result], [ %[sem], #0 ]\n\t"
               "add   %[result], %[delta]\n\t"
               "strex r3 , %[result], [ %[sem] ]\n\t"
-              "cmp   r3, #1\n\t"
-              "bne   b1\n"
+              "cmp   r3, #0\n\t"
+              "bne   1b\n"
               "dmb   \n" // Required by Architecture. (DAI0321A)
             : [result] "=&r" (result) :
             [sem] "r" (sem), [delta] "r" (delta) : "r3" );
@@ -41,8 +43,8 @@ uint32_t atomic_mask_or(uint32_t *sem, uint32_t mask) {
             "1: ldrex  %[result], [ %[sem], #0 ]\n\t"
                 "orr   %[result], %[mask]\n\t"
                 "strex r3 , %[result], [ %[sem] ]\n\t"
-                "cmp   r3, #1\n\t"
-                "bne   b1\n"
+                "cmp   r3, #0\n\t"
+                "bne   1b\n"
                 "dmb   \n" // Required by Architecture. (DAI0321A)
               : [result] "=&r" (result) :
               [sem] "r" (sem), [mask] "r" (mask) : "r3" );
@@ -60,8 +62,8 @@ uint32_t atomic_mask_and(uint32_t *sem, uint32_t mask) {
             "1: ldrex  %[result], [ %[sem], #0 ]\n\t"
                 "and   %[result], %[mask]\n\t"
                 "strex r3 , %[result], [ %[sem] ]\n\t"
-                "cmp   r3, #1\n\t"
-                "bne   b1\n"
+                "cmp   r3, #0\n\t"
+                "bne   1b\n"
                 "dmb   \n" // Required by Architecture. (DAI0321A)
               : [result] "=&r" (result) :
               [sem] "r" (sem), [mask] "r" (mask) : "r3" );
@@ -72,3 +74,27 @@ uint32_t atomic_mask_and(uint32_t *sem, uint32_t mask) {
 
     
     
+
+/// @brief Atomic compare and swap
+/// @return 1 if the value was expect, and is now update.  0 otherwise.
+/// @param *sem pointer to the underlying value
+/// @param expect what it has to be
+/// @param update what to replace it with
+int atomic_cas(uint32_t *sem, uint32_t expect, uint32_t update) {
+      uint32_t fail;
+      __asm("   dmb   \n"
+            "1: ldrex  %[fail], [ %[sem], #0 ]\n\t"
+                "cmp   %[fail], %[expect]\n\t"
+                "bne   2f\n\t"
+                "strex %[fail], %[update], [ %[sem] ]\n\t"
+                "cmp   %[fail], #0\n\t"
+                "bne   1b\n\t"
+                "b     3f\n"
+            "2:  clrex \n\t"
+                "movs  %[fail], #1\n"
+            "3:  dmb   \n" // Required by Architecture. (DAI0321A)
+              : [fail] "=&r" (fail) :
+              [sem] "r" (sem), [expect] "r" (expect), [update] "r" (update) : "cc", "memory" );
+
+      return(fail == 0);
+      }
@@ -0,0 +1,16 @@
+//
+// LDREX/STREX based atomic operators.
+// atomic.c is the target version, atomic-host.c is for testing on Linux.
+//
+
+#ifndef __ATOMIC_H__
+#define __ATOMIC_H__
+
+#include <stdint.h>
+
+int32_t  atomic_add(uint32_t *sem, int32_t delta);
+uint32_t atomic_mask_or(uint32_t *sem, uint32_t mask);
+uint32_t atomic_mask_and(uint32_t *sem, uint32_t mask);
+int      atomic_cas(uint32_t *sem, uint32_t expect, uint32_t update);
+
+#endif
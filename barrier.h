@@ -0,0 +1,21 @@
+/// @file barrier.h
+/// @brief Memory barriers shared by the lockless routines.
+/// @details
+/// On the Cortex-M3 a DMB is what the architecture asks for around
+/// shared data (ARM App note DAI0321A).   Host builds use the C11
+/// fence so the same code can be tortured with threads on Linux.
+
+#ifndef __BARRIER_H__
+#define __BARRIER_H__
+
+#if defined(__arm__)
+#define MEM_BARRIER() __asm__ __volatile__ ( "dmb" : : : "memory" )
+#else
+#include <stdatomic.h>
+#define MEM_BARRIER() atomic_thread_fence(memory_order_seq_cst)
+#endif
+
+/// Keep the compiler from moving loads and stores across this point.
+#define COMPILER_BARRIER() __asm__ __volatile__ ( "" : : : "memory" )
+
+#endif
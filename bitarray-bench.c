@@ -0,0 +1,98 @@
+/// @file bitarray-bench.c
+/// @brief Host benchmark for the bit arrays.
+/// @details
+/// Times allocation from a mostly full map with bitarray_alloc(), against
+/// testing a bit at a time, and single bit stores through the emulated
+/// alias against a plain read-modify-write.   The emulated alias is only
+/// there to check the arithmetic, so expect it to be slower here - on the
+/// target it's one store.
+///
+/// Usage: bitarray-bench [-b bits] [-n rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bitarray.h"
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+// Allocation the slow way.
+static int alloc_naive(BITARRAY *ba) {
+    for ( uint32_t i = 0; i < ba->Bits; i++ ) {
+        if ( !bitarray_get(ba, i) ) {
+            ba->Words[i / 32] |= 1u << ( i % 32 );
+            return(i);
+            }
+        }
+
+    return(-1);
+    }
+
+int main(int argc, char **argv) {
+    uint32_t bits = 4096, *words;
+    long rounds = 1000000;
+    volatile int sink = 0;
+    BITARRAY ba;
+    double t;
+    int opt;
+
+    while ( ( opt = getopt(argc, argv, "b:n:") ) != -1 ) {
+        if ( opt == 'b' ) bits = atol(optarg);
+        else if ( opt == 'n' ) rounds = atol(optarg);
+        else {
+            fprintf(stderr, "Usage: bitarray-bench [-b bits] [-n rounds]\n");
+            return(2);
+            }
+        }
+
+    words = calloc(BITARRAY_WORDS(bits), sizeof(uint32_t));
+    bitarray_init(&ba, words, bits);
+
+    // Free bits near the end, one at a time.
+    for ( int naive = 0; naive < 2; naive++ ) {
+        bitarray_fill(&ba, 1);
+        t = now();
+
+        for ( long i = 0; i < rounds; i++ ) {
+            uint32_t bit = bits - 1 - i % 64;
+
+            ba.Words[bit / 32] &= ~( 1u << ( bit % 32 ) );
+            sink += naive ? alloc_naive(&ba) : bitarray_alloc(&ba);
+            }
+
+        t = now() - t;
+        printf("%-24s %8.1f ns\n", naive ? "alloc, bit at a time" : "bitarray_alloc", t / rounds * 1e9);
+        }
+
+    for ( int plain = 0; plain < 2; plain++ ) {
+        t = now();
+
+        for ( long i = 0; i < rounds; i++ ) {
+            uint32_t bit = ( i * 37 ) % bits;
+
+            if ( plain ) ba.Words[bit / 32] ^= 1u << ( bit % 32 );
+            else bitarray_put(&ba, bit, !bitarray_get(&ba, bit));
+            }
+
+        t = now() - t;
+        printf("%-24s %8.1f ns\n", plain ? "plain toggle" : "emulated alias toggle", t / rounds * 1e9);
+        }
+
+    t = now();
+
+    for ( long i = 0; i < rounds / 100; i++ ) sink += bitarray_count(&ba) + bitarray_ffs(&ba, i % bits);
+
+    t = now() - t;
+    printf("%-24s %8.1f ns (%u bits)\n", "count + ffs", t / ( rounds / 100 ) * 1e9, bits);
+
+    free(words);
+    return(0);
+    }
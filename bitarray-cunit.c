@@ -0,0 +1,247 @@
+// CUnit tests for the bit arrays.
+//
+// On the host every single bit store goes through the emulated bitband
+// alias, so these check the alias arithmetic as well as the searches.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bitarray.h"
+
+#include "CUnit/Basic.h"
+
+#define BITS 100
+
+uint32_t words[BITARRAY_WORDS(BITS) + 1];
+BITARRAY ba;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// The slow way.
+static int naive(const BITARRAY *b, uint32_t from, int val) {
+    for ( uint32_t i = from; i < b->Bits; i++ ) {
+        if ( bitarray_get(b, i) == val ) return(i);
+        }
+
+    return(-1);
+    }
+
+static void reset(void) {
+    memset(words, 0, sizeof(words));
+    words[BITARRAY_WORDS(BITS)] = 0xdeadbeef; // Guard.
+    bitarray_init(&ba, words, BITS);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testSetClear(void) {
+    reset();
+
+    CU_ASSERT( ba.Alias == 0x22000000 );
+
+    bitarray_set(&ba, 0);
+    bitarray_set(&ba, 31);
+    bitarray_set(&ba, 32);
+    bitarray_set(&ba, 99);
+    CU_ASSERT( words[0] == 0x80000001 );
+    CU_ASSERT( words[1] == 1 );
+    CU_ASSERT( words[3] == 1u << 3 );
+    CU_ASSERT( ba.Stores == 4 );
+
+    CU_ASSERT( bitarray_get(&ba, 31) );
+    CU_ASSERT( !bitarray_get(&ba, 30) );
+
+    bitarray_clear(&ba, 31);
+    bitarray_put(&ba, 99, 0);
+    CU_ASSERT( words[0] == 1 );
+    CU_ASSERT( words[3] == 0 );
+    CU_ASSERT( words[BITARRAY_WORDS(BITS)] == 0xdeadbeef );
+    }
+
+void testRange(void) {
+    reset();
+
+    bitarray_put_range(&ba, 5, 80, 1);
+    CU_ASSERT( words[0] == 0xffffffe0 );
+    CU_ASSERT( words[1] == 0xffffffff );
+    CU_ASSERT( words[2] == 0x1fffff );
+    CU_ASSERT( bitarray_count(&ba) == 80 );
+
+    bitarray_put_range(&ba, 32, 32, 0);
+    CU_ASSERT( words[1] == 0 );
+    CU_ASSERT( bitarray_count(&ba) == 48 );
+
+    // Fill stops at the last bit.
+    bitarray_fill(&ba, 1);
+    CU_ASSERT( words[3] == 0xf );
+    CU_ASSERT( bitarray_count(&ba) == BITS );
+    CU_ASSERT( words[BITARRAY_WORDS(BITS)] == 0xdeadbeef );
+
+    bitarray_fill(&ba, 0);
+    CU_ASSERT( bitarray_count(&ba) == 0 );
+    }
+
+void testBulk(void) {
+    uint32_t other[BITARRAY_WORDS(BITS)] = { 0 };
+    BITARRAY b;
+
+    reset();
+    bitarray_init(&b, other, BITS);
+
+    bitarray_put_range(&ba, 0, 60, 1);
+    bitarray_put_range(&b, 40, 60, 1);
+
+    bitarray_and(&ba, &b);
+    CU_ASSERT( bitarray_count(&ba) == 20 );
+    CU_ASSERT( bitarray_ffs(&ba, 0) == 40 );
+
+    bitarray_or(&ba, &b);
+    CU_ASSERT( bitarray_count(&ba) == 60 );
+
+    bitarray_put_range(&b, 40, 10, 0);
+    bitarray_andnot(&ba, &b);
+    CU_ASSERT( bitarray_count(&ba) == 10 );
+    CU_ASSERT( bitarray_ffs(&ba, 0) == 40 );
+    CU_ASSERT( bitarray_ffc(&ba, 40) == 50 );
+    }
+
+void testFind(void) {
+    reset();
+
+    CU_ASSERT( bitarray_ffs(&ba, 0) == -1 );
+    CU_ASSERT( bitarray_ffc(&ba, 0) == 0 );
+    CU_ASSERT( bitarray_ffc(&ba, BITS) == -1 );
+
+    // Past the end doesn't count, even if it's set.
+    words[3] = 0xfffffff0;
+    CU_ASSERT( bitarray_ffs(&ba, 0) == -1 );
+
+    bitarray_fill(&ba, 1);
+    CU_ASSERT( bitarray_ffc(&ba, 0) == -1 );
+
+    // Random patterns, every starting point.
+    srand(44);
+
+    for ( int round = 0; round < 1000; round++ ) {
+        for ( int w = 0; w < BITARRAY_WORDS(BITS); w++ ) {
+            words[w] = rand() & rand() & rand();
+
+            if ( round & 1 ) words[w] = ~words[w];
+            }
+
+        for ( uint32_t from = 0; from <= BITS; from++ ) {
+            CU_ASSERT( bitarray_ffs(&ba, from) == naive(&ba, from, 1) );
+            CU_ASSERT( bitarray_ffc(&ba, from) == naive(&ba, from, 0) );
+            }
+        }
+    }
+
+void testAlloc(void) {
+    reset();
+
+    bitarray_set(&ba, 0);
+    bitarray_set(&ba, 2);
+
+    CU_ASSERT( bitarray_alloc(&ba) == 1 );
+    CU_ASSERT( bitarray_alloc(&ba) == 3 );
+
+    for ( int i = 4; i < BITS; i++ ) CU_ASSERT( bitarray_alloc(&ba) == i );
+
+    CU_ASSERT( bitarray_alloc(&ba) == -1 );
+    CU_ASSERT( words[BITARRAY_WORDS(BITS)] == 0xdeadbeef );
+
+    bitarray_clear(&ba, 64);
+    CU_ASSERT( bitarray_alloc(&ba) == 64 );
+    }
+
+// Allocate and free from several threads.   Nobody gets a bit twice.
+#define THREADS 4
+#define ROUNDS  50000
+
+int owner[BITS], bad;
+
+static void *hammer(void *arg) {
+    int me = (int) (intptr_t) arg + 1;
+
+    for ( int i = 0; i < ROUNDS; i++ ) {
+        int bit = bitarray_alloc(&ba);
+
+        if ( bit < 0 ) continue;
+
+        if ( __atomic_exchange_n(&owner[bit], me, __ATOMIC_SEQ_CST) != 0 ) bad++;
+
+        __atomic_store_n(&owner[bit], 0, __ATOMIC_SEQ_CST);
+        bitarray_clear(&ba, bit);
+        }
+
+    return(arg);
+    }
+
+void testConcurrent(void) {
+    pthread_t t[THREADS];
+
+    reset();
+    memset(owner, 0, sizeof(owner));
+    bad = 0;
+
+    // Most of it taken, so they fight over what's left.
+    bitarray_put_range(&ba, 0, BITS - 3, 1);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_create(&t[i], NULL, hammer, (void *) (intptr_t) i);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_join(t[i], NULL);
+
+    CU_ASSERT( bad == 0 );
+    CU_ASSERT( bitarray_count(&ba) == BITS - 3 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Bit Array", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Set and clear", testSetClear)) ||
+            (NULL == CU_add_test(pSuite, "Ranges", testRange)) ||
+            (NULL == CU_add_test(pSuite, "Bulk", testBulk)) ||
+            (NULL == CU_add_test(pSuite, "Find", testFind)) ||
+            (NULL == CU_add_test(pSuite, "Allocate", testAlloc)) ||
+            (NULL == CU_add_test(pSuite, "Concurrent allocation", testConcurrent))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,187 @@
+/// @file bitarray.c
+/// @brief Dense bit arrays on top of bitbanded_address().
+/// @details
+/// For flash page allocation maps, GPIO shadow state and presence
+/// bitmaps.   The caller provides the words, BITARRAY_WORDS(n) of them.
+///
+/// Single bits go through the bitband alias when the words are in the
+/// SRAM or peripheral bitband regions.   The store is a read-modify-write
+/// done by the bus, so nothing else in the word gets clobbered, even
+/// by an ISR.   Elsewhere it's a plain read-modify-write, and the caller
+/// has to keep ISRs out.
+///
+/// Bulk operations work a word at a time, and ignore the alias.
+///
+/// Searches use CLZ.   The M3 has no count trailing zeros, but the lowest
+/// set bit of x is 31 - clz(x & -x).   Bits past Bits in the last word
+/// are never reported.
+///
+/// On the host, the words are pretended to start at the bottom of SRAM.
+/// locker-bb.c assumes 32-bit pointers, so the alias is worked out by
+/// a copy of bitbanded_address().   Alias stores are decoded back to a
+/// word and bit, and applied with the atomic operators, so the address
+/// arithmetic gets tested both ways.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "atomic.h"
+#include "locker-bb.h"
+#include "bitarray.h"
+
+#define SRAM_BB_START   0x20000000
+#define SRAM_BB_END     0x20100000
+#define PERIPH_BB_START 0x40000000
+#define PERIPH_BB_END   0x40100000
+
+#if !defined(__arm__)
+// bitbanded_address(), for the host.
+static uint32_t host_bb_address(uint32_t addr, int bit) {
+    return( ( addr & 0xf0000000 ) | 0x02000000 | ( ( addr & 0x000fffff ) << 5 ) | ( bit << 2 ) );
+    }
+#endif
+
+/// @brief Set up an array.   The words are left as they are.
+/// @param words storage, BITARRAY_WORDS(bits) of them
+/// @param bits how many
+void bitarray_init(BITARRAY *ba, uint32_t *words, uint32_t bits) {
+    ba->Words = words;
+    ba->Bits = bits;
+    ba->Alias = 0;
+    ba->Stores = 0;
+
+#if defined(__arm__)
+    uint32_t addr = (uint32_t) words;
+    uint32_t end = addr + 4 * BITARRAY_WORDS(bits);
+
+    if ( ( addr >= SRAM_BB_START && end <= SRAM_BB_END ) ||
+         ( addr >= PERIPH_BB_START && end <= PERIPH_BB_END ) ) {
+        ba->Alias = bitbanded_address(addr, 0);
+        }
+#else
+    ba->Alias = host_bb_address(SRAM_BB_START, 0);
+#endif
+    }
+
+#if !defined(__arm__)
+/// @brief What the bus does with a store to the alias region.
+void bitarray_bb_store(BITARRAY *ba, uint32_t alias, uint32_t val) {
+    uint32_t addr = ( alias & 0xf0000000 ) | ( ( alias & 0x01ffffff ) >> 5 );
+    uint32_t bit = ( alias >> 2 ) & 31;
+    uint32_t *word = &ba->Words[( ( addr & ~3u ) - SRAM_BB_START ) / 4];
+
+    if ( val & 1 ) atomic_mask_or(word, 1u << bit);
+    else atomic_mask_and(word, ~( 1u << bit ));
+
+    ba->Stores++;
+    }
+#endif
+
+// The bits of word w that are in the array.
+static uint32_t valid(const BITARRAY *ba, uint32_t w) {
+    uint32_t left = ba->Bits - 32 * w;
+
+    return( left >= 32 ? 0xffffffff : ( 1u << left ) - 1 );
+    }
+
+/// @brief Set or clear everything.
+void bitarray_fill(BITARRAY *ba, int val) {
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(ba->Bits); w++ ) ba->Words[w] = val ? valid(ba, w) : 0;
+    }
+
+/// @brief Set or clear n bits from first.   Whole words at a time in the middle.
+void bitarray_put_range(BITARRAY *ba, uint32_t first, uint32_t n, int val) {
+    while ( n ) {
+        uint32_t w = first / 32, b = first % 32;
+        uint32_t take = ( 32 - b < n ) ? 32 - b : n;
+        uint32_t mask = ( take == 32 ) ? 0xffffffff : ( ( 1u << take ) - 1 ) << b;
+
+        if ( val ) ba->Words[w] |= mask;
+        else ba->Words[w] &= ~mask;
+
+        first += take;
+        n -= take;
+        }
+    }
+
+/// @brief How many are set.
+uint32_t bitarray_count(const BITARRAY *ba) {
+    uint32_t n = 0;
+
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(ba->Bits); w++ ) {
+        n += __builtin_popcount(ba->Words[w] & valid(ba, w));
+        }
+
+    return(n);
+    }
+
+/// @brief dst &= src, for as many bits as the shorter one has.
+void bitarray_and(BITARRAY *dst, const BITARRAY *src) {
+    uint32_t bits = dst->Bits < src->Bits ? dst->Bits : src->Bits;
+
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(bits); w++ ) dst->Words[w] &= src->Words[w];
+    }
+
+/// @brief dst |= src, for as many bits as the shorter one has.
+void bitarray_or(BITARRAY *dst, const BITARRAY *src) {
+    uint32_t bits = dst->Bits < src->Bits ? dst->Bits : src->Bits;
+
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(bits); w++ ) {
+        dst->Words[w] |= src->Words[w] & valid(dst, w);
+        }
+    }
+
+/// @brief dst &= ~src.   Take the bits in src out of dst.
+void bitarray_andnot(BITARRAY *dst, const BITARRAY *src) {
+    uint32_t bits = dst->Bits < src->Bits ? dst->Bits : src->Bits;
+
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(bits); w++ ) dst->Words[w] &= ~src->Words[w];
+    }
+
+// The first bit at or after from that's set in word ^ flip.
+static int find(const BITARRAY *ba, uint32_t from, uint32_t flip) {
+    if ( from >= ba->Bits ) return(-1);
+
+    uint32_t w = from / 32;
+    uint32_t x = ( ( ba->Words[w] ^ flip ) & valid(ba, w) ) & ( 0xffffffff << ( from % 32 ) );
+
+    while ( x == 0 ) {
+        if ( ++w == BITARRAY_WORDS(ba->Bits) ) return(-1);
+
+        x = ( ba->Words[w] ^ flip ) & valid(ba, w);
+        }
+
+    return( 32 * w + 31 - __builtin_clz(x & -x) );
+    }
+
+/// @brief Find the first set bit.
+/// @param from where to start looking
+/// @return the bit, or -1 if there isn't one
+int bitarray_ffs(const BITARRAY *ba, uint32_t from) {
+    return( find(ba, from, 0) );
+    }
+
+/// @brief Find the first clear bit.
+/// @return the bit, or -1 if they're all set
+int bitarray_ffc(const BITARRAY *ba, uint32_t from) {
+    return( find(ba, from, 0xffffffff) );
+    }
+
+/// @brief Find a clear bit and set it, atomically.   For allocation maps.
+/// @return the bit, or -1 if they're all taken
+int bitarray_alloc(BITARRAY *ba) {
+    for ( uint32_t w = 0; w < BITARRAY_WORDS(ba->Bits); w++ ) {
+        for (;;) {
+            uint32_t old = ( (volatile uint32_t *) ba->Words )[w];
+            uint32_t x = ~old & valid(ba, w);
+
+            if ( x == 0 ) break; // Full.   Try the next.
+
+            x &= -x;
+
+            if ( atomic_cas(&ba->Words[w], old, old | x) ) return( 32 * w + 31 - __builtin_clz(x) );
+            }
+        }
+
+    return(-1);
+    }
@@ -0,0 +1,64 @@
+//
+// Dense bit arrays.   Single bits set and cleared with one store to the
+// bitband alias, word-wide bulk operations, and CLZ searches.
+//
+
+#ifndef __BITARRAY_H__
+#define __BITARRAY_H__
+
+#include <stdint.h>
+
+/// Words of storage for n bits.
+#define BITARRAY_WORDS(n) ( ( (n) + 31 ) / 32 )
+
+typedef struct {
+    uint32_t *Words;
+    uint32_t Bits;
+    uint32_t Alias;     // Bitband alias of bit 0, or 0 if Words isn't in a bitband region.
+    uint32_t Stores;    // Host only.   Alias stores emulated.
+    } BITARRAY;
+
+void bitarray_init(BITARRAY*, uint32_t *words, uint32_t bits);
+
+void bitarray_fill(BITARRAY*, int val);
+void bitarray_put_range(BITARRAY*, uint32_t first, uint32_t n, int val);
+uint32_t bitarray_count(const BITARRAY*);
+void bitarray_and(BITARRAY *dst, const BITARRAY *src);
+void bitarray_or(BITARRAY *dst, const BITARRAY *src);
+void bitarray_andnot(BITARRAY *dst, const BITARRAY *src);
+
+int bitarray_ffs(const BITARRAY*, uint32_t from);
+int bitarray_ffc(const BITARRAY*, uint32_t from);
+int bitarray_alloc(BITARRAY*);
+
+#if !defined(__arm__)
+void bitarray_bb_store(BITARRAY*, uint32_t alias, uint32_t val);
+#endif
+
+/// @brief Set or clear one bit.   One store if it's bitbanded, so an ISR
+/// changing another bit in the same word can't be lost.
+static inline void bitarray_put(BITARRAY *ba, uint32_t bit, int val) {
+    if ( ba->Alias ) {
+#if defined(__arm__)
+        *(volatile uint32_t *) ( ba->Alias + 4 * bit ) = val ? 1 : 0;
+#else
+        bitarray_bb_store(ba, ba->Alias + 4 * bit, val ? 1 : 0);
+#endif
+        }
+    else if ( val ) ba->Words[bit / 32] |= 1u << ( bit % 32 );
+    else ba->Words[bit / 32] &= ~( 1u << ( bit % 32 ) );
+    }
+
+static inline void bitarray_set(BITARRAY *ba, uint32_t bit) {
+    bitarray_put(ba, bit, 1);
+    }
+
+static inline void bitarray_clear(BITARRAY *ba, uint32_t bit) {
+    bitarray_put(ba, bit, 0);
+    }
+
+static inline int bitarray_get(const BITARRAY *ba, uint32_t bit) {
+    return( ( ( (volatile uint32_t *) ba->Words )[bit / 32] >> ( bit % 32 ) ) & 1 );
+    }
+
+#endif
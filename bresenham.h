@@ -1,3 +1,6 @@
+#ifndef __BRESENHAM_H__
+#define __BRESENHAM_H__
+
 typedef struct {
     unsigned fixed; // For fractions greater than one.
     int error;		// The state
@@ -8,3 +11,5 @@ typedef struct {
 void interp_reset(tInterpKernel *kernel);
 void interp_init(tInterpKernel *kernel, unsigned num, unsigned denom);
 unsigned interp_next(tInterpKernel *kernel);
+
+#endif
@@ -0,0 +1,102 @@
+/// @file coro-bench.c
+/// @brief Host benchmark for the coroutines.
+/// @details
+/// Two coroutines play ping-pong through a pair of rings, so every pass
+/// resumes both.   Then the same again with more coroutines waiting on
+/// rings that stay empty, to show what a waiting coroutine costs each
+/// pass - a ring check, not a call.
+///
+/// Usage: coro-bench [-n passes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coro.h"
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+static uint64_t clock_ms(void) {
+    return(0);
+    }
+
+typedef struct {
+    CORO Co;
+    RINGBUF *In, *Out;
+    } PLAYER;
+
+static RINGBUF ping, pong, quiet;
+static uint8_t pingmem[16], pongmem[16], quietmem[16];
+
+static int player(CORO *c) {
+    PLAYER *p = (PLAYER *) c;
+
+    CORO_BEGIN(c);
+
+    for (;;) {
+        CORO_AWAIT_READABLE(c, p->In, 1);
+        ringbuffer_addchar(p->Out, ringbuffer_getchar(p->In));
+        }
+
+    CORO_END(c);
+    }
+
+static int sleeper(CORO *c) {
+    CORO_BEGIN(c);
+    CORO_AWAIT_READABLE(c, &quiet, 1);
+    CORO_END(c);
+    }
+
+int main(int argc, char **argv) {
+    static PLAYER player_a = { .In = &ping, .Out = &pong }, player_b = { .In = &pong, .Out = &ping };
+    static CORO co[64];
+    long passes = 5000000;
+    double base = 0;
+    COROLOOP loop;
+    int opt;
+
+    while ( ( opt = getopt(argc, argv, "n:") ) != -1 ) {
+        if ( opt == 'n' ) passes = atol(optarg);
+        else {
+            fprintf(stderr, "Usage: coro-bench [-n passes]\n");
+            return(2);
+            }
+        }
+
+    for ( int waiting = 0; waiting <= 64; waiting = waiting ? waiting * 4 : 4 ) {
+        double t;
+
+        ringbuffer_init(&ping, pingmem, sizeof(pingmem));
+        ringbuffer_init(&pong, pongmem, sizeof(pongmem));
+        ringbuffer_init(&quiet, quietmem, sizeof(quietmem));
+        coro_loop_init(&loop, clock_ms);
+
+        coro_add(&loop, &player_a.Co, player);
+        coro_add(&loop, &player_b.Co, player);
+
+        for ( int i = 0; i < waiting; i++ ) coro_add(&loop, &co[i], sleeper);
+
+        ringbuffer_addchar(&ping, 'x');
+
+        t = now();
+
+        for ( long i = 0; i < passes; i++ ) coro_run_once(&loop);
+
+        t = ( now() - t ) / passes;
+
+        if ( waiting == 0 ) {
+            base = t;
+            printf("%2d waiting: %6.1f ns a pass, %5.1f ns a resume\n", waiting, t * 1e9, t / 2 * 1e9);
+            }
+        else printf("%2d waiting: %6.1f ns a pass, %5.1f ns for each one waiting\n", waiting, t * 1e9, ( t - base ) / waiting * 1e9);
+        }
+
+    return(0);
+    }
@@ -0,0 +1,367 @@
+// CUnit tests for the coroutines.
+//
+// Threads play the ISRs, filling the receive rings and draining the
+// transmit rings while the run loop goes.   The clock is a variable, so
+// the timeout tests don't depend on the machine.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "coro.h"
+
+#include "CUnit/Basic.h"
+
+COROLOOP loop;
+volatile uint64_t ms;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static uint64_t clock_ms(void) {
+    return( __atomic_load_n(&ms, __ATOMIC_SEQ_CST) );
+    }
+
+static void idle(uint64_t wake) {
+    (void) wake;
+    sched_yield();
+    }
+
+// A framed protocol.   A length byte, then that many bytes.   The reply
+// is the frame back with its bytes summed on the end.
+typedef struct {
+    CORO Co;
+    RINGBUF Rx, Tx;
+    uint8_t RxMem[64], TxMem[16];
+    int Len, i;
+    uint8_t Sum;
+    int Frames;
+    } ECHO;
+
+static int echo(CORO *c) {
+    ECHO *e = (ECHO *) c;
+
+    CORO_BEGIN(c);
+
+    for (;;) {
+        CORO_AWAIT_READABLE(c, &e->Rx, 1);
+        e->Len = ringbuffer_getchar(&e->Rx);
+
+        if ( e->Len == 0 ) break; // Goodbye.
+
+        CORO_AWAIT_READABLE(c, &e->Rx, e->Len);
+        CORO_AWAIT_WRITABLE(c, &e->Tx, 1);
+        ringbuffer_addchar(&e->Tx, e->Len);
+
+        // Byte at a time, so the small Tx ring pushes back.
+        for ( e->Sum = 0, e->i = 0; e->i < e->Len; e->i++ ) {
+            CORO_AWAIT_WRITABLE(c, &e->Tx, 1);
+            e->Sum += ringbuffer_getchar(&e->Rx) & 0xff;
+            ringbuffer_addchar(&e->Tx, e->Sum);
+            }
+
+        e->Frames++;
+        }
+
+    CORO_END(c);
+    }
+
+#define HANDLERS 48
+#define FRAMES   200
+
+ECHO handler[HANDLERS];
+int bad;
+
+static void frame(int h, int f, uint8_t *buf, int *len) {
+    int n = 1 + ( h * 7 + f * 13 ) % 40;
+
+    buf[0] = n;
+
+    for ( int i = 1; i <= n; i++ ) buf[i] = h + f + i;
+
+    *len = n + 1;
+    }
+
+// The receive ISR.   Frames for every handler, a byte at a time, into
+// whatever room there is.
+static void *rx_isr(void *arg) {
+    int pos[HANDLERS] = { 0 }, f[HANDLERS] = { 0 }, busy = 1;
+
+    while ( busy ) {
+        busy = 0;
+
+        for ( int h = 0; h < HANDLERS; h++ ) {
+            uint8_t buf[64];
+            int len;
+
+            if ( f[h] > FRAMES ) continue;
+
+            busy = 1;
+
+            if ( f[h] == FRAMES ) { buf[0] = 0; len = 1; }
+            else frame(h, f[h], buf, &len);
+
+            if ( ringbuffer_free(&handler[h].Rx) == 0 ) continue;
+
+            ringbuffer_addchar(&handler[h].Rx, buf[pos[h]]);
+
+            if ( ++pos[h] == len ) {
+                pos[h] = 0;
+                f[h]++;
+                }
+            }
+
+        sched_yield();
+        }
+
+    return(arg);
+    }
+
+// The transmit ISR.   Checks what comes out.
+static void *tx_isr(void *arg) {
+    int pos[HANDLERS] = { 0 }, f[HANDLERS] = { 0 }, done = 0;
+
+    while ( done < HANDLERS ) {
+        for ( int h = 0; h < HANDLERS; h++ ) {
+            uint8_t buf[64];
+            int c, len;
+            uint8_t sum = 0;
+
+            if ( f[h] == FRAMES ) continue;
+
+            if ( ( c = ringbuffer_getchar(&handler[h].Tx) ) < 0 ) continue;
+
+            frame(h, f[h], buf, &len);
+
+            for ( int i = 1; i <= pos[h] && pos[h] > 0; i++ ) sum += buf[i];
+
+            if ( c != ( pos[h] == 0 ? buf[0] : sum ) ) bad++;
+
+            if ( ++pos[h] == len ) {
+                pos[h] = 0;
+
+                if ( ++f[h] == FRAMES ) done++;
+                }
+            }
+
+        sched_yield();
+        }
+
+    return(arg);
+    }
+
+typedef struct {
+    CORO Co;
+    RINGBUF *Ring;
+    int Got;
+    int TimedOut;
+    uint64_t At;
+    } WAITER;
+
+static int waiter(CORO *c) {
+    WAITER *w = (WAITER *) c;
+
+    CORO_BEGIN(c);
+    CORO_AWAIT_READABLE_FOR(c, w->Ring, 4, 100);
+    w->TimedOut = c->TimedOut;
+    w->Got = ringbuffer_used(w->Ring);
+    w->At = c->Loop->Now;
+    CORO_END(c);
+    }
+
+typedef struct {
+    CORO Co;
+    int Id, Period, Count;
+    } SLEEPER;
+
+int order[32], norder;
+
+static int sleeper(CORO *c) {
+    SLEEPER *s = (SLEEPER *) c;
+
+    CORO_BEGIN(c);
+
+    for ( s->Count = 0; s->Count < 3; s->Count++ ) {
+        CORO_SLEEP(c, s->Period);
+        order[norder++] = s->Id;
+        }
+
+    CORO_YIELD(c);
+    order[norder++] = s->Id + 100;
+    CORO_END(c);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+// Dozens of protocol handlers on one stack, fed by ISRs.
+void testHandlers(void) {
+    pthread_t rx, tx;
+
+    coro_loop_init(&loop, clock_ms);
+    loop.Idle = idle;
+    bad = 0;
+
+    for ( int h = 0; h < HANDLERS; h++ ) {
+        memset(&handler[h], 0, sizeof(handler[h]));
+        ringbuffer_init(&handler[h].Rx, handler[h].RxMem, sizeof(handler[h].RxMem));
+        ringbuffer_init(&handler[h].Tx, handler[h].TxMem, sizeof(handler[h].TxMem));
+        coro_add(&loop, &handler[h].Co, echo);
+        }
+
+    pthread_create(&rx, NULL, rx_isr, NULL);
+    pthread_create(&tx, NULL, tx_isr, NULL);
+
+    coro_run(&loop); // Until they've all said goodbye.
+
+    pthread_join(rx, NULL);
+    pthread_join(tx, NULL);
+
+    CU_ASSERT( bad == 0 );
+    CU_ASSERT( loop.Head == NULL );
+
+    for ( int h = 0; h < HANDLERS; h++ ) CU_ASSERT( handler[h].Frames == FRAMES );
+
+    // Waiting costs a check, not a call.
+    CU_ASSERT( loop.Resumes < loop.Passes * HANDLERS );
+    }
+
+void testTimeout(void) {
+    static uint8_t mem[2][16];
+    WAITER w[2];
+    RINGBUF r[2];
+
+    ms = 1000;
+    coro_loop_init(&loop, clock_ms);
+    memset(w, 0, sizeof(w));
+
+    for ( int i = 0; i < 2; i++ ) {
+        ringbuffer_init(&r[i], mem[i], 16);
+        w[i].Ring = &r[i];
+        coro_add(&loop, &w[i].Co, waiter);
+        }
+
+    coro_run_once(&loop);
+    CU_ASSERT( coro_next_wake(&loop) == 1100 );
+
+    // One gets its data in time, with some to spare.
+    ms = 1050;
+    for ( int i = 0; i < 3; i++ ) ringbuffer_addchar(&r[0], i);
+    CU_ASSERT( coro_run_once(&loop) == 0 );
+    ringbuffer_addchar(&r[0], 3);
+    ringbuffer_addchar(&r[1], 3);
+    CU_ASSERT( coro_run_once(&loop) == 1 );
+    CU_ASSERT( w[0].TimedOut == 0 && w[0].Got == 4 && w[0].At == 1050 );
+
+    // The other doesn't.
+    ms = 1099;
+    CU_ASSERT( coro_run_once(&loop) == 0 );
+    ms = 1100;
+    CU_ASSERT( coro_run_once(&loop) == 1 );
+    CU_ASSERT( w[1].TimedOut == 1 && w[1].Got == 1 && w[1].At == 1100 );
+    CU_ASSERT( loop.Head == NULL );
+    }
+
+void testSleep(void) {
+    static const int expect[] = { 1, 2, 1, 3, 1, 101, 2, 3, 2, 102, 3, 103 };
+    SLEEPER s[3];
+
+    ms = 0xfffffff0ULL; // Past 32 bits on the way.
+    coro_loop_init(&loop, clock_ms);
+    memset(s, 0, sizeof(s));
+    norder = 0;
+
+    for ( int i = 0; i < 3; i++ ) {
+        s[i].Id = i + 1;
+        s[i].Period = 10 * ( i + 1 ) + 5;
+        coro_add(&loop, &s[i].Co, sleeper);
+        }
+
+    while ( loop.Head ) {
+        coro_run_once(&loop);
+        ms++;
+        }
+
+    CU_ASSERT( norder == 12 );
+    CU_ASSERT( memcmp(order, expect, sizeof(expect)) == 0 );
+    CU_ASSERT( coro_next_wake(&loop) == CORO_NEVER );
+    }
+
+// A deadline of 0 is still a deadline.
+static int napper(CORO *c) {
+    CORO_BEGIN(c);
+    CORO_SLEEP(c, 0);
+    CORO_AWAIT_READABLE_FOR(c, ((WAITER *) c)->Ring, 1, 0);
+    ((WAITER *) c)->TimedOut = c->TimedOut;
+    CORO_SLEEP(c, 2);
+    CORO_END(c);
+    }
+
+void testZeroDeadline(void) {
+    static uint8_t mem[16];
+    RINGBUF r;
+    WAITER w;
+
+    ms = 0;
+    coro_loop_init(&loop, clock_ms);
+    memset(&w, 0, sizeof(w));
+    ringbuffer_init(&r, mem, 16);
+    w.Ring = &r;
+    coro_add(&loop, &w.Co, napper);
+
+    CU_ASSERT( coro_next_wake(&loop) == CORO_NEVER );
+    CU_ASSERT( coro_run_once(&loop) == 1 );
+    CU_ASSERT( w.TimedOut == 1 );
+    CU_ASSERT( coro_next_wake(&loop) == 2 );
+
+    ms = 2;
+    CU_ASSERT( coro_run_once(&loop) == 1 );
+    CU_ASSERT( loop.Head == NULL );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Coroutines", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Protocol handlers", testHandlers)) ||
+            (NULL == CU_add_test(pSuite, "Timeouts", testTimeout)) ||
+            (NULL == CU_add_test(pSuite, "Sleep", testSleep)) ||
+            (NULL == CU_add_test(pSuite, "Zero deadline", testZeroDeadline))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,140 @@
+/// @file coro.c
+/// @brief Stackless coroutines and their run loop.
+/// @details
+/// A protocol handler that waits for bytes either polls, or needs a
+/// task and a stack of its own.   Coroutines need neither.   The body is
+/// a switch on the line it last waited at - protothreads - so a wait
+/// is a return, and resuming is a jump back to that line.   They all
+/// share the run loop's stack.
+///
+/// A waiting coroutine leaves what it's waiting for in its CORO - bytes
+/// to read, room to write, a time, or a ring with a timeout.   The run
+/// loop checks that itself, with coro_ready(), and only calls the ones
+/// that can go.   A coroutine that's still waiting costs a compare or
+/// two a pass, not a call.
+///
+/// ISRs fill and drain the rings.   The loop reads the clock once a
+/// pass.   When nothing was ready, Idle gets the next time anyone wants
+/// to wake - coro_idle_wfi() sleeps until an interrupt.
+///
+/// Coroutines are run in the order they were added.   One that returns
+/// CORO_DONE is taken off the list.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ringbuffer.h"
+#include "coro.h"
+
+/// @brief Set up a run loop.
+/// @param clock milliseconds.   getSysTickMS64 on the target.
+void coro_loop_init(COROLOOP *l, uint64_t (*clock)(void)) {
+    l->Head = NULL;
+    l->Clock = clock;
+    l->Now = clock();
+    l->Idle = NULL;
+    l->Passes = 0;
+    l->Resumes = 0;
+    }
+
+/// @brief Add a coroutine.   It starts at the next pass.
+/// @param c cleared, apart from whatever it's embedded in
+void coro_add(COROLOOP *l, CORO *c, int (*fn)(CORO*)) {
+    CORO **p = &l->Head;
+
+    while ( *p ) p = &(*p)->Next;
+
+    c->Next = NULL;
+    c->Loop = l;
+    c->Fn = fn;
+    c->Line = 0;
+    c->Wait = CORO_NONE;
+    c->Timed = 0;
+    c->TimedOut = 0;
+    c->Wake = 0;
+    c->Resumes = 0;
+    *p = c;
+    }
+
+/// @brief Can it go?   Sets TimedOut if it's because the time's up.
+int coro_ready(CORO *c) {
+    int ok;
+
+    switch ( c->Wait ) {
+        case CORO_READABLE:
+            ok = ringbuffer_used(c->Ring) >= c->Need;
+            break;
+
+        case CORO_WRITABLE:
+            ok = ringbuffer_free(c->Ring) >= c->Need;
+            break;
+
+        case CORO_TIME:
+            ok = 0;
+            break;
+
+        default:
+            return(1);
+        }
+
+    c->TimedOut = !ok && c->Timed && c->Loop->Now >= c->Wake;
+    return( ok || c->TimedOut );
+    }
+
+/// @brief Run everything that's ready, once.
+/// @return how many ran
+int coro_run_once(COROLOOP *l) {
+    CORO **p = &l->Head;
+    int ran = 0;
+
+    l->Now = l->Clock();
+    l->Passes++;
+
+    while ( *p ) {
+        CORO *c = *p;
+
+        if ( coro_ready(c) ) {
+            c->Resumes++;
+            ran++;
+
+            if ( c->Fn(c) == CORO_DONE ) {
+                *p = c->Next;
+                continue;
+                }
+            }
+
+        p = &c->Next;
+        }
+
+    l->Resumes += ran;
+    return(ran);
+    }
+
+/// @brief The earliest Wake of anything waiting, or CORO_NEVER if
+/// nobody has one.
+uint64_t coro_next_wake(COROLOOP *l) {
+    uint64_t next = CORO_NEVER;
+
+    for ( CORO *c = l->Head; c; c = c->Next ) {
+        if ( c->Wait != CORO_NONE && c->Timed && c->Wake < next ) next = c->Wake;
+        }
+
+    return(next);
+    }
+
+/// @brief Run until they've all finished.
+void coro_run(COROLOOP *l) {
+    while ( l->Head ) {
+        if ( coro_run_once(l) == 0 && l->Idle ) l->Idle(coro_next_wake(l));
+        }
+    }
+
+#if defined(__arm__)
+/// @brief Sleep until an interrupt.   SysTick is one, so timeouts are
+/// seen within a tick.   An interrupt that lands between the loop's
+/// last look and here costs at most a tick too.
+void coro_idle_wfi(uint64_t wake) {
+    (void) wake;
+    __asm__ __volatile__ ( "cpsid i\n\twfi\n\tcpsie i" : : : "memory" );
+    }
+#endif
@@ -0,0 +1,104 @@
+//
+// Stackless coroutines, protothread style, that wait on RINGBUFs and
+// the 64-bit systick.   Dozens of protocol handlers on one stack.
+//
+
+#ifndef __CORO_H__
+#define __CORO_H__
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+
+// What a coroutine is waiting for.
+#define CORO_NONE     0  // Just yielded.   Runs next pass.
+#define CORO_READABLE 1  // Need bytes in Ring.
+#define CORO_WRITABLE 2  // Need room in Ring.
+#define CORO_TIME     3  // Wake.
+
+// What the body returns.
+#define CORO_WAITING  0
+#define CORO_DONE     1
+
+// coro_next_wake() when nobody has a deadline.
+#define CORO_NEVER    UINT64_MAX
+
+struct COROLOOP;
+
+typedef struct CORO {
+    struct CORO *Next;
+    struct COROLOOP *Loop;
+    int (*Fn)(struct CORO*);
+    uint16_t Line;        // Where to resume.   0 to start.
+    uint8_t Wait;
+    uint8_t Timed;        // Wake is a deadline.
+    uint8_t TimedOut;     // The last wait ended by Wake, not the ring.
+    RINGBUF *Ring;
+    uint32_t Need;
+    uint64_t Wake;
+    uint32_t Resumes;
+    } CORO;
+
+typedef struct COROLOOP {
+    CORO *Head;
+    uint64_t (*Clock)(void);  // getSysTickMS64, or a simulation.
+    uint64_t Now;             // Read once a pass.
+    void (*Idle)(uint64_t wake); // Nothing ready.  May be NULL.   wake may be CORO_NEVER.
+    uint32_t Passes;
+    uint32_t Resumes;
+    } COROLOOP;
+
+void coro_loop_init(COROLOOP*, uint64_t (*clock)(void));
+void coro_add(COROLOOP*, CORO*, int (*fn)(CORO*));
+int  coro_ready(CORO*);
+int  coro_run_once(COROLOOP*);
+void coro_run(COROLOOP*);
+uint64_t coro_next_wake(COROLOOP*);
+
+#if defined(__arm__)
+void coro_idle_wfi(uint64_t wake);
+#endif
+
+// The body of a coroutine is CORO_BEGIN() ... CORO_END().   Locals don't
+// survive a wait - keep state in a struct with the CORO first.   A body
+// can't use switch around a wait, and only one wait per source line.
+
+#define CORO_BEGIN(c)  switch ( (c)->Line ) { case 0:
+
+#define CORO_END(c)    } (c)->Line = 0; return(CORO_DONE)
+
+#define CORO_AWAIT_(c, kind, rb, n, timed, wake) do { \
+        (c)->Wait = (kind);                      \
+        (c)->Ring = (rb);                        \
+        (c)->Need = (n);                         \
+        (c)->Timed = (timed);                    \
+        (c)->Wake = (wake);                      \
+        (c)->Line = __LINE__;                    \
+        __attribute__ ((fallthrough));           \
+        case __LINE__:                           \
+        if ( !coro_ready(c) ) return(CORO_WAITING); \
+        (c)->Wait = CORO_NONE;                   \
+        } while (0)
+
+/// Until there are n bytes to read.
+#define CORO_AWAIT_READABLE(c, rb, n) CORO_AWAIT_(c, CORO_READABLE, rb, n, 0, 0)
+
+/// Until there's room for n bytes.
+#define CORO_AWAIT_WRITABLE(c, rb, n) CORO_AWAIT_(c, CORO_WRITABLE, rb, n, 0, 0)
+
+/// The same, giving up after ms.   Check (c)->TimedOut.
+#define CORO_AWAIT_READABLE_FOR(c, rb, n, ms) CORO_AWAIT_(c, CORO_READABLE, rb, n, 1, (c)->Loop->Now + (ms))
+#define CORO_AWAIT_WRITABLE_FOR(c, rb, n, ms) CORO_AWAIT_(c, CORO_WRITABLE, rb, n, 1, (c)->Loop->Now + (ms))
+
+/// For ms.
+#define CORO_SLEEP(c, ms) CORO_AWAIT_(c, CORO_TIME, 0, 0, 1, (c)->Loop->Now + (ms))
+
+/// Let the others run.
+#define CORO_YIELD(c) do {                       \
+        (c)->Wait = CORO_NONE;                   \
+        (c)->Line = __LINE__;                    \
+        return(CORO_WAITING);                    \
+        case __LINE__: ;                         \
+        } while (0)
+
+#endif
@@ -0,0 +1,193 @@
+// CUnit tests for crash records and the decoder.
+//
+// The records here are synthetic - built on the host with the same
+// crashdump_fill() that the fault handler uses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crashdump.h"
+#include "crashdump-decode.h"
+
+#include "CUnit/Basic.h"
+
+uint32_t regs[17];
+uint32_t fsr[CD_FSR_COUNT];
+uint32_t stack[100];
+
+CRASHDUMP cd;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// Decode into a string.
+static int decode(const void *buf, size_t len, char **text) {
+    size_t size;
+    FILE *f = open_memstream(text, &size);
+    int ret = crashdump_decode(buf, len, f);
+
+    fclose(f);
+    return(ret);
+    }
+
+// A usage fault on the process stack.
+static void make_dump(uint32_t words) {
+    for ( int i = 0; i < 17; i++ ) regs[i] = 0x1000 + i;
+
+    regs[CD_R13_SP] = 0x20001f00;
+    regs[CD_R15_PC] = 0x00004567;
+    regs[CD_PSR] = 0x01000006;
+
+    memset(fsr, 0, sizeof(fsr));
+    fsr[CD_CFSR] = ( 1 << 25 ) | ( 1 << 15 ); // DIVBYZERO, BFARVALID
+    fsr[CD_HFSR] = 1u << 30;
+    fsr[CD_BFAR] = 0xdeadbeef;
+
+    for ( int i = 0; i < 100; i++ ) stack[i] = 0xcafe0000 + i;
+
+    crashdump_fill(&cd, regs, 0xFFFFFFFD, fsr, stack, words);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testStackWords(void) {
+    CU_ASSERT( crashdump_stack_words(0x20001000, 0) == 0 );          // Unknown top.
+    CU_ASSERT( crashdump_stack_words(0x20001000, 0x20001000) == 0 ); // Empty.
+    CU_ASSERT( crashdump_stack_words(0x20002000, 0x20001000) == 0 ); // Past the end.
+    CU_ASSERT( crashdump_stack_words(0x20000ff2, 0x20001000) == 0 ); // Misaligned.
+    CU_ASSERT( crashdump_stack_words(0x20000ff0, 0x20001000) == 4 );
+    CU_ASSERT( crashdump_stack_words(0x20000000, 0x20001000) == CRASHDUMP_STACK_WORDS );
+    }
+
+void testValid(void) {
+    make_dump(10);
+    CU_ASSERT( cd.Magic == CRASHDUMP_MAGIC );
+    CU_ASSERT( cd.StackBase == 0x20001f00 );
+    CU_ASSERT( cd.StackWords == 10 );
+    CU_ASSERT( cd.Stack[9] == 0xcafe0009 && cd.Stack[10] == 0 );
+    CU_ASSERT( crashdump_valid(&cd) );
+
+    // Too much stack gets clipped.
+    make_dump(1000);
+    CU_ASSERT( cd.StackWords == CRASHDUMP_STACK_WORDS );
+    CU_ASSERT( crashdump_valid(&cd) );
+    }
+
+void testDecode(void) {
+    char *text;
+
+    make_dump(6);
+    CU_ASSERT( decode(&cd, sizeof(cd), &text) == CD_OK );
+
+    CU_ASSERT( strstr(text, "Fault 6 on PSP") != NULL );
+    CU_ASSERT( strstr(text, "  pc: 0x00004567") != NULL );
+    CU_ASSERT( strstr(text, "DIVBYZERO") != NULL );
+    CU_ASSERT( strstr(text, "UNDEFINSTR") == NULL );
+    CU_ASSERT( strstr(text, "FORCED") != NULL );
+    CU_ASSERT( strstr(text, "BFAR: 0xdeadbeef") != NULL );
+    CU_ASSERT( strstr(text, "MMFAR") == NULL );
+    CU_ASSERT( strstr(text, "20001f10: cafe0004 cafe0005\n") != NULL );
+    free(text);
+    }
+
+// Every single bit flip has to be caught.
+void testCorrupt(void) {
+    uint8_t *bytes = (uint8_t *) &cd;
+    char *text;
+    int missed = 0;
+
+    make_dump(CRASHDUMP_STACK_WORDS);
+
+    for ( size_t i = 12; i < sizeof(cd); i++ ) {
+        for ( int bit = 0; bit < 8; bit++ ) {
+            bytes[i] ^= 1 << bit;
+
+            if ( decode(&cd, sizeof(cd), &text) != CD_ERR_CRC ) missed++;
+
+            free(text);
+            bytes[i] ^= 1 << bit;
+            }
+        }
+
+    CU_ASSERT( missed == 0 );
+    CU_ASSERT( decode(&cd, sizeof(cd), &text) == CD_OK );
+    free(text);
+    }
+
+void testBadHeader(void) {
+    char *text;
+
+    make_dump(4);
+    CU_ASSERT( decode(&cd, 4, &text) == CD_ERR_SHORT );
+    free(text);
+    CU_ASSERT( decode(&cd, sizeof(cd) - 1, &text) == CD_ERR_SHORT );
+    free(text);
+
+    cd.Version++;
+    CU_ASSERT( decode(&cd, sizeof(cd), &text) == CD_ERR_VERSION );
+    CU_ASSERT( !crashdump_valid(&cd) );
+    free(text);
+
+    cd.Magic = 0;
+    CU_ASSERT( decode(&cd, sizeof(cd), &text) == CD_ERR_MAGIC );
+    free(text);
+    }
+
+// The no-init copy on the target.
+void testCheckClear(void) {
+    crashdump_fill(&crashdump, regs, 0xFFFFFFF9, fsr, stack, 3);
+    CU_ASSERT( crashdump_check() == &crashdump );
+    crashdump_clear();
+    CU_ASSERT( crashdump_check() == NULL );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Crash Dump", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Stack bounds", testStackWords)) ||
+            (NULL == CU_add_test(pSuite, "Valid record", testValid)) ||
+            (NULL == CU_add_test(pSuite, "Decode", testDecode)) ||
+            (NULL == CU_add_test(pSuite, "Corruption", testCorrupt)) ||
+            (NULL == CU_add_test(pSuite, "Bad header", testBadHeader)) ||
+            (NULL == CU_add_test(pSuite, "Check and clear", testCheckClear))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
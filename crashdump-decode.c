@@ -0,0 +1,175 @@
+/// @file crashdump-decode.c
+/// @brief Host side decoder for crash records.
+/// @details
+/// Checks a crash record uploaded from the target, and prints the
+/// registers, the decoded fault status and the stack copy.
+///
+/// Usage: crashdump-decode dumpfile...
+///
+/// Build with -DNO_MAIN to link the decoder into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crashdump.h"
+#include "crashdump-decode.h"
+#include "crc32.h"
+
+typedef struct {
+    uint32_t Bit;
+    const char *Name;
+    } BITNAME;
+
+static const BITNAME cfsr_bits[] = {
+    { 1 << 0,  "IACCVIOL" },  { 1 << 1,  "DACCVIOL" },
+    { 1 << 3,  "MUNSTKERR" }, { 1 << 4,  "MSTKERR" },
+    { 1 << 7,  "MMARVALID" },
+    { 1 << 8,  "IBUSERR" },   { 1 << 9,  "PRECISERR" },
+    { 1 << 10, "IMPRECISERR" }, { 1 << 11, "UNSTKERR" },
+    { 1 << 12, "STKERR" },    { 1 << 15, "BFARVALID" },
+    { 1 << 16, "UNDEFINSTR" }, { 1 << 17, "INVSTATE" },
+    { 1 << 18, "INVPC" },     { 1 << 19, "NOCP" },
+    { 1 << 24, "UNALIGNED" }, { 1 << 25, "DIVBYZERO" },
+    { 0, NULL }
+    };
+
+static const BITNAME hfsr_bits[] = {
+    { 1u << 1,  "VECTTBL" }, { 1u << 30, "FORCED" }, { 1u << 31, "DEBUGEVT" },
+    { 0, NULL }
+    };
+
+static void print_bits(FILE *out, const char *label, uint32_t val, const BITNAME *names) {
+    fprintf(out, "%s: 0x%08x", label, val);
+
+    for ( ; names->Name; names++ ) {
+        if ( val & names->Bit ) fprintf(out, " %s", names->Name);
+        }
+
+    fprintf(out, "\n");
+    }
+
+/// @return a description of a crashdump_decode() error
+const char *crashdump_error(int err) {
+    switch ( err ) {
+        case CD_OK:
+            return("ok");
+
+        case CD_ERR_SHORT:
+            return("truncated record");
+
+        case CD_ERR_MAGIC:
+            return("not a crash record");
+
+        case CD_ERR_VERSION:
+            return("unknown record version");
+
+        case CD_ERR_CRC:
+            return("CRC mismatch");
+
+        default:
+            return("unknown error");
+        }
+    }
+
+/// @brief Check and print a crash record.
+/// @return CD_OK, or one of the CD_ERR codes.
+/// @param buf the record as uploaded
+/// @param len how many bytes
+/// @param out where the report goes
+int crashdump_decode(const void *buf, size_t len, FILE *out) {
+    static const char *regnames[17] = {
+        "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8",
+        "r9", "r10", "r11", "r12", "sp", "lr", "pc", "xpsr"
+        };
+    CRASHDUMP cd;
+    uint32_t crc;
+
+    if ( len < 8 ) return(CD_ERR_SHORT);
+
+    memcpy(&cd, buf, 8);
+
+    if ( cd.Magic != CRASHDUMP_MAGIC ) return(CD_ERR_MAGIC);
+
+    if ( cd.Version != CRASHDUMP_VERSION || cd.Length != sizeof(CRASHDUMP) ) return(CD_ERR_VERSION);
+
+    if ( len < sizeof(CRASHDUMP) ) return(CD_ERR_SHORT);
+
+    memcpy(&cd, buf, sizeof(cd));
+    crc = cd.CRC;
+    cd.CRC = 0;
+
+    if ( crc32(0, &cd, sizeof(cd)) != crc || cd.StackWords > CRASHDUMP_STACK_WORDS ) return(CD_ERR_CRC);
+
+    fprintf(out, "Fault %u on %s, EXC_RETURN 0x%08x\n", cd.Regs[CD_PSR] & 0x1FF,
+            ( cd.ExcReturn & 4 ) ? "PSP" : "MSP", cd.ExcReturn);
+
+    for ( int i = 0; i < 17; i++ ) {
+        fprintf(out, "%4s: 0x%08x%s", regnames[i], cd.Regs[i], ( i % 4 == 3 || i == 16 ) ? "\n" : "  ");
+        }
+
+    print_bits(out, "CFSR", cd.FSR[CD_CFSR], cfsr_bits);
+    print_bits(out, "HFSR", cd.FSR[CD_HFSR], hfsr_bits);
+    fprintf(out, "DFSR: 0x%08x AFSR: 0x%08x\n", cd.FSR[CD_DFSR], cd.FSR[CD_AFSR]);
+
+    if ( cd.FSR[CD_CFSR] & ( 1 << 7 ) ) fprintf(out, "MMFAR: 0x%08x\n", cd.FSR[CD_MMFAR]);
+
+    if ( cd.FSR[CD_CFSR] & ( 1 << 15 ) ) fprintf(out, "BFAR: 0x%08x\n", cd.FSR[CD_BFAR]);
+
+    for ( int i = 0; i < 2; i++ ) {
+        if ( cd.StackSize[i] ) {
+            fprintf(out, "%s: %u of %u bytes used\n", i ? "PSP" : "MSP", cd.StackUsed[i], cd.StackSize[i]);
+            }
+        }
+
+    fprintf(out, "Stack: %u words from 0x%08x\n", cd.StackWords, cd.StackBase);
+
+    for ( uint32_t i = 0; i < cd.StackWords; i++ ) {
+        if ( i % 4 == 0 ) fprintf(out, "%08x:", cd.StackBase + i * 4);
+
+        fprintf(out, " %08x", cd.Stack[i]);
+
+        if ( i % 4 == 3 || i == cd.StackWords - 1 ) fprintf(out, "\n");
+        }
+
+    return(CD_OK);
+    }
+
+#ifndef NO_MAIN
+int main(int argc, char **argv) {
+    int status = 0;
+
+    if ( argc < 2 ) {
+        fprintf(stderr, "usage: %s dumpfile...\n", argv[0]);
+        return(1);
+        }
+
+    for ( int i = 1; i < argc; i++ ) {
+        uint8_t buf[4096];
+        size_t len;
+        int err;
+        FILE *in = fopen(argv[i], "rb");
+
+        if ( in == NULL ) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+            }
+
+        len = fread(buf, 1, sizeof(buf), in);
+        fclose(in);
+
+        if ( argc > 2 ) printf("==== %s\n", argv[i]);
+
+        err = crashdump_decode(buf, len, stdout);
+
+        if ( err ) {
+            fprintf(stderr, "%s: %s\n", argv[i], crashdump_error(err));
+            status = 1;
+            }
+        }
+
+    return(status);
+    }
+#endif
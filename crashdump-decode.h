@@ -0,0 +1,20 @@
+//
+// Host side decoding of crash records.
+//
+
+#ifndef __CRASHDUMP_DECODE_H__
+#define __CRASHDUMP_DECODE_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define CD_OK           0
+#define CD_ERR_SHORT   -1
+#define CD_ERR_MAGIC   -2
+#define CD_ERR_VERSION -3
+#define CD_ERR_CRC     -4
+
+int crashdump_decode(const void *buf, size_t len, FILE *out);
+const char *crashdump_error(int err);
+
+#endif
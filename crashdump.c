@@ -0,0 +1,172 @@
+/// @file crashdump.c
+/// @brief Crash records that survive reset.
+/// @details
+/// The old approach was to print the registers out the UART and spin.
+/// That's slow, it's lost if nobody is watching, and its gone after
+/// the watchdog bites.
+///
+/// Instead, CrashDumpFaultHandler saves the registers with
+/// FH_REGISTER_SAVE, adds the fault status registers and a bounded copy
+/// of the faulting stack, seals the lot with a CRC and resets.   The
+/// record lives in .noinit RAM, so the startup code leaves it alone.
+/// On the next boot, crashdump_check() hands it back for upload, and
+/// crashdump-decode on the host makes sense of it.
+///
+/// The linker script needs a .noinit section that the startup code
+/// doesn't zero:
+/// @code
+///    .noinit (NOLOAD) : { *(.noinit) } > SRAM
+/// @endcode
+///
+/// Install CrashDumpFaultHandler as the HardFault, MemManage, BusFault
+/// and UsageFault vectors, and call crashdump_init() early so the stack
+/// copy knows where each stack ends.   Stacks registered with
+/// stackpaint get their high-water marks recorded as well.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "crashdump.h"
+#include "crc32.h"
+#include "stackpaint.h"
+
+CRASHDUMP crashdump __attribute__ ((section(".noinit")));
+
+static uint32_t stack_top[2]; // MSP, PSP
+
+/// @brief Tell the crash handler where the stacks end.
+/// @param msp_top Initial MSP, from the vector table.
+/// @param psp_top Initial PSP for the app, or 0 if there isn't one.
+void crashdump_init(uint32_t msp_top, uint32_t psp_top) {
+    stack_top[0] = msp_top;
+    stack_top[1] = psp_top;
+    }
+
+/// @brief How much of a stack can we copy?
+/// @return the number of words between sp and top, up to CRASHDUMP_STACK_WORDS
+/// @param sp the stack pointer at the time of the fault
+/// @param top the end of that stack, or 0 if unknown
+// If sp is off in the weeds, copy nothing rather than fault again.
+uint32_t crashdump_stack_words(uint32_t sp, uint32_t top) {
+    uint32_t words;
+
+    if ( top == 0 || sp >= top || ( sp & 3 ) ) return(0);
+
+    words = ( top - sp ) >> 2;
+    return( words < CRASHDUMP_STACK_WORDS ? words : CRASHDUMP_STACK_WORDS );
+    }
+
+/// @brief Build and seal a crash record.
+/// @param cd the record
+/// @param regs 17 registers in FH_REGISTER_SAVE order
+/// @param exc_return LR at exception entry
+/// @param fsr fault status registers, CD_CFSR etc.
+/// @param stack copy of the stack, starting at regs[CD_R13_SP]
+/// @param words how much stack
+void crashdump_fill(CRASHDUMP *cd, const uint32_t *regs, uint32_t exc_return,
+                    const uint32_t *fsr, const uint32_t *stack, uint32_t words) {
+    uint32_t i;
+
+    cd->Magic = CRASHDUMP_MAGIC;
+    cd->Version = CRASHDUMP_VERSION;
+    cd->Length = sizeof(CRASHDUMP);
+    cd->CRC = 0;
+
+    for ( i = 0; i < 17; i++ ) cd->Regs[i] = regs[i];
+
+    cd->ExcReturn = exc_return;
+
+    for ( i = 0; i < CD_FSR_COUNT; i++ ) cd->FSR[i] = fsr[i];
+
+    for ( i = 0; i < STACKPAINT_STACKS; i++ ) {
+        STACKUSAGE usage = { 0, 0 };
+
+        stackpaint_usage(i, &usage);
+        cd->StackSize[i] = usage.Size;
+        cd->StackUsed[i] = usage.Used;
+        }
+
+    if ( words > CRASHDUMP_STACK_WORDS ) words = CRASHDUMP_STACK_WORDS;
+
+    cd->StackBase = regs[CD_R13_SP];
+    cd->StackWords = words;
+
+    for ( i = 0; i < words; i++ ) cd->Stack[i] = stack[i];
+
+    for ( ; i < CRASHDUMP_STACK_WORDS; i++ ) cd->Stack[i] = 0;
+
+    cd->CRC = crc32(0, cd, sizeof(CRASHDUMP));
+    }
+
+/// @brief Check a record.
+/// @return 1 if the record is intact and a version we understand.
+int crashdump_valid(const CRASHDUMP *cd) {
+    CRASHDUMP copy;
+
+    if ( cd->Magic != CRASHDUMP_MAGIC ||
+            cd->Version != CRASHDUMP_VERSION ||
+            cd->Length != sizeof(CRASHDUMP) ||
+            cd->StackWords > CRASHDUMP_STACK_WORDS ) return(0);
+
+    memcpy(&copy, cd, sizeof(copy));
+    copy.CRC = 0;
+    return( crc32(0, &copy, sizeof(copy)) == cd->CRC );
+    }
+
+/// @brief On boot - did we crash last time?
+/// @return the record if there is one, otherwise NULL
+CRASHDUMP *crashdump_check(void) {
+    return( crashdump_valid(&crashdump) ? &crashdump : NULL );
+    }
+
+/// @brief Once the record has been uploaded, get rid of it.
+void crashdump_clear(void) {
+    crashdump.Magic = 0;
+    }
+
+// ------------------------------------------------------------------
+// The fault handler.
+// ------------------------------------------------------------------
+#if defined(__arm__)
+
+#include "fault.h"
+
+#define VWRAP(addr) (*((volatile uint32_t *)(addr)))
+
+uint32_t regdump[17]; // FH_REGISTER_SAVE puts things here.
+
+// Called from the naked handler, with the EXC_RETURN value.
+void crashdump_capture(uint32_t exc_return) {
+    uint32_t fsr[CD_FSR_COUNT];
+    uint32_t sp = regdump[CD_R13_SP];
+    uint32_t top = stack_top[( exc_return & 4 ) ? 1 : 0];
+
+    fsr[CD_CFSR]  = VWRAP(0xE000ED28);
+    fsr[CD_HFSR]  = VWRAP(0xE000ED2C);
+    fsr[CD_DFSR]  = VWRAP(0xE000ED30);
+    fsr[CD_AFSR]  = VWRAP(0xE000ED3C);
+    fsr[CD_MMFAR] = VWRAP(0xE000ED34);
+    fsr[CD_BFAR]  = VWRAP(0xE000ED38);
+
+    crashdump_fill(&crashdump, regdump, exc_return, fsr,
+                   (const uint32_t *) sp, crashdump_stack_words(sp, top));
+
+    // Reset via AIRCR.SYSRESETREQ
+    __asm__ __volatile__ ( "dsb" : : : "memory" );
+    VWRAP(0xE000ED0C) = 0x05FA0004;
+
+    while(1) { ; }
+    }
+
+// This is a one way trip.
+__attribute__ ((naked)) void CrashDumpFaultHandler(void) {
+    FH_REGISTER_SAVE
+
+    __asm__ __volatile__ (
+        ".thumb \n\t"
+        "mov r0, lr\n\t"
+        "b crashdump_capture\n\t"
+        ".align\n\t"
+        : : );
+    }
+#endif
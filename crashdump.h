@@ -0,0 +1,62 @@
+//
+// Crash records that survive reset.
+// Copyright 2016 Robert Sexton
+//
+
+#ifndef __CRASHDUMP_H__
+#define __CRASHDUMP_H__
+
+#include <stdint.h>
+
+#define CRASHDUMP_MAGIC       0x48535243 // "CRSH"
+#define CRASHDUMP_VERSION     2
+#define CRASHDUMP_STACK_WORDS 64
+
+// Register slots, in FH_REGISTER_SAVE order.
+#define CD_R13_SP 13
+#define CD_R14_LR 14
+#define CD_R15_PC 15
+#define CD_PSR    16
+
+// Fault status slots.
+#define CD_CFSR  0
+#define CD_HFSR  1
+#define CD_DFSR  2
+#define CD_AFSR  3
+#define CD_MMFAR 4
+#define CD_BFAR  5
+#define CD_FSR_COUNT 6
+
+typedef struct {
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Length;       // sizeof(CRASHDUMP) for this version.
+    uint32_t CRC;          // Over the whole record, with this field zero.
+
+    uint32_t Regs[17];     // r0-r12, sp, lr, pc, xpsr
+    uint32_t ExcReturn;    // LR on entry.   Bit 2 set means PSP.
+    uint32_t FSR[CD_FSR_COUNT];
+
+    uint32_t StackSize[2]; // MSP, PSP in bytes.   0 if it wasn't painted.
+    uint32_t StackUsed[2]; // High-water marks, in bytes.
+
+    uint32_t StackBase;    // Target address of Stack[0]
+    uint32_t StackWords;   // How much of Stack[] is valid.
+    uint32_t Stack[CRASHDUMP_STACK_WORDS];
+    } CRASHDUMP;
+
+extern CRASHDUMP crashdump;
+
+void crashdump_init(uint32_t msp_top, uint32_t psp_top);
+uint32_t crashdump_stack_words(uint32_t sp, uint32_t top);
+void crashdump_fill(CRASHDUMP*, const uint32_t *regs, uint32_t exc_return,
+                    const uint32_t *fsr, const uint32_t *stack, uint32_t words);
+int  crashdump_valid(const CRASHDUMP*);
+CRASHDUMP *crashdump_check(void);
+void crashdump_clear(void);
+
+#if defined(__arm__)
+void CrashDumpFaultHandler(void);
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/// @file crc32-bench.c
+/// @brief Host benchmark for the CRC-32 implementations.
+/// @details
+/// Times the nibble table crc32() and slice-by-8 crc32_fast() over a
+/// 256 KiB image, and checks that they agree.
+///
+/// Usage: crc32-bench [-n passes] [-t]
+///
+/// -t prints the slice-by-8 tables instead, in the form crc32-fast.c
+/// uses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crc32.h"
+
+#define IMAGE_SIZE ( 256 * 1024 )
+
+static void print_tables(void) {
+    uint32_t t[8][256];
+
+    for ( uint32_t i = 0; i < 256; i++ ) {
+        uint32_t c = i;
+
+        for ( int b = 0; b < 8; b++ ) c = ( c >> 1 ) ^ ( ( c & 1 ) ? 0xEDB88320 : 0 );
+
+        t[0][i] = c;
+        }
+
+    for ( int k = 1; k < 8; k++ ) {
+        for ( int i = 0; i < 256; i++ ) t[k][i] = ( t[k - 1][i] >> 8 ) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+
+    printf("static const uint32_t crc32_slice[8][256] = {\n");
+
+    for ( int k = 0; k < 8; k++ ) {
+        printf("    {\n");
+
+        for ( int i = 0; i < 256; i++ ) {
+            printf("%s0x%08X%s", i % 6 == 0 ? "        " : " ", t[k][i],
+                   i == 255 ? "\n" : ( i % 6 == 5 ? ",\n" : "," ));
+            }
+
+        printf("    }%s\n", k == 7 ? "" : ",");
+        }
+
+    printf("    };\n");
+    }
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+static void bench(const char *name, uint32_t (*fn)(uint32_t, const void *, uint32_t),
+                  const uint8_t *image, int passes) {
+    volatile uint32_t crc = 0;
+    double start = now(), elapsed;
+
+    for ( int i = 0; i < passes; i++ ) crc = fn(crc, image, IMAGE_SIZE);
+
+    elapsed = now() - start;
+    printf("%-12s %8.1f MB/s %8.3f ms per 256 KiB\n", name,
+           passes * (double) IMAGE_SIZE / elapsed / 1e6, elapsed * 1e3 / passes);
+    }
+
+int main(int argc, char **argv) {
+    uint8_t *image = malloc(IMAGE_SIZE);
+    int opt, passes = 200;
+
+    while ( ( opt = getopt(argc, argv, "n:t") ) != -1 ) {
+        switch ( opt ) {
+            case 'n':
+                passes = atoi(optarg);
+                break;
+
+            case 't':
+                print_tables();
+                return(0);
+
+            default:
+                fprintf(stderr, "usage: %s [-n passes] [-t]\n", argv[0]);
+                return(1);
+            }
+        }
+
+    srand(1);
+
+    for ( int i = 0; i < IMAGE_SIZE; i++ ) image[i] = rand();
+
+    if ( crc32(0, image, IMAGE_SIZE) != crc32_fast(0, image, IMAGE_SIZE) ) {
+        fprintf(stderr, "crc32 and crc32_fast disagree\n");
+        return(1);
+        }
+
+    bench("nibble", crc32, image, passes / 10 + 1);
+    bench("slice-by-8", crc32_fast, image, passes);
+
+    free(image);
+    return(0);
+    }
@@ -0,0 +1,211 @@
+// CUnit tests for CRC-32 and image verification.
+//
+// Known answers for the CRC, then the slice-by-8 version against the
+// nibble version at every alignment, then image headers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "imghdr.h"
+
+#include "CUnit/Basic.h"
+
+#define SLOT 4096
+
+uint8_t buf[SLOT + 64];
+
+// Test vectors - zlib's crc32() gives the same.
+struct {
+    const char *Data;
+    uint32_t CRC;
+    } vectors[] = {
+    { "", 0x00000000 },
+    { "a", 0xE8B7BE43 },
+    { "abc", 0x352441C2 },
+    { "123456789", 0xCBF43926 },
+    { "message digest", 0x20159D7F },
+    { "abcdefghijklmnopqrstuvwxyz", 0x4C2750BD },
+    { "The quick brown fox jumps over the lazy dog", 0x414FA339 },
+    { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", 0x7CA94A72 },
+    { NULL, 0 }
+    };
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// An image with a header, vector table at 0x100.
+static IMGHDR *make_image(uint32_t len) {
+    IMGHDR *h = (IMGHDR *) buf;
+
+    for ( uint32_t i = 0; i < len; i++ ) buf[sizeof(IMGHDR) + i] = i * 7 + ( i >> 8 );
+
+    imghdr_make(h, buf + sizeof(IMGHDR), len, 0x0102, 0x100);
+    return(h);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testVectors(void) {
+    for ( int i = 0; vectors[i].Data; i++ ) {
+        uint32_t len = strlen(vectors[i].Data);
+
+        CU_ASSERT( crc32(0, vectors[i].Data, len) == vectors[i].CRC );
+        CU_ASSERT( crc32_fast(0, vectors[i].Data, len) == vectors[i].CRC );
+        }
+
+    memset(buf, 0, 32);
+    CU_ASSERT( crc32_fast(0, buf, 32) == 0x190A55AD );
+    memset(buf, 0xFF, 32);
+    CU_ASSERT( crc32_fast(0, buf, 32) == 0xFF6CAB0B );
+    }
+
+// Every alignment and length, and chained in two pieces.
+void testSlice(void) {
+    int bad = 0;
+
+    for ( int i = 0; i < 200; i++ ) buf[i] = rand();
+
+    for ( int align = 0; align < 8; align++ ) {
+        for ( int len = 0; len < 100; len++ ) {
+            uint32_t want = crc32(0, buf + align, len);
+
+            if ( crc32_fast(0, buf + align, len) != want ) bad++;
+
+            for ( int split = 0; split <= len; split += 3 ) {
+                uint32_t c = crc32_fast(0, buf + align, split);
+
+                if ( crc32_fast(c, buf + align + split, len - split) != want ) bad++;
+                }
+            }
+        }
+
+    CU_ASSERT( bad == 0 );
+    }
+
+void testHeader(void) {
+    IMGHDR *h = make_image(1000);
+
+    CU_ASSERT( imghdr_check(h, SLOT) == IMG_OK );
+    CU_ASSERT( imghdr_verify(h, SLOT) == IMG_OK );
+    CU_ASSERT( imghdr_verify(h, 0) == IMG_OK );
+    CU_ASSERT( imghdr_verify(h, 1000) == IMG_ERR_LENGTH );
+
+    h->Version++;
+    CU_ASSERT( imghdr_verify(h, SLOT) == IMG_ERR_HEADER );
+    h->Version--;
+
+    buf[500] ^= 0x10;
+    CU_ASSERT( imghdr_verify(h, SLOT) == IMG_ERR_CRC );
+    buf[500] ^= 0x10;
+
+    h->Magic = 0;
+    CU_ASSERT( imghdr_verify(h, SLOT) == IMG_ERR_MAGIC );
+
+    // Vector table off the end, or misaligned.
+    h = make_image(1000);
+    imghdr_make(h, buf + sizeof(IMGHDR), 1000, 1, 1020);
+    CU_ASSERT( imghdr_check(h, SLOT) == IMG_ERR_ENTRY );
+    imghdr_make(h, buf + sizeof(IMGHDR), 1000, 1, 0x102);
+    CU_ASSERT( imghdr_check(h, SLOT) == IMG_ERR_ENTRY );
+    imghdr_make(h, buf + sizeof(IMGHDR), 1000, 1, 8);
+    CU_ASSERT( imghdr_check(h, SLOT) == IMG_ERR_ENTRY );
+    }
+
+// Streaming, in every chunk size.
+void testIncremental(void) {
+    uint32_t total = sizeof(IMGHDR) + 3000;
+    IMGVERIFY v;
+    int bad = 0;
+
+    make_image(3000);
+
+    for ( uint32_t chunk = 1; chunk < 300; chunk++ ) {
+        uint32_t sent = 0;
+        int ret = IMG_MORE;
+
+        imgverify_init(&v, SLOT);
+
+        while ( sent < total ) {
+            uint32_t n = ( total - sent < chunk ) ? total - sent : chunk;
+
+            ret = imgverify_feed(&v, buf + sent, n);
+            sent += n;
+
+            if ( sent < total && ret != IMG_MORE ) bad++;
+            }
+
+        if ( ret != IMG_OK ) bad++;
+        }
+
+    CU_ASSERT( bad == 0 );
+
+    // One too many.
+    CU_ASSERT( imgverify_feed(&v, buf, 1) == IMG_ERR_OVERRUN );
+    CU_ASSERT( imgverify_feed(&v, buf, 0) == IMG_ERR_OVERRUN );
+
+    imgverify_init(&v, SLOT);
+    CU_ASSERT( imgverify_feed(&v, buf, total + 1) == IMG_ERR_OVERRUN );
+
+    // Corruption in the last byte.
+    buf[total - 1] ^= 1;
+    imgverify_init(&v, SLOT);
+    CU_ASSERT( imgverify_feed(&v, buf, 100) == IMG_MORE );
+    CU_ASSERT( imgverify_feed(&v, buf + 100, total - 100) == IMG_ERR_CRC );
+    buf[total - 1] ^= 1;
+
+    // Bad header - no need to wait for the rest.
+    ( (IMGHDR *) buf )->Length = SLOT;
+    imgverify_init(&v, SLOT);
+    CU_ASSERT( imgverify_feed(&v, buf, sizeof(IMGHDR)) == IMG_ERR_HEADER );
+    CU_ASSERT( imgverify_feed(&v, buf, 10) == IMG_ERR_HEADER );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("CRC and Image Headers", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "CRC vectors", testVectors)) ||
+            (NULL == CU_add_test(pSuite, "Slice by 8", testSlice)) ||
+            (NULL == CU_add_test(pSuite, "Header", testHeader)) ||
+            (NULL == CU_add_test(pSuite, "Incremental", testIncremental))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,43 @@
+/// @file crc32.c
+/// @brief CRC-32 (IEEE 802.3)
+/// @details
+/// Reflected, polynomial 0xEDB88320, pre and post inverted - the same
+/// CRC as zlib.   Chain calls by passing the previous result back in:
+/// @code
+///    crc = crc32(0, first, n1);
+///    crc = crc32(crc, second, n2);
+/// @endcode
+///
+/// A nibble at a time from a 16 entry table.   64 bytes of flash, and
+/// plenty quick for a fault record.   crc32_fast() in crc32-fast.c
+/// is the big table version, for whole images.
+
+#include <stdint.h>
+
+#include "crc32.h"
+
+static const uint32_t crc32_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+/// @brief Update a CRC.
+/// @return the new CRC
+/// @param crc 0 to start, or the result of the last call
+/// @param buf the data
+/// @param len how many bytes
+uint32_t crc32(uint32_t crc, const void *buf, uint32_t len) {
+    const uint8_t *p = buf;
+
+    crc = ~crc;
+
+    while ( len-- ) {
+        crc ^= *p++;
+        crc = ( crc >> 4 ) ^ crc32_nibble[crc & 0xF];
+        crc = ( crc >> 4 ) ^ crc32_nibble[crc & 0xF];
+        }
+
+    return(~crc);
+    }
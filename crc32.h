@@ -0,0 +1,13 @@
+//
+// CRC-32 (IEEE 802.3, as used by zlib and Ethernet).
+//
+
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <stdint.h>
+
+uint32_t crc32(uint32_t crc, const void *buf, uint32_t len);
+uint32_t crc32_fast(uint32_t crc, const void *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,243 @@
+// CUnit tests for delta updates and the flash simulator.
+//
+// The images are synthetic firmware - code-like bytes with a literal
+// pool of addresses every 64 bytes.   The new version has a block of
+// code inserted near the start, so everything after moves and all of
+// the addresses change.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crc32.h"
+#include "delta.h"
+#include "flashsim.h"
+
+#include "CUnit/Basic.h"
+
+#define IMAGE  ( 128 * 1024 )
+#define PAGE   1024
+#define SLOT   ( 160 * 1024 )
+#define INSERT 300
+
+uint8_t old[IMAGE];
+uint8_t new[IMAGE + INSERT];
+uint8_t page[PAGE];
+uint8_t ringbuf[256];
+
+char path[] = "/tmp/delta-cunitXXXXXX";
+FLASHSIM fs;
+FLASHDEV dev;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void make_images(void) {
+    uint32_t *w;
+
+    srand(42);
+
+    for ( int i = 0; i < IMAGE; i += 2 ) { // Thumb-ish
+        old[i] = rand() & 0x3F;
+        old[i + 1] = 0x40 + ( rand() & 7 );
+        }
+
+    for ( int i = 60; i < IMAGE; i += 64 ) {
+        w = (uint32_t *) &old[i];
+        *w = 0x08000000 + ( ( i * 7 ) % IMAGE );
+        }
+
+    // New code at 8k, and the addresses past it move.
+    memcpy(new, old, 8192);
+
+    for ( int i = 0; i < INSERT; i++ ) new[8192 + i] = rand();
+
+    memcpy(new + 8192 + INSERT, old + 8192, IMAGE - 8192);
+
+    for ( int i = 60; i < IMAGE; i += 64 ) {
+        w = (uint32_t *) &new[i < 8192 ? i : i + INSERT];
+
+        if ( *w - 0x08000000 >= 8192 ) *w += INSERT;
+        }
+
+    new[100000] ^= 0x55; // And a bug fix.
+    }
+
+// Apply a patch through a ring buffer, a little at a time.
+static int apply(const uint8_t *image, uint32_t imagelen, const uint8_t *patch, uint32_t len) {
+    RINGBUF rb;
+    DELTA d;
+    uint32_t sent = 0;
+
+    ringbuffer_init(&rb, ringbuf, sizeof(ringbuf));
+    delta_init(&d, image, imagelen, &dev, PAGE, SLOT - PAGE, page);
+
+    while ( sent < len ) {
+        while ( sent < len && ringbuffer_addchar(&rb, patch[sent]) >= 0 ) sent++;
+
+        if ( delta_pump(&d, &rb) != DELTA_MORE ) break;
+        }
+
+    return(d.Status);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    int fd = mkstemp(path);
+
+    close(fd);
+    unlink(path);
+    make_images();
+
+    if ( flashsim_open(&fs, path, SLOT, PAGE) ) return(-1);
+
+    flashsim_dev(&fs, &dev);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    flashsim_close(&fs);
+    unlink(path);
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testFlashSim(void) {
+    uint8_t data[4] = { 0x12, 0x34, 0x56, 0x78 };
+    FLASHSIM fs2;
+
+    CU_ASSERT( fs.Mem[0] == 0xFF && fs.Mem[SLOT - 1] == 0xFF );
+    CU_ASSERT( flashsim_program(&fs, 10, data, 4) == 0 );
+    CU_ASSERT( memcmp(fs.Mem + 10, data, 4) == 0 );
+
+    // Can't set bits without an erase.
+    data[0] = 0xFF;
+    CU_ASSERT( flashsim_program(&fs, 10, data, 1) == -1 );
+    CU_ASSERT( fs.Mem[10] == 0x12 && fs.Violations == 1 );
+
+    CU_ASSERT( flashsim_program(&fs, SLOT - 2, data, 4) == -1 );
+    CU_ASSERT( flashsim_erase(&fs, SLOT) == -1 );
+
+    // It's a file, so it survives.
+    flashsim_close(&fs);
+    CU_ASSERT( flashsim_open(&fs2, path, SLOT, PAGE) == 0 );
+    CU_ASSERT( fs2.Mem[10] == 0x12 );
+    CU_ASSERT( flashsim_erase(&fs2, 20) == 0 );
+    CU_ASSERT( fs2.Mem[10] == 0xFF && fs2.Erases == 1 );
+    flashsim_close(&fs2);
+
+    flashsim_open(&fs, path, SLOT, PAGE);
+    flashsim_dev(&fs, &dev);
+    }
+
+void testRoundTrip(void) {
+    uint32_t len;
+    uint8_t *patch = delta_make(old, IMAGE, new, sizeof(new), &len);
+    struct timespec t0, t1;
+    double ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_OK );
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    CU_ASSERT( memcmp(fs.Mem + PAGE, new, sizeof(new)) == 0 );
+    CU_ASSERT( fs.Violations == 0 );
+
+    // A patch that isn't much smaller than the image isn't worth it.
+    CU_ASSERT( len < sizeof(new) / 2 );
+
+    ms = ( t1.tv_sec - t0.tv_sec ) * 1e3 + ( t1.tv_nsec - t0.tv_nsec ) * 1e-6;
+    printf("\n    new image %u bytes, patch %u bytes (%.1f%%), applied at %.1f MB/s ... ",
+           (unsigned) sizeof(new), len, 100.0 * len / sizeof(new), sizeof(new) / ms / 1e3);
+    free(patch);
+
+    // No changes at all.
+    patch = delta_make(old, IMAGE, old, IMAGE, &len);
+    CU_ASSERT( len < 32 );
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_OK );
+    CU_ASSERT( memcmp(fs.Mem + PAGE, old, IMAGE) == 0 );
+    free(patch);
+
+    // Nothing in common.
+    patch = delta_make(old, 1000, new + 50000, 5000, &len);
+    CU_ASSERT( apply(old, 1000, patch, len) == DELTA_OK );
+    CU_ASSERT( memcmp(fs.Mem + PAGE, new + 50000, 5000) == 0 );
+    free(patch);
+    }
+
+void testErrors(void) {
+    uint32_t len;
+    uint8_t *patch = delta_make(old, IMAGE, new, sizeof(new), &len);
+    DELTA d;
+
+    // Made against a different image.
+    old[5] ^= 1;
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_ERR_OLD );
+    old[5] ^= 1;
+
+    // Corrupt data.
+    patch[len - 2] ^= 1;
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_ERR_CRC );
+    patch[len - 2] ^= 1;
+
+    // Short and long.
+    CU_ASSERT( apply(old, IMAGE, patch, len - 1) == DELTA_MORE );
+
+    delta_init(&d, old, IMAGE, &dev, PAGE, SLOT - PAGE, page);
+    CU_ASSERT( delta_feed(&d, patch, len) == DELTA_OK );
+    CU_ASSERT( delta_feed(&d, patch, 1) == DELTA_ERR_FORMAT );
+
+    // Too big for the slot.
+    delta_init(&d, old, IMAGE, &dev, PAGE, IMAGE, page);
+    CU_ASSERT( delta_feed(&d, patch, len) == DELTA_ERR_SIZE );
+
+    patch[0] = 0;
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_ERR_MAGIC );
+
+    // Bad op.
+    patch[0] = 'D';
+    patch[sizeof(DELTAHDR)] = 7;
+    CU_ASSERT( apply(old, IMAGE, patch, len) == DELTA_ERR_FORMAT );
+    free(patch);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Delta Update", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Flash simulator", testFlashSim)) ||
+            (NULL == CU_add_test(pSuite, "Round trip", testRoundTrip)) ||
+            (NULL == CU_add_test(pSuite, "Errors", testErrors))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,273 @@
+/// @file delta-make.c
+/// @brief Host tool.  Builds delta patches for delta.c
+/// @details
+/// Greedy matching from a hash of every four byte sequence in the old
+/// image.   Runs that match exactly become COPYs.   The gaps between
+/// matches become ADDs if the old image at the same place is mostly
+/// the same (typically code with a few changed addresses), and INSERTs
+/// otherwise.
+///
+/// After building the patch, applies it to a simulated flash and
+/// reports the sizes and how fast it went.
+///
+/// Usage: delta-make old.bin new.bin out.patch
+///
+/// Build with -DNO_MAIN to link the generator into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crc32.h"
+#include "delta.h"
+
+#define HASH_BITS 16
+#define MIN_MATCH 8
+#define MAX_CHAIN 64
+
+typedef struct {
+    uint8_t *Buf;
+    uint32_t Len;
+    uint32_t Size;
+    } OUTBUF;
+
+static void put(OUTBUF *o, const void *data, uint32_t len) {
+    if ( o->Len + len > o->Size ) {
+        o->Size = ( o->Len + len ) * 2;
+        o->Buf = realloc(o->Buf, o->Size);
+        }
+
+    memcpy(o->Buf + o->Len, data, len);
+    o->Len += len;
+    }
+
+static void put_varint(OUTBUF *o, uint32_t v) {
+    uint8_t b;
+
+    do {
+        b = v & 0x7F;
+        v >>= 7;
+
+        if ( v ) b |= 0x80;
+
+        put(o, &b, 1);
+        }
+    while ( v );
+    }
+
+static void put_op(OUTBUF *o, uint8_t op, uint32_t len, int32_t offset) {
+    put(o, &op, 1);
+    put_varint(o, len);
+
+    if ( op != DELTA_INSERT ) put_varint(o, ( (uint32_t) offset << 1 ) ^ (uint32_t) ( offset >> 31 ));
+    }
+
+static uint32_t hash4(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return( ( v * 2654435761u ) >> ( 32 - HASH_BITS ) );
+    }
+
+static uint32_t match_len(const uint8_t *a, const uint8_t *b, uint32_t max) {
+    uint32_t n = 0;
+
+    while ( n < max && a[n] == b[n] ) n++;
+
+    return(n);
+    }
+
+// The bytes between matches.
+static void gap(OUTBUF *o, const uint8_t *old, uint32_t oldlen, uint32_t *oldpos,
+                const uint8_t *new, uint32_t len) {
+    uint32_t same = 0;
+    uint8_t *diff;
+
+    if ( len == 0 ) return;
+
+    if ( *oldpos + len <= oldlen ) {
+        same = 0;
+
+        for ( uint32_t i = 0; i < len; i++ ) same += ( old[*oldpos + i] == new[i] );
+        }
+
+    if ( same * 2 < len ) {
+        put_op(o, DELTA_INSERT, len, 0);
+        put(o, new, len);
+        return;
+        }
+
+    diff = malloc(len);
+
+    for ( uint32_t i = 0; i < len; i++ ) diff[i] = new[i] - old[*oldpos + i];
+
+    put_op(o, DELTA_ADD, len, 0);
+    put(o, diff, len);
+    free(diff);
+    *oldpos += len;
+    }
+
+/// @brief Make a patch.
+/// @return the patch, to be freed by the caller.
+/// @param old the old image
+/// @param oldlen how big
+/// @param new the new image
+/// @param newlen how big
+/// @param *patchlen returns the patch size
+uint8_t *delta_make(const uint8_t *old, uint32_t oldlen,
+                    const uint8_t *new, uint32_t newlen, uint32_t *patchlen) {
+    int32_t *head = malloc(sizeof(int32_t) << HASH_BITS);
+    int32_t *prev = malloc(sizeof(int32_t) * ( oldlen + 1 ));
+    DELTAHDR h = { DELTA_MAGIC, oldlen, crc32_fast(0, old, oldlen), newlen, crc32_fast(0, new, newlen) };
+    OUTBUF o = { NULL, 0, 0 };
+    uint32_t i = 0, start = 0, oldpos = 0;
+
+    put(&o, &h, sizeof(h));
+
+    memset(head, 0xFF, sizeof(int32_t) << HASH_BITS);
+
+    for ( uint32_t j = 0; j + 4 <= oldlen; j++ ) {
+        uint32_t k = hash4(old + j);
+
+        prev[j] = head[k];
+        head[k] = j;
+        }
+
+    while ( i < newlen ) {
+        uint32_t best = 0, bestpos = 0, max = newlen - i;
+
+        // Carrying on from the last match is free.
+        if ( oldpos + ( i - start ) < oldlen ) {
+            uint32_t p = oldpos + ( i - start );
+            uint32_t n = match_len(old + p, new + i, ( oldlen - p < max ) ? oldlen - p : max);
+
+            if ( n >= MIN_MATCH ) {
+                best = n;
+                bestpos = p;
+                }
+            }
+
+        if ( i + 4 <= newlen ) {
+            int32_t c = head[hash4(new + i)];
+
+            for ( int chain = 0; c >= 0 && chain < MAX_CHAIN; chain++, c = prev[c] ) {
+                uint32_t lim = ( oldlen - c < max ) ? oldlen - c : max;
+                uint32_t n = match_len(old + c, new + i, lim);
+
+                if ( n > best ) {
+                    best = n;
+                    bestpos = c;
+                    }
+                }
+            }
+
+        if ( best < MIN_MATCH ) {
+            i++;
+            continue;
+            }
+
+        gap(&o, old, oldlen, &oldpos, new + start, i - start);
+        put_op(&o, DELTA_COPY, best, (int32_t) ( bestpos - oldpos ));
+        oldpos = bestpos + best;
+        i += best;
+        start = i;
+        }
+
+    gap(&o, old, oldlen, &oldpos, new + start, newlen - start);
+
+    free(head);
+    free(prev);
+    *patchlen = o.Len;
+    return(o.Buf);
+    }
+
+#ifndef NO_MAIN
+#include "flashsim.h"
+
+static uint8_t *slurp(const char *path, uint32_t *len) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+    long size;
+
+    if ( f == NULL ) {
+        perror(path);
+        exit(1);
+        }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(size + 1);
+
+    if ( fread(buf, 1, size, f) != (size_t) size ) {
+        perror(path);
+        exit(1);
+        }
+
+    fclose(f);
+    *len = size;
+    return(buf);
+    }
+
+int main(int argc, char **argv) {
+    uint32_t oldlen, newlen, patchlen, slot;
+    uint8_t *old, *new, *patch, *page;
+    struct timespec t0, t1;
+    FLASHSIM fs;
+    FLASHDEV dev;
+    DELTA d;
+    FILE *f;
+    char path[] = "/tmp/delta-flashXXXXXX";
+    int fd, ret;
+    double ms;
+
+    if ( argc != 4 ) {
+        fprintf(stderr, "usage: %s old.bin new.bin out.patch\n", argv[0]);
+        return(1);
+        }
+
+    old = slurp(argv[1], &oldlen);
+    new = slurp(argv[2], &newlen);
+    patch = delta_make(old, oldlen, new, newlen, &patchlen);
+
+    if ( ( f = fopen(argv[3], "wb") ) == NULL || fwrite(patch, 1, patchlen, f) != patchlen ) {
+        perror(argv[3]);
+        return(1);
+        }
+
+    fclose(f);
+
+    // Check it, on a simulated flash with 1k pages.
+    slot = ( newlen + 1023 ) & ~1023;
+    fd = mkstemp(path);
+    close(fd);
+    unlink(path);
+
+    if ( flashsim_open(&fs, path, slot ? slot : 1024, 1024) ) {
+        perror(path);
+        return(1);
+        }
+
+    flashsim_dev(&fs, &dev);
+    page = malloc(1024);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    delta_init(&d, old, oldlen, &dev, 0, slot, page);
+    ret = delta_feed(&d, patch, patchlen);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    ms = ( t1.tv_sec - t0.tv_sec ) * 1e3 + ( t1.tv_nsec - t0.tv_nsec ) * 1e-6;
+
+    printf("old %u, new %u, patch %u bytes (%.1f%% of new)\n", oldlen, newlen, patchlen,
+           newlen ? 100.0 * patchlen / newlen : 0.0);
+    printf("applied in %.3f ms, %.1f MB/s, %s\n", ms, newlen / ms / 1e3,
+           ret == DELTA_OK ? "verified" : "FAILED");
+
+    flashsim_close(&fs);
+    unlink(path);
+    return( ret == DELTA_OK ? 0 : 1 );
+    }
+#endif
@@ -0,0 +1,279 @@
+/// @file delta.c
+/// @brief Streaming delta firmware updates.
+/// @details
+/// A new image is mostly the old one with things moved about.   A
+/// delta patch says how to rebuild it - copy this run of the old
+/// image, add these small differences to that one, insert these new
+/// bytes - so only the changes go over the link.
+///
+/// The patch is applied as it arrives.  RAM use is the DELTA
+/// structure plus one flash page.   The new image is built a page at
+/// a time into the second slot, and the old image is read in place.
+/// Once the last page is written, the CRC of the new slot is checked
+/// against the one in the patch header.   The header also has the CRC
+/// of the old image that the patch was made against, so the patch is
+/// rejected up front if it doesn't match what's running.
+///
+/// The format is like bsdiff:
+/// @code
+///    DELTAHDR
+///    { op, varint length, [zigzag varint offset], [data] } ...
+/// @endcode
+/// The offset moves the old image position before a COPY or ADD, and
+/// both move it along by the length afterwards.   ADD data is the
+/// byte-wise difference new - old, which is mostly zeros when code
+/// moves - so the patch compresses well if the link does that.
+///
+/// delta-make builds patches on the host.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "delta.h"
+
+// Parser states.
+#define D_HDR  0
+#define D_OP   1
+#define D_LEN  2
+#define D_OFF  3
+#define D_DATA 4
+
+/// @brief Get ready to apply a patch.
+/// @param d patch state
+/// @param old the running image
+/// @param oldmax size of its slot
+/// @param flash the flash to write to
+/// @param newaddr start of the new slot, page aligned
+/// @param newmax size of the new slot
+/// @param page a buffer of flash->PageSize bytes
+void delta_init(DELTA *d, const uint8_t *old, uint32_t oldmax,
+                FLASHDEV *flash, uint32_t newaddr, uint32_t newmax, uint8_t *page) {
+    memset(d, 0, sizeof(*d));
+    d->Old = old;
+    d->OldMax = oldmax;
+    d->Flash = flash;
+    d->NewAddr = newaddr;
+    d->NewMax = newmax;
+    d->Page = page;
+    d->State = D_HDR;
+    d->Status = DELTA_MORE;
+    }
+
+static int write_page(DELTA *d) {
+    uint32_t addr = d->NewAddr + ( ( d->NewPos - 1 ) / d->Flash->PageSize ) * d->Flash->PageSize;
+
+    // Pad out the last page.
+    memset(d->Page + d->PageFill, 0xFF, d->Flash->PageSize - d->PageFill);
+    d->PageFill = 0;
+
+    if ( d->Flash->Erase(d->Flash->Ctx, addr) ||
+            d->Flash->Program(d->Flash->Ctx, addr, d->Page, d->Flash->PageSize) ) return(-1);
+
+    return(0);
+    }
+
+// Output some bytes.   src is the old image, data is from the patch.
+// Either can be NULL, not both.
+static int emit(DELTA *d, const uint8_t *src, const uint8_t *data, uint32_t len) {
+    while ( len ) {
+        uint32_t n = d->Flash->PageSize - d->PageFill;
+        uint8_t *out = d->Page + d->PageFill;
+
+        if ( n > len ) n = len;
+
+        if ( src == NULL ) memcpy(out, data, n);
+        else if ( data == NULL ) memcpy(out, src, n);
+        else {
+            for ( uint32_t i = 0; i < n; i++ ) out[i] = src[i] + data[i];
+            }
+
+        if ( src ) src += n;
+
+        if ( data ) data += n;
+
+        d->PageFill += n;
+        d->NewPos += n;
+        len -= n;
+
+        if ( d->PageFill == d->Flash->PageSize && write_page(d) ) return(-1);
+        }
+
+    return(0);
+    }
+
+// All of the new image is there.   Flush and check it.
+static int finish(DELTA *d) {
+    if ( d->PageFill && write_page(d) ) return( d->Status = DELTA_ERR_FLASH );
+
+    if ( crc32_fast(0, d->Flash->Base + d->NewAddr, d->Hdr.NewLength) != d->Hdr.NewCRC ) {
+        return( d->Status = DELTA_ERR_CRC );
+        }
+
+    return( d->Status = DELTA_OK );
+    }
+
+static int check_header(DELTA *d) {
+    if ( d->Hdr.Magic != DELTA_MAGIC ) return(DELTA_ERR_MAGIC);
+
+    if ( d->Hdr.OldLength > d->OldMax || d->Hdr.NewLength > d->NewMax ) return(DELTA_ERR_SIZE);
+
+    if ( crc32_fast(0, d->Old, d->Hdr.OldLength) != d->Hdr.OldCRC ) return(DELTA_ERR_OLD);
+
+    return(DELTA_MORE);
+    }
+
+/// @brief Apply the next piece of a patch.
+/// @return DELTA_MORE until the new image is complete, then DELTA_OK
+/// or an error.   Errors stick.
+/// @param d patch state
+/// @param buf patch data
+/// @param len how many bytes.  Any size will do.
+int delta_feed(DELTA *d, const uint8_t *buf, uint32_t len) {
+    while ( len && d->Status == DELTA_MORE ) {
+        uint8_t b = *buf;
+        uint32_t n;
+
+        switch ( d->State ) {
+            case D_HDR:
+                n = sizeof(DELTAHDR) - d->HdrCount;
+
+                if ( n > len ) n = len;
+
+                memcpy((uint8_t *) &d->Hdr + d->HdrCount, buf, n);
+                d->HdrCount += n;
+                buf += n;
+                len -= n;
+
+                if ( d->HdrCount < sizeof(DELTAHDR) ) break;
+
+                if ( ( d->Status = check_header(d) ) != DELTA_MORE ) break;
+
+                d->State = D_OP;
+
+                if ( d->Hdr.NewLength == 0 ) finish(d);
+
+                break;
+
+            case D_OP:
+                buf++;
+                len--;
+
+                if ( b > DELTA_INSERT ) {
+                    d->Status = DELTA_ERR_FORMAT;
+                    break;
+                    }
+
+                d->Op = b;
+                d->Varint = 0;
+                d->Shift = 0;
+                d->State = D_LEN;
+                break;
+
+            case D_LEN:
+            case D_OFF:
+                buf++;
+                len--;
+
+                if ( d->Shift > 28 ) {
+                    d->Status = DELTA_ERR_FORMAT;
+                    break;
+                    }
+
+                d->Varint |= ( b & 0x7F ) << d->Shift;
+                d->Shift += 7;
+
+                if ( b & 0x80 ) break;
+
+                if ( d->State == D_LEN ) {
+                    d->Len = d->Varint;
+                    d->Varint = 0;
+                    d->Shift = 0;
+
+                    if ( d->Len == 0 || d->Len > d->Hdr.NewLength - d->NewPos ) {
+                        d->Status = DELTA_ERR_FORMAT;
+                        break;
+                        }
+
+                    d->State = ( d->Op == DELTA_INSERT ) ? D_DATA : D_OFF;
+                    break;
+                    }
+
+                // Zigzag - the low bit is the sign.
+                d->OldPos += ( d->Varint >> 1 ) ^ -( d->Varint & 1 );
+
+                if ( d->OldPos > d->Hdr.OldLength || d->Len > d->Hdr.OldLength - d->OldPos ) {
+                    d->Status = DELTA_ERR_FORMAT;
+                    break;
+                    }
+
+                if ( d->Op == DELTA_COPY ) {
+                    if ( emit(d, d->Old + d->OldPos, NULL, d->Len) ) {
+                        d->Status = DELTA_ERR_FLASH;
+                        break;
+                        }
+
+                    d->OldPos += d->Len;
+                    d->State = D_OP;
+
+                    if ( d->NewPos == d->Hdr.NewLength ) finish(d);
+                    }
+                else d->State = D_DATA;
+
+                break;
+
+            case D_DATA:
+                n = ( len < d->Len ) ? len : d->Len;
+
+                if ( emit(d, d->Op == DELTA_ADD ? d->Old + d->OldPos : NULL, buf, n) ) {
+                    d->Status = DELTA_ERR_FLASH;
+                    break;
+                    }
+
+                if ( d->Op == DELTA_ADD ) d->OldPos += n;
+
+                buf += n;
+                len -= n;
+                d->Len -= n;
+
+                if ( d->Len == 0 ) {
+                    d->State = D_OP;
+
+                    if ( d->NewPos == d->Hdr.NewLength ) finish(d);
+                    }
+
+                break;
+            }
+        }
+
+    // Anything after the end is garbage.
+    if ( len && d->Status == DELTA_OK ) d->Status = DELTA_ERR_FORMAT;
+
+    return(d->Status);
+    }
+
+/// @brief Apply whatever patch data is waiting in a ring buffer.
+/// @return same as delta_feed()
+int delta_pump(DELTA *d, RINGBUF *rb) {
+    int32_t n;
+
+    while ( ( n = ringbuffer_getbulkcount(rb) ) > 0 ) {
+        delta_feed(d, ringbuffer_getbulkpointer(rb), n);
+        ringbuffer_bulkremove(rb, n);
+        }
+
+    return(d->Status);
+    }
+
+#if defined(__arm__)
+#include "imghdr.h"
+
+/// @brief Launch the new image, once the patch has been applied.
+/// The new image gets the full imghdr check as well.
+/// @return only on failure.
+int delta_launch(DELTA *d, uint32_t *runtimep, int mode) {
+    if ( d->Status != DELTA_OK ) return(d->Status);
+
+    return( imghdr_launch((const IMGHDR *) ( d->Flash->Base + d->NewAddr ), d->NewMax, runtimep, mode) );
+    }
+#endif
@@ -0,0 +1,72 @@
+//
+// Streaming delta firmware updates.
+//
+
+#ifndef __DELTA_H__
+#define __DELTA_H__
+
+#include <stdint.h>
+
+#include "flashdev.h"
+#include "ringbuffer.h"
+
+#define DELTA_MAGIC 0x31544C44 // "DLT1"
+
+// Patch operations.   Each is an op byte, a varint length, then:
+#define DELTA_COPY   0 // zigzag varint offset.  Copy from the old image.
+#define DELTA_ADD    1 // zigzag varint offset, then bytes to add to the old image.
+#define DELTA_INSERT 2 // New bytes.
+
+// Results
+#define DELTA_OK         0
+#define DELTA_MORE       1
+#define DELTA_ERR_MAGIC  -1
+#define DELTA_ERR_OLD    -2 // Patch is for a different old image.
+#define DELTA_ERR_FORMAT -3
+#define DELTA_ERR_FLASH  -4
+#define DELTA_ERR_CRC    -5 // New image CRC
+#define DELTA_ERR_SIZE   -6 // Doesn't fit in the slot.
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t OldLength;
+    uint32_t OldCRC;
+    uint32_t NewLength;
+    uint32_t NewCRC;
+    } DELTAHDR;
+
+typedef struct {
+    const uint8_t *Old;  // The running image.
+    uint32_t OldMax;
+    FLASHDEV *Flash;     // Where the new one goes.
+    uint32_t NewAddr;    // Page aligned.
+    uint32_t NewMax;
+    uint8_t *Page;       // One page of RAM.
+    uint32_t PageFill;
+
+    DELTAHDR Hdr;
+    uint32_t HdrCount;
+    int State;
+    int Op;
+    uint32_t Len;
+    uint32_t Varint;
+    int Shift;
+    uint32_t OldPos;
+    uint32_t NewPos;
+    int Status;
+    } DELTA;
+
+void delta_init(DELTA*, const uint8_t *old, uint32_t oldmax,
+                FLASHDEV*, uint32_t newaddr, uint32_t newmax, uint8_t *page);
+int  delta_feed(DELTA*, const uint8_t *buf, uint32_t len);
+int  delta_pump(DELTA*, RINGBUF*);
+
+#if defined(__arm__)
+int delta_launch(DELTA*, uint32_t *runtimep, int mode);
+#endif
+
+// Host side - delta-make.c
+uint8_t *delta_make(const uint8_t *old, uint32_t oldlen,
+                    const uint8_t *new, uint32_t newlen, uint32_t *patchlen);
+
+#endif
@@ -0,0 +1,184 @@
+// CUnit tests for deferred logging.
+//
+// The host build puts the format strings in a dlog_fmt section of the
+// test program itself, so the decoder gets tested against the real
+// thing rather than a hand-made table.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dlog.h"
+#include "dlog-decode.h"
+
+#include "CUnit/Basic.h"
+
+#define RINGSIZE 32
+
+uint32_t ringstore[RINGSIZE];
+uint32_t words[256];
+char line[256];
+
+DLOGTABLE table;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// Pull one message out of the ring and format it.
+static const char *next_message(void) {
+    static uint32_t w[DLOG_MAXARGS + 1];
+    int n = dlog_drain(&dlog_ring, w, 1 + ( ( dlog_ring.Buf[dlog_ring.iRead & dlog_ring.BufMask] ) & 7 ));
+
+    if ( n == 0 ) return(NULL);
+
+    CU_ASSERT( dlog_format(&table, w, n, line, sizeof(line)) == n );
+    return(line);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    dlog_init(&dlog_ring, ringstore, RINGSIZE);
+    table.Strings = __start_dlog_fmt;
+    table.Size = __stop_dlog_fmt - __start_dlog_fmt;
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testNEW(void) {
+    CU_ASSERT( dlog_ring.iWrite == 0 );
+    CU_ASSERT( dlog_drain(&dlog_ring, words, 256) == 0 );
+    CU_ASSERT( table.Size > 0 );
+    }
+
+// What actually goes in the ring.
+void testEncoding(void) {
+    DLOG("two %d %d", 1, 2);
+
+    CU_ASSERT( dlog_ring.iWrite == 3 );
+    CU_ASSERT( ( ringstore[0] & 7 ) == 2 );
+    CU_ASSERT( ( ringstore[0] & ~7u ) < table.Size );
+    CU_ASSERT( ringstore[1] == 1 && ringstore[2] == 2 );
+
+    CU_ASSERT( strcmp(next_message(), "two 1 2") == 0 );
+    }
+
+void testFormats(void) {
+    DLOG("plain");
+    DLOG("hex 0x%08x HEX %X", 0xdeadbeef, 0xabc);
+    DLOG("signed %d %i unsigned %u", -5, -1, 0xFFFFFFFF);
+    DLOG("pad [%5d] [%-5d] [%05u]", 42, 42, 42);
+    DLOG("char %c long %ld %lx pct 100%%", 'A', 7, 0xff);
+    DLOG("ptr %p oct %o", 0x20000000, 8);
+    DLOG("seven %d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7);
+
+    CU_ASSERT( strcmp(next_message(), "plain") == 0 );
+    CU_ASSERT( strcmp(next_message(), "hex 0xdeadbeef HEX ABC") == 0 );
+    CU_ASSERT( strcmp(next_message(), "signed -5 -1 unsigned 4294967295") == 0 );
+    CU_ASSERT( strcmp(next_message(), "pad [   42] [42   ] [00042]") == 0 );
+    CU_ASSERT( strcmp(next_message(), "char A long 7 ff pct 100%") == 0 );
+    CU_ASSERT( strcmp(next_message(), "ptr 0x20000000 oct 10") == 0 );
+    CU_ASSERT( strcmp(next_message(), "seven 1234567") == 0 );
+    CU_ASSERT( next_message() == NULL );
+    }
+
+// Things the decoder has to survive.
+void testBadInput(void) {
+    uint32_t w[4];
+
+    DLOG("needs %d %s", 1, 2);
+    CU_ASSERT( strcmp(next_message(), "needs 1 <%s?>") == 0 );
+
+    DLOG("short %d %d", 3);
+    CU_ASSERT( strcmp(next_message(), "short 3 <missing>") == 0 );
+
+    w[0] = ( table.Size + 64 ) & ~7u;
+    CU_ASSERT( dlog_format(&table, w, 1, line, sizeof(line)) == -1 );
+
+    w[0] = 3; // Three arguments, but only one word.
+    CU_ASSERT( dlog_format(&table, w, 2, line, sizeof(line)) == 0 );
+
+    // Truncated output.
+    DLOG("a long message that won't fit %d", 12345);
+    dlog_drain(&dlog_ring, w, 4);
+    CU_ASSERT( dlog_format(&table, w, 2, line, 8) == 2 );
+    CU_ASSERT( strcmp(line, "a long ") == 0 );
+    }
+
+// Fill it up, then wrap around the end of the storage.
+void testFullAndWrap(void) {
+    int i;
+
+    for ( i = 0; i < 20; i++ ) DLOG("msg %d %d", i, i * 2);
+
+    CU_ASSERT( dlog_ring.Dropped == 20 - RINGSIZE / 3 );
+
+    for ( i = 0; i < RINGSIZE / 3; i++ ) {
+        char expect[32];
+        sprintf(expect, "msg %d %d", i, i * 2);
+        CU_ASSERT( strcmp(next_message(), expect) == 0 );
+        }
+
+    for ( i = 0; i < 100; i++ ) {
+        char expect[32];
+
+        DLOG("again %x", i);
+        sprintf(expect, "again %x", i);
+        CU_ASSERT( strcmp(next_message(), expect) == 0 );
+        }
+    }
+
+// The drain only hands out whole messages.
+void testDrainWhole(void) {
+    DLOG("one %d", 1);
+    DLOG("two %d %d", 1, 2);
+
+    CU_ASSERT( dlog_drain(&dlog_ring, words, 4) == 2 );
+    CU_ASSERT( dlog_drain(&dlog_ring, words, 2) == 0 );
+    CU_ASSERT( dlog_drain(&dlog_ring, words, 3) == 3 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Deferred Log", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Test of fresh structure", testNEW)) ||
+            (NULL == CU_add_test(pSuite, "Encoding", testEncoding)) ||
+            (NULL == CU_add_test(pSuite, "Formats", testFormats)) ||
+            (NULL == CU_add_test(pSuite, "Bad input", testBadInput)) ||
+            (NULL == CU_add_test(pSuite, "Full and wrap", testFullAndWrap)) ||
+            (NULL == CU_add_test(pSuite, "Drain whole messages", testDrainWhole))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
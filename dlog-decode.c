@@ -0,0 +1,173 @@
+/// @file dlog-decode.c
+/// @brief Host side decoder for deferred log messages.
+/// @details
+/// Pulls the format strings out of the dlog_fmt section of the
+/// firmware ELF file, and uses them to format the words that came out
+/// of dlog_drain().
+///
+/// The usual integer conversions work - %d %i %u %x %X %o %c %p, with
+/// flags, width and precision.   Length modifiers are accepted and
+/// ignored, since everything is 32 bits.   There is no %s - the string
+/// would be gone by the time we got here.
+///
+/// Usage: dlog-decode firmware.elf logfile
+///
+/// Build with -DNO_MAIN to link the decoder into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dlog.h"
+#include "dlog-decode.h"
+#include "elfread.h"
+
+// Append to the output, truncating as needed.
+static int put(char *out, int outlen, int pos, const char *s, int len) {
+    for ( int i = 0; i < len && pos < outlen - 1; i++ ) out[pos++] = s[i];
+
+    return(pos);
+    }
+
+/// @brief Format one message.
+/// @return the number of words used, 0 if the message is incomplete,
+/// or -1 if the header doesn't point at a format string.
+/// @param t the format strings
+/// @param words the message, header first
+/// @param nwords how many words are available
+/// @param out where the text goes
+/// @param outlen size of out
+int dlog_format(const DLOGTABLE *t, const uint32_t *words, int nwords, char *out, int outlen) {
+    uint32_t id, nargs;
+    const char *p, *end;
+    int pos = 0, arg = 0;
+
+    if ( nwords < 1 ) return(0);
+
+    id = words[0] & ~( DLOG_ALIGN - 1 );
+    nargs = words[0] & ( DLOG_ALIGN - 1 );
+
+    if ( (int) nargs + 1 > nwords ) return(0);
+
+    if ( id >= t->Size ) return(-1);
+
+    p = t->Strings + id;
+    end = memchr(p, '\0', t->Size - id);
+
+    if ( end == NULL ) return(-1);
+
+    while ( p < end ) {
+        char spec[32], buf[64];
+        int n = 0, len;
+
+        if ( *p != '%' ) {
+            pos = put(out, outlen, pos, p++, 1);
+            continue;
+            }
+
+        // Collect the conversion spec, dropping length modifiers.
+        spec[n++] = *p++;
+
+        while ( p < end && strchr("-+ #0123456789.", *p) && n < 24 ) spec[n++] = *p++;
+
+        while ( p < end && strchr("hlzjt", *p) ) p++;
+
+        if ( p >= end ) break;
+
+        if ( *p == '%' ) {
+            pos = put(out, outlen, pos, p++, 1);
+            continue;
+            }
+
+        if ( !strchr("diuxXocp", *p) ) { // Can't do it.   Show it.
+            len = snprintf(buf, sizeof(buf), "<%%%c?>", *p++);
+            pos = put(out, outlen, pos, buf, len);
+            continue;
+            }
+
+        spec[n++] = ( *p == 'p' ) ? 'x' : *p;
+        spec[n] = '\0';
+
+        if ( *p == 'p' ) pos = put(out, outlen, pos, "0x", 2);
+
+        if ( arg < (int) nargs ) {
+            uint32_t v = words[1 + arg++];
+
+            if ( *p == 'd' || *p == 'i' ) len = snprintf(buf, sizeof(buf), spec, (int32_t) v);
+            else len = snprintf(buf, sizeof(buf), spec, v);
+            }
+        else len = snprintf(buf, sizeof(buf), "<missing>");
+
+        pos = put(out, outlen, pos, buf, len);
+        p++;
+        }
+
+    out[pos] = '\0';
+    return( nargs + 1 );
+    }
+
+#ifndef NO_MAIN
+int main(int argc, char **argv) {
+    ELFFILE ef;
+    Elf32_Shdr *sh;
+    DLOGTABLE t;
+    uint32_t *words = NULL;
+    int n = 0, used;
+    size_t got;
+    char line[1024];
+    FILE *in;
+
+    if ( argc != 3 ) {
+        fprintf(stderr, "usage: %s firmware.elf logfile\n", argv[0]);
+        return(1);
+        }
+
+    if ( elf_open(&ef, argv[1]) ) {
+        fprintf(stderr, "%s: can't read ELF file\n", argv[1]);
+        return(1);
+        }
+
+    if ( ( sh = elf_section(&ef, "dlog_fmt") ) == NULL ||
+            ( t.Strings = elf_section_data(&ef, sh) ) == NULL ) {
+        fprintf(stderr, "%s: no dlog_fmt section\n", argv[1]);
+        return(1);
+        }
+
+    t.Size = sh->sh_size;
+
+    if ( ( in = fopen(argv[2], "rb") ) == NULL ) {
+        perror(argv[2]);
+        return(1);
+        }
+
+    do {
+        words = realloc(words, ( n + 4096 ) * sizeof(uint32_t));
+        got = fread(&words[n], sizeof(uint32_t), 4096, in);
+        n += got;
+        }
+    while ( got == 4096 );
+
+    fclose(in);
+
+    for ( int i = 0; i < n; i += used ) {
+        used = dlog_format(&t, &words[i], n - i, line, sizeof(line));
+
+        if ( used == 0 ) break; // Truncated at the end.
+
+        if ( used < 0 ) {
+            printf("<bad message id 0x%08x>\n", words[i]);
+            used = 1;
+            continue;
+            }
+
+        printf("%s", line);
+
+        if ( line[0] == '\0' || line[strlen(line) - 1] != '\n' ) printf("\n");
+        }
+
+    free(words);
+    elf_close(&ef);
+    return(0);
+    }
+#endif
@@ -0,0 +1,17 @@
+//
+// Host side decoding of deferred log messages.
+//
+
+#ifndef __DLOG_DECODE_H__
+#define __DLOG_DECODE_H__
+
+#include <stdint.h>
+
+typedef struct {
+    const char *Strings; // Contents of the dlog_fmt section.
+    uint32_t Size;
+    } DLOGTABLE;
+
+int dlog_format(const DLOGTABLE*, const uint32_t *words, int nwords, char *out, int outlen);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+@file dlog.c
+@brief Deferred binary logging.
+\copyright Copyright(C) 2016 Robert Sexton
+@details
+Formatting a log message with usprintf costs hundreds of cycles, and
+the format strings cost flash.   Instead:
+
+- DLOG("fmt", args...) puts the format string in the dlog_fmt section,
+  and stores its offset in that section plus the raw arguments into a
+  ring of words.   That's a handful of stores.
+- The argument count goes in the low bits of the offset.  Format
+  strings are 8-byte aligned so there is room.
+- dlog-decode on the host reads the format strings out of the ELF file
+  and does the formatting.
+
+The section doesn't need to be loaded.   In the linker script:
+@code
+    dlog_fmt 0 (INFO) : {
+        __start_dlog_fmt = .;
+        KEEP(*(dlog_fmt))
+        __stop_dlog_fmt = .;
+        }
+@endcode
+GNU ld provides __start_dlog_fmt and __stop_dlog_fmt on its own for
+host builds.
+
+Same model as the ringbuffer - free running word indices, power of two
+sizing, drop when full.   One writer per ring.   If ISRs at different
+priorities need to log, give each one a ring of its own.
+*/
+
+#include <stdint.h>
+
+#include "dlog.h"
+
+DLOGRING dlog_ring;
+
+/// @brief Initialization call.
+/// @param r pointer to a log ring
+/// @param buf storage for the ring
+/// @param size power of two size, in words
+void dlog_init(DLOGRING* r, uint32_t* buf, int size) {
+    r->iRead = 0;
+    r->iWrite = 0;
+    r->Dropped = 0;
+    r->Buf = buf;
+    r->BufSize = size;
+    r->BufMask = size - 1;
+    }
+
+/// @brief Copy whole messages out of the ring, for upload.
+/// @return the number of words copied
+/// @param r pointer to a log ring
+/// @param dst where to put them
+/// @param max how many words will fit
+int dlog_drain(DLOGRING* r, uint32_t *dst, int max) {
+    int count = 0;
+
+    while ( r->iRead != r->iWrite ) {
+        uint32_t header = r->Buf[r->iRead & r->BufMask];
+        int len = 1 + ( header & ( DLOG_ALIGN - 1 ) );
+
+        if ( count + len > max ) break;
+
+        for ( int i = 0; i < len; i++ ) dst[count++] = r->Buf[( r->iRead + i ) & r->BufMask];
+
+        COMPILER_BARRIER();
+        r->iRead += len;
+        }
+
+    return(count);
+    }
@@ -0,0 +1,73 @@
+//
+// Deferred binary logging.   The target stores a format ID and the raw
+// arguments, and the host does the formatting.
+// Copyright(C) 2016 Robert Sexton
+//
+
+#ifndef __DLOG_H__
+#define __DLOG_H__
+
+#include <stdint.h>
+
+#include "barrier.h"
+
+#define DLOG_MAXARGS 7 // The count lives in the low bits of the ID.
+#define DLOG_ALIGN   8
+
+typedef struct {
+    uint32_t iWrite;
+    uint32_t iRead;
+
+    uint32_t Dropped;  // Messages lost because the ring was full.
+
+    uint32_t* Buf;     // Pointer to the storage area.
+    uint32_t BufSize;  // Length of the storage area, in words.
+    uint32_t BufMask;
+    } DLOGRING;
+
+extern DLOGRING dlog_ring;
+
+// Bounds of the format string section.  Provided by the linker.
+extern const char __start_dlog_fmt[];
+extern const char __stop_dlog_fmt[];
+
+void dlog_init(DLOGRING*, uint32_t*, int);
+int  dlog_drain(DLOGRING*, uint32_t *dst, int max);
+
+/// @brief Store one message.   Header word, then the arguments.
+/// @param r pointer to a log ring
+/// @param header format ID | argument count
+/// @param args the arguments, as words
+/// @param nargs how many
+static inline void dlog_write(DLOGRING* r, uint32_t header, const uint32_t *args, int nargs) {
+    uint32_t w = r->iWrite;
+
+    if ( ( w + nargs + 1 ) - r->iRead > r->BufSize ) { // Back-pressure.
+        r->Dropped++;
+        return;
+        }
+
+    r->Buf[w & r->BufMask] = header;
+
+    for ( int i = 0; i < nargs; i++ ) r->Buf[( w + 1 + i ) & r->BufMask] = args[i];
+
+    COMPILER_BARRIER();
+    r->iWrite = w + nargs + 1;
+    }
+
+#define DLOG_NARGS(...) ( sizeof( (uint32_t []) { 0, ## __VA_ARGS__ } ) / sizeof(uint32_t) - 1 )
+
+/// Log a message.   Arguments must be integers that fit in 32 bits.
+/// The format string goes into the dlog_fmt section, and never gets
+/// loaded on the target.
+#define DLOG(fmt, ...) do { \
+    static const char __dlog_fmt[] \
+        __attribute__((section("dlog_fmt"), aligned(DLOG_ALIGN), used)) = fmt; \
+    const uint32_t __dlog_args[] = { 0, ## __VA_ARGS__ }; \
+    _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_MAXARGS, "Too many DLOG arguments"); \
+    dlog_write(&dlog_ring, \
+        (uint32_t) ( (uintptr_t) __dlog_fmt - (uintptr_t) __start_dlog_fmt ) | DLOG_NARGS(__VA_ARGS__), \
+        __dlog_args + 1, DLOG_NARGS(__VA_ARGS__) ); \
+    } while (0)
+
+#endif
@@ -0,0 +1,148 @@
+/// @file elffixture.c
+/// @brief Builds small ELF32 files in memory, for the host tool tests.
+/// @details
+/// Enough of a little endian ARM ELF file for elfread - sections,
+/// a symbol table and the string tables.   No toolchain needed.
+/// Add sections and symbols, then elffix_build() lays it all out.
+/// Symbols must be added in ELF order - STT_FILE and locals first.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "elffixture.h"
+
+void elffix_init(ELFFIXTURE *ef) {
+    memset(ef, 0, sizeof(*ef));
+    ef->NSect = 1;
+    ef->NSym = 1;
+    ef->StrLen = 1;
+    }
+
+/// @return the section index
+int elffix_section(ELFFIXTURE *ef, const char *name, uint32_t type, uint32_t flags,
+                   uint32_t addr, uint32_t size, const void *data) {
+    EFSECTION *s = &ef->Sect[ef->NSect];
+
+    s->Name = name;
+    s->Type = type;
+    s->Flags = flags;
+    s->Addr = addr;
+    s->Size = size;
+    s->Data = data;
+    return(ef->NSect++);
+    }
+
+void elffix_symbol(ELFFIXTURE *ef, const char *name, uint32_t value, uint32_t size,
+                   int type, int bind, int shndx) {
+    Elf32_Sym *s = &ef->Sym[ef->NSym++];
+
+    s->st_name = ef->StrLen;
+    s->st_value = value;
+    s->st_size = size;
+    s->st_info = ELF32_ST_INFO(bind, type);
+    s->st_shndx = shndx;
+
+    strcpy(ef->Str + ef->StrLen, name);
+    ef->StrLen += strlen(name) + 1;
+    }
+
+/// @brief Lay out the file.
+/// @return the image, to be freed by the caller.
+uint8_t *elffix_build(ELFFIXTURE *ef, uint32_t *size) {
+    char shstr[1024];
+    uint32_t shlen = 1, off = sizeof(Elf32_Ehdr), names[EF_MAXSECTIONS + 3];
+    uint32_t offsets[EF_MAXSECTIONS], symoff, stroff, shstroff, shoff;
+    int symtab = ef->NSect, nsect = ef->NSect + 3, firstglobal = 1;
+    uint8_t *image;
+    Elf32_Ehdr *eh;
+    Elf32_Shdr *sh;
+
+    shstr[0] = 0;
+
+    for ( int i = 1; i < ef->NSect; i++ ) {
+        names[i] = shlen;
+        strcpy(shstr + shlen, ef->Sect[i].Name);
+        shlen += strlen(ef->Sect[i].Name) + 1;
+        offsets[i] = off;
+
+        if ( ef->Sect[i].Type != SHT_NOBITS ) off += ( ef->Sect[i].Size + 3 ) & ~3;
+        }
+
+    names[symtab] = shlen;
+    strcpy(shstr + shlen, ".symtab");
+    shlen += 8;
+    names[symtab + 1] = shlen;
+    strcpy(shstr + shlen, ".strtab");
+    shlen += 8;
+    names[symtab + 2] = shlen;
+    strcpy(shstr + shlen, ".shstrtab");
+    shlen += 10;
+
+    symoff = off;
+    off += ef->NSym * sizeof(Elf32_Sym);
+    stroff = off;
+    off += ( ef->StrLen + 3 ) & ~3;
+    shstroff = off;
+    off += ( shlen + 3 ) & ~3;
+    shoff = off;
+    off += nsect * sizeof(Elf32_Shdr);
+
+    image = calloc(1, off);
+    eh = (Elf32_Ehdr *) image;
+    memcpy(eh->e_ident, ELFMAG, SELFMAG);
+    eh->e_ident[EI_CLASS] = ELFCLASS32;
+    eh->e_ident[EI_DATA] = ELFDATA2LSB;
+    eh->e_ident[EI_VERSION] = EV_CURRENT;
+    eh->e_type = ET_EXEC;
+    eh->e_machine = EM_ARM;
+    eh->e_version = EV_CURRENT;
+    eh->e_ehsize = sizeof(Elf32_Ehdr);
+    eh->e_shoff = shoff;
+    eh->e_shentsize = sizeof(Elf32_Shdr);
+    eh->e_shnum = nsect;
+    eh->e_shstrndx = nsect - 1;
+
+    sh = (Elf32_Shdr *) ( image + shoff );
+
+    for ( int i = 1; i < ef->NSect; i++ ) {
+        sh[i].sh_name = names[i];
+        sh[i].sh_type = ef->Sect[i].Type;
+        sh[i].sh_flags = ef->Sect[i].Flags;
+        sh[i].sh_addr = ef->Sect[i].Addr;
+        sh[i].sh_offset = offsets[i];
+        sh[i].sh_size = ef->Sect[i].Size;
+        sh[i].sh_addralign = 4;
+
+        if ( ef->Sect[i].Data && ef->Sect[i].Type != SHT_NOBITS ) {
+            memcpy(image + offsets[i], ef->Sect[i].Data, ef->Sect[i].Size);
+            }
+        }
+
+    // Locals come first.   sh_info is the first global.
+    while ( firstglobal < ef->NSym && ELF32_ST_BIND(ef->Sym[firstglobal].st_info) == STB_LOCAL ) firstglobal++;
+
+    memcpy(image + symoff, ef->Sym, ef->NSym * sizeof(Elf32_Sym));
+    sh[symtab].sh_name = names[symtab];
+    sh[symtab].sh_type = SHT_SYMTAB;
+    sh[symtab].sh_offset = symoff;
+    sh[symtab].sh_size = ef->NSym * sizeof(Elf32_Sym);
+    sh[symtab].sh_link = symtab + 1;
+    sh[symtab].sh_info = firstglobal;
+    sh[symtab].sh_entsize = sizeof(Elf32_Sym);
+
+    memcpy(image + stroff, ef->Str, ef->StrLen);
+    sh[symtab + 1].sh_name = names[symtab + 1];
+    sh[symtab + 1].sh_type = SHT_STRTAB;
+    sh[symtab + 1].sh_offset = stroff;
+    sh[symtab + 1].sh_size = ef->StrLen;
+
+    memcpy(image + shstroff, shstr, shlen);
+    sh[symtab + 2].sh_name = names[symtab + 2];
+    sh[symtab + 2].sh_type = SHT_STRTAB;
+    sh[symtab + 2].sh_offset = shstroff;
+    sh[symtab + 2].sh_size = shlen;
+
+    *size = off;
+    return(image);
+    }
@@ -0,0 +1,36 @@
+//
+// Builds small ELF32 files in memory, for the host tool tests.
+//
+
+#ifndef __ELFFIXTURE_H__
+#define __ELFFIXTURE_H__
+
+#include <stdint.h>
+#include <elf.h>
+
+#define EF_MAXSECTIONS 16
+#define EF_MAXSYMS     256
+
+typedef struct {
+    const char *Name;
+    uint32_t Type, Flags, Addr, Size;
+    const void *Data;   // NULL for NOBITS, or zeros.
+    } EFSECTION;
+
+typedef struct {
+    EFSECTION Sect[EF_MAXSECTIONS];
+    int NSect;                      // Index 0 is the null section.
+    Elf32_Sym Sym[EF_MAXSYMS];
+    int NSym;
+    char Str[8192];                 // Symbol names.
+    uint32_t StrLen;
+    } ELFFIXTURE;
+
+void elffix_init(ELFFIXTURE*);
+int  elffix_section(ELFFIXTURE*, const char *name, uint32_t type, uint32_t flags,
+                    uint32_t addr, uint32_t size, const void *data);
+void elffix_symbol(ELFFIXTURE*, const char *name, uint32_t value, uint32_t size,
+                   int type, int bind, int shndx);
+uint8_t *elffix_build(ELFFIXTURE*, uint32_t *size);
+
+#endif
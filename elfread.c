@@ -0,0 +1,124 @@
+/// @file elfread.c
+/// @brief Minimal ELF32 reader for the host side tools.
+/// @details
+/// The whole file gets read into memory, and everything else is
+/// pointers into that.   Enough for section and symbol tables, which is
+/// all the tools need.   32-bit, little endian - in other words ARM.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfread.h"
+
+/// @brief Read an ELF file into memory.
+/// @return 0 on success, -1 on failure.
+/// @param ef pointer to an ELFFILE structure
+/// @param path file name
+int elf_open(ELFFILE *ef, const char *path) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *image;
+    long size;
+
+    if ( f == NULL ) return(-1);
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    image = malloc(size ? size : 1);
+
+    if ( image == NULL || fread(image, 1, size, f) != (size_t) size ) {
+        free(image);
+        fclose(f);
+        return(-1);
+        }
+
+    fclose(f);
+
+    if ( elf_load(ef, image, size) ) {
+        free(image);
+        return(-1);
+        }
+
+    ef->Owned = 1;
+    return(0);
+    }
+
+/// @brief Use an ELF image that is already in memory.
+/// @return 0 on success, -1 if it isn't a usable ELF32 file.
+/// @param ef pointer to an ELFFILE structure
+/// @param image the file contents.   Must stay around.
+/// @param size how big
+int elf_load(ELFFILE *ef, uint8_t *image, size_t size) {
+    Elf32_Ehdr *eh = (Elf32_Ehdr *) image;
+
+    memset(ef, 0, sizeof(*ef));
+
+    if ( size < sizeof(Elf32_Ehdr) ||
+            memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+            eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+            eh->e_ident[EI_DATA] != ELFDATA2LSB ) return(-1);
+
+    if ( eh->e_shoff == 0 || eh->e_shentsize != sizeof(Elf32_Shdr) ||
+            eh->e_shoff + (size_t) eh->e_shnum * sizeof(Elf32_Shdr) > size ||
+            eh->e_shstrndx >= eh->e_shnum ) return(-1);
+
+    ef->Image = image;
+    ef->Size = size;
+    ef->Ehdr = eh;
+    ef->Shdr = (Elf32_Shdr *) ( image + eh->e_shoff );
+    ef->ShStr = (const char *) elf_section_data(ef, &ef->Shdr[eh->e_shstrndx]);
+
+    return( ef->ShStr ? 0 : -1 );
+    }
+
+void elf_close(ELFFILE *ef) {
+    if ( ef->Owned ) free(ef->Image);
+
+    memset(ef, 0, sizeof(*ef));
+    }
+
+/// @return the name of a section
+const char *elf_section_name(ELFFILE *ef, Elf32_Shdr *sh) {
+    return( ef->ShStr + sh->sh_name );
+    }
+
+/// @return the section header for a name, or NULL.
+/// @param ef pointer to an ELFFILE structure
+/// @param name section name, eg ".text"
+Elf32_Shdr *elf_section(ELFFILE *ef, const char *name) {
+    for ( int i = 0; i < ef->Ehdr->e_shnum; i++ ) {
+        if ( strcmp(elf_section_name(ef, &ef->Shdr[i]), name) == 0 ) return(&ef->Shdr[i]);
+        }
+
+    return(NULL);
+    }
+
+/// @return a pointer to the contents of a section, or NULL if it
+/// has none in the file (.bss) or runs off the end.
+const void *elf_section_data(ELFFILE *ef, Elf32_Shdr *sh) {
+    if ( sh->sh_type == SHT_NOBITS ||
+            (size_t) sh->sh_offset + sh->sh_size > ef->Size ) return(NULL);
+
+    return( ef->Image + sh->sh_offset );
+    }
+
+/// @return the symbol table, or NULL if the file is stripped.
+/// @param ef pointer to an ELFFILE structure
+/// @param *count returns the number of symbols
+/// @param *strtab returns the matching string table
+Elf32_Sym *elf_symbols(ELFFILE *ef, int *count, const char **strtab) {
+    for ( int i = 0; i < ef->Ehdr->e_shnum; i++ ) {
+        Elf32_Shdr *sh = &ef->Shdr[i];
+
+        if ( sh->sh_type != SHT_SYMTAB || sh->sh_link >= ef->Ehdr->e_shnum ) continue;
+
+        *strtab = elf_section_data(ef, &ef->Shdr[sh->sh_link]);
+        *count = sh->sh_size / sizeof(Elf32_Sym);
+        return( (Elf32_Sym *) elf_section_data(ef, sh) );
+        }
+
+    *count = 0;
+    return(NULL);
+    }
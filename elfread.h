@@ -0,0 +1,30 @@
+//
+// Minimal ELF32 reader for the host side tools.
+//
+
+#ifndef __ELFREAD_H__
+#define __ELFREAD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <elf.h>
+
+typedef struct {
+    uint8_t *Image;     // The whole file.
+    size_t Size;
+    int Owned;          // Free Image on close.
+    Elf32_Ehdr *Ehdr;
+    Elf32_Shdr *Shdr;
+    const char *ShStr;  // Section name strings.
+    } ELFFILE;
+
+int  elf_open(ELFFILE*, const char *path);
+int  elf_load(ELFFILE*, uint8_t *image, size_t size);
+void elf_close(ELFFILE*);
+
+Elf32_Shdr *elf_section(ELFFILE*, const char *name);
+const char *elf_section_name(ELFFILE*, Elf32_Shdr*);
+const void *elf_section_data(ELFFILE*, Elf32_Shdr*);
+Elf32_Sym  *elf_symbols(ELFFILE*, int *count, const char **strtab);
+
+#endif
@@ -0,0 +1,215 @@
+// CUnit tests for the ELF footprint analyzer.
+//
+// Two synthetic builds of the same firmware.   The second one has a
+// function that grew, one that went away and one that's new.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "elfread.h"
+#include "elffixture.h"
+#include "elfsize.h"
+
+#include "CUnit/Basic.h"
+
+uint8_t *image[2];
+ELFFILE elf[2];
+
+// Just enough of a GNU ld map file.
+const char *map =
+    "Discarded input sections\n"
+    " .text.unused   0x00000000       0x10 build/main.o\n"
+    "\n"
+    "Linker script and memory map\n"
+    "\n"
+    ".text           0x08000000      0x200\n"
+    " .text          0x08000000      0x100 build/main.o\n"
+    "                0x08000000                main\n"
+    " .text.uart_send\n"
+    "                0x08000100       0x80 drivers/uart.o\n"
+    " .text          0x08000180       0x80 lib/libc.a(memcpy.o)\n"
+    ".data           0x20000000       0x20 load address 0x08000200\n"
+    " .data          0x20000000       0x20 build/main.o\n"
+    " COMMON         0x20000020       0x40 drivers/uart.o\n";
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static uint8_t *build(int version, uint32_t *size) {
+    ELFFIXTURE ef;
+    int text, data, bss;
+    uint32_t grow = version ? 0x20 : 0;
+
+    elffix_init(&ef);
+    text = elffix_section(&ef, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0x08000000, 0x200 + grow, NULL);
+    data = elffix_section(&ef, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0x20000000, 0x20, NULL);
+    bss = elffix_section(&ef, ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0x20000020, 0x40, NULL);
+    elffix_section(&ef, ".comment", SHT_PROGBITS, 0, 0, 0x10, NULL);
+
+    elffix_symbol(&ef, "main.c", 0, 0, STT_FILE, STB_LOCAL, SHN_ABS);
+    elffix_symbol(&ef, "helper", 0x08000041, 0x20, STT_FUNC, STB_LOCAL, text);
+    elffix_symbol(&ef, "$t", 0x08000040, 0, STT_NOTYPE, STB_LOCAL, text);
+    elffix_symbol(&ef, "uart.c", 0, 0, STT_FILE, STB_LOCAL, SHN_ABS);
+    elffix_symbol(&ef, "helper", 0x08000101, 0x10, STT_FUNC, STB_LOCAL, text);
+    elffix_symbol(&ef, "main", 0x08000001, 0x40, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "uart_send", 0x08000111, 0x60 + grow, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "memcpy_label", 0x08000180 + grow, 0, STT_NOTYPE, STB_GLOBAL, text);  // No size.
+    elffix_symbol(&ef, "config", 0x20000000, 0x20, STT_OBJECT, STB_GLOBAL, data);
+    elffix_symbol(&ef, version ? "rxbuf" : "txbuf", 0x20000020, 0x40, STT_OBJECT, STB_GLOBAL, bss);
+    elffix_symbol(&ef, "Default_Handler", 0x08000061, 0x10, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "SysTick_Handler", 0x08000061, 0x10, STT_FUNC, STB_WEAK, text); // Alias
+
+    return( elffix_build(&ef, size) );
+    }
+
+static ESENTRY *find(ESREPORT *r, const char *key) {
+    for ( int i = 0; i < r->Count; i++ ) {
+        if ( strcmp(r->Entries[i].Key, key) == 0 ) return(&r->Entries[i]);
+        }
+
+    return(NULL);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    uint32_t size;
+
+    for ( int i = 0; i < 2; i++ ) {
+        image[i] = build(i, &size);
+
+        if ( elf_load(&elf[i], image[i], size) ) return(-1);
+        }
+
+    return(0);
+    }
+
+int clean_suite1(void) {
+    for ( int i = 0; i < 2; i++ ) {
+        elf_close(&elf[i]);
+        free(image[i]);
+        }
+
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testSymbols(void) {
+    ESREPORT r;
+    ESENTRY *e;
+    int32_t flash = 0, ram = 0;
+
+    CU_ASSERT( elfsize_report(&r, &elf[0], NULL, ES_SYMBOL) == 0 );
+
+    CU_ASSERT( r.Flash == 0x220 && r.Ram == 0x60 );
+
+    // Everything adds up.
+    for ( int i = 0; i < r.Count; i++ ) {
+        flash += r.Entries[i].Flash;
+        ram += r.Entries[i].Ram;
+        }
+
+    CU_ASSERT( flash == r.Flash && ram == r.Ram );
+
+    CU_ASSERT( ( e = find(&r, "main") ) != NULL && e->Flash == 0x40 );
+    CU_ASSERT( ( e = find(&r, "helper (main.c)") ) != NULL && e->Flash == 0x20 );
+    CU_ASSERT( ( e = find(&r, "helper (uart.c)") ) != NULL && e->Flash == 0x10 );
+    CU_ASSERT( ( e = find(&r, "config") ) != NULL && e->Flash == 0x20 && e->Ram == 0x20 );
+    CU_ASSERT( ( e = find(&r, "txbuf") ) != NULL && e->Flash == 0 && e->Ram == 0x40 );
+
+    // Sized from the end of the section, and the last symbol is there.
+    CU_ASSERT( ( e = find(&r, "memcpy_label") ) != NULL && e->Flash == 0x80 );
+
+    // Aliases count once, under the global name.
+    CU_ASSERT( ( e = find(&r, "Default_Handler") ) != NULL && e->Flash == 0x10 );
+    CU_ASSERT( find(&r, "SysTick_Handler") == NULL );
+
+    // Gaps.  0x61..0x70 is covered, 0x70..0x100 isn't, and neither
+    // are the holes at 0x120 and 0x170.
+    CU_ASSERT( ( e = find(&r, "(.text other)") ) != NULL && e->Flash == 0x200 - 0x40 - 0x20 - 0x10 - 0x10 - 0x60 - 0x80 );
+    CU_ASSERT( find(&r, "$t") == NULL );
+    CU_ASSERT( find(&r, "(.comment other)") == NULL );
+    elfsize_free(&r);
+    }
+
+void testGroups(void) {
+    ESREPORT r;
+    ESENTRY *e;
+
+    // Objects from the STT_FILE symbols.   Globals don't have one.
+    CU_ASSERT( elfsize_report(&r, &elf[0], NULL, ES_OBJECT) == 0 );
+    CU_ASSERT( ( e = find(&r, "main.c") ) != NULL && e->Flash == 0x20 );
+    CU_ASSERT( ( e = find(&r, "(global)") ) != NULL );
+    elfsize_free(&r);
+
+    // And from the map file.
+    CU_ASSERT( elfsize_report(&r, &elf[0], map, ES_OBJECT) == 0 );
+    CU_ASSERT( ( e = find(&r, "build/main.o") ) != NULL && e->Flash == 0x40 + 0x20 + 0x10 + 0x20 && e->Ram == 0x20 );
+    CU_ASSERT( ( e = find(&r, "drivers/uart.o") ) != NULL && e->Flash == 0x70 && e->Ram == 0x40 );
+    CU_ASSERT( ( e = find(&r, "lib/libc.a(memcpy.o)") ) != NULL && e->Flash == 0x80 );
+    elfsize_free(&r);
+
+    CU_ASSERT( elfsize_report(&r, &elf[0], map, ES_MODULE) == 0 );
+    CU_ASSERT( find(&r, "build") != NULL );
+    CU_ASSERT( find(&r, "drivers") != NULL );
+    CU_ASSERT( ( e = find(&r, "libc.a") ) != NULL && e->Flash == 0x80 );
+    elfsize_free(&r);
+    }
+
+void testDiff(void) {
+    ESREPORT a, b, d;
+    ESENTRY *e;
+
+    elfsize_report(&a, &elf[0], NULL, ES_SYMBOL);
+    elfsize_report(&b, &elf[1], NULL, ES_SYMBOL);
+
+    CU_ASSERT( elfsize_diff(&d, &a, &b) == 3 );
+    CU_ASSERT( d.Flash == 0x20 && d.Ram == 0 );
+    CU_ASSERT( ( e = find(&d, "uart_send") ) != NULL && e->Flash == 0x20 );
+    CU_ASSERT( ( e = find(&d, "txbuf") ) != NULL && e->Ram == -0x40 );
+    CU_ASSERT( ( e = find(&d, "rxbuf") ) != NULL && e->Ram == 0x40 );
+    CU_ASSERT( find(&d, "main") == NULL );
+
+    elfsize_free(&a);
+    elfsize_free(&b);
+    elfsize_free(&d);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("ELF Size", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Symbols", testSymbols)) ||
+            (NULL == CU_add_test(pSuite, "Objects and modules", testGroups)) ||
+            (NULL == CU_add_test(pSuite, "Diff", testDiff))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,519 @@
+/// @file elfsize.c
+/// @brief Host tool.  Flash and RAM footprint from an ELF file.
+/// @details
+/// Reads the section and symbol tables directly, rather than guessing
+/// sizes from the gaps in nm output.
+///
+/// - Symbol sizes come from the symbol table.   Symbols without one
+///   (assembler labels) run to the next symbol or the end of their
+///   section, never past it.
+/// - Aliases at the same address are only counted once, and any bytes
+///   no symbol covers - padding, literal pools - show up as
+///   "(.section other)", so the totals always add up.
+/// - Allocated sections with contents count as flash, writable ones as
+///   RAM.   .data counts as both, since it's loaded from flash.
+/// - Objects come from the linker map file, if there's one next to
+///   the ELF file (firmware.elf -> firmware.map).   Otherwise, static
+///   symbols are matched up with the STT_FILE symbol before them and
+///   globals are "(global)".   The module is the library archive or the
+///   directory the object is in.
+///
+/// With two files, prints what changed.   -t sets a regression limit
+/// in bytes.   Anything that grew by more is flagged, and the exit
+/// status is 1 if the flash or RAM totals did.
+///
+/// Usage: elfsize [-g symbol|object|module] [-n count] [-t bytes] old.elf [new.elf]
+///
+/// Build with -DNO_MAIN to link the analyzer into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elfread.h"
+#include "elfsize.h"
+
+typedef struct {
+    uint32_t Addr;
+    uint32_t Size;
+    const char *Object;
+    } MAPRANGE;
+
+typedef struct {
+    const char *Name;
+    const char *Object;
+    uint32_t Addr;
+    uint32_t Size;
+    int Section;
+    int Local;
+    } SYM;
+
+// --------------------------------------------------------------------
+// Map files
+// --------------------------------------------------------------------
+
+static int range_cmp(const void *a, const void *b) {
+    uint32_t x = ( (const MAPRANGE *) a )->Addr, y = ( (const MAPRANGE *) b )->Addr;
+    return( ( x > y ) - ( x < y ) );
+    }
+
+// Input section lines from a GNU ld map file:
+//   " .text.foo      0x08000100       0x24 build/foo.o"
+// or, with a long section name, split over two lines.
+static MAPRANGE *map_parse(char *map, int *count) {
+    MAPRANGE *r = NULL;
+    int n = 0, size = 0, started = 0, pending = 0;
+    char *line, *save;
+
+    for ( line = strtok_r(map, "\n", &save); line; line = strtok_r(NULL, "\n", &save) ) {
+        char obj[1024];
+        unsigned long addr, len;
+        char *p;
+
+        if ( strstr(line, "Linker script and memory map") ) started = 1;
+
+        if ( !started ) continue;
+
+        if ( line[0] == ' ' && ( line[1] == '.' || strncmp(line + 1, "COMMON", 6) == 0 ) ) {
+            p = line + 1 + strcspn(line + 1, " \t");
+
+            if ( *p == 0 ) {  // Section name on its own.
+                pending = 1;
+                continue;
+                }
+            }
+        else if ( pending && line[0] == ' ' ) p = line;
+        else p = NULL;
+
+        pending = 0;
+
+        if ( p == NULL || sscanf(p, " 0x%lx 0x%lx %1023[^\n]", &addr, &len, obj) != 3 || len == 0 ) continue;
+
+        if ( n == size ) {
+            size = size ? size * 2 : 256;
+            r = realloc(r, size * sizeof(MAPRANGE));
+            }
+
+        r[n].Addr = addr;
+        r[n].Size = len;
+        r[n++].Object = strdup(obj);
+        }
+
+    qsort(r, n, sizeof(MAPRANGE), range_cmp);
+    *count = n;
+    return(r);
+    }
+
+static const char *map_lookup(MAPRANGE *r, int n, uint32_t addr) {
+    int lo = 0, hi = n - 1, found = -1;
+
+    while ( lo <= hi ) {
+        int mid = ( lo + hi ) / 2;
+
+        if ( r[mid].Addr <= addr ) {
+            found = mid;
+            lo = mid + 1;
+            }
+        else hi = mid - 1;
+        }
+
+    if ( found < 0 || addr >= r[found].Addr + r[found].Size ) return(NULL);
+
+    return(r[found].Object);
+    }
+
+// --------------------------------------------------------------------
+// Grouping
+// --------------------------------------------------------------------
+
+// "lib/libc.a(memcpy.o)" -> "libc.a", "drivers/uart.o" -> "drivers"
+static char *module_of(const char *obj) {
+    const char *paren = strchr(obj, '(');
+    const char *end = paren ? paren : obj + strlen(obj);
+    const char *slash;
+    char *m;
+
+    for ( slash = end; slash > obj && slash[-1] != '/'; slash-- ) ;
+
+    if ( paren ) return( strndup(slash, paren - slash) );
+
+    if ( slash == obj ) return( strdup(".") );
+
+    m = strndup(obj, slash - obj - 1);
+    return(m);
+    }
+
+static char *key_of(const SYM *s, int group) {
+    const char *obj = s->Object ? s->Object : "(global)";
+    char *k;
+
+    switch ( group ) {
+        case ES_OBJECT:
+            return( strdup(obj) );
+
+        case ES_MODULE:
+            return( s->Object ? module_of(s->Object) : strdup(obj) );
+
+        default:
+            // Statics can share a name.
+            if ( s->Local && s->Object ) {
+                k = malloc(strlen(s->Name) + strlen(s->Object) + 4);
+                sprintf(k, "%s (%s)", s->Name, s->Object);
+                return(k);
+                }
+
+            return( strdup(s->Name) );
+        }
+    }
+
+static int entry_cmp(const void *a, const void *b) {
+    return( strcmp(( (const ESENTRY *) a )->Key, ( (const ESENTRY *) b )->Key) );
+    }
+
+// Sort and merge duplicate keys.
+static void merge(ESREPORT *r) {
+    int n = 0;
+
+    qsort(r->Entries, r->Count, sizeof(ESENTRY), entry_cmp);
+
+    for ( int i = 0; i < r->Count; i++ ) {
+        if ( n && strcmp(r->Entries[n - 1].Key, r->Entries[i].Key) == 0 ) {
+            r->Entries[n - 1].Flash += r->Entries[i].Flash;
+            r->Entries[n - 1].Ram += r->Entries[i].Ram;
+            free(r->Entries[i].Key);
+            }
+        else r->Entries[n++] = r->Entries[i];
+        }
+
+    r->Count = n;
+    }
+
+static void add(ESREPORT *r, int *size, char *key, int32_t flash, int32_t ram) {
+    if ( r->Count == *size ) {
+        *size = *size ? *size * 2 : 256;
+        r->Entries = realloc(r->Entries, *size * sizeof(ESENTRY));
+        }
+
+    r->Entries[r->Count].Key = key;
+    r->Entries[r->Count].Flash = flash;
+    r->Entries[r->Count++].Ram = ram;
+    }
+
+static int sym_cmp(const void *a, const void *b) {
+    const SYM *x = a, *y = b;
+
+    if ( x->Section != y->Section ) return( x->Section - y->Section );
+
+    if ( x->Addr != y->Addr ) return( ( x->Addr > y->Addr ) - ( x->Addr < y->Addr ) );
+
+    // Globals first, so aliases are reported by their public name.
+    if ( x->Local != y->Local ) return( x->Local - y->Local );
+
+    return( ( x->Size < y->Size ) - ( x->Size > y->Size ) );
+    }
+
+static int is_flash(Elf32_Shdr *sh) {
+    return( ( sh->sh_flags & SHF_ALLOC ) && sh->sh_type != SHT_NOBITS );
+    }
+
+static int is_ram(Elf32_Shdr *sh) {
+    return( ( sh->sh_flags & SHF_ALLOC ) && ( sh->sh_flags & SHF_WRITE ) );
+    }
+
+/// @brief Work out where the bytes went.
+/// @return 0, or -1 if there's no symbol table.
+/// @param r the report
+/// @param ef the ELF file
+/// @param map linker map file contents, or NULL.   Gets chopped up.
+/// @param group ES_SYMBOL, ES_OBJECT or ES_MODULE
+int elfsize_report(ESREPORT *r, ELFFILE *ef, const char *map, int group) {
+    const char *strtab, *file = NULL;
+    Elf32_Sym *es;
+    MAPRANGE *ranges = NULL;
+    SYM *syms;
+    int count, n = 0, size = 0, nranges = 0;
+    char *mapcopy = NULL;
+
+    memset(r, 0, sizeof(*r));
+
+    if ( ( es = elf_symbols(ef, &count, &strtab) ) == NULL ) return(-1);
+
+    if ( map ) {
+        mapcopy = strdup(map);
+        ranges = map_parse(mapcopy, &nranges);
+        }
+
+    syms = malloc(( count + 1 ) * sizeof(SYM));
+
+    for ( int i = 0; i < count; i++ ) {
+        int type = ELF32_ST_TYPE(es[i].st_info);
+        Elf32_Shdr *sh;
+
+        if ( type == STT_FILE ) {
+            file = strtab + es[i].st_name;
+            continue;
+            }
+
+        if ( ( type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE ) ||
+                es[i].st_shndx == SHN_UNDEF || es[i].st_shndx >= ef->Ehdr->e_shnum ||
+                es[i].st_name == 0 ) continue;
+
+        sh = &ef->Shdr[es[i].st_shndx];
+
+        if ( !( sh->sh_flags & SHF_ALLOC ) ) continue;
+
+        // Skip mapping symbols - $t, $d, $a
+        if ( strtab[es[i].st_name] == '$' ) continue;
+
+        syms[n].Name = strtab + es[i].st_name;
+        syms[n].Addr = es[i].st_value & ( type == STT_FUNC ? ~1 : ~0 );
+        syms[n].Size = es[i].st_size;
+        syms[n].Section = es[i].st_shndx;
+        syms[n].Local = ( ELF32_ST_BIND(es[i].st_info) == STB_LOCAL );
+        syms[n].Object = nranges ? map_lookup(ranges, nranges, syms[n].Addr) :
+                         ( syms[n].Local ? file : NULL );
+        n++;
+        }
+
+    qsort(syms, n, sizeof(SYM), sym_cmp);
+
+    // Totals, and the bytes in each section.
+    for ( int s = 0; s < ef->Ehdr->e_shnum; s++ ) {
+        Elf32_Shdr *sh = &ef->Shdr[s];
+        uint32_t cursor = sh->sh_addr, end = sh->sh_addr + sh->sh_size, covered = 0;
+        int flash = is_flash(sh), ram = is_ram(sh);
+
+        if ( !flash && !ram ) continue;
+
+        r->Flash += flash ? sh->sh_size : 0;
+        r->Ram += ram ? sh->sh_size : 0;
+
+        for ( int i = 0; i < n; i++ ) {
+            uint32_t len, send;
+
+            if ( syms[i].Section != s ) continue;
+
+            len = syms[i].Size;
+
+            if ( len == 0 ) { // Up to the next one.
+                int j = i + 1;
+
+                while ( j < n && syms[j].Section == s && syms[j].Addr == syms[i].Addr ) j++;
+
+                len = ( ( j < n && syms[j].Section == s ) ? syms[j].Addr : end ) - syms[i].Addr;
+                }
+
+            send = syms[i].Addr + len;
+
+            if ( send > end ) send = end;
+
+            if ( syms[i].Addr < cursor ) len = ( send > cursor ) ? send - cursor : 0;
+            else len = send - syms[i].Addr;
+
+            if ( send > cursor ) cursor = send;
+
+            if ( len == 0 ) continue; // An alias.
+
+            covered += len;
+            add(r, &size, key_of(&syms[i], group), flash ? len : 0, ram ? len : 0);
+            }
+
+        if ( covered < sh->sh_size ) {
+            char *k = malloc(strlen(elf_section_name(ef, sh)) + 10);
+            uint32_t len = sh->sh_size - covered;
+
+            sprintf(k, "(%s other)", elf_section_name(ef, sh));
+            add(r, &size, k, flash ? len : 0, ram ? len : 0);
+            }
+        }
+
+    merge(r);
+
+    free(syms);
+
+    for ( int i = 0; i < nranges; i++ ) free((char *) ranges[i].Object);
+
+    free(ranges);
+    free(mapcopy);
+    return(0);
+    }
+
+/// @brief What changed between two builds.
+/// @return the number of entries that changed
+/// @param out the differences.   Totals too.
+/// @param old the old build
+/// @param new the new build
+int elfsize_diff(ESREPORT *out, const ESREPORT *old, const ESREPORT *new) {
+    int i = 0, j = 0, size = 0;
+
+    memset(out, 0, sizeof(*out));
+    out->Flash = new->Flash - old->Flash;
+    out->Ram = new->Ram - old->Ram;
+
+    while ( i < old->Count || j < new->Count ) {
+        int c = ( i == old->Count ) ? 1 : ( j == new->Count ) ? -1 :
+                strcmp(old->Entries[i].Key, new->Entries[j].Key);
+        int32_t flash, ram;
+        const char *key;
+
+        if ( c < 0 ) {
+            key = old->Entries[i].Key;
+            flash = -old->Entries[i].Flash;
+            ram = -old->Entries[i++].Ram;
+            }
+        else if ( c > 0 ) {
+            key = new->Entries[j].Key;
+            flash = new->Entries[j].Flash;
+            ram = new->Entries[j++].Ram;
+            }
+        else {
+            key = new->Entries[j].Key;
+            flash = new->Entries[j].Flash - old->Entries[i].Flash;
+            ram = new->Entries[j++].Ram - old->Entries[i++].Ram;
+            }
+
+        if ( flash || ram ) add(out, &size, strdup(key), flash, ram);
+        }
+
+    return(out->Count);
+    }
+
+void elfsize_free(ESREPORT *r) {
+    for ( int i = 0; i < r->Count; i++ ) free(r->Entries[i].Key);
+
+    free(r->Entries);
+    memset(r, 0, sizeof(*r));
+    }
+
+#ifndef NO_MAIN
+static int32_t iabs(int32_t x) {
+    return( x < 0 ? -x : x );
+    }
+
+// Biggest first.   For diffs, biggest change first.
+static int big_cmp(const void *a, const void *b) {
+    const ESENTRY *x = a, *y = b;
+    int32_t sx = iabs(x->Flash) + iabs(x->Ram), sy = iabs(y->Flash) + iabs(y->Ram);
+
+    if ( sx != sy ) return( ( sx < sy ) - ( sx > sy ) );
+
+    return( strcmp(x->Key, y->Key) );
+    }
+
+// Load an ELF file and the map file next to it.
+static int load(ESREPORT *r, const char *path, int group) {
+    char mappath[1024];
+    char *map = NULL;
+    const char *dot = strrchr(path, '.');
+    ELFFILE ef;
+    FILE *f;
+    int ret;
+
+    if ( elf_open(&ef, path) ) {
+        fprintf(stderr, "%s: can't read ELF file\n", path);
+        return(-1);
+        }
+
+    snprintf(mappath, sizeof(mappath), "%.*s.map", dot ? (int) ( dot - path ) : (int) strlen(path), path);
+
+    if ( ( f = fopen(mappath, "r") ) != NULL ) {
+        long size;
+
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        map = calloc(1, size + 1);
+
+        if ( fread(map, 1, size, f) != (size_t) size ) size = 0;
+
+        map[size] = 0;
+        fclose(f);
+        }
+
+    if ( ( ret = elfsize_report(r, &ef, map, group) ) != 0 ) fprintf(stderr, "%s: no symbol table\n", path);
+
+    free(map);
+
+    // Keys point into our own copies, so the file can go.
+    elf_close(&ef);
+    return(ret);
+    }
+
+int main(int argc, char **argv) {
+    static const char *groups[] = { "symbol", "object", "module" };
+    int opt, group = ES_SYMBOL, limit = 40, status = 0;
+    long threshold = -1;
+    ESREPORT old, new, diff;
+
+    while ( ( opt = getopt(argc, argv, "g:n:t:") ) != -1 ) {
+        switch ( opt ) {
+            case 'g':
+                for ( group = 0; group < 3 && strcmp(optarg, groups[group]); group++ ) ;
+
+                if ( group == 3 ) argc = 0;
+
+                break;
+
+            case 'n':
+                limit = atoi(optarg);
+                break;
+
+            case 't':
+                threshold = atol(optarg);
+                break;
+
+            default:
+                argc = 0;
+                break;
+            }
+        }
+
+    if ( argc - optind < 1 || argc - optind > 2 ) {
+        fprintf(stderr, "usage: %s [-g symbol|object|module] [-n count] [-t bytes] old.elf [new.elf]\n", argv[0]);
+        return(2);
+        }
+
+    if ( load(&old, argv[optind], group) ) return(2);
+
+    if ( argc - optind == 1 ) {
+        qsort(old.Entries, old.Count, sizeof(ESENTRY), big_cmp);
+        printf("%8s %8s  %s\n", "flash", "ram", groups[group]);
+
+        for ( int i = 0; i < old.Count && i < limit; i++ ) {
+            printf("%8d %8d  %s\n", old.Entries[i].Flash, old.Entries[i].Ram, old.Entries[i].Key);
+            }
+
+        printf("%8d %8d  total\n", old.Flash, old.Ram);
+        elfsize_free(&old);
+        return(0);
+        }
+
+    if ( load(&new, argv[optind + 1], group) ) return(2);
+
+    elfsize_diff(&diff, &old, &new);
+    qsort(diff.Entries, diff.Count, sizeof(ESENTRY), big_cmp);
+    printf("%8s %8s  %s\n", "flash", "ram", groups[group]);
+
+    for ( int i = 0; i < diff.Count && i < limit; i++ ) {
+        int flag = threshold >= 0 && ( diff.Entries[i].Flash > threshold || diff.Entries[i].Ram > threshold );
+
+        printf("%+8d %+8d  %s%s\n", diff.Entries[i].Flash, diff.Entries[i].Ram,
+               diff.Entries[i].Key, flag ? "  <-- over limit" : "");
+        }
+
+    printf("%+8d %+8d  total (flash %d -> %d, ram %d -> %d)\n", diff.Flash, diff.Ram,
+           old.Flash, new.Flash, old.Ram, new.Ram);
+
+    if ( threshold >= 0 && ( diff.Flash > threshold || diff.Ram > threshold ) ) {
+        printf("REGRESSION: grew by more than %ld bytes\n", threshold);
+        status = 1;
+        }
+
+    elfsize_free(&old);
+    elfsize_free(&new);
+    elfsize_free(&diff);
+    return(status);
+    }
+#endif
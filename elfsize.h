@@ -0,0 +1,34 @@
+//
+// Flash and RAM footprint from an ELF file.
+//
+
+#ifndef __ELFSIZE_H__
+#define __ELFSIZE_H__
+
+#include <stdint.h>
+
+#include "elfread.h"
+
+// How to group things.
+#define ES_SYMBOL 0
+#define ES_OBJECT 1
+#define ES_MODULE 2
+
+typedef struct {
+    char *Key;
+    int32_t Flash;
+    int32_t Ram;
+    } ESENTRY;
+
+typedef struct {
+    ESENTRY *Entries;   // Sorted by key.
+    int Count;
+    int32_t Flash;      // Totals, from the section headers.
+    int32_t Ram;
+    } ESREPORT;
+
+int  elfsize_report(ESREPORT*, ELFFILE*, const char *map, int group);
+int  elfsize_diff(ESREPORT *out, const ESREPORT *old, const ESREPORT *new);
+void elfsize_free(ESREPORT*);
+
+#endif
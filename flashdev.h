@@ -0,0 +1,20 @@
+//
+// Minimal flash device interface.
+//
+
+#ifndef __FLASHDEV_H__
+#define __FLASHDEV_H__
+
+#include <stdint.h>
+
+// Addresses are offsets into the device.   Reads go straight through
+// Base, since flash is memory mapped.
+typedef struct {
+    int (*Erase)(void *ctx, uint32_t addr);  // The page holding addr.
+    int (*Program)(void *ctx, uint32_t addr, const void *buf, uint32_t len);
+    void *Ctx;
+    const uint8_t *Base;
+    uint32_t PageSize;
+    } FLASHDEV;
+
+#endif
@@ -0,0 +1,332 @@
+// CUnit tests for the flash log.
+//
+// Runs on the file backed flash simulator.   The power loss test cuts
+// the power at every point in a run of appends, remounts, and checks
+// that what comes back is a clean run of records with nothing missing
+// that was synced.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flashsim.h"
+#include "flashlog.h"
+
+#include "CUnit/Basic.h"
+
+#define SECTOR  1024
+#define SECTORS 8
+#define START   SECTOR  // Leave a sector in front, to check offsets.
+#define HDR     16
+
+char path[] = "/tmp/flashlog-cunitXXXXXX";
+FLASHSIM fs;
+FLASHDEV dev;
+FLASHLOG fl;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// Record n is n bytes of n, with n in the tag, and at least 4 bytes.
+static int append(FLASHLOG *l, uint32_t n) {
+    uint8_t data[64];
+    uint32_t len = 4 + n % 60;
+
+    memset(data, n, len);
+    memcpy(data, &n, 4);
+    return( flashlog_append(l, n, data, len) );
+    }
+
+// Read the whole log.   Returns the number of records, and checks that
+// they run in sequence.
+static int check(FLASHLOG *l, uint32_t *first, uint32_t *last) {
+    uint8_t data[64], expect[64];
+    uint32_t pos = l->Tail, n;
+    uint16_t tag;
+    int len, count = 0;
+
+    while ( ( len = flashlog_read(l, &pos, &tag, data, sizeof(data)) ) >= 0 ) {
+        memcpy(&n, data, 4);
+        memset(expect, n, len);
+        memcpy(expect, &n, 4);
+
+        if ( len != (int) ( 4 + n % 60 ) || tag != (uint16_t) n || memcmp(data, expect, len) ) return(-1);
+
+        if ( count == 0 ) *first = n;
+        else if ( n != *last + 1 ) return(-1);
+
+        *last = n;
+        count++;
+        }
+
+    return(count);
+    }
+
+static void blank(void) {
+    memset(fs.Mem, 0xFF, fs.Size);
+    flashsim_power(&fs, -1);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    int fd = mkstemp(path);
+
+    close(fd);
+    unlink(path);
+
+    if ( flashsim_open(&fs, path, START + SECTORS * SECTOR, SECTOR) ) return(-1);
+
+    flashsim_dev(&fs, &dev);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    flashsim_close(&fs);
+    unlink(path);
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testPowerSim(void) {
+    uint8_t data[8] = { 0 };
+
+    blank();
+    flashsim_power(&fs, 5);
+    CU_ASSERT( flashsim_program(&fs, 0, data, 4) == 0 );
+    CU_ASSERT( flashsim_program(&fs, 4, data, 4) == -1 );
+    CU_ASSERT( fs.PowerLost && fs.Mem[4] == 0 && fs.Mem[5] == 0xFF );
+    CU_ASSERT( flashsim_program(&fs, 6, data, 1) == -1 && fs.Mem[6] == 0xFF );
+
+    // The erase that runs out only does half.
+    flashsim_power(&fs, 0);
+    CU_ASSERT( flashsim_erase(&fs, 0) == -1 );
+    CU_ASSERT( fs.Mem[0] == 0xFF && fs.Mem[SECTOR - 1] == 0xFF );
+
+    flashsim_power(&fs, -1);
+    CU_ASSERT( flashsim_program(&fs, SECTOR - 1, data, 1) == 0 );
+    flashsim_power(&fs, 0);
+    CU_ASSERT( flashsim_erase(&fs, 0) == -1 );
+    CU_ASSERT( fs.Mem[SECTOR - 1] == 0 );
+    flashsim_power(&fs, -1);
+    }
+
+void testFormat(void) {
+    blank();
+    CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == -1 );
+    CU_ASSERT( flashlog_format(&fl, &dev, START, 6) == -1 );     // Not a power of two.
+    CU_ASSERT( flashlog_format(&fl, &dev, START, SECTORS) == 0 );
+    CU_ASSERT( fl.Head == HDR && fl.Tail == HDR && flashlog_used(&fl) == 0 );
+    CU_ASSERT( fs.Mem[0] == 0xFF );                               // Before START
+
+    CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == 0 );
+    CU_ASSERT( fl.Head == HDR && fl.Tail == HDR );
+    }
+
+void testAppend(void) {
+    uint32_t first, last, programmed;
+    uint8_t big[SECTOR];
+
+    blank();
+    flashlog_format(&fl, &dev, START, SECTORS);
+    programmed = fs.Programmed;
+
+    // Readable before it's on flash.
+    for ( uint32_t n = 0; n < 20; n++ ) CU_ASSERT( append(&fl, n) == 0 );
+
+    CU_ASSERT( check(&fl, &first, &last) == 20 && first == 0 && last == 19 );
+
+    // Only whole pages went out.   The first one had the header.
+    CU_ASSERT( fl.Head > FLASHLOG_PAGE );
+    CU_ASSERT( fs.Programmed - programmed == ( fl.Head / FLASHLOG_PAGE ) * FLASHLOG_PAGE - HDR );
+
+    // Not synced - the tail end is lost.
+    CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == 0 );
+    CU_ASSERT( check(&fl, &first, &last) < 20 );
+
+    for ( uint32_t n = last + 1; n < 40; n++ ) append(&fl, n);
+
+    CU_ASSERT( flashlog_sync(&fl) == 0 );
+    CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == 0 );
+    CU_ASSERT( check(&fl, &first, &last) == 40 && last == 39 );
+
+    // Too big for a sector.
+    CU_ASSERT( flashlog_append(&fl, 0, big, SECTOR - HDR - 8 + 1) == -1 );
+    CU_ASSERT( flashlog_append(&fl, 0, big, FLASHLOG_MAX + 1) == -1 );
+    }
+
+void testWrap(void) {
+    uint32_t first, last, head, tail, lo = UINT32_MAX, hi = 0;
+
+    blank();
+    flashlog_format(&fl, &dev, START, SECTORS);
+
+    for ( uint32_t n = 0; n < 2000; n++ ) {
+        append(&fl, n);
+
+        // Mount finds the same place, wherever the head is.
+        if ( n % 97 == 0 ) {
+            flashlog_sync(&fl);
+            head = fl.Head;
+            tail = fl.Tail;
+            CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == 0 );
+            CU_ASSERT( fl.Head == head && fl.Tail == tail );
+            }
+        }
+
+    CU_ASSERT( flashlog_used(&fl) <= SECTORS * SECTOR );
+    CU_ASSERT( flashlog_used(&fl) > ( SECTORS - 1 ) * SECTOR - SECTOR / 2 );
+    CU_ASSERT( check(&fl, &first, &last) > 0 && last == 1999 && first > 0 );
+
+    // Rotation wears every sector the same.
+    for ( uint32_t i = 0; i < SECTORS; i++ ) {
+        uint32_t e = flashlog_erases(&fl, i);
+
+        if ( e < lo ) lo = e;
+        if ( e > hi ) hi = e;
+        }
+
+    CU_ASSERT( lo > 1 && hi - lo <= 1 );
+
+    // A reader that fell behind skips to the tail.
+    {
+        uint32_t pos = fl.Tail - 100;
+        uint16_t tag;
+        uint8_t data[64];
+
+        CU_ASSERT( flashlog_read(&fl, &pos, &tag, data, sizeof(data)) > 0 && tag == (uint16_t) first );
+    }
+    }
+
+void testPositionWrap(void) {
+    uint32_t first, last;
+
+    // Start just short of 2^32, so the positions wrap.
+    blank();
+    flashlog_format(&fl, &dev, START, SECTORS);
+    fl.Head = fl.Flushed = fl.Tail = 0 - 3 * SECTOR; // A sector boundary.
+
+    for ( uint32_t n = 0; n < 500; n++ ) append(&fl, n);
+
+    flashlog_sync(&fl);
+    CU_ASSERT( fl.Head < 0x80000000 );
+    CU_ASSERT( flashlog_mount(&fl, &dev, START, SECTORS) == 0 );
+    CU_ASSERT( check(&fl, &first, &last) > 0 && last == 499 );
+    }
+
+void testPowerLoss(void) {
+    int failures = 0, runs = 0;
+
+    for ( int32_t budget = 0; budget < 6 * SECTOR; budget += 7 ) {
+        uint32_t first = 0, last = 0, synced = 0, n, more;
+        int count;
+
+        blank();
+        flashlog_format(&fl, &dev, START, SECTORS);
+
+        // Part way through, so the power goes during wraps too.
+        for ( n = 0; n < 150; n++ ) append(&fl, n);
+
+        flashlog_sync(&fl);
+        synced = n - 1;
+        flashsim_power(&fs, budget);
+
+        for ( ; append(&fl, n) == 0; n++ ) {
+            if ( n % 3 == 0 ) {
+                if ( flashlog_sync(&fl) ) break;
+
+                synced = n;
+                }
+            }
+
+        // Back on.
+        flashsim_power(&fs, -1);
+        runs++;
+
+        if ( flashlog_mount(&fl, &dev, START, SECTORS) ) {
+            failures++;
+            continue;
+            }
+
+        count = check(&fl, &first, &last);
+
+        if ( count <= 0 || last < synced ) {
+            failures++;
+            continue;
+            }
+
+        // And it carries on.
+        for ( more = last + 1; more < last + 100; more++ ) append(&fl, more);
+
+        flashlog_sync(&fl);
+        flashlog_mount(&fl, &dev, START, SECTORS);
+
+        if ( check(&fl, &first, &last) <= 0 || last != more - 1 ) failures++;
+        }
+
+    printf("\n%d power failures, %d bad ", runs, failures);
+    CU_ASSERT( failures == 0 );
+    }
+
+void testThroughput(void) {
+    struct timespec t0, t1;
+    uint32_t records = 200000;
+    double secs;
+
+    blank();
+    flashlog_format(&fl, &dev, START, SECTORS);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for ( uint32_t n = 0; n < records; n++ ) append(&fl, n);
+
+    flashlog_sync(&fl);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) * 1e-9;
+
+    printf("\n%.0f records/s, %.1f MB/s programmed ", records / secs, fs.Programmed / secs / 1e6);
+    CU_ASSERT( fs.Violations == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Flash Log", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Power loss simulation", testPowerSim)) ||
+            (NULL == CU_add_test(pSuite, "Format and mount", testFormat)) ||
+            (NULL == CU_add_test(pSuite, "Append", testAppend)) ||
+            (NULL == CU_add_test(pSuite, "Wrap", testWrap)) ||
+            (NULL == CU_add_test(pSuite, "Position wrap", testPositionWrap)) ||
+            (NULL == CU_add_test(pSuite, "Power loss", testPowerLoss)) ||
+            (NULL == CU_add_test(pSuite, "Throughput", testThroughput))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
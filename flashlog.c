@@ -0,0 +1,369 @@
+/// @file flashlog.c
+/// @brief Log structured circular event log in flash.
+/// @details
+/// Basic Model - RINGBUF, stretched over flash sectors
+/// - Head and Tail are free running byte positions, just like the
+///   ringbuffer indexes.   Used is Head - Tail.   The sector count is
+///   a power of two, so a position maps to a sector with a mask even
+///   after it wraps.
+/// - Each sector starts with a header holding the log position of its
+///   first byte.   Sector i always holds positions where
+///   ( pos / SectorSize ) % Sectors == i.
+/// - Records never span sectors.   Each one has a CRC.
+/// - When the head fills a sector it erases the next one, oldest data
+///   and all.   Every sector gets erased in turn, so wear is level.
+///   Each header keeps an erase count to prove it.
+///
+/// Appends collect in a page buffer, and get programmed a page at a
+/// time.   flashlog_sync() programs a partial page, when something
+/// needs to be on flash right now.
+///
+/// Mounting doesn't read every record.   Going around the sectors from
+/// 0, the positions go up one sector at a time until the head sector,
+/// then drop back to older data (or blank flash).   That's a sorted
+/// list, so a binary search over the headers finds the head sector.
+/// Only that sector's records get read.
+///
+/// Power loss
+/// - An erase that didn't finish leaves a sector with a bad header.
+///   It's always the one after the head, so the search still works.
+///   If it's sector 0, the search starts at sector 1.
+/// - A record that didn't finish fails its CRC.   So might the bytes
+///   after it.   Rather than trust anything past a bad record, the log
+///   moves on to the next sector.
+/// - Records appended but not yet synced are lost.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "flashlog.h"
+
+#define HDRSIZE    sizeof(FLHDR)
+#define RECSIZE    sizeof(FLREC)
+#define PAD4(x)    ( ( (x) + 3 ) & ~3 )
+
+static uint32_t sector_of(FLASHLOG *l, uint32_t pos) {
+    return( ( pos / l->SectorSize ) & ( l->Sectors - 1 ) );
+    }
+
+static uint32_t sector_start(FLASHLOG *l, uint32_t pos) {
+    return( pos - pos % l->SectorSize );
+    }
+
+// Device offset of a log position.
+static uint32_t addr_of(FLASHLOG *l, uint32_t pos) {
+    return( l->Start + sector_of(l, pos) * l->SectorSize + pos % l->SectorSize );
+    }
+
+static const FLHDR *header(FLASHLOG *l, uint32_t sector) {
+    return( (const FLHDR *) ( l->Dev->Base + l->Start + sector * l->SectorSize ) );
+    }
+
+static int header_ok(FLASHLOG *l, uint32_t sector) {
+    const FLHDR *h = header(l, sector);
+
+    return( h->Magic == FLASHLOG_MAGIC &&
+            h->CRC == crc32(0, h, offsetof(FLHDR, CRC)) &&
+            sector_of(l, h->Pos) == sector && h->Pos % l->SectorSize == 0 );
+    }
+
+// Copy out log bytes, from the page buffer if they haven't been
+// programmed yet.
+static void fetch(FLASHLOG *l, uint32_t pos, void *buf, uint32_t len) {
+    uint8_t *p = buf;
+
+    while ( len ) {
+        uint32_t n = FLASHLOG_PAGE - pos % FLASHLOG_PAGE;
+
+        if ( n > len ) n = len;
+
+        if ( pos - l->PageAddr < FLASHLOG_PAGE ) memcpy(p, l->Page + ( pos - l->PageAddr ), n);
+        else memcpy(p, l->Dev->Base + addr_of(l, pos), n);
+
+        pos += n;
+        p += n;
+        len -= n;
+        }
+    }
+
+static int flush(FLASHLOG *l) {
+    uint32_t len = l->Head - l->Flushed;
+    int ret = 0;
+
+    if ( len ) ret = l->Dev->Program(l->Dev->Ctx, addr_of(l, l->Flushed), l->Page + ( l->Flushed - l->PageAddr ), len);
+
+    l->Flushed = l->Head;
+    return(ret);
+    }
+
+// Start the page buffer at a position.   It has to hold whatever is
+// already programmed there.
+static void page_load(FLASHLOG *l, uint32_t pos) {
+    l->PageAddr = pos - pos % FLASHLOG_PAGE;
+    memcpy(l->Page, l->Dev->Base + addr_of(l, l->PageAddr), FLASHLOG_PAGE);
+    }
+
+// Erase the sector for a position and write its header.   The oldest
+// sector's data goes away, so the tail moves up.
+static int sector_begin(FLASHLOG *l, uint32_t pos) {
+    uint32_t sector = sector_of(l, pos);
+    uint32_t oldest = pos - ( l->Sectors - 1 ) * l->SectorSize + HDRSIZE;
+    FLHDR h;
+
+    h.Erases = header_ok(l, sector) ? header(l, sector)->Erases + 1 : 1;
+
+    if ( (int32_t) ( l->Tail - oldest ) < 0 ) l->Tail = oldest;
+
+    // The head stays put until there's a good header.
+    if ( l->Dev->Erase(l->Dev->Ctx, l->Start + sector * l->SectorSize) ) return(-1);
+
+    h.Magic = FLASHLOG_MAGIC;
+    h.Pos = pos;
+    h.CRC = crc32(0, &h, offsetof(FLHDR, CRC));
+
+    if ( l->Dev->Program(l->Dev->Ctx, l->Start + sector * l->SectorSize, &h, HDRSIZE) ) return(-1);
+
+    l->Head = l->Flushed = pos + HDRSIZE;
+    page_load(l, l->Head);
+    return(0);
+    }
+
+static void setup(FLASHLOG *l, FLASHDEV *dev, uint32_t start, uint32_t sectors) {
+    memset(l, 0, sizeof(*l));
+    l->Dev = dev;
+    l->Start = start;
+    l->Sectors = sectors;
+    l->SectorSize = dev->PageSize;
+    }
+
+/// @brief Wipe the log.
+/// @return 0, or -1 on a flash error or a bad geometry.
+/// @param dev flash
+/// @param start device offset, sector aligned
+/// @param sectors at least two, and a power of two.
+int flashlog_format(FLASHLOG *l, FLASHDEV *dev, uint32_t start, uint32_t sectors) {
+    setup(l, dev, start, sectors);
+
+    if ( sectors < 2 || ( sectors & ( sectors - 1 ) ) || dev->PageSize % FLASHLOG_PAGE ) return(-1);
+
+    for ( uint32_t i = 1; i < sectors; i++ ) {
+        if ( dev->Erase(dev->Ctx, start + i * l->SectorSize) ) return(-1);
+        }
+
+    if ( sector_begin(l, 0) ) return(-1);
+
+    l->Tail = HDRSIZE;
+    return(0);
+    }
+
+// Checks one record.   Returns its size, or 0 for blank, -1 for bad.
+static int record_check(FLASHLOG *l, uint32_t pos) {
+    const FLREC *r = (const FLREC *) ( l->Dev->Base + addr_of(l, pos) );
+    uint32_t room = l->SectorSize - pos % l->SectorSize, crc;
+
+    // Full right to the end.
+    if ( room < RECSIZE || room == l->SectorSize ) return(0);
+
+    if ( r->Length == 0xFFFF ) return(0);
+
+    if ( RECSIZE + PAD4(r->Length) > room ) return(-1);
+
+    crc = crc32(0, r, offsetof(FLREC, CRC));
+    crc = crc32(crc, r + 1, r->Length);
+    return( crc == r->CRC ? (int) ( RECSIZE + PAD4(r->Length) ) : -1 );
+    }
+
+/// @brief Find the log.
+/// @return 0, or -1 if there isn't one.
+int flashlog_mount(FLASHLOG *l, FLASHDEV *dev, uint32_t start, uint32_t sectors) {
+    uint32_t b, lo, hi, w, pos, end;
+    int n;
+
+    setup(l, dev, start, sectors);
+
+    if ( sectors < 2 || ( sectors & ( sectors - 1 ) ) || dev->PageSize % FLASHLOG_PAGE ) return(-1);
+
+    // At most one bad header, from an erase that didn't finish.
+    if ( header_ok(l, 0) ) b = 0;
+    else if ( header_ok(l, 1) ) b = 1;
+    else return(-1);
+
+    // The last sector that carries on the sequence from b.
+    lo = b;
+    hi = sectors - 1;
+
+    while ( lo < hi ) {
+        uint32_t mid = ( lo + hi + 1 ) / 2;
+
+        if ( header_ok(l, mid) && header(l, mid)->Pos == header(l, b)->Pos + ( mid - b ) * l->SectorSize ) lo = mid;
+        else hi = mid - 1;
+        }
+
+    w = lo;
+    pos = header(l, w)->Pos;
+
+    // The oldest sector still in sequence.
+    l->Tail = pos + HDRSIZE;
+
+    for ( uint32_t k = sectors - 1; k > 0; k-- ) {
+        uint32_t s = ( w + sectors - k ) & ( sectors - 1 );
+
+        if ( header_ok(l, s) && header(l, s)->Pos == pos - k * l->SectorSize ) {
+            l->Tail = header(l, s)->Pos + HDRSIZE;
+            break;
+            }
+        }
+
+    // Walk the head sector's records.
+    end = pos + l->SectorSize;
+
+    for ( pos += HDRSIZE; ( n = record_check(l, pos) ) > 0; pos += n ) ;
+
+    l->Head = l->Flushed = pos;
+
+    // Anything but blank flash after the last good record means a
+    // write was cut off.   Don't add to this sector.
+
+    if ( n == 0 ) {
+        const uint8_t *p = dev->Base + addr_of(l, pos);
+
+        for ( uint32_t i = 0; i < end - pos; i++ ) {
+            if ( p[i] != 0xFF ) {
+                n = -1;
+                break;
+                }
+            }
+        }
+
+    if ( n < 0 ) l->Head = l->Flushed = end;
+
+    page_load(l, l->Head);
+
+    return(0);
+    }
+
+/// @brief Add a record.   It's on flash when its page fills, or after
+/// flashlog_sync().
+/// @return 0, or -1 on a flash error or if it's too big for a sector.
+int flashlog_append(FLASHLOG *l, uint16_t tag, const void *data, uint32_t len) {
+    uint32_t need = RECSIZE + PAD4(len);
+    uint8_t pad[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    const uint8_t *chunk[3];
+    uint32_t size[3];
+    FLREC r;
+
+    if ( len > FLASHLOG_MAX || need > l->SectorSize - HDRSIZE ) return(-1);
+
+    // Won't fit - the rest of this sector stays blank.
+    if ( l->Head % l->SectorSize == 0 || l->Head % l->SectorSize + need > l->SectorSize ) {
+        if ( flush(l) ) return(-1);
+
+        if ( sector_begin(l, sector_start(l, l->Head - 1) + l->SectorSize) ) return(-1);
+        }
+
+    r.Length = len;
+    r.Tag = tag;
+    r.CRC = crc32(crc32(0, &r, offsetof(FLREC, CRC)), data, len);
+
+    chunk[0] = (const uint8_t *) &r;
+    size[0] = RECSIZE;
+    chunk[1] = data;
+    size[1] = len;
+    chunk[2] = pad;
+    size[2] = PAD4(len) - len;
+
+    for ( int c = 0; c < 3; c++ ) {
+        const uint8_t *p = chunk[c];
+        uint32_t left = size[c];
+
+        while ( left ) {
+            uint32_t off = l->Head - l->PageAddr;
+            uint32_t n = FLASHLOG_PAGE - off < left ? FLASHLOG_PAGE - off : left;
+
+            memcpy(l->Page + off, p, n);
+            l->Head += n;
+            p += n;
+            left -= n;
+
+            if ( l->Head - l->PageAddr == FLASHLOG_PAGE ) {
+                if ( flush(l) ) return(-1);
+
+                l->PageAddr = l->Head;
+                memset(l->Page, 0xFF, FLASHLOG_PAGE);
+                }
+            }
+        }
+
+    return(0);
+    }
+
+/// @brief Program whatever is in the page buffer.
+int flashlog_sync(FLASHLOG *l) {
+    return( flush(l) );
+    }
+
+/// @brief Read the record at a position, and move on to the next.
+/// Start at Tail.   Records that fail their CRC are where a write got
+/// cut off, and the rest of that sector is skipped.
+/// @return the record length, or -1 at the head.
+/// @param pos where to read.   Gets moved on.
+/// @param buf gets up to max bytes of the data
+int flashlog_read(FLASHLOG *l, uint32_t *pos, uint16_t *tag, void *buf, uint32_t max) {
+    uint8_t chunk[64];
+    FLREC r;
+
+    for ( ;; ) {
+        uint32_t off, crc;
+
+        // Fell off the tail?
+        if ( (int32_t) ( *pos - l->Tail ) < 0 ) *pos = l->Tail;
+
+        if ( *pos == l->Head ) return(-1);
+
+        off = *pos % l->SectorSize;
+
+        if ( off == 0 ) {
+            *pos += HDRSIZE;
+            continue;
+            }
+
+        if ( l->SectorSize - off >= RECSIZE ) {
+            fetch(l, *pos, &r, RECSIZE);
+
+            if ( r.Length != 0xFFFF && RECSIZE + PAD4(r.Length) <= l->SectorSize - off ) {
+                crc = crc32(0, &r, offsetof(FLREC, CRC));
+
+                for ( uint32_t i = 0; i < r.Length; i += sizeof(chunk) ) {
+                    uint32_t n = r.Length - i < sizeof(chunk) ? r.Length - i : sizeof(chunk);
+
+                    fetch(l, *pos + RECSIZE + i, chunk, n);
+                    crc = crc32(crc, chunk, n);
+                    }
+
+                if ( crc == r.CRC ) break;
+                }
+            }
+
+        // The end of a sector, or of the good part of one.
+        *pos = sector_start(l, *pos) + l->SectorSize;
+        }
+
+    if ( r.Length < max ) max = r.Length;
+
+    fetch(l, *pos + RECSIZE, buf, max);
+    *tag = r.Tag;
+    *pos += RECSIZE + PAD4(r.Length);
+    return(r.Length);
+    }
+
+/// @brief Bytes in the log.
+uint32_t flashlog_used(FLASHLOG *l) {
+    return( l->Head - l->Tail );
+    }
+
+/// @brief How many times a sector has been erased.
+uint32_t flashlog_erases(FLASHLOG *l, uint32_t sector) {
+    return( header_ok(l, sector) ? header(l, sector)->Erases : 0 );
+    }
@@ -0,0 +1,54 @@
+//
+// Log structured circular event log in flash.
+//
+
+#ifndef __FLASHLOG_H__
+#define __FLASHLOG_H__
+
+#include <stdint.h>
+
+#include "flashdev.h"
+
+#define FLASHLOG_MAGIC 0x474F4C46 // "FLOG"
+#define FLASHLOG_PAGE  256        // Appends are programmed this much at a time.
+#define FLASHLOG_MAX   0xFFFE     // Longest record.
+
+// The start of every sector.
+typedef struct {
+    uint32_t Magic;
+    uint32_t Pos;     // Log position of the sector start.
+    uint32_t Erases;  // Wear count.
+    uint32_t CRC;     // Of the above.
+    } FLHDR;
+
+// The start of every record.   The data follows, padded to a word.
+typedef struct {
+    uint16_t Length;  // 0xFFFF is erased flash - the end of the sector.
+    uint16_t Tag;
+    uint32_t CRC;     // Of Length, Tag and the data.
+    } FLREC;
+
+typedef struct {
+    FLASHDEV *Dev;
+    uint32_t Start;       // Device offset of sector 0.
+    uint32_t Sectors;     // Power of two.
+    uint32_t SectorSize;  // The erase page size.
+
+    // Free running positions, like RINGBUF's indexes.
+    uint32_t Head;        // The next record goes here.
+    uint32_t Tail;        // The oldest record.
+    uint32_t Flushed;     // Programmed up to here.
+
+    uint32_t PageAddr;    // Log position of Page.
+    uint8_t  Page[FLASHLOG_PAGE];
+    } FLASHLOG;
+
+int      flashlog_format(FLASHLOG*, FLASHDEV*, uint32_t start, uint32_t sectors);
+int      flashlog_mount(FLASHLOG*, FLASHDEV*, uint32_t start, uint32_t sectors);
+int      flashlog_append(FLASHLOG*, uint16_t tag, const void *data, uint32_t len);
+int      flashlog_sync(FLASHLOG*);
+int      flashlog_read(FLASHLOG*, uint32_t *pos, uint16_t *tag, void *buf, uint32_t max);
+uint32_t flashlog_used(FLASHLOG*);
+uint32_t flashlog_erases(FLASHLOG*, uint32_t sector);
+
+#endif
@@ -0,0 +1,153 @@
+/// @file flashsim.c
+/// @brief File backed NOR flash simulator.
+/// @details
+/// The flash is a file, mapped into memory, so reads are just pointer
+/// access - the same as on the target - and the contents survive from
+/// one run to the next.   A new file starts out erased.
+///
+/// Behaves like NOR flash:
+/// - Erase is a whole page at a time, and sets everything to 0xFF.
+/// - Programming can only clear bits.   Trying to set one is counted
+///   as a violation and fails, and the flash ends up with the AND of
+///   old and new, just like the real thing.
+///
+/// Power loss injection, for testing what survives a reset:
+/// flashsim_power(fs, n) lets n more bytes get programmed (an erase
+/// counts as one) and then pulls the plug.   The operation that runs
+/// out only gets part way - a program stops after the bytes it had
+/// budget for, an erase leaves the top half of the page alone.   Then
+/// everything fails until flashsim_power() turns the power back on.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flashsim.h"
+
+/// @brief Open or create a flash file.
+/// @return 0 on success, -1 on failure.
+/// @param fs flash
+/// @param path the backing file
+/// @param size flash size in bytes, a multiple of pagesize
+/// @param pagesize erase page size
+int flashsim_open(FLASHSIM *fs, const char *path, uint32_t size, uint32_t pagesize) {
+    struct stat st;
+    int fresh;
+
+    memset(fs, 0, sizeof(*fs));
+
+    if ( pagesize == 0 || size % pagesize ) return(-1);
+
+    if ( ( fs->Fd = open(path, O_RDWR | O_CREAT, 0644) ) < 0 ) return(-1);
+
+    fstat(fs->Fd, &st);
+    fresh = ( st.st_size != size );
+
+    if ( fresh && ftruncate(fs->Fd, size) ) {
+        close(fs->Fd);
+        return(-1);
+        }
+
+    fs->Mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fs->Fd, 0);
+
+    if ( fs->Mem == MAP_FAILED ) {
+        close(fs->Fd);
+        return(-1);
+        }
+
+    fs->Size = size;
+    fs->PageSize = pagesize;
+    fs->PowerBudget = -1;
+
+    if ( fresh ) memset(fs->Mem, 0xFF, size);
+
+    return(0);
+    }
+
+void flashsim_close(FLASHSIM *fs) {
+    if ( fs->Mem ) {
+        msync(fs->Mem, fs->Size, MS_SYNC);
+        munmap(fs->Mem, fs->Size);
+        close(fs->Fd);
+        }
+
+    fs->Mem = NULL;
+    }
+
+/// @brief Erase the page containing an address.
+/// @return 0, or -1 if it's out of range.
+int flashsim_erase(FLASHSIM *fs, uint32_t addr) {
+    if ( addr >= fs->Size || fs->PowerLost ) return(-1);
+
+    addr -= addr % fs->PageSize;
+
+    if ( fs->PowerBudget == 0 ) {
+        memset(fs->Mem + addr, 0xFF, fs->PageSize / 2);
+        fs->PowerLost = 1;
+        return(-1);
+        }
+
+    if ( fs->PowerBudget > 0 ) fs->PowerBudget--;
+
+    memset(fs->Mem + addr, 0xFF, fs->PageSize);
+    fs->Erases++;
+    return(0);
+    }
+
+/// @brief Program some bytes.
+/// @return 0, or -1 if out of range or a bit would have to go from 0 to 1.
+int flashsim_program(FLASHSIM *fs, uint32_t addr, const void *buf, uint32_t len) {
+    const uint8_t *p = buf;
+    int ret = 0;
+
+    if ( addr > fs->Size || len > fs->Size - addr || fs->PowerLost ) return(-1);
+
+    if ( fs->PowerBudget >= 0 && len > (uint32_t) fs->PowerBudget ) {
+        len = fs->PowerBudget;
+        fs->PowerLost = 1;
+        ret = -1;
+        }
+
+    if ( fs->PowerBudget > 0 ) fs->PowerBudget -= len;
+
+    for ( uint32_t i = 0; i < len; i++ ) {
+        if ( p[i] & ~fs->Mem[addr + i] ) {
+            fs->Violations++;
+            ret = -1;
+            }
+
+        fs->Mem[addr + i] &= p[i];
+        }
+
+    fs->Programmed += len;
+    return(ret);
+    }
+
+static int dev_erase(void *ctx, uint32_t addr) {
+    return( flashsim_erase(ctx, addr) );
+    }
+
+static int dev_program(void *ctx, uint32_t addr, const void *buf, uint32_t len) {
+    return( flashsim_program(ctx, addr, buf, len) );
+    }
+
+/// @brief Fill in a FLASHDEV for the simulator.
+void flashsim_dev(FLASHSIM *fs, FLASHDEV *dev) {
+    dev->Erase = dev_erase;
+    dev->Program = dev_program;
+    dev->Ctx = fs;
+    dev->Base = fs->Mem;
+    dev->PageSize = fs->PageSize;
+    }
+
+/// @brief Turn the power back on, and set up the next failure.
+/// @param budget bytes that can be programmed before it fails, or -1
+void flashsim_power(FLASHSIM *fs, int32_t budget) {
+    fs->PowerLost = 0;
+    fs->PowerBudget = budget;
+    }
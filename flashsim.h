@@ -0,0 +1,33 @@
+//
+// File backed NOR flash simulator, for testing on the host.
+//
+
+#ifndef __FLASHSIM_H__
+#define __FLASHSIM_H__
+
+#include <stdint.h>
+
+#include "flashdev.h"
+
+typedef struct {
+    uint8_t *Mem;        // The file, mapped.
+    uint32_t Size;
+    uint32_t PageSize;   // Erase unit.
+    int Fd;
+
+    uint32_t Erases;     // Statistics
+    uint32_t Programmed; // Bytes
+    uint32_t Violations; // Tried to program a 0 back to a 1.
+
+    int32_t PowerBudget; // Bytes until the power fails.  -1 for never.
+    int PowerLost;       // Everything fails until flashsim_power().
+    } FLASHSIM;
+
+int  flashsim_open(FLASHSIM*, const char *path, uint32_t size, uint32_t pagesize);
+void flashsim_close(FLASHSIM*);
+int  flashsim_erase(FLASHSIM*, uint32_t addr);
+int  flashsim_program(FLASHSIM*, uint32_t addr, const void *buf, uint32_t len);
+void flashsim_dev(FLASHSIM*, FLASHDEV*);
+void flashsim_power(FLASHSIM*, int32_t budget);
+
+#endif
@@ -0,0 +1,90 @@
+/// @file fmt-bench.c
+/// @brief Host benchmark for the formatter.
+/// @details
+/// Builds the lines of the fault report with fmt, and with snprintf,
+/// and times them.   Also decimal on its own, since that's where
+/// snprintf divides.
+///
+/// Usage: fmt-bench [-n rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fmt.h"
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+int main(int argc, char **argv) {
+    volatile uint32_t xpsr = 0x01000003, pc = 0x00012345, sp = 0x20001f80, lr = 0xfffffff9;
+    volatile uint32_t sink = 0;
+    long rounds = 2000000;
+    char buf[64];
+    FMTOUT o;
+    double t, tfmt;
+    int opt;
+
+    while ( ( opt = getopt(argc, argv, "n:") ) != -1 ) {
+        if ( opt == 'n' ) rounds = atol(optarg);
+        else {
+            fprintf(stderr, "Usage: fmt-bench [-n rounds]\n");
+            return(2);
+            }
+        }
+
+    t = now();
+
+    for ( long i = 0; i < rounds; i++ ) {
+        fmt_to_buf(&o, buf, sizeof(buf));
+        fmt_str(&o, "XFSR: 0x");
+        fmt_hex(&o, xpsr + i, 8);
+        fmt_str(&o, " PC: 0x");
+        fmt_hex(&o, pc, 8);
+        fmt_str(&o, " SP: 0x");
+        fmt_hex(&o, sp, 8);
+        fmt_str(&o, " LR: 0x");
+        fmt_hex(&o, lr, 8);
+        sink += buf[10];
+        }
+
+    tfmt = ( now() - t ) / rounds;
+    t = now();
+
+    for ( long i = 0; i < rounds; i++ ) {
+        snprintf(buf, sizeof(buf), "XFSR: 0x%08x PC: 0x%08x SP: 0x%08x LR: 0x%08x", xpsr + (uint32_t) i, pc, sp, lr);
+        sink += buf[10];
+        }
+
+    t = ( now() - t ) / rounds;
+    printf("%-20s fmt %7.1f ns   snprintf %7.1f ns\n", "hex report line", tfmt * 1e9, t * 1e9);
+
+    t = now();
+
+    for ( long i = 0; i < rounds; i++ ) {
+        fmt_to_buf(&o, buf, sizeof(buf));
+        fmt_udec(&o, (uint32_t) i * 2654435761u, 10, ' ');
+        fmt_dec(&o, -(int32_t) i, 0, ' ');
+        sink += buf[3];
+        }
+
+    tfmt = ( now() - t ) / rounds;
+    t = now();
+
+    for ( long i = 0; i < rounds; i++ ) {
+        snprintf(buf, sizeof(buf), "%10u%d", (uint32_t) i * 2654435761u, -(int32_t) i);
+        sink += buf[3];
+        }
+
+    t = ( now() - t ) / rounds;
+    printf("%-20s fmt %7.1f ns   snprintf %7.1f ns\n", "two decimals", tfmt * 1e9, t * 1e9);
+
+    return(0);
+    }
@@ -0,0 +1,244 @@
+// CUnit tests for the formatter.
+//
+// snprintf is the reference.   The reciprocal divide is checked for
+// all of uint32_t, the digits for every value up to 2^24 and around
+// every power of ten, and the padding for every width.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fmt.h"
+
+#include "CUnit/Basic.h"
+
+FMTOUT out;
+char buf[64], ref[64];
+uint8_t ringmem[16];
+RINGBUF ring;
+
+int failures; // Counted rather than asserted, or CUnit drowns.
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void check_udec(uint32_t v, int width, char pad) {
+    fmt_to_buf(&out, buf, sizeof(buf));
+    fmt_udec(&out, v, width, pad);
+
+    if ( pad == '0' ) snprintf(ref, sizeof(ref), "%0*u", width, v);
+    else snprintf(ref, sizeof(ref), "%*u", width, v);
+
+    if ( strcmp(buf, ref) != 0 ) failures++;
+    }
+
+static void check_dec(int32_t v, int width, char pad) {
+    fmt_to_buf(&out, buf, sizeof(buf));
+    fmt_dec(&out, v, width, pad);
+
+    if ( pad == '0' ) snprintf(ref, sizeof(ref), "%0*d", width, v);
+    else snprintf(ref, sizeof(ref), "%*d", width, v);
+
+    if ( strcmp(buf, ref) != 0 ) failures++;
+    }
+
+static void check_hex(uint32_t v, int digits) {
+    fmt_to_buf(&out, buf, sizeof(buf));
+    fmt_hex(&out, v, digits);
+    snprintf(ref, sizeof(ref), "%0*x", digits, v);
+
+    if ( strcmp(buf, ref) != 0 ) failures++;
+    }
+
+static char *collected;
+
+static void collect(char c) {
+    *collected++ = c;
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+// A multiply and a shift can't go down as v goes up, so if both ends of
+// every run of ten are right, everything in between is too.   That's
+// all of uint32_t in a fifth of the time.
+void testDiv10(void) {
+    failures = 0;
+
+    for ( uint32_t q = 0; q < 429496729; q++ ) {
+        if ( fmt_div10(10 * q) != q || fmt_div10(10 * q + 9) != q ) failures++;
+        }
+
+    // The last, short run.
+    for ( uint32_t v = 4294967290u; v != 0; v++ ) {
+        if ( fmt_div10(v) != 429496729 ) failures++;
+        }
+
+    CU_ASSERT( failures == 0 );
+    }
+
+void testUnsigned(void) {
+    uint32_t p10 = 1;
+
+    failures = 0;
+
+    for ( uint32_t v = 0; v < ( 1 << 24 ); v++ ) check_udec(v, 0, ' ');
+
+    for ( int i = 0; i < 10; i++, p10 *= 10 ) {
+        for ( int d = -2; d <= 2; d++ ) check_udec(p10 + d, 0, ' ');
+        }
+
+    check_udec(0xffffffff, 0, ' ');
+    check_udec(0xfffffffe, 0, ' ');
+
+    srand(46);
+
+    for ( int i = 0; i < 1000000; i++ ) check_udec(rand() ^ ( (uint32_t) rand() << 16 ), 0, ' ');
+
+    CU_ASSERT( failures == 0 );
+    }
+
+void testSigned(void) {
+    static const int32_t edge[] = { 0, 1, -1, 9, -9, 10, -10, 2147483647, -2147483647 - 1, -2147483647 };
+
+    failures = 0;
+
+    for ( int32_t v = -( 1 << 20 ); v < ( 1 << 20 ); v++ ) check_dec(v, 0, ' ');
+
+    for ( unsigned i = 0; i < sizeof(edge) / sizeof(edge[0]); i++ ) {
+        for ( int w = 0; w <= 14; w++ ) {
+            check_dec(edge[i], w, ' ');
+            check_dec(edge[i], w, '0');
+            }
+        }
+
+    CU_ASSERT( failures == 0 );
+    }
+
+void testPadding(void) {
+    failures = 0;
+
+    for ( int w = 0; w <= 14; w++ ) {
+        for ( uint32_t v = 0; v < 100000; v += 7 ) {
+            check_udec(v, w, ' ');
+            check_udec(v, w, '0');
+            check_dec(-(int32_t) v, w, ' ');
+            check_dec(-(int32_t) v, w, '0');
+            }
+        }
+
+    CU_ASSERT( failures == 0 );
+    }
+
+void testHex(void) {
+    failures = 0;
+
+    // Every digit count, against every value with one digit set and
+    // every nibble value.
+    for ( int digits = 0; digits <= 8; digits++ ) {
+        for ( int pos = 0; pos < 8; pos++ ) {
+            for ( uint32_t n = 0; n < 16; n++ ) check_hex(n << ( 4 * pos ), digits);
+            }
+        }
+
+    for ( uint32_t v = 0; v < ( 1 << 20 ); v++ ) check_hex(v, 2);
+
+    check_hex(0xffffffff, 8);
+    check_hex(0xdeadbeef, 0);
+
+    CU_ASSERT( failures == 0 );
+    }
+
+// The fault report lines, against usprintf style output.
+void testReport(void) {
+    fmt_to_buf(&out, buf, sizeof(buf));
+    fmt_str(&out, "XFSR: 0x");
+    fmt_hex(&out, 0x01000003, 8);
+    fmt_str(&out, " PC: 0x");
+    fmt_hex(&out, 0x1234, 8);
+    fmt_str(&out, " Fault ");
+    fmt_udec(&out, 3, 0, ' ');
+    CU_ASSERT_STRING_EQUAL( buf, "XFSR: 0x01000003 PC: 0x00001234 Fault 3" );
+    CU_ASSERT( out.Dropped == 0 );
+    }
+
+void testSinks(void) {
+    char small[8], collect_buf[32] = { 0 };
+
+    // A full buffer stays terminated, and counts what it lost.
+    fmt_to_buf(&out, small, sizeof(small));
+    fmt_str(&out, "0123456789");
+    CU_ASSERT_STRING_EQUAL( small, "0123456" );
+    CU_ASSERT( out.Dropped == 3 );
+
+    fmt_to_buf(&out, small, 0);
+    fmt_char(&out, 'x');
+    CU_ASSERT( out.Dropped == 1 );
+
+    // A ring.
+    ringbuffer_init(&ring, ringmem, sizeof(ringmem));
+    fmt_to_ring(&out, &ring);
+    fmt_udec(&out, 4294967295u, 12, '0');
+    CU_ASSERT( ringbuffer_used(&ring) == 12 );
+    CU_ASSERT( ringbuffer_getchar(&ring) == '0' );
+    CU_ASSERT( ringbuffer_getchar(&ring) == '0' );
+    CU_ASSERT( ringbuffer_getchar(&ring) == '4' );
+
+    fmt_str(&out, "abcdefghij");
+    CU_ASSERT( out.Dropped == 10 + 12 - 3 - sizeof(ringmem) );
+
+    // A function.
+    collected = collect_buf;
+    fmt_to_func(&out, collect);
+    fmt_dec(&out, -42, 5, ' ');
+    fmt_hex(&out, 0xab, 4);
+    CU_ASSERT_STRING_EQUAL( collect_buf, "  -4200ab" );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Formatter", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Divide by ten, all of uint32_t", testDiv10)) ||
+            (NULL == CU_add_test(pSuite, "Unsigned", testUnsigned)) ||
+            (NULL == CU_add_test(pSuite, "Signed", testSigned)) ||
+            (NULL == CU_add_test(pSuite, "Padding", testPadding)) ||
+            (NULL == CU_add_test(pSuite, "Hex", testHex)) ||
+            (NULL == CU_add_test(pSuite, "Fault report", testReport)) ||
+            (NULL == CU_add_test(pSuite, "Sinks", testSinks))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,147 @@
+/// @file fmt.c
+/// @brief Division-free number formatting.
+/// @details
+/// usprintf parses the format string every time, walks varargs and
+/// divides by ten for every decimal digit - hundreds of cycles a number
+/// and an unknown amount of stack, which is the last thing a fault
+/// handler needs.   These do one job each:
+/// - fmt_hex() - at least digits hex digits, zero padded, like %0Nx.
+/// - fmt_udec() and fmt_dec() - decimal, at least width wide, padded on
+///   the left with pad.   Like %Nu and %Nd with ' ', %0Nu and %0Nd
+///   with '0'.   The digits come from fmt_div10(), a multiply by the
+///   reciprocal, and the CM3 has no divide it would be worth using.
+/// - fmt_str() and fmt_char().
+///
+/// The output goes to a caller buffer, a RINGBUF, or one character at a
+/// time to a function, like UARTCharPut.   When the buffer or ring is
+/// full the rest is counted in Dropped.   The buffer is always left NUL
+/// terminated.
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+#include "fmt.h"
+
+#define FMT_DEC_MAX 32 // Widest field, sign and all.
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/// @brief Write into buf, NUL terminated.
+void fmt_to_buf(FMTOUT *o, char *buf, int size) {
+    o->Buf = buf;
+    o->Size = size;
+    o->Len = 0;
+    o->Ring = 0;
+    o->Put = 0;
+    o->Dropped = 0;
+
+    if ( size > 0 ) buf[0] = '\0';
+    }
+
+/// @brief Write into a ring.
+void fmt_to_ring(FMTOUT *o, RINGBUF *ring) {
+    fmt_to_buf(o, 0, 0);
+    o->Ring = ring;
+    }
+
+/// @brief Hand each character to put.
+void fmt_to_func(FMTOUT *o, void (*put)(char c)) {
+    fmt_to_buf(o, 0, 0);
+    o->Put = put;
+    }
+
+// Everything goes through here.
+static void put(FMTOUT *o, const char *s, int n) {
+    if ( o->Put ) {
+        while ( n-- ) o->Put(*s++);
+        }
+    else if ( o->Ring ) {
+        while ( n-- ) {
+            if ( ringbuffer_addchar(o->Ring, *s++) < 0 ) o->Dropped++;
+            }
+        }
+    else {
+        int room = o->Size - 1 - o->Len;
+
+        if ( room < 0 ) room = 0;
+
+        if ( n > room ) {
+            o->Dropped += n - room;
+            n = room;
+            }
+
+        while ( n-- ) o->Buf[o->Len++] = *s++;
+
+        if ( o->Size > 0 ) o->Buf[o->Len] = '\0';
+        }
+    }
+
+void fmt_char(FMTOUT *o, char c) {
+    put(o, &c, 1);
+    }
+
+void fmt_str(FMTOUT *o, const char *s) {
+    const char *e = s;
+
+    while ( *e ) e++;
+
+    put(o, s, e - s);
+    }
+
+/// @brief Hex, lower case.
+/// @param digits at least this many, zero padded.   Up to 8.
+void fmt_hex(FMTOUT *o, uint32_t v, int digits) {
+    char buf[8];
+    int n = 8;
+
+    // Leading zeros we don't need.
+    while ( n > 1 && n > digits && ( v >> ( 4 * ( n - 1 ) ) ) == 0 ) n--;
+
+    for ( int i = n; i--; v >>= 4 ) buf[i] = hexdigits[v & 0xF];
+
+    put(o, buf, n);
+    }
+
+// Digits into the end of a buffer, backwards.   Returns where they start.
+static char *udec(char *end, uint32_t v) {
+    do {
+        uint32_t q = fmt_div10(v);
+
+        *--end = '0' + ( v - q * 10 );
+        v = q;
+        } while ( v );
+
+    return(end);
+    }
+
+// Sign and padding go in front of the digits, which are at the end of
+// buf.   Spaces go before the sign, zeros after it, like printf.
+static void padded(FMTOUT *o, char *buf, char *digits, int neg, int width, char pad) {
+    char *end = buf + FMT_DEC_MAX;
+
+    width -= ( end - digits ) + neg;
+
+    if ( pad != '0' && neg ) *--digits = '-';
+
+    while ( width-- > 0 && digits > buf + 1 ) *--digits = pad;
+
+    if ( pad == '0' && neg ) *--digits = '-';
+
+    put(o, digits, end - digits);
+    }
+
+/// @brief Unsigned decimal.
+/// @param width at least this wide, up to 31.   0 for no padding.
+/// @param pad ' ' or '0'
+void fmt_udec(FMTOUT *o, uint32_t v, int width, char pad) {
+    char buf[FMT_DEC_MAX];
+
+    padded(o, buf, udec(buf + FMT_DEC_MAX, v), 0, width, pad);
+    }
+
+/// @brief Signed decimal.
+void fmt_dec(FMTOUT *o, int32_t v, int width, char pad) {
+    char buf[FMT_DEC_MAX];
+
+    padded(o, buf, udec(buf + FMT_DEC_MAX, v < 0 ? 0u - (uint32_t) v : (uint32_t) v), v < 0, width, pad);
+    }
@@ -0,0 +1,40 @@
+//
+// Small, division-free number formatting.   No varargs, no format
+// strings, and a few words of stack - for fault handlers and logs.
+//
+
+#ifndef __FMT_H__
+#define __FMT_H__
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+
+/// Where the characters go.   One of a caller buffer, a ring, or a
+/// function that takes them one at a time.
+typedef struct {
+    char *Buf;              // Kept NUL terminated.
+    int Size;
+    int Len;
+    RINGBUF *Ring;
+    void (*Put)(char c);
+    uint32_t Dropped;       // Didn't fit.
+    } FMTOUT;
+
+void fmt_to_buf(FMTOUT*, char *buf, int size);
+void fmt_to_ring(FMTOUT*, RINGBUF*);
+void fmt_to_func(FMTOUT*, void (*put)(char c));
+
+void fmt_char(FMTOUT*, char c);
+void fmt_str(FMTOUT*, const char *s);
+void fmt_hex(FMTOUT*, uint32_t v, int digits);
+void fmt_udec(FMTOUT*, uint32_t v, int width, char pad);
+void fmt_dec(FMTOUT*, int32_t v, int width, char pad);
+
+/// @brief v / 10 for any uint32_t, with a multiply and a shift.
+/// 0xCCCCCCCD is 2^35 / 10, rounded up.   UMULL on the M3.
+static inline uint32_t fmt_div10(uint32_t v) {
+    return( (uint32_t) ( ( (uint64_t) v * 0xCCCCCCCDu ) >> 35 ) );
+    }
+
+#endif
@@ -0,0 +1,256 @@
+// CUnit tests for the log-linear histograms.
+//
+// Percentiles are checked against the exact answer from the sorted
+// samples, for a few distributions that look like latencies.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "hdrhist.h"
+
+#include "CUnit/Basic.h"
+
+#define SAMPLES 200000
+
+HDRHIST h, h2;
+uint32_t sample[SAMPLES];
+uint8_t snap[HDR_SNAP_MAX];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static int cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return( ( x > y ) - ( x < y ) );
+    }
+
+static double uniform(void) {
+    return( ( rand() + 1.0 ) / ( RAND_MAX + 2.0 ) );
+    }
+
+// Record them all, and check a range of percentiles against the truth.
+// Returns the worst relative error.
+static double check(int n) {
+    static const uint32_t ppm[] = { 1, 10000, 250000, 500000, 900000, 990000, 999000, 999900, 1000000 };
+    double worst = 0;
+
+    hdr_reset(&h);
+
+    for ( int i = 0; i < n; i++ ) hdr_record(&h, sample[i]);
+
+    qsort(sample, n, sizeof(sample[0]), cmp);
+
+    CU_ASSERT( hdr_total(&h) == (uint64_t) n );
+    CU_ASSERT( h.Min == sample[0] );
+    CU_ASSERT( h.Max == sample[n - 1] );
+
+    for ( unsigned i = 0; i < sizeof(ppm) / sizeof(ppm[0]); i++ ) {
+        uint64_t rank = ( (uint64_t) n * ppm[i] + 999999 ) / 1000000;
+        uint32_t truth = sample[rank ? rank - 1 : 0];
+        uint32_t got = hdr_value_at(&h, ppm[i]);
+        double err = fabs((double) got - truth) / ( truth ? truth : 1 );
+
+        // Half a bucket, and a count of slack for the small exact ones.
+        CU_ASSERT( err <= 1.0 / ( 2 * HDR_SUB ) || fabs((double) got - truth) <= 1 );
+
+        if ( err > worst ) worst = err;
+        }
+
+    return(worst);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testBuckets(void) {
+    // Every bucket's edges map back to it, and they tile uint32_t.
+    CU_ASSERT( hdr_lowest(0) == 0 );
+    CU_ASSERT( hdr_highest(HDR_BUCKETS - 1) == 0xffffffff );
+
+    for ( int i = 0; i < HDR_BUCKETS; i++ ) {
+        CU_ASSERT( hdr_bucket(hdr_lowest(i)) == i );
+        CU_ASSERT( hdr_bucket(hdr_highest(i)) == i );
+
+        if ( i ) CU_ASSERT( hdr_lowest(i) == hdr_highest(i - 1) + 1 );
+
+        // Width within the relative error.
+        CU_ASSERT( hdr_highest(i) - hdr_lowest(i) <= hdr_lowest(i) / HDR_SUB );
+        }
+
+    for ( uint32_t v = 0; v < 2 * HDR_SUB; v++ ) CU_ASSERT( hdr_bucket(v) == (int) v );
+    }
+
+void testUniform(void) {
+    srand(45);
+
+    for ( int i = 0; i < SAMPLES; i++ ) sample[i] = rand() % 100000;
+
+    check(SAMPLES);
+    }
+
+void testExponential(void) {
+    srand(46);
+
+    for ( int i = 0; i < SAMPLES; i++ ) sample[i] = (uint32_t) ( -log(uniform()) * 2000 );
+
+    check(SAMPLES);
+    }
+
+// Mostly fast, with a slow tail.   Like an ISR that sometimes waits.
+void testBimodal(void) {
+    srand(47);
+
+    for ( int i = 0; i < SAMPLES; i++ ) {
+        if ( rand() % 100 ) sample[i] = 120 + rand() % 20;
+        else sample[i] = 50000 + rand() % 1000000;
+        }
+
+    check(SAMPLES);
+    }
+
+void testSmallAndHuge(void) {
+    for ( int i = 0; i < 1000; i++ ) sample[i] = i % 7;
+
+    CU_ASSERT( check(1000) == 0 ); // Exact down here.
+
+    for ( int i = 0; i < 1000; i++ ) sample[i] = 0xffffffff - i * 1000003;
+
+    check(1000);
+
+    hdr_reset(&h);
+    CU_ASSERT( hdr_value_at(&h, 500000) == 0 );
+    }
+
+void testSpan(void) {
+    hdr_reset(&h);
+
+    hdr_record_span(&h, 0x1fffffff0ULL, 0x200000010ULL); // Over a 32-bit wrap.
+    hdr_record_span(&h, 5, 0x100000005ULL);              // Too big.
+
+    CU_ASSERT( h.Min == 0x20 );
+    CU_ASSERT( h.Max == 0xffffffff );
+    CU_ASSERT( h.Count[hdr_bucket(0x20)] == 1 );
+    }
+
+void testSnapshot(void) {
+    int len, len2;
+
+    srand(48);
+    hdr_reset(&h);
+    hdr_reset(&h2);
+
+    for ( int i = 0; i < SAMPLES; i++ ) hdr_record(&h, (uint32_t) ( -log(uniform()) * 2000 ));
+
+    len = hdr_snapshot(&h, snap, sizeof(snap));
+    CU_ASSERT( len > 0 && len < 1000 );
+
+    // Round trip.
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len) == 0 );
+    CU_ASSERT( memcmp(&h, &h2, sizeof(h)) == 0 );
+
+    // Merging twice doubles it, and agrees with hdr_merge.
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len) == 0 );
+    hdr_merge(&h, &h);
+    CU_ASSERT( memcmp(&h, &h2, sizeof(h)) == 0 );
+    CU_ASSERT( hdr_total(&h2) == 2 * SAMPLES );
+
+    // Too small a buffer.
+    CU_ASSERT( hdr_snapshot(&h, snap, len - 1) == -1 );
+
+    // Damage.   dst mustn't change.
+    len2 = hdr_snapshot(&h, snap, sizeof(snap));
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len2 - 1) == -1 );
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len2 + 1) == -1 );
+    snap[1]++;
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len2) == -1 );
+    snap[1]--;
+    snap[0] = 0;
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len2) == -1 );
+    CU_ASSERT( memcmp(&h, &h2, sizeof(h)) == 0 );
+
+    // An empty one.
+    hdr_reset(&h);
+    len = hdr_snapshot(&h, snap, sizeof(snap));
+    CU_ASSERT( len == 9 );
+    CU_ASSERT( hdr_merge_snapshot(&h2, snap, len) == 0 );
+    CU_ASSERT( hdr_total(&h2) == 2 * SAMPLES );
+    }
+
+// ISRs and threads recording at once.
+#define THREADS 4
+#define ROUNDS  100000
+
+static void *hammer(void *arg) {
+    uint32_t v = (uint32_t) (intptr_t) arg;
+
+    for ( int i = 0; i < ROUNDS; i++ ) hdr_record_atomic(&h, v + i % 1000);
+
+    return(arg);
+    }
+
+void testAtomic(void) {
+    pthread_t t[THREADS];
+
+    hdr_reset(&h);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_create(&t[i], NULL, hammer, (void *) (intptr_t) ( 10 + i * 100000 ));
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_join(t[i], NULL);
+
+    CU_ASSERT( hdr_total(&h) == THREADS * ROUNDS );
+    CU_ASSERT( h.Min == 10 );
+    CU_ASSERT( h.Max == 10 + ( THREADS - 1 ) * 100000 + 999 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Log-linear Histogram", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Buckets", testBuckets)) ||
+            (NULL == CU_add_test(pSuite, "Uniform", testUniform)) ||
+            (NULL == CU_add_test(pSuite, "Exponential", testExponential)) ||
+            (NULL == CU_add_test(pSuite, "Bimodal", testBimodal)) ||
+            (NULL == CU_add_test(pSuite, "Small and huge", testSmallAndHuge)) ||
+            (NULL == CU_add_test(pSuite, "Spans", testSpan)) ||
+            (NULL == CU_add_test(pSuite, "Snapshots", testSnapshot)) ||
+            (NULL == CU_add_test(pSuite, "Atomic", testAtomic))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,229 @@
+/// @file hdrhist.c
+/// @brief Log-linear latency histograms.
+/// @details
+/// For distributions from the field - ISR durations, ring dwell time,
+/// message round trips - not just the worst case.
+///
+/// Values are uint32_t, in whatever unit the caller likes.   Below
+/// 2 * HDR_SUB each value has its own bucket.   Above that each power of
+/// two is split into HDR_SUB buckets, so the error is relative, not
+/// absolute.   The bucket is a CLZ, a shift and an add.
+///
+/// hdr_record() is inline and for a single writer.   hdr_record_atomic()
+/// uses LDREX/STREX, so ISRs at any priority can share a histogram.
+///
+/// Snapshots are what goes over the wire.   Only buckets with something
+/// in them are sent, as varint (gap, count) pairs:
+/// @code
+///    { 'H', HDR_SUB_BITS, varint Min, varint Max, varint n, { gap, count } * n }
+/// @endcode
+/// A few dozen bytes for a typical latency distribution.   The host
+/// merges them into one histogram, from many boards or many periods.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "hdrhist.h"
+
+/// @brief Empty it.
+void hdr_reset(HDRHIST *h) {
+    memset(h->Count, 0, sizeof(h->Count));
+    h->Min = 0xffffffff;
+    h->Max = 0;
+    }
+
+/// @brief Record a value, safe against other writers including ISRs.
+void hdr_record_atomic(HDRHIST *h, uint32_t v) {
+    uint32_t old;
+
+    atomic_add(&h->Count[hdr_bucket(v)], 1);
+
+    do {
+        old = *(volatile uint32_t *) &h->Min;
+        } while ( v < old && !atomic_cas(&h->Min, old, v) );
+
+    do {
+        old = *(volatile uint32_t *) &h->Max;
+        } while ( v > old && !atomic_cas(&h->Max, old, v) );
+    }
+
+/// @brief Record the time between two 64-bit stamps - timestamp_cycles(),
+/// timestamp_ns() or getSysTickMS64().   Anything over 32 bits is
+/// recorded as 0xffffffff.
+void hdr_record_span(HDRHIST *h, uint64_t start, uint64_t end) {
+    uint64_t span = end - start;
+
+    hdr_record(h, span > 0xffffffff ? 0xffffffff : (uint32_t) span);
+    }
+
+/// @brief The smallest value that goes in a bucket.
+uint32_t hdr_lowest(int bucket) {
+    if ( bucket < 2 * HDR_SUB ) return(bucket);
+
+    int shift = ( bucket >> HDR_SUB_BITS ) - 1;
+
+    return( (uint32_t) ( bucket - ( shift << HDR_SUB_BITS ) ) << shift );
+    }
+
+/// @brief The largest value that goes in a bucket.
+uint32_t hdr_highest(int bucket) {
+    if ( bucket < 2 * HDR_SUB ) return(bucket);
+
+    int shift = ( bucket >> HDR_SUB_BITS ) - 1;
+
+    return( hdr_lowest(bucket) + ( ( 1u << shift ) - 1 ) );
+    }
+
+/// @brief How many values have been recorded.
+uint64_t hdr_total(const HDRHIST *h) {
+    uint64_t n = 0;
+
+    for ( int i = 0; i < HDR_BUCKETS; i++ ) n += h->Count[i];
+
+    return(n);
+    }
+
+/// @brief A percentile.
+/// @param ppm parts per million - 500000 for the median, 999000 for p99.9
+/// @return the middle of the bucket it's in, kept within Min and Max.
+/// 0 if it's empty.
+uint32_t hdr_value_at(const HDRHIST *h, uint32_t ppm) {
+    uint64_t total = hdr_total(h), rank, seen = 0;
+
+    if ( total == 0 ) return(0);
+
+    if ( ppm > 1000000 ) ppm = 1000000;
+
+    rank = ( total * ppm + 999999 ) / 1000000;
+
+    if ( rank == 0 ) rank = 1;
+
+    for ( int i = 0; i < HDR_BUCKETS; i++ ) {
+        seen += h->Count[i];
+
+        if ( seen >= rank ) {
+            uint32_t lo = hdr_lowest(i), hi = hdr_highest(i);
+            uint32_t mid = lo + ( hi - lo ) / 2;
+
+            if ( mid < h->Min ) mid = h->Min;
+
+            if ( mid > h->Max ) mid = h->Max;
+
+            return(mid);
+            }
+        }
+
+    return(h->Max);
+    }
+
+/// @brief Add one histogram into another.
+void hdr_merge(HDRHIST *dst, const HDRHIST *src) {
+    for ( int i = 0; i < HDR_BUCKETS; i++ ) dst->Count[i] += src->Count[i];
+
+    if ( src->Min < dst->Min ) dst->Min = src->Min;
+
+    if ( src->Max > dst->Max ) dst->Max = src->Max;
+    }
+
+static int put_varint(uint8_t *buf, int pos, int size, uint32_t v) {
+    do {
+        if ( pos >= size ) return(-1);
+
+        buf[pos++] = ( v & 0x7F ) | ( v > 0x7F ? 0x80 : 0 );
+        v >>= 7;
+        } while ( v );
+
+    return(pos);
+    }
+
+static int get_varint(const uint8_t *buf, int pos, int len, uint32_t *v) {
+    int shift = 0;
+
+    *v = 0;
+
+    do {
+        if ( pos >= len || shift > 28 ) return(-1);
+
+        *v |= (uint32_t) ( buf[pos] & 0x7F ) << shift;
+        shift += 7;
+        } while ( buf[pos++] & 0x80 );
+
+    return(pos);
+    }
+
+/// @brief Write a snapshot.   Take it from a copy if ISRs are recording.
+/// @param buf where to put it.   HDR_SNAP_MAX is always enough.
+/// @return bytes used, or -1 if it didn't fit
+int hdr_snapshot(const HDRHIST *h, uint8_t *buf, int size) {
+    int pos, n = 0, last = 0;
+
+    for ( int i = 0; i < HDR_BUCKETS; i++ ) n += ( h->Count[i] != 0 );
+
+    if ( size < 2 ) return(-1);
+
+    buf[0] = HDR_SNAP_MAGIC;
+    buf[1] = HDR_SUB_BITS;
+    pos = put_varint(buf, 2, size, h->Min);
+
+    if ( pos >= 0 ) pos = put_varint(buf, pos, size, h->Max);
+
+    if ( pos >= 0 ) pos = put_varint(buf, pos, size, n);
+
+    for ( int i = 0; i < HDR_BUCKETS && pos >= 0; i++ ) {
+        if ( h->Count[i] == 0 ) continue;
+
+        pos = put_varint(buf, pos, size, i - last);
+
+        if ( pos >= 0 ) pos = put_varint(buf, pos, size, h->Count[i]);
+
+        last = i;
+        }
+
+    return(pos);
+    }
+
+/// @brief Add a snapshot into a histogram.
+/// @return 0, or -1 if it's damaged or from a different HDR_SUB_BITS.
+/// dst is untouched if it fails.
+int hdr_merge_snapshot(HDRHIST *dst, const uint8_t *buf, int len) {
+    uint32_t min, max, n, gap, count;
+    int pos, bucket = 0;
+
+    if ( len < 2 || buf[0] != HDR_SNAP_MAGIC || buf[1] != HDR_SUB_BITS ) return(-1);
+
+    pos = get_varint(buf, 2, len, &min);
+
+    if ( pos >= 0 ) pos = get_varint(buf, pos, len, &max);
+
+    if ( pos >= 0 ) pos = get_varint(buf, pos, len, &n);
+
+    if ( pos < 0 || n > HDR_BUCKETS ) return(-1);
+
+    // Check it all before touching dst.
+    for ( int pass = 0; pass < 2; pass++ ) {
+        int p = pos;
+
+        bucket = 0;
+
+        for ( uint32_t i = 0; i < n; i++ ) {
+            p = get_varint(buf, p, len, &gap);
+
+            if ( p >= 0 ) p = get_varint(buf, p, len, &count);
+
+            if ( p < 0 || gap > HDR_BUCKETS || bucket + (int) gap >= HDR_BUCKETS ) return(-1);
+
+            bucket += gap;
+
+            if ( pass ) dst->Count[bucket] += count;
+            }
+
+        if ( p != len ) return(-1);
+        }
+
+    if ( min < dst->Min ) dst->Min = min;
+
+    if ( max > dst->Max ) dst->Max = max;
+
+    return(0);
+    }
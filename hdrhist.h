@@ -0,0 +1,58 @@
+//
+// Log-linear latency histograms.   Fixed size, no division to record,
+// with compact snapshots that merge on the host.
+//
+
+#ifndef __HDRHIST_H__
+#define __HDRHIST_H__
+
+#include <stdint.h>
+
+// 2^HDR_SUB_BITS buckets per power of two.   The midpoint of a bucket is
+// within 2^-(HDR_SUB_BITS+1) of anything in it - 3% for 4.
+#ifndef HDR_SUB_BITS
+#define HDR_SUB_BITS 4
+#endif
+
+#define HDR_SUB      ( 1 << HDR_SUB_BITS )
+#define HDR_BUCKETS  ( ( 33 - HDR_SUB_BITS ) * HDR_SUB ) // All of uint32_t.
+
+typedef struct {
+    uint32_t Min;
+    uint32_t Max;
+    uint32_t Count[HDR_BUCKETS];
+    } HDRHIST;
+
+#define HDR_SNAP_MAGIC 0x48  // 'H'
+#define HDR_SNAP_MAX   ( 12 + 10 * HDR_BUCKETS ) // Worst case snapshot size.
+
+void     hdr_reset(HDRHIST*);
+void     hdr_record_atomic(HDRHIST*, uint32_t v);
+void     hdr_record_span(HDRHIST*, uint64_t start, uint64_t end);
+uint64_t hdr_total(const HDRHIST*);
+uint32_t hdr_value_at(const HDRHIST*, uint32_t ppm);
+uint32_t hdr_lowest(int bucket);
+uint32_t hdr_highest(int bucket);
+void     hdr_merge(HDRHIST *dst, const HDRHIST *src);
+int      hdr_snapshot(const HDRHIST*, uint8_t *buf, int size);
+int      hdr_merge_snapshot(HDRHIST *dst, const uint8_t *buf, int len);
+
+/// @brief Which bucket v goes in.   Exact below 2 * HDR_SUB, then
+/// HDR_SUB buckets per power of two.
+static inline int hdr_bucket(uint32_t v) {
+    uint32_t shift = 31 - HDR_SUB_BITS - __builtin_clz(v | HDR_SUB);
+
+    return( ( shift << HDR_SUB_BITS ) + ( v >> shift ) );
+    }
+
+/// @brief Record a value.   Not safe against other writers - see
+/// hdr_record_atomic() for ISRs.
+static inline void hdr_record(HDRHIST *h, uint32_t v) {
+    h->Count[hdr_bucket(v)]++;
+
+    if ( v < h->Min ) h->Min = v;
+
+    if ( v > h->Max ) h->Max = v;
+    }
+
+#endif
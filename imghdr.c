@@ -0,0 +1,236 @@
+/// @file imghdr.c
+/// @brief Application image headers, and verification before launch.
+/// @details
+/// The launchers in bl_launcher.s jump into whatever is in flash.   A
+/// half-written or corrupt image means a crash loop.   So the image
+/// slot starts with an IMGHDR - magic, length, version, where the
+/// vector table is, and CRCs of the image and of the header itself -
+/// and imghdr_launch() checks all of that before handing over.
+///
+/// @code
+///    [ IMGHDR | pad | vector table, code ... ]
+///    ^ slot          ^ slot + Entry
+/// @endcode
+///
+/// The check can also be done a piece at a time while the image
+/// streams in (imgverify_init/imgverify_feed), so a download can be
+/// rejected the moment the last byte arrives, without a second pass
+/// over flash.
+///
+/// The image CRC is slice-by-8 crc32_fast().   On parts with an STM32
+/// style CRC unit, build with -DCRC32_HW_STM32 and the body goes
+/// through the hardware instead, a word per store.   The unit does
+/// CRC-32/MPEG-2 - same polynomial, but not reflected.   Bit reversing
+/// each word on the way in and the result on the way out gives the
+/// zlib CRC.   Only one verifier can use the unit at a time, and its
+/// clock needs to be on.
+///
+/// imgstamp adds the header on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "imghdr.h"
+
+// ------------------------------------------------------------------
+// CRC backends
+// ------------------------------------------------------------------
+#if defined(__arm__) && defined(CRC32_HW_STM32)
+
+#ifndef CRC32_HW_BASE
+#define CRC32_HW_BASE 0x40023000
+#endif
+
+#define CRC_DR (*((volatile uint32_t *)(CRC32_HW_BASE + 0)))
+#define CRC_CR (*((volatile uint32_t *)(CRC32_HW_BASE + 8)))
+
+static inline uint32_t rbit(uint32_t x) {
+    __asm__ ( "rbit %0, %1" : "=r" (x) : "r" (x) );
+    return(x);
+    }
+
+static void crc_start(IMGVERIFY *v) {
+    CRC_CR = 1; // Reset to 0xFFFFFFFF
+    v->CarryLen = 0;
+    }
+
+static void crc_body(IMGVERIFY *v, const uint8_t *p, uint32_t len) {
+    uint32_t w;
+
+    while ( len && v->CarryLen ) { // Finish off a partial word.
+        v->Carry[v->CarryLen++] = *p++;
+        len--;
+
+        if ( v->CarryLen == 4 ) {
+            memcpy(&w, v->Carry, 4);
+            CRC_DR = rbit(w);
+            v->CarryLen = 0;
+            }
+        }
+
+    for ( ; len >= 4; len -= 4, p += 4 ) {
+        memcpy(&w, p, 4);
+        CRC_DR = rbit(w);
+        }
+
+    while ( len-- ) v->Carry[v->CarryLen++] = *p++;
+    }
+
+static uint32_t crc_end(IMGVERIFY *v) {
+    return( crc32_fast(~rbit(CRC_DR), v->Carry, v->CarryLen) );
+    }
+
+#else
+
+static void crc_start(IMGVERIFY *v) {
+    v->CRC = 0;
+    }
+
+static void crc_body(IMGVERIFY *v, const uint8_t *p, uint32_t len) {
+    v->CRC = crc32_fast(v->CRC, p, len);
+    }
+
+static uint32_t crc_end(IMGVERIFY *v) {
+    return(v->CRC);
+    }
+
+#endif
+
+/// @brief Sanity check a header.
+/// @return IMG_OK, or one of the IMG_ERR codes
+/// @param h the header
+/// @param maxlen size of the slot, header included.  0 for no limit.
+int imghdr_check(const IMGHDR *h, uint32_t maxlen) {
+    if ( h->Magic != IMGHDR_MAGIC ) return(IMG_ERR_MAGIC);
+
+    if ( crc32_fast(0, h, offsetof(IMGHDR, HeaderCRC)) != h->HeaderCRC ) return(IMG_ERR_HEADER);
+
+    if ( maxlen && ( maxlen < sizeof(IMGHDR) || h->Length > maxlen - sizeof(IMGHDR) ) ) return(IMG_ERR_LENGTH);
+
+    // Room for at least the initial SP and PC.
+    if ( h->Entry < sizeof(IMGHDR) || ( h->Entry & 3 ) ||
+            (uint64_t) h->Entry + 8 > (uint64_t) h->Length + sizeof(IMGHDR) ) return(IMG_ERR_ENTRY);
+
+    return(IMG_OK);
+    }
+
+/// @brief Fill in a header.
+/// @param h the header
+/// @param body the image that follows the header
+/// @param len how big
+/// @param version whatever the app wants
+/// @param entry offset of the vector table from the header
+void imghdr_make(IMGHDR *h, const void *body, uint32_t len, uint32_t version, uint32_t entry) {
+    h->Magic = IMGHDR_MAGIC;
+    h->Length = len;
+    h->Version = version;
+    h->Entry = entry;
+    h->CRC = crc32_fast(0, body, len);
+    h->HeaderCRC = crc32_fast(0, h, offsetof(IMGHDR, HeaderCRC));
+    }
+
+/// @brief Start an incremental check.
+/// @param v verifier state
+/// @param maxlen size of the slot, header included.  0 for no limit.
+void imgverify_init(IMGVERIFY *v, uint32_t maxlen) {
+    memset(v, 0, sizeof(*v));
+    v->MaxLength = maxlen;
+    v->Status = IMG_MORE;
+    }
+
+/// @brief Check the next piece of an image, in order, from the header on.
+/// @return IMG_MORE until the whole image has been seen, then IMG_OK
+/// or an error.   Errors stick.
+/// @param v verifier state
+/// @param buf the data
+/// @param len how many bytes.  Any size will do.
+int imgverify_feed(IMGVERIFY *v, const void *buf, uint32_t len) {
+    const uint8_t *p = buf;
+    uint32_t remaining;
+
+    if ( v->Status != IMG_MORE ) {
+        if ( v->Status == IMG_OK && len ) v->Status = IMG_ERR_OVERRUN;
+
+        return(v->Status);
+        }
+
+    if ( v->Count < sizeof(IMGHDR) ) {
+        uint32_t n = sizeof(IMGHDR) - v->Count;
+
+        if ( n > len ) n = len;
+
+        memcpy((uint8_t *) &v->Hdr + v->Count, p, n);
+        v->Count += n;
+        p += n;
+        len -= n;
+
+        if ( v->Count < sizeof(IMGHDR) ) return(IMG_MORE);
+
+        if ( ( v->Status = imghdr_check(&v->Hdr, v->MaxLength) ) != IMG_OK ) return(v->Status);
+
+        v->Status = IMG_MORE;
+        crc_start(v);
+        }
+
+    remaining = v->Hdr.Length - ( v->Count - sizeof(IMGHDR) );
+
+    if ( len > remaining ) return( v->Status = IMG_ERR_OVERRUN );
+
+    crc_body(v, p, len);
+    v->Count += len;
+
+    if ( len == remaining ) v->Status = ( crc_end(v) == v->Hdr.CRC ) ? IMG_OK : IMG_ERR_CRC;
+
+    return(v->Status);
+    }
+
+/// @brief Check an image that's already in memory.
+/// @return IMG_OK, or one of the IMG_ERR codes
+/// @param h the header, with the image after it
+/// @param maxlen size of the slot, header included.  0 for no limit.
+int imghdr_verify(const IMGHDR *h, uint32_t maxlen) {
+    IMGVERIFY v;
+    int ret;
+
+    imgverify_init(&v, maxlen);
+
+    // Header first, so a bad length doesn't send us off the end.
+    if ( ( ret = imgverify_feed(&v, h, sizeof(IMGHDR)) ) != IMG_MORE ) return(ret);
+
+    return( imgverify_feed(&v, h + 1, h->Length) );
+    }
+
+#if defined(__arm__)
+#include "bl_launcher.h"
+
+/// @brief Verify an image and launch it.
+/// @return only if the image is bad, with the IMG_ERR code.
+/// @param h the header at the start of the slot
+/// @param maxlen size of the slot
+/// @param runtimep runtime data for the app
+/// @param mode IMG_LAUNCH_MSP, IMG_LAUNCH_THREAD or IMG_LAUNCH_NOSP
+int imghdr_launch(const IMGHDR *h, uint32_t maxlen, uint32_t *runtimep, int mode) {
+    uint32_t *vectors = (uint32_t *) ( (uintptr_t) h + h->Entry );
+    int ret = imghdr_verify(h, maxlen);
+
+    if ( ret != IMG_OK ) return(ret);
+
+    switch ( mode ) {
+        case IMG_LAUNCH_THREAD:
+            LaunchUserAppThread(vectors, runtimep);
+            break;
+
+        case IMG_LAUNCH_NOSP:
+            LaunchUserAppNoSP(vectors, runtimep);
+            break;
+
+        default:
+            LaunchUserApp(vectors, runtimep);
+            break;
+        }
+
+    return(ret);
+    }
+#endif
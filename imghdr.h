@@ -0,0 +1,59 @@
+//
+// Application image headers and verification before launch.
+//
+
+#ifndef __IMGHDR_H__
+#define __IMGHDR_H__
+
+#include <stdint.h>
+
+#define IMGHDR_MAGIC 0x474D4943 // "CIMG"
+
+// Results
+#define IMG_OK          0
+#define IMG_MORE        1  // Incremental check needs more data.
+#define IMG_ERR_MAGIC   -1
+#define IMG_ERR_HEADER  -2 // Header CRC
+#define IMG_ERR_LENGTH  -3 // Too big for the slot.
+#define IMG_ERR_ENTRY   -4 // Vector table isn't inside the image.
+#define IMG_ERR_CRC     -5 // Image CRC
+#define IMG_ERR_OVERRUN -6 // More data than the header says.
+
+// Launch modes, see bl_launcher.s
+#define IMG_LAUNCH_MSP    0 // LaunchUserApp
+#define IMG_LAUNCH_THREAD 1 // LaunchUserAppThread
+#define IMG_LAUNCH_NOSP   2 // LaunchUserAppNoSP
+
+// At the start of the image slot.
+typedef struct {
+    uint32_t Magic;
+    uint32_t Length;    // Bytes of image after the header.
+    uint32_t Version;   // For the app's own use.
+    uint32_t Entry;     // Offset of the vector table from the header.
+    uint32_t CRC;       // crc32 of the image after the header.
+    uint32_t HeaderCRC; // crc32 of the header up to here.
+    } IMGHDR;
+
+// Incremental verifier state.
+typedef struct {
+    IMGHDR Hdr;
+    uint32_t MaxLength;
+    uint32_t Count;     // Bytes seen so far, header included.
+    uint32_t CRC;
+    int Status;
+    uint8_t Carry[4];   // Partial word, for the hardware CRC.
+    uint32_t CarryLen;
+    } IMGVERIFY;
+
+int  imghdr_check(const IMGHDR*, uint32_t maxlen);
+void imghdr_make(IMGHDR*, const void *body, uint32_t len, uint32_t version, uint32_t entry);
+int  imghdr_verify(const IMGHDR*, uint32_t maxlen);
+
+void imgverify_init(IMGVERIFY*, uint32_t maxlen);
+int  imgverify_feed(IMGVERIFY*, const void *buf, uint32_t len);
+
+#if defined(__arm__)
+int imghdr_launch(const IMGHDR*, uint32_t maxlen, uint32_t *runtimep, int mode);
+#endif
+
+#endif
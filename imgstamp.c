@@ -0,0 +1,82 @@
+/// @file imgstamp.c
+/// @brief Host tool.  Puts an IMGHDR on a raw application binary.
+/// @details
+/// The binary is linked to run from slot + entry.  The output is the
+/// header, zero padding up to entry, and the binary - ready to program
+/// at the start of the slot.
+///
+/// Usage: imgstamp [-v version] [-e entry] in.bin out.img
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "imghdr.h"
+
+int main(int argc, char **argv) {
+    uint32_t version = 0, entry = 256;
+    uint8_t *image;
+    long size;
+    uint32_t len;
+    IMGHDR h;
+    FILE *f;
+    int opt;
+
+    while ( ( opt = getopt(argc, argv, "v:e:") ) != -1 ) {
+        switch ( opt ) {
+            case 'v':
+                version = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'e':
+                entry = strtoul(optarg, NULL, 0);
+                break;
+
+            default:
+                argc = 0;
+                break;
+            }
+        }
+
+    if ( argc - optind != 2 || entry < sizeof(IMGHDR) || ( entry & 3 ) ) {
+        fprintf(stderr, "usage: %s [-v version] [-e entry] in.bin out.img\n", argv[0]);
+        return(1);
+        }
+
+    if ( ( f = fopen(argv[optind], "rb") ) == NULL ) {
+        perror(argv[optind]);
+        return(1);
+        }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // Everything after the header - padding and the binary.
+    len = entry - sizeof(IMGHDR) + size;
+    image = calloc(1, sizeof(IMGHDR) + len);
+
+    if ( fread(image + entry, 1, size, f) != (size_t) size ) {
+        perror(argv[optind]);
+        return(1);
+        }
+
+    fclose(f);
+
+    imghdr_make(&h, image + sizeof(IMGHDR), len, version, entry);
+    memcpy(image, &h, sizeof(h));
+
+    if ( ( f = fopen(argv[optind + 1], "wb") ) == NULL ||
+            fwrite(image, 1, sizeof(IMGHDR) + len, f) != sizeof(IMGHDR) + len ) {
+        perror(argv[optind + 1]);
+        return(1);
+        }
+
+    fclose(f);
+    printf("%s: %u bytes, version 0x%x, entry 0x%x, CRC 0x%08x\n",
+           argv[optind + 1], (unsigned) ( sizeof(IMGHDR) + len ), version, entry, h.CRC);
+    free(image);
+    return(0);
+    }
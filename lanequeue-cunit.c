@@ -0,0 +1,266 @@
+// CUnit tests for the multi-lane queue.
+//
+// Everything runs off a clock the tests move by hand - one tick per
+// byte sent, like a link - so the results are the same every run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lanequeue.h"
+
+#include "CUnit/Basic.h"
+
+#define CONTROL   0
+#define TELEMETRY 1
+#define BULK      2
+
+LANEQUEUE q;
+uint8_t ring[LQ_LANES][4096];
+uint8_t msg[1024], out[1024];
+uint32_t ticks;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static uint32_t clock_ticks(void) {
+    return(ticks);
+    }
+
+// Keep a lane topped up with messages of one size.
+static void fill(int lane, int len) {
+    memset(msg, lane, len);
+
+    while ( ringbuffer_free(&q.Lane[lane].Ring) >= (uint32_t) ( len + LQ_HDR ) ) lq_put(&q, lane, msg, len);
+    }
+
+// Send n messages over the link, keeping the listed lanes busy.
+static void run(int n, const int *sizes) {
+    for ( int i = 0; i < n; i++ ) {
+        int lane, len;
+
+        for ( int l = 0; l < q.Lanes; l++ ) {
+            if ( sizes[l] ) fill(l, sizes[l]);
+            }
+
+        len = lq_get(&q, out, sizeof(out), &lane);
+        CU_ASSERT_FATAL( len > 0 );
+        CU_ASSERT( out[0] == lane && out[len - 1] == lane );
+        ticks += len;
+        }
+    }
+
+static void setup(int mode, uint32_t quantum) {
+    ticks = 0;
+    lq_init(&q, mode, quantum, clock_ticks);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testPutGet(void) {
+    int lane;
+
+    setup(LQ_FAIR, 256);
+    lq_lane(&q, CONTROL, ring[0], 64, 1, 1);
+    lq_lane(&q, BULK, ring[2], 64, 1, 1);
+
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 0 );
+
+    ticks = 5;
+    CU_ASSERT( lq_put(&q, BULK, "hello", 5) == 0 );
+    CU_ASSERT( lq_put(&q, BULK, "", 0) == 0 );
+    CU_ASSERT( lq_pending(&q) == 5 + 2 * LQ_HDR );
+
+    ticks = 12;
+    CU_ASSERT( lq_get(&q, out, 4, &lane) == -1 ); // Too small.  Still there.
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 5 );
+    CU_ASSERT( lane == BULK );
+    CU_ASSERT( memcmp(out, "hello", 5) == 0 );
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 0 );
+    CU_ASSERT( lane == BULK );
+    CU_ASSERT( lq_pending(&q) == 0 );
+
+    CU_ASSERT( q.Lane[BULK].Sent == 2 );
+    CU_ASSERT( q.Lane[BULK].Bytes == 5 );
+    CU_ASSERT( q.Lane[BULK].MaxLatency == 7 );
+    CU_ASSERT( q.Lane[BULK].TotalLatency == 14 );
+    }
+
+void testDrops(void) {
+    setup(LQ_FAIR, 256);
+    lq_lane(&q, CONTROL, ring[0], 64, 1, 1);
+    lq_lane(&q, BULK, ring[2], 64, 1, 1);
+
+    // 64 bytes holds two of 26 + 6.
+    CU_ASSERT( lq_put(&q, BULK, msg, 26) == 0 );
+    CU_ASSERT( lq_put(&q, BULK, msg, 26) == 0 );
+    CU_ASSERT( lq_put(&q, BULK, msg, 1) == -1 );
+    CU_ASSERT( lq_put(&q, BULK, msg, 100) == -1 );
+    CU_ASSERT( q.Lane[BULK].Dropped == 2 );
+    CU_ASSERT( q.Lane[BULK].Queued == 2 );
+
+    // The others don't care.
+    CU_ASSERT( lq_put(&q, CONTROL, msg, 10) == 0 );
+    CU_ASSERT( q.Lane[CONTROL].Dropped == 0 );
+    }
+
+// Strict priority.   Control goes first, every time.
+void testStrict(void) {
+    static const int sizes[] = { 0, 0, 512 };
+    int lane;
+
+    setup(LQ_STRICT, 0);
+    lq_lane(&q, CONTROL, ring[0], 256, 1, 1);
+    lq_lane(&q, TELEMETRY, ring[1], 256, 1, 1);
+    lq_lane(&q, BULK, ring[2], 4096, 1, 1);
+
+    run(10, sizes);
+    lq_put(&q, TELEMETRY, msg, 20);
+    lq_put(&q, CONTROL, msg, 8);
+
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 8 && lane == CONTROL );
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 20 && lane == TELEMETRY );
+    CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 512 && lane == BULK );
+    }
+
+// Equal weights, wildly different message sizes.   The bytes come out
+// even, not the messages.
+void testFairBytes(void) {
+    static const int sizes[] = { 16, 100, 1000 };
+    uint32_t total;
+
+    setup(LQ_FAIR, 1000);
+    lq_lane(&q, CONTROL, ring[0], 4096, 1, 1);
+    lq_lane(&q, TELEMETRY, ring[1], 4096, 1, 1);
+    lq_lane(&q, BULK, ring[2], 4096, 1, 1);
+
+    run(50000, sizes);
+
+    total = q.Lane[0].Bytes + q.Lane[1].Bytes + q.Lane[2].Bytes;
+
+    for ( int l = 0; l < 3; l++ ) {
+        CU_ASSERT( abs((int) ( 3 * q.Lane[l].Bytes ) - (int) total) < (int) total / 100 );
+        }
+    }
+
+// Fractional weights - 1/2, 3/2 and 1 - give exactly those shares.
+void testFractional(void) {
+    static const int sizes[] = { 50, 50, 50 };
+    uint32_t total;
+
+    setup(LQ_FAIR, 200);
+    lq_lane(&q, CONTROL, ring[0], 4096, 1, 2);
+    lq_lane(&q, TELEMETRY, ring[1], 4096, 3, 2);
+    lq_lane(&q, BULK, ring[2], 4096, 1, 1);
+
+    run(30000, sizes);
+
+    total = q.Lane[0].Sent + q.Lane[1].Sent + q.Lane[2].Sent;
+    CU_ASSERT( total == 30000 );
+
+    // 1 : 3 : 2.   A round's worth of slack.
+    CU_ASSERT( abs((int) ( 6 * q.Lane[0].Sent ) - (int) total) <= 6 * 8 );
+    CU_ASSERT( abs((int) ( 2 * q.Lane[1].Sent ) - (int) total) <= 2 * 8 );
+    CU_ASSERT( abs((int) ( 3 * q.Lane[2].Sent ) - (int) total) <= 3 * 8 );
+    }
+
+// Bulk is always full.   A control message waits for at most a round,
+// never for the bulk backlog.
+void testNoStarvation(void) {
+    static const int sizes[] = { 0, 0, 1000 };
+    int lane;
+
+    setup(LQ_FAIR, 1000);
+    lq_lane(&q, CONTROL, ring[0], 256, 1, 4);
+    lq_lane(&q, BULK, ring[2], 4096, 4, 1);
+
+    for ( int i = 0; i < 200; i++ ) {
+        memset(msg, CONTROL, 8);
+
+        if ( i % 10 == 0 ) lq_put(&q, CONTROL, msg, 8);
+
+        run(1, sizes);
+        }
+
+    // One quantum of bulk, 4000 bytes, is the most it can be stuck behind.
+    CU_ASSERT( q.Lane[CONTROL].Sent == 20 );
+    CU_ASSERT( q.Lane[CONTROL].MaxLatency <= 4000 + 1000 );
+
+    // And a lane on its own gets the whole link.
+    while ( lq_get(&q, out, sizeof(out), &lane) > 0 ) CU_ASSERT( lane == BULK );
+
+    memset(msg, CONTROL, 4);
+
+    for ( int i = 0; i < 20; i++ ) lq_put(&q, CONTROL, msg, 4);
+
+    for ( int i = 0; i < 20; i++ ) CU_ASSERT( lq_get(&q, out, sizeof(out), &lane) == 4 && lane == CONTROL );
+    }
+
+// Same inputs, same order.
+void testDeterministic(void) {
+    static const int sizes[] = { 30, 70, 400 };
+    uint8_t order[2][2000];
+
+    for ( int pass = 0; pass < 2; pass++ ) {
+        setup(LQ_FAIR, 300);
+        lq_lane(&q, CONTROL, ring[0], 1024, 2, 3);
+        lq_lane(&q, TELEMETRY, ring[1], 1024, 5, 4);
+        lq_lane(&q, BULK, ring[2], 4096, 7, 3);
+
+        for ( int i = 0; i < 2000; i++ ) {
+            run(1, sizes);
+            order[pass][i] = out[0];
+            }
+        }
+
+    CU_ASSERT( memcmp(order[0], order[1], sizeof(order[0])) == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Lane Queue", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Put and get", testPutGet)) ||
+            (NULL == CU_add_test(pSuite, "Drops", testDrops)) ||
+            (NULL == CU_add_test(pSuite, "Strict priority", testStrict)) ||
+            (NULL == CU_add_test(pSuite, "Fair by bytes", testFairBytes)) ||
+            (NULL == CU_add_test(pSuite, "Fractional weights", testFractional)) ||
+            (NULL == CU_add_test(pSuite, "No starvation", testNoStarvation)) ||
+            (NULL == CU_add_test(pSuite, "Deterministic", testDeterministic))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
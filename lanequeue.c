@@ -0,0 +1,172 @@
+/// @file lanequeue.c
+/// @brief Multi-lane message queue with strict or weighted-fair draining.
+/// @details
+/// Control, telemetry and bulk traffic share one link.   In one ring,
+/// a bulk transfer sits in front of every control message.   Here each
+/// class has its own lane, and the drain picks which goes next:
+/// - LQ_STRICT - always the lowest numbered lane that has something.
+///   Lane 0 never waits for the others, but can starve them.
+/// - LQ_FAIR - deficit round robin.   On its turn a lane gets a quantum
+///   of bytes, Quantum times its weight, and sends whole messages while
+///   they fit.   What's left carries over while it has data.   So every
+///   lane gets its share of the bytes, whatever its message sizes, and
+///   a control message waits at most a round.
+///
+/// Weights are fractions, num / denom, so the bytes per turn usually
+/// aren't whole.   A tInterpKernel hands them out - with a quantum of
+/// 100, a weight of 1/3 gets 33, 33, 34... bytes a turn, exactly 33.3
+/// on average, with no floating point.   Every lane gets some credit
+/// every turn, so a small message in a lightly weighted lane still goes
+/// within a round or so.
+///
+/// Messages go in whole or not at all, each with a header holding its
+/// length and the Clock when it was queued.   The latency is counted
+/// when it's taken.   One writer per lane and one reader, so nothing is
+/// locked - the same rules as the RINGBUF underneath.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ringbuffer.h"
+#include "bresenham.h"
+#include "lanequeue.h"
+
+/// @brief Set up the queue.   Add lanes with lq_lane().
+/// @param mode LQ_STRICT or LQ_FAIR
+/// @param quantum bytes per round for weight 1.   At least the biggest message is best.
+/// @param clock for latencies.   May be NULL.
+void lq_init(LANEQUEUE *q, int mode, uint32_t quantum, uint32_t (*clock)(void)) {
+    memset(q, 0, sizeof(*q));
+    q->Mode = mode;
+    q->Quantum = quantum;
+    q->Clock = clock;
+    q->Fresh = 1;
+    }
+
+/// @brief Set up a lane.   Lanes are numbered from 0, highest priority first.
+/// @param buf, size the ring.   Power of two.
+/// @param num, denom the weight in LQ_FAIR mode.   num must not be 0.
+/// Call lq_init() first - the weight is kept as bytes per turn.
+void lq_lane(LANEQUEUE *q, int lane, uint8_t *buf, int size, unsigned num, unsigned denom) {
+    LQLANE *l = &q->Lane[lane];
+
+    memset(l, 0, sizeof(*l));
+    ringbuffer_init(&l->Ring, buf, size);
+    interp_init(&l->Weight, q->Quantum * num, denom);
+
+    if ( lane >= q->Lanes ) q->Lanes = lane + 1;
+    }
+
+static uint32_t now(LANEQUEUE *q) {
+    return( q->Clock ? q->Clock() : 0 );
+    }
+
+static uint8_t peek(RINGBUF *r, int offset) {
+    return( r->Buf[( r->iRead + offset ) & r->BufMask] );
+    }
+
+/// @brief Queue a message.
+/// @return 0, or -1 if the lane didn't have room.   It's counted as a drop.
+int lq_put(LANEQUEUE *q, int lane, const void *msg, int len) {
+    LQLANE *l = &q->Lane[lane];
+    const uint8_t *p = msg;
+    uint32_t stamp = now(q);
+
+    if ( len > 0xffff || ringbuffer_free(&l->Ring) < (uint32_t) ( len + LQ_HDR ) ) {
+        l->Dropped++;
+        return(-1);
+        }
+
+    ringbuffer_addchar(&l->Ring, len & 0xff);
+    ringbuffer_addchar(&l->Ring, len >> 8);
+
+    for ( int i = 0; i < 4; i++ ) ringbuffer_addchar(&l->Ring, stamp >> ( 8 * i ));
+
+    for ( int i = 0; i < len; i++ ) ringbuffer_addchar(&l->Ring, p[i]);
+
+    l->Queued++;
+    return(0);
+    }
+
+// The length of the message at the head.
+static int head(LQLANE *l) {
+    return( peek(&l->Ring, 0) | ( peek(&l->Ring, 1) << 8 ) );
+    }
+
+static int take(LANEQUEUE *q, LQLANE *l, void *buf, int size) {
+    int len = head(l);
+    uint32_t stamp = 0, latency;
+    uint8_t *p = buf;
+
+    if ( len > size ) return(-1);
+
+    for ( int i = 0; i < 4; i++ ) stamp |= (uint32_t) peek(&l->Ring, 2 + i) << ( 8 * i );
+
+    ringbuffer_bulkremove(&l->Ring, LQ_HDR);
+
+    for ( int i = 0; i < len; i++ ) p[i] = ringbuffer_getchar(&l->Ring);
+
+    latency = now(q) - stamp;
+    l->TotalLatency += latency;
+
+    if ( latency > l->MaxLatency ) l->MaxLatency = latency;
+
+    l->Sent++;
+    l->Bytes += len;
+    return(len);
+    }
+
+/// @brief Take the next message.
+/// @param buf, size where to put it
+/// @param lane set to the lane it came from.   May be NULL.
+/// @return its length, 0 if everything is empty, or -1 if the next
+/// message is bigger than size.   It stays queued.
+int lq_get(LANEQUEUE *q, void *buf, int size, int *lane) {
+    LQLANE *l;
+    int len;
+
+    if ( lq_pending(q) == 0 ) return(0);
+
+    if ( q->Mode == LQ_STRICT ) {
+        for ( q->Current = 0; ringbuffer_used(&q->Lane[q->Current].Ring) == 0; q->Current++ ) { ; }
+
+        l = &q->Lane[q->Current];
+        }
+    else {
+        for (;;) {
+            l = &q->Lane[q->Current];
+
+            if ( ringbuffer_used(&l->Ring) ) {
+                if ( q->Fresh ) {
+                    l->Deficit += interp_next(&l->Weight);
+                    q->Fresh = 0;
+                    }
+
+                if ( head(l) <= l->Deficit ) break;
+                }
+            else l->Deficit = 0; // No banking credit while idle.
+
+            q->Current = ( q->Current + 1 ) % q->Lanes;
+            q->Fresh = 1;
+            }
+        }
+
+    len = take(q, l, buf, size);
+
+    if ( len >= 0 ) {
+        l->Deficit -= len;
+
+        if ( lane ) *lane = q->Current;
+        }
+
+    return(len);
+    }
+
+/// @brief Bytes queued in all lanes, headers included.
+uint32_t lq_pending(LANEQUEUE *q) {
+    uint32_t n = 0;
+
+    for ( int i = 0; i < q->Lanes; i++ ) n += ringbuffer_used(&q->Lane[i].Ring);
+
+    return(n);
+    }
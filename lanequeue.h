@@ -0,0 +1,49 @@
+//
+// Multi-lane message queue.   One RINGBUF per traffic class, drained in
+// strict priority or weighted-fair order.
+//
+
+#ifndef __LANEQUEUE_H__
+#define __LANEQUEUE_H__
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+#include "bresenham.h"
+
+#define LQ_LANES 4
+#define LQ_HDR   6      // Per message - length, and when it was queued.
+
+#define LQ_STRICT 0     // Lowest numbered lane with anything in it.
+#define LQ_FAIR   1     // Deficit round robin, by weight.
+
+typedef struct {
+    RINGBUF Ring;
+    tInterpKernel Weight; // Bytes per turn, as a fraction.
+    int32_t Deficit;      // Bytes it may still send this round.
+
+    uint32_t Queued;      // Statistics
+    uint32_t Sent;
+    uint32_t Bytes;
+    uint32_t Dropped;     // Didn't fit.
+    uint32_t MaxLatency;  // Clock ticks, queued to taken.
+    uint64_t TotalLatency;
+    } LQLANE;
+
+typedef struct {
+    LQLANE Lane[LQ_LANES];
+    int Lanes;
+    int Mode;
+    int Current;          // The lane whose turn it is.
+    int Fresh;            // It hasn't had its quantum this turn.
+    uint32_t Quantum;     // Bytes per round for a weight of 1.
+    uint32_t (*Clock)(void);
+    } LANEQUEUE;
+
+void lq_init(LANEQUEUE*, int mode, uint32_t quantum, uint32_t (*clock)(void));
+void lq_lane(LANEQUEUE*, int lane, uint8_t *buf, int size, unsigned num, unsigned denom);
+int  lq_put(LANEQUEUE*, int lane, const void *msg, int len);
+int  lq_get(LANEQUEUE*, void *buf, int size, int *lane);
+uint32_t lq_pending(LANEQUEUE*);
+
+#endif
@@ -35,7 +35,8 @@ void mpu_init() {
 
 
     // --------------------------- User Slots --------------------------
-    // Templates - R/O fences.
+    // Templates - R/O fences.   The context switch replaces these with
+    // the task's own table - see mpu_plan() and mpu_task_load().
 
     MPURegionSet(2, 0x2002ff80, MPU_RGN_SIZE_32B | MPU_RGN_PERM_NOEXEC |
                  MPU_RGN_PERM_PRV_RW_USR_RO);
@@ -25,6 +25,9 @@ unsigned long bitbanded_address(unsigned long addr, int bit) {
 /// @return
 /// - 1: Success
 /// - 0: Failure
+/// @details Any bit set in the word fails it, so locks sharing a word
+/// block each other, and waiters aren't served in order.   For fair
+/// locks with contention counters see locktable.c.
 int get_bitbanded_lock(unsigned long lockaddr, int bit) {
 
     unsigned mask, locked;
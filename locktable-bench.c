@@ -0,0 +1,132 @@
+/// @file locktable-bench.c
+/// @brief Host benchmark for the lock table.
+/// @details
+/// N threads fight over one lock, holding it for a short critical
+/// section each time.   Compares the ticket lock, lt_lock(), against
+/// spinning on lt_trylock(), which is how get_bitbanded_lock() gets
+/// used - no queue, first to look wins.   Reports the mean and worst
+/// acquisition latency, and how evenly the acquisitions were spread
+/// (the fewest any thread got in the run, over the mean).
+///
+/// Usage: locktable-bench [-m ms per run] [-t max threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "locktable.h"
+
+#define MAX_THREADS 16
+
+static LOCKTABLE table;
+static long ms = 300;
+static volatile int stop;
+static int spin;              // 1 to use the trylock loop.
+static volatile uint32_t shared;
+
+typedef struct {
+    long Got;
+    double Wait, MaxWait;
+    } RESULT;
+
+static RESULT result[MAX_THREADS];
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+static uint32_t clock_us(void) {
+    return( (uint32_t) ( now() * 1e6 ) );
+    }
+
+static void relax(void) {
+    sched_yield();
+    }
+
+static void *worker(void *arg) {
+    RESULT *r = arg;
+
+    while ( !stop ) {
+        double t = now(), w;
+
+        if ( spin ) {
+            while ( !lt_trylock(&table, 0) ) relax();
+            }
+        else lt_lock(&table, 0);
+
+        w = now() - t;
+        r->Wait += w;
+
+        if ( w > r->MaxWait ) r->MaxWait = w;
+
+        r->Got++;
+
+        for ( int j = 0; j < 16; j++ ) shared = shared + 1;
+
+        lt_unlock(&table, 0);
+        }
+
+    return(arg);
+    }
+
+int main(int argc, char **argv) {
+    int opt, maxthreads = 4;
+
+    while ( ( opt = getopt(argc, argv, "m:t:") ) != -1 ) {
+        if ( opt == 'm' ) ms = atol(optarg);
+        else if ( opt == 't' ) maxthreads = atoi(optarg);
+        else {
+            fprintf(stderr, "Usage: locktable-bench [-m ms] [-t threads]\n");
+            return(2);
+            }
+        }
+
+    if ( maxthreads < 1 || maxthreads > MAX_THREADS ) maxthreads = 4;
+
+    printf("%-8s %7s %10s %10s %8s %9s\n", "lock", "threads", "mean ns", "max us", "fair", "contended");
+
+    for ( int threads = 1; threads <= maxthreads; threads *= 2 ) {
+        for ( spin = 0; spin < 2; spin++ ) {
+            pthread_t t[MAX_THREADS];
+            struct timespec run = { ms / 1000, ms % 1000 * 1000000 };
+            double wait = 0, maxwait = 0;
+            long got = 0, fewest = -1;
+
+            lt_init(&table, clock_us, relax);
+            stop = 0;
+
+            for ( int i = 0; i < threads; i++ ) {
+                result[i] = (RESULT) { 0, 0, 0 };
+                pthread_create(&t[i], NULL, worker, &result[i]);
+                }
+
+            nanosleep(&run, NULL);
+            stop = 1;
+
+            for ( int i = 0; i < threads; i++ ) pthread_join(t[i], NULL);
+
+            for ( int i = 0; i < threads; i++ ) {
+                wait += result[i].Wait;
+                got += result[i].Got;
+
+                if ( result[i].MaxWait > maxwait ) maxwait = result[i].MaxWait;
+
+                if ( fewest < 0 || result[i].Got < fewest ) fewest = result[i].Got;
+                }
+
+            printf("%-8s %7d %10.1f %10.1f %8.2f %8.1f%%\n", spin ? "trylock" : "ticket", threads,
+                   wait / got * 1e9, maxwait * 1e6,
+                   (double) fewest * threads / got,
+                   100.0 * table.Lock[0].Contended / table.Lock[0].Acquires);
+            }
+        }
+
+    return(0);
+    }
@@ -0,0 +1,228 @@
+// CUnit tests for the lock table.
+//
+// The clock is a counter that the tests move by hand, so the wait and
+// hold times come out exact.   The threaded tests check mutual exclusion
+// and first come, first served order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "locktable.h"
+
+#include "CUnit/Basic.h"
+
+LOCKTABLE table;
+uint32_t ticks;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static uint32_t clock_ticks(void) {
+    return( __atomic_load_n(&ticks, __ATOMIC_SEQ_CST) );
+    }
+
+static void relax(void) {
+    sched_yield();
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testTrylock(void) {
+    lt_init(&table, clock_ticks, relax);
+
+    CU_ASSERT( lt_trylock(&table, 3) == 1 );
+    CU_ASSERT( lt_held(&table, 3) );
+    CU_ASSERT( lt_trylock(&table, 3) == 0 );
+
+    // Its neighbours in the word don't care.
+    CU_ASSERT( lt_trylock(&table, 2) == 1 );
+    CU_ASSERT( lt_trylock(&table, 4) == 1 );
+    CU_ASSERT( table.Held == 0x1c );
+
+    lt_unlock(&table, 3);
+    CU_ASSERT( !lt_held(&table, 3) );
+    CU_ASSERT( table.Held == 0x14 );
+    CU_ASSERT( lt_trylock(&table, 3) == 1 );
+
+    lt_unlock(&table, 2);
+    lt_unlock(&table, 3);
+    lt_unlock(&table, 4);
+    CU_ASSERT( table.Held == 0 );
+
+    // A failed trylock doesn't take a ticket.
+    CU_ASSERT( table.Lock[3].Next == 2 );
+    CU_ASSERT( table.Lock[3].Serving == 2 );
+    CU_ASSERT( table.Lock[3].Acquires == 2 );
+    CU_ASSERT( table.Lock[3].Contended == 0 );
+    }
+
+void testHoldTime(void) {
+    LTLOCK *l = &table.Lock[0];
+
+    lt_init(&table, clock_ticks, relax);
+    ticks = 100;
+
+    lt_lock(&table, 0);
+    ticks = 130;
+    lt_unlock(&table, 0);
+
+    CU_ASSERT( lt_trylock(&table, 0) );
+    ticks = 140;
+    lt_unlock(&table, 0);
+
+    CU_ASSERT( l->Acquires == 2 );
+    CU_ASSERT( l->Contended == 0 );
+    CU_ASSERT( l->WaitTime == 0 );
+    CU_ASSERT( l->HoldTime == 40 );
+    CU_ASSERT( l->MaxHold == 30 );
+
+    lt_reset_stats(&table, 0);
+    CU_ASSERT( l->Acquires == 0 );
+    CU_ASSERT( l->HoldTime == 0 );
+    CU_ASSERT( l->MaxHold == 0 );
+    }
+
+void testWrap(void) {
+    lt_init(&table, NULL, NULL);
+    table.Lock[7].Next = table.Lock[7].Serving = 0xfffffffe;
+
+    for ( int i = 0; i < 4; i++ ) {
+        lt_lock(&table, 7);
+        CU_ASSERT( lt_trylock(&table, 7) == 0 );
+        lt_unlock(&table, 7);
+        }
+
+    CU_ASSERT( table.Lock[7].Serving == 2 );
+    CU_ASSERT( table.Lock[7].Contended == 0 );
+    }
+
+// A waiter queues behind the holder, and gets it when it's let go.
+static void *waiter(void *arg) {
+    lt_lock(&table, 1);
+    ticks = 500;
+    lt_unlock(&table, 1);
+    return(arg);
+    }
+
+void testWait(void) {
+    LTLOCK *l = &table.Lock[1];
+    pthread_t t;
+
+    lt_init(&table, clock_ticks, relax);
+    ticks = 100;
+
+    lt_lock(&table, 1);
+    pthread_create(&t, NULL, waiter, NULL);
+
+    while ( __atomic_load_n(&l->Next, __ATOMIC_SEQ_CST) != 2 ) sched_yield();
+
+    ticks = 300;
+    lt_unlock(&table, 1);
+    pthread_join(t, NULL);
+
+    CU_ASSERT( l->Acquires == 2 );
+    CU_ASSERT( l->Contended == 1 );
+    CU_ASSERT( l->MaxQueue == 1 );
+    CU_ASSERT( l->WaitTime == 200 );
+    CU_ASSERT( l->MaxWait == 200 );
+    CU_ASSERT( l->HoldTime == 400 );
+    CU_ASSERT( l->MaxHold == 200 );
+    CU_ASSERT( table.Held == 0 );
+    }
+
+// Everyone adds to a counter that isn't atomic, and keeps a note of
+// who was served.   Nobody can have more than THREADS - 1 tickets ahead.
+#define THREADS 4
+#define ROUNDS  20000
+
+volatile uint32_t shared, inside;
+uint32_t order[THREADS * ROUNDS];
+int bad;
+
+static void *hammer(void *arg) {
+    for ( int i = 0; i < ROUNDS; i++ ) {
+        lt_lock(&table, 5);
+
+        if ( inside++ ) bad++;
+
+        order[shared] = (uint32_t) (intptr_t) arg;
+        shared = shared + 1;
+        inside--;
+
+        lt_unlock(&table, 5);
+        }
+
+    return(arg);
+    }
+
+void testExclusion(void) {
+    pthread_t t[THREADS];
+    uint32_t got[THREADS] = { 0 };
+
+    lt_init(&table, clock_ticks, relax);
+    shared = inside = bad = 0;
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_create(&t[i], NULL, hammer, (void *) (intptr_t) i);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_join(t[i], NULL);
+
+    CU_ASSERT( shared == THREADS * ROUNDS );
+    CU_ASSERT( bad == 0 );
+    CU_ASSERT( table.Lock[5].Acquires == THREADS * ROUNDS );
+    CU_ASSERT( table.Lock[5].MaxQueue < THREADS );
+    CU_ASSERT( table.Held == 0 );
+
+    for ( int i = 0; i < THREADS * ROUNDS; i++ ) got[order[i]]++;
+
+    for ( int i = 0; i < THREADS; i++ ) CU_ASSERT( got[i] == ROUNDS );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Lock Table", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Trylock", testTrylock)) ||
+            (NULL == CU_add_test(pSuite, "Hold time", testHoldTime)) ||
+            (NULL == CU_add_test(pSuite, "Ticket wrap", testWrap)) ||
+            (NULL == CU_add_test(pSuite, "Wait in turn", testWait)) ||
+            (NULL == CU_add_test(pSuite, "Mutual exclusion", testExclusion))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
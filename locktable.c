@@ -0,0 +1,149 @@
+/// @file locktable.c
+/// @brief Lock table.   Fair ticket locks with counters.
+/// @details
+/// get_bitbanded_lock() shares a word between locks, so one holder
+/// blocks every lock in the word.   It doesn't queue, so a busy waiter
+/// can lose every time, and it doesn't say how often anyone waits.
+///
+/// These are ticket locks.   Take a number with an atomic add, and wait
+/// until it's being served.   First come, first served.   Each lock has
+/// its own words, so locks don't interfere.
+/// - lt_trylock() only takes a ticket if it can be served at once, with
+///   a compare and swap.   It never waits or queues.
+/// - lt_lock() backs off in proportion to the number of tickets ahead,
+///   up to LT_BACKOFF_MAX spins, then calls Relax if there is one -
+///   sched_yield() lets the holder run on a single core.
+/// - The holder keeps the counters.   Acquires, how many of them had to
+///   wait, the longest queue, and the wait and hold times from Clock.
+///
+/// The atomics are LDREX/STREX from atomic.c on the target, and C11 from
+/// atomic-host.c on the host.
+///
+/// The bitband fast path is kept for Held, where it's safe - one bit per
+/// lock, written only by the holder, so a single store to the bitband
+/// alias can't disturb any other lock's bit.   Debuggers and crash dumps
+/// can see who holds what in one word.   It's never used to decide who
+/// gets the lock.   Tables outside the SRAM bitband region, and host
+/// builds, use atomic OR and AND instead.
+///
+/// Ticket locks spin.   Don't take one from an ISR that might have
+/// interrupted the holder.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "barrier.h"
+#include "locktable.h"
+
+#if defined(__arm__)
+#include "locker-bb.h"
+
+#define SRAM_BB_START 0x20000000
+#define SRAM_BB_END   0x20100000
+#endif
+
+/// @brief Set up a table.   All locks free.
+/// @param clock for the wait and hold times.  May be NULL.
+/// @param relax called between rounds of waiting.  May be NULL.
+void lt_init(LOCKTABLE *t, uint32_t (*clock)(void), void (*relax)(void)) {
+    memset(t, 0, sizeof(*t));
+    t->Clock = clock;
+    t->Relax = relax;
+
+#if defined(__arm__)
+    if ( (uint32_t) &t->Held >= SRAM_BB_START && (uint32_t) &t->Held < SRAM_BB_END ) {
+        t->HeldBB = (volatile uint32_t *) bitbanded_address((unsigned long) &t->Held, 0);
+        }
+#endif
+    }
+
+static uint32_t now(LOCKTABLE *t) {
+    return( t->Clock ? t->Clock() : 0 );
+    }
+
+// Ours now.   Only the holder gets here, so no atomics for the counters.
+static void taken(LOCKTABLE *t, int id, uint32_t asked, uint32_t ahead) {
+    LTLOCK *l = &t->Lock[id];
+    uint32_t got = now(t);
+
+    l->Since = got;
+    l->Acquires++;
+
+    if ( ahead ) {
+        l->Contended++;
+        l->WaitTime += got - asked;
+
+        if ( got - asked > l->MaxWait ) l->MaxWait = got - asked;
+
+        if ( ahead > l->MaxQueue ) l->MaxQueue = ahead;
+        }
+
+    if ( t->HeldBB ) t->HeldBB[id] = 1;
+    else atomic_mask_or(&t->Held, 1u << id);
+    }
+
+/// @brief Get a lock if it's free.
+/// @return 1 if we have it, 0 if someone else does.
+int lt_trylock(LOCKTABLE *t, int id) {
+    LTLOCK *l = &t->Lock[id];
+    uint32_t serving = *(volatile uint32_t *) &l->Serving;
+
+    if ( !atomic_cas(&l->Next, serving, serving + 1) ) return(0);
+
+    taken(t, id, 0, 0);
+    return(1);
+    }
+
+/// @brief Wait for a lock, in turn.
+void lt_lock(LOCKTABLE *t, int id) {
+    LTLOCK *l = &t->Lock[id];
+    uint32_t asked = now(t);
+    uint32_t ticket = atomic_add(&l->Next, 1) - 1;
+    uint32_t ahead = ticket - *(volatile uint32_t *) &l->Serving, first = ahead;
+
+    while ( ahead ) {
+        uint32_t spins = ahead * LT_BACKOFF;
+
+        if ( spins > LT_BACKOFF_MAX ) spins = LT_BACKOFF_MAX;
+
+        while ( spins-- ) COMPILER_BARRIER();
+
+        if ( t->Relax ) t->Relax();
+
+        ahead = ticket - *(volatile uint32_t *) &l->Serving;
+        }
+
+    MEM_BARRIER(); // Nothing from the critical section before we have it.
+    taken(t, id, asked, first);
+    }
+
+/// @brief Let the next ticket in.
+void lt_unlock(LOCKTABLE *t, int id) {
+    LTLOCK *l = &t->Lock[id];
+    uint32_t held = now(t) - l->Since;
+
+    l->HoldTime += held;
+
+    if ( held > l->MaxHold ) l->MaxHold = held;
+
+    if ( t->HeldBB ) t->HeldBB[id] = 0;
+    else atomic_mask_and(&t->Held, ~( 1u << id ));
+
+    MEM_BARRIER(); // The critical section is done before the next one starts.
+    *(volatile uint32_t *) &l->Serving = l->Serving + 1;
+    }
+
+/// @brief Is anybody holding it?   A snapshot, for reports.
+int lt_held(LOCKTABLE *t, int id) {
+    return( ( *(volatile uint32_t *) &t->Held >> id ) & 1 );
+    }
+
+/// @brief Clear a lock's counters.   Hold the lock.
+void lt_reset_stats(LOCKTABLE *t, int id) {
+    LTLOCK *l = &t->Lock[id];
+
+    l->Acquires = l->Contended = l->MaxQueue = l->MaxWait = l->MaxHold = 0;
+    l->WaitTime = l->HoldTime = 0;
+    }
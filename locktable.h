@@ -0,0 +1,44 @@
+//
+// Lock table.   Fair ticket locks with contention and hold time counters.
+//
+
+#ifndef __LOCKTABLE_H__
+#define __LOCKTABLE_H__
+
+#include <stdint.h>
+
+#define LT_LOCKS       32   // One bit each in Held.
+#define LT_BACKOFF     16   // Spin loops per ticket ahead of us.
+#define LT_BACKOFF_MAX 1024
+
+typedef struct {
+    uint32_t Next;       // Ticket dispenser.
+    uint32_t Serving;    // Now serving.
+    uint32_t Since;      // Clock when it was taken.
+
+    // Only the holder writes these.
+    uint32_t Acquires;
+    uint32_t Contended;  // Had to wait.
+    uint32_t MaxQueue;   // Most tickets ahead of anyone.
+    uint64_t WaitTime;   // Clock ticks.
+    uint32_t MaxWait;
+    uint64_t HoldTime;
+    uint32_t MaxHold;
+    } LTLOCK;
+
+typedef struct {
+    uint32_t Held;                 // One bit per lock.   For looking, not locking.
+    volatile uint32_t *HeldBB;     // Bitband alias of Held, or NULL.
+    uint32_t (*Clock)(void);       // DWT_CYCCNT, or a host clock.
+    void (*Relax)(void);           // Called while waiting.  May be NULL.
+    LTLOCK Lock[LT_LOCKS];
+    } LOCKTABLE;
+
+void lt_init(LOCKTABLE*, uint32_t (*clock)(void), void (*relax)(void));
+int  lt_trylock(LOCKTABLE*, int id);
+void lt_lock(LOCKTABLE*, int id);
+void lt_unlock(LOCKTABLE*, int id);
+int  lt_held(LOCKTABLE*, int id);
+void lt_reset_stats(LOCKTABLE*, int id);
+
+#endif
@@ -0,0 +1,131 @@
+/// @file lzs-bench.c
+/// @brief Host benchmark for the streaming compressor.
+/// @details
+/// Ratio and speed on the kinds of data that go through the rings -
+/// ASCII logs, register dumps, and random bytes for the worst case.
+/// Or on a file of your own.   Compression is fed 256 byte pieces, the
+/// way a ring drains.
+///
+/// Usage: lzs-bench [-n bytes] [file]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lzs.h"
+
+#define PIECE 256
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+static void bench(const char *name, const uint8_t *data, int n) {
+    static LZSENC enc;
+    static LZSDEC dec;
+    uint8_t *packed = malloc(LZS_BOUND(n) + LZS_BOUND(PIECE));
+    uint8_t *out = malloc(n + LZS_MAXLEN);
+    int clen = 0, dlen = 0, used, reps = 0;
+    double t, tc, td;
+
+    t = now();
+
+    do {
+        lzs_enc_init(&enc);
+        clen = 0;
+
+        for ( int i = 0; i < n; i += PIECE ) {
+            clen += lzs_compress(&enc, data + i, n - i < PIECE ? n - i : PIECE, packed + clen);
+            }
+
+        clen += lzs_flush(&enc, packed + clen);
+        reps++;
+        } while ( now() - t < 0.5 );
+
+    tc = ( now() - t ) / reps;
+    t = now();
+    reps = 0;
+
+    do {
+        lzs_dec_init(&dec);
+        dlen = lzs_decompress(&dec, packed, clen, &used, out, n + LZS_MAXLEN);
+        reps++;
+        } while ( now() - t < 0.5 );
+
+    td = ( now() - t ) / reps;
+
+    printf("%-12s %9d -> %9d  %6.2f:1  compress %7.1f MB/s  decompress %7.1f MB/s%s\n", name, n, clen,
+           (double) n / clen, n / tc / 1e6, n / td / 1e6,
+           ( dlen == n && memcmp(out, data, n) == 0 ) ? "" : "  MISMATCH");
+
+    free(packed);
+    free(out);
+    }
+
+int main(int argc, char **argv) {
+    int opt, n = 1 << 20;
+    uint8_t *data;
+
+    while ( ( opt = getopt(argc, argv, "n:") ) != -1 ) {
+        if ( opt == 'n' ) n = atoi(optarg);
+        else {
+            fprintf(stderr, "Usage: lzs-bench [-n bytes] [file]\n");
+            return(2);
+            }
+        }
+
+    if ( optind < argc ) {
+        FILE *f = fopen(argv[optind], "rb");
+
+        if ( !f ) {
+            perror(argv[optind]);
+            return(1);
+            }
+
+        data = malloc(n);
+        n = fread(data, 1, n, f);
+        fclose(f);
+        bench(argv[optind], data, n);
+        free(data);
+        return(0);
+        }
+
+    data = malloc(n + 128);
+    srand(49);
+
+    // ASCII log.
+    for ( int len = 0, i = 0; len < n; i++ ) {
+        static const char *what[] = { "link up", "rx overrun", "flash sync", "task idle", "tick" };
+
+        len += sprintf((char *) data + len, "[%10u] %s: %s %d\r\n", 1000 * i + rand() % 1000,
+                       i % 3 ? "info" : "warn", what[rand() % 5], rand() % 100);
+        }
+
+    bench("ascii log", data, n);
+
+    // Register dumps.
+    uint32_t regs[16];
+
+    for ( int i = 0; i < 16; i++ ) regs[i] = rand() ^ rand() << 16;
+
+    for ( int len = 0; len < n; len += sizeof(regs) ) {
+        regs[rand() % 16] ^= 1 << ( rand() % 32 );
+        regs[0] += 1000;
+        memcpy(data + len, regs, sizeof(regs));
+        }
+
+    bench("registers", data, n);
+
+    for ( int i = 0; i < n; i++ ) data[i] = rand();
+
+    bench("random", data, n);
+
+    free(data);
+    return(0);
+    }
@@ -0,0 +1,256 @@
+// CUnit tests for the streaming compressor.
+//
+// Round trips of different kinds of data, cut into random pieces on the
+// way in and on the way out, with flushes in the middle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lzs.h"
+
+#include "CUnit/Basic.h"
+
+#define SIZE 300000
+
+LZSENC enc;
+LZSDEC dec;
+uint8_t data[SIZE], packed[LZS_BOUND(SIZE) + 4096], unpacked[SIZE + LZS_MAXLEN];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void make_random(uint8_t *p, int n) {
+    for ( int i = 0; i < n; i++ ) p[i] = rand();
+    }
+
+static void make_log(uint8_t *p, int n) {
+    static const char *what[] = { "link up", "rx overrun", "flash sync", "task idle", "tick" };
+    char line[128];
+    int len = 0, i = 0;
+
+    while ( len < n ) {
+        int l = snprintf(line, sizeof(line), "[%10u] %s: %s %d\r\n", 1000 * i + rand() % 1000,
+                         i % 3 ? "info" : "warn", what[rand() % 5], rand() % 100);
+
+        if ( l > n - len ) l = n - len;
+
+        memcpy(p + len, line, l);
+        len += l;
+        i++;
+        }
+    }
+
+// A struct of registers, sampled over and over, a few bits changing.
+static void make_regs(uint8_t *p, int n) {
+    uint32_t regs[16];
+
+    make_random((uint8_t *) regs, sizeof(regs));
+
+    for ( int len = 0; len < n; len += sizeof(regs) ) {
+        regs[rand() % 16] ^= 1 << ( rand() % 32 );
+        regs[0] += 1000; // A timestamp.
+        memcpy(p + len, regs, n - len < (int) sizeof(regs) ? n - len : (int) sizeof(regs));
+        }
+    }
+
+// Compress in random pieces, flushing now and then.
+static int compress(const uint8_t *p, int n, int maxpiece, int flushes) {
+    int len = 0;
+
+    lzs_enc_init(&enc);
+
+    for ( int i = 0; i < n; ) {
+        int piece = 1 + rand() % maxpiece;
+
+        if ( piece > n - i ) piece = n - i;
+
+        len += lzs_compress(&enc, p + i, piece, packed + len);
+        i += piece;
+
+        if ( flushes && rand() % flushes == 0 ) len += lzs_flush(&enc, packed + len);
+        }
+
+    len += lzs_flush(&enc, packed + len);
+    return(len);
+    }
+
+// Decompress in random pieces, into a space that's sometimes tight.
+static int decompress(int n, int maxpiece) {
+    int len = 0;
+
+    lzs_dec_init(&dec);
+
+    for ( int i = 0; i < n; ) {
+        int piece = 1 + rand() % maxpiece, used;
+        int room = LZS_MAXLEN + rand() % 200;
+        int got;
+
+        if ( piece > n - i ) piece = n - i;
+
+        if ( room > (int) sizeof(unpacked) - len ) room = sizeof(unpacked) - len;
+
+        got = lzs_decompress(&dec, packed + i, piece, &used, unpacked + len, room);
+
+        if ( got < 0 ) return(-1);
+
+        len += got;
+        i += used;
+        }
+
+    return(len);
+    }
+
+static double round_trip(const char *name, const uint8_t *p, int n, int maxpiece, int flushes) {
+    int clen = compress(p, n, maxpiece, flushes);
+    int dlen = decompress(clen, maxpiece);
+
+    CU_ASSERT( clen <= LZS_BOUND(n) );
+    CU_ASSERT( dlen == n );
+    CU_ASSERT( memcmp(unpacked, p, n) == 0 );
+
+    if ( name ) printf("\n    %-10s %7d -> %7d, %.2f:1 ", name, n, clen, (double) n / clen);
+
+    return( (double) n / clen );
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testSmall(void) {
+    int used;
+
+    // Nothing, one byte, and a bit more than a match.
+    CU_ASSERT( compress(data, 0, 1, 0) == 0 );
+
+    data[0] = 'x';
+    round_trip(NULL, data, 1, 1, 0);
+
+    memset(data, 'a', 100);
+    round_trip(NULL, data, 100, 7, 0);
+    CU_ASSERT( compress(data, 100, 100, 0) < 10 );
+
+    // Bad offsets are caught.
+    static const uint8_t bad[] = { 0x01, 0x05, 0x00 };
+    lzs_dec_init(&dec);
+    CU_ASSERT( lzs_decompress(&dec, bad, sizeof(bad), &used, unpacked, sizeof(unpacked)) == -1 );
+    }
+
+void testRandom(void) {
+    srand(49);
+    make_random(data, SIZE);
+
+    // Incompressible - the bound has to hold.
+    CU_ASSERT( round_trip("random", data, SIZE, 5000, 0) > 0.85 );
+    }
+
+void testZeros(void) {
+    memset(data, 0, SIZE);
+    CU_ASSERT( round_trip("zeros", data, SIZE, 5000, 0) > 30 );
+    }
+
+void testLog(void) {
+    srand(50);
+    make_log(data, SIZE);
+    CU_ASSERT( round_trip("ascii log", data, SIZE, 5000, 0) > 2 );
+    }
+
+void testRegisters(void) {
+    srand(51);
+    make_regs(data, SIZE);
+    CU_ASSERT( round_trip("registers", data, SIZE, 5000, 0) > 4 );
+    }
+
+// Tiny pieces, and flushes all over the place.
+void testPieces(void) {
+    srand(52);
+    make_log(data, 50000);
+    round_trip(NULL, data, 50000, 3, 0);
+    round_trip(NULL, data, 50000, 200, 5);
+    round_trip(NULL, data, 50000, 1, 50);
+    }
+
+// Straight out of a ring, segment by segment, with the output space cut short.
+void testRing(void) {
+    static uint8_t ringmem[4096];
+    RINGBUF ring;
+    int len = 0, dlen, used, i = 0;
+
+    srand(53);
+    make_log(data, 100000);
+    ringbuffer_init(&ring, ringmem, sizeof(ringmem));
+    lzs_enc_init(&enc);
+
+    while ( i < 100000 || ringbuffer_used(&ring) ) {
+        while ( i < 100000 && ringbuffer_free(&ring) ) ringbuffer_addchar(&ring, data[i++]);
+
+        len += lzs_compress_ring(&enc, &ring, packed + len, 100 + rand() % 3000);
+        }
+
+    len += lzs_flush(&enc, packed + len);
+
+    lzs_dec_init(&dec);
+    dlen = lzs_decompress(&dec, packed, len, &used, unpacked, sizeof(unpacked));
+    CU_ASSERT( used == len );
+    CU_ASSERT( dlen == 100000 );
+    CU_ASSERT( memcmp(unpacked, data, 100000) == 0 );
+    CU_ASSERT( enc.In == 100000 );
+    CU_ASSERT( enc.Out == (uint32_t) len );
+    }
+
+// Long enough for the 16-bit hash positions to wrap many times.
+void testLong(void) {
+    srand(54);
+    make_regs(data, SIZE);
+    memcpy(data + SIZE / 2, data, SIZE / 2);
+    round_trip(NULL, data, SIZE, 100000, 0);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Streaming Compression", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Small", testSmall)) ||
+            (NULL == CU_add_test(pSuite, "Random", testRandom)) ||
+            (NULL == CU_add_test(pSuite, "Zeros", testZeros)) ||
+            (NULL == CU_add_test(pSuite, "ASCII log", testLog)) ||
+            (NULL == CU_add_test(pSuite, "Registers", testRegisters)) ||
+            (NULL == CU_add_test(pSuite, "Pieces and flushes", testPieces)) ||
+            (NULL == CU_add_test(pSuite, "From a ring", testRing)) ||
+            (NULL == CU_add_test(pSuite, "Long", testLong))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,216 @@
+/// @file lzs.c
+/// @brief Streaming LZSS compression.
+/// @details
+/// Trace rings, register dumps and ASCII logs repeat themselves a lot,
+/// and the uplink and the flash log are short of bandwidth.   This is
+/// LZSS - each item is a literal byte, or a copy of 3 to 66 bytes from
+/// up to 1023 back - with groups of eight items behind a flag byte:
+/// @code
+///    { flags, item * 8 }     flag bit n set - item n is a match
+///    literal: one byte
+///    match:   offset & 0xff, ( offset >> 8 ) << 6 | ( length - 3 )
+/// @endcode
+/// A match with offset 0 ends its group early.   lzs_flush() writes
+/// one, so everything taken in so far can be decoded - at the end of a
+/// log record, or a packet.
+///
+/// Compression takes input in pieces of any size, like the bulk pointer
+/// segments of a RINGBUF.   There's one hash table entry per 3-byte
+/// hash and no chains, so finding a match is a hash, a load and a
+/// compare.   Greedy, no lazy matching.   The state is about 4KiB,
+/// decompression about 1KiB.   Nothing is allocated.
+///
+/// Output goes into a buffer the caller provides.   LZS_BOUND(n) bytes
+/// is always enough for n bytes in, whatever they are.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ringbuffer.h"
+#include "lzs.h"
+
+#define HMASK ( LZS_HIST - 1 )
+
+/// @brief Start a new stream.
+void lzs_enc_init(LZSENC *e) {
+    memset(e, 0, sizeof(*e));
+    e->GroupLen = 1;
+    }
+
+static int hash(LZSENC *e, uint32_t p) {
+    uint32_t v = e->Hist[p & HMASK] << 16 | e->Hist[( p + 1 ) & HMASK] << 8 | e->Hist[( p + 2 ) & HMASK];
+
+    return( ( v * 2654435761u ) >> ( 32 - LZS_HASH_BITS ) );
+    }
+
+// Remember position p, if there are three bytes there to hash.
+static void insert(LZSENC *e, uint32_t p) {
+    if ( p + LZS_MINLEN <= e->End ) e->Hash[hash(e, p)] = (uint16_t) p;
+    }
+
+// Finish a group if it's full, or if end says so.
+static int item_done(LZSENC *e, uint8_t *out, int end) {
+    int n = 0;
+
+    if ( ++e->Items == 8 || end ) {
+        n = e->GroupLen;
+        memcpy(out, e->Group, n);
+        e->Group[0] = 0;
+        e->GroupLen = 1;
+        e->Items = 0;
+        e->Out += n;
+        }
+
+    return(n);
+    }
+
+// Encode one item at Pos.
+static int encode(LZSENC *e, uint8_t *out) {
+    uint32_t avail = e->End - e->Pos, best = 0, cand, dist;
+
+    if ( avail >= LZS_MINLEN ) {
+        cand = ( e->Pos & ~0xffffu ) | e->Hash[hash(e, e->Pos)];
+
+        if ( cand > e->Pos ) cand -= 0x10000;
+
+        dist = e->Pos - cand;
+
+        if ( dist > 0 && dist < LZS_WINDOW ) {
+            uint32_t max = avail < LZS_MAXLEN ? avail : LZS_MAXLEN;
+
+            while ( best < max && e->Hist[( cand + best ) & HMASK] == e->Hist[( e->Pos + best ) & HMASK] ) best++;
+            }
+
+        if ( best >= LZS_MINLEN ) {
+            e->Group[0] |= 1 << e->Items;
+            e->Group[e->GroupLen++] = dist & 0xff;
+            e->Group[e->GroupLen++] = ( dist >> 8 ) << 6 | ( best - LZS_MINLEN );
+
+            for ( uint32_t i = 0; i < best; i++ ) insert(e, e->Pos + i);
+
+            e->Pos += best;
+            return( item_done(e, out, 0) );
+            }
+        }
+
+    insert(e, e->Pos);
+    e->Group[e->GroupLen++] = e->Hist[e->Pos++ & HMASK];
+    return( item_done(e, out, 0) );
+    }
+
+/// @brief Compress some more of the stream.   Output comes a group at a
+/// time, so a few bytes may stay behind until the next call or a flush.
+/// @param out LZS_BOUND(n) bytes
+/// @return bytes written to out
+int lzs_compress(LZSENC *e, const uint8_t *in, int n, uint8_t *out) {
+    int len = 0;
+
+    e->In += n;
+
+    while ( n-- ) {
+        e->Hist[e->End++ & HMASK] = *in++;
+
+        if ( e->End - e->Pos >= LZS_MAXLEN ) len += encode(e, out + len);
+        }
+
+    return(len);
+    }
+
+/// @brief Encode everything taken in, and end the group.
+/// @param out LZS_BOUND(LZS_MAXLEN) bytes
+/// @return bytes written to out
+int lzs_flush(LZSENC *e, uint8_t *out) {
+    int len = 0;
+
+    while ( e->Pos != e->End ) len += encode(e, out + len);
+
+    if ( e->Items ) {
+        e->Group[0] |= 1 << e->Items;
+        e->Group[e->GroupLen++] = 0;
+        e->Group[e->GroupLen++] = 0;
+        len += item_done(e, out + len, 1);
+        }
+
+    return(len);
+    }
+
+/// @brief Compress what's in a ring, a bulk segment at a time, as far as
+/// it will fit in out.
+/// @return bytes written to out
+int lzs_compress_ring(LZSENC *e, RINGBUF *src, uint8_t *out, int size) {
+    int len = 0, n;
+
+    while ( ( n = ringbuffer_getbulkcount(src) ) > 0 ) {
+        if ( LZS_BOUND(n) > size - len ) n = ( size - len - 24 ) * 8 / 9;
+
+        if ( n <= 0 ) break;
+
+        len += lzs_compress(e, ringbuffer_getbulkpointer(src), n, out + len);
+        ringbuffer_bulkremove(src, n);
+        }
+
+    return(len);
+    }
+
+/// @brief Start decoding a new stream.
+void lzs_dec_init(LZSDEC *d) {
+    memset(d, 0, sizeof(*d));
+    d->Partial = -1;
+    }
+
+/// @brief Decompress some more of the stream.
+/// @param in, n compressed data, in pieces of any size
+/// @param used set to how much of it was taken.   It stops early if out
+/// is within LZS_MAXLEN of full.
+/// @return bytes written to out, or -1 if the data is bad
+int lzs_decompress(LZSDEC *d, const uint8_t *in, int n, int *used, uint8_t *out, int size) {
+    int i = 0, len = 0;
+
+    while ( i < n && !d->Error && size - len >= LZS_MAXLEN ) {
+        uint8_t b = in[i++];
+
+        if ( d->Items == 0 ) {
+            d->Flags = b;
+            d->Items = 8;
+            continue;
+            }
+
+        if ( ( d->Flags & 1 ) == 0 ) {
+            d->Hist[d->Pos++ & ( LZS_WINDOW - 1 )] = b;
+            out[len++] = b;
+            }
+        else if ( d->Partial < 0 ) {
+            d->Partial = b;
+            continue;
+            }
+        else {
+            uint32_t dist = d->Partial | ( b >> 6 ) << 8;
+            int count = ( b & 63 ) + LZS_MINLEN;
+
+            d->Partial = -1;
+
+            if ( dist == 0 ) { // End of group.
+                d->Items = 0;
+                continue;
+                }
+
+            if ( dist > d->Pos ) {
+                d->Error = 1;
+                break;
+                }
+
+            while ( count-- ) {
+                uint8_t c = d->Hist[( d->Pos - dist ) & ( LZS_WINDOW - 1 )];
+
+                d->Hist[d->Pos++ & ( LZS_WINDOW - 1 )] = c;
+                out[len++] = c;
+                }
+            }
+
+        d->Flags >>= 1;
+        d->Items--;
+        }
+
+    *used = i;
+    return( d->Error ? -1 : len );
+    }
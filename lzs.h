@@ -0,0 +1,52 @@
+//
+// Streaming LZSS compression for rings and logs.   Fixed window,
+// fixed state, no allocation.
+//
+
+#ifndef __LZS_H__
+#define __LZS_H__
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+
+#define LZS_WINDOW_BITS 10
+#define LZS_WINDOW      ( 1 << LZS_WINDOW_BITS )  // How far back a match can reach.
+#define LZS_HIST        ( 2 * LZS_WINDOW )        // Window plus lookahead.
+#define LZS_HASH_BITS   10
+#define LZS_MINLEN      3
+#define LZS_MAXLEN      ( LZS_MINLEN + 63 )
+
+/// Output space that's always enough for compressing n bytes.
+#define LZS_BOUND(n)    ( (n) + (n) / 8 + 24 )
+
+typedef struct {
+    uint8_t Hist[LZS_HIST];
+    uint16_t Hash[1 << LZS_HASH_BITS]; // Low bits of the last position with that hash.
+    uint32_t Pos;       // Next byte to encode.
+    uint32_t End;       // Bytes taken in.
+    uint8_t Group[17];  // Flags, then up to 8 items.
+    int GroupLen;
+    int Items;
+
+    uint32_t In, Out;   // Statistics
+    } LZSENC;
+
+typedef struct {
+    uint8_t Hist[LZS_WINDOW];
+    uint32_t Pos;       // Bytes produced.
+    int Flags;          // Of the current group.
+    int Items;          // Left in it.
+    int Partial;        // First byte of a match, or -1.
+    int Error;
+    } LZSDEC;
+
+void lzs_enc_init(LZSENC*);
+int  lzs_compress(LZSENC*, const uint8_t *in, int n, uint8_t *out);
+int  lzs_flush(LZSENC*, uint8_t *out);
+int  lzs_compress_ring(LZSENC*, RINGBUF *src, uint8_t *out, int size);
+
+void lzs_dec_init(LZSDEC*);
+int  lzs_decompress(LZSDEC*, const uint8_t *in, int n, int *used, uint8_t *out, int size);
+
+#endif
@@ -0,0 +1,186 @@
+// CUnit tests for the MPU planner.
+//
+// Plans get checked with a little MPU model: an address is mapped if
+// it falls in an enabled region, in a subregion that isn't disabled.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mpuplan.h"
+
+#include "CUnit/Basic.h"
+
+MPUREGION regions[MPU_SLOTS];
+MPUTASK task;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static int mapped(const MPUREGION *r, int n, uint32_t addr) {
+    for ( int i = 0; i < n; i++ ) {
+        uint32_t k = ( ( r[i].RASR >> 1 ) & 0x1F ) + 1;
+        uint64_t size = 1ULL << k;
+        uint64_t base = r[i].RBAR & ~31;
+
+        if ( !( r[i].RASR & MPU_RASR_ENABLE ) || addr < base || addr >= base + size ) continue;
+
+        if ( k >= 8 && ( r[i].RASR & ( 1 << ( 8 + ( addr - base ) / ( size >> 3 ) ) ) ) ) continue;
+
+        return(1);
+        }
+
+    return(0);
+    }
+
+// Check every 32 byte block from a bit before to a bit after.
+static int exact(const MPUREGION *r, int n, uint32_t base, uint32_t size) {
+    uint32_t from = base > 4096 ? base - 4096 : 0;
+
+    for ( uint64_t a = from; a < (uint64_t) base + size + 4096 && a <= 0xFFFFFFE0; a += 32 ) {
+        int inside = a >= base && a < (uint64_t) base + size;
+
+        if ( mapped(r, n, a) != inside ) return(0);
+        }
+
+    for ( int i = 0; i < n; i++ ) {
+        uint32_t size = 1u << ( ( ( r[i].RASR >> 1 ) & 0x1F ) + 1 );
+
+        if ( size && ( r[i].RBAR & ~31 & ( size - 1 ) ) ) return(0); // Misaligned.
+        }
+
+    return(1);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testSimple(void) {
+    // The old lm3s fences.
+    CU_ASSERT( mpu_plan_area(0x2002ff80, 32, MPU_AP_PRW_URO, regions, 4) == 1 );
+    CU_ASSERT( regions[0].RBAR == 0x2002ff80 );
+    CU_ASSERT( regions[0].RASR == ( MPU_AP_PRW_URO | ( 4 << 1 ) | MPU_RASR_ENABLE ) );
+
+    // Most of the world.
+    CU_ASSERT( mpu_plan_area(0, 0xE0000000, MPU_AP_RW, regions, 4) == 1 );
+    CU_ASSERT( regions[0].RASR == ( MPU_AP_RW | ( 0x80 << 8 ) | ( 31 << 1 ) | MPU_RASR_ENABLE ) );
+
+    // 4k aligned.
+    CU_ASSERT( mpu_plan_area(0x20001000, 4096, 0, regions, 4) == 1 );
+    CU_ASSERT( regions[0].RASR == ( ( 11 << 1 ) | MPU_RASR_ENABLE ) );
+    }
+
+void testSubregions(void) {
+    // 3k at 0x20000200 - one 4k region, with the ends switched off.
+    CU_ASSERT( mpu_plan_area(0x20000200, 0xC00, 0, regions, 4) == 1 );
+    CU_ASSERT( regions[0].RBAR == 0x20000000 );
+    CU_ASSERT( ( regions[0].RASR >> 8 & 0xFF ) == 0x81 );
+    CU_ASSERT( exact(regions, 1, 0x20000200, 0xC00) );
+
+    // 96 bytes.  Three subregions of a 256.
+    CU_ASSERT( mpu_plan_area(0x20000040, 96, 0, regions, 4) == 1 );
+    CU_ASSERT( exact(regions, 1, 0x20000040, 96) );
+
+    // 64 bytes across a 256 byte boundary.  Two 32s.
+    CU_ASSERT( mpu_plan_area(0x200000E0, 64, 0, regions, 4) == 2 );
+    CU_ASSERT( exact(regions, 2, 0x200000E0, 64) );
+
+    // Straddles a big boundary.
+    CU_ASSERT( mpu_plan_area(0x2000F000, 0x2000, 0, regions, 4) == 2 );
+    CU_ASSERT( exact(regions, 2, 0x2000F000, 0x2000) );
+
+    CU_ASSERT( mpu_plan_area(0x20000010, 64, 0, regions, 4) == -1 ); // Misaligned
+    CU_ASSERT( mpu_plan_area(0x20000000, 0, 0, regions, 4) == -1 );
+    }
+
+// Lots of areas.  Every plan must be exact, and fail with one
+// region less.
+void testExhaustive(void) {
+    int bad = 0;
+    MPUREGION r[8];
+
+    for ( uint32_t base = 0x20000000; base < 0x20000000 + 2048; base += 32 ) {
+        for ( uint32_t size = 32; size <= 4096; size += 32 ) {
+            int n = mpu_plan_area(base, size, 0, r, 8);
+
+            if ( n < 0 || !exact(r, n, base, size) ) bad++;
+            else if ( n > 1 && mpu_plan_area(base, size, 0, r, n - 1) != -1 ) bad++;
+            }
+        }
+
+    CU_ASSERT( bad == 0 );
+    }
+
+void testTask(void) {
+    MPUAREA areas[] = {
+        { 0x20004000, 0x1C00, MPU_AP_RW | MPU_MEM_SRAM | MPU_RASR_XN },
+        { 0x40004000, 0x1000, MPU_AP_RW | MPU_MEM_DEVICE | MPU_RASR_XN },
+        };
+
+    CU_ASSERT( mpu_plan(areas, 2, &task) == 2 );
+    CU_ASSERT( task.Slot[0].RBAR == ( 0x20004000 | MPU_RBAR_VALID | 2 ) );
+    CU_ASSERT( task.Slot[0].RASR & MPU_RASR_XN );
+    CU_ASSERT( ( task.Slot[0].RASR >> 8 & 0xFF ) == 0x80 );
+    CU_ASSERT( task.Slot[1].RBAR == ( 0x40004000 | MPU_RBAR_VALID | 3 ) );
+    CU_ASSERT( exact(&task.Slot[1], 1, 0x40004000, 0x1000) );
+
+    // Unused slots are valid, but disabled.
+    CU_ASSERT( task.Slot[2].RBAR == ( MPU_RBAR_VALID | 4 ) && task.Slot[2].RASR == 0 );
+    CU_ASSERT( task.Slot[3].RBAR == ( MPU_RBAR_VALID | 5 ) && task.Slot[3].RASR == 0 );
+
+    // Too many.
+    MPUAREA lots[] = {
+        { 0x20000020, 32, 0 }, { 0x20000060, 32, 0 }, { 0x200000a0, 32, 0 },
+        { 0x200000e0, 32, 0 }, { 0x20000120, 32, 0 }
+        };
+
+    CU_ASSERT( mpu_plan(lots, 4, &task) == 4 );
+    CU_ASSERT( mpu_plan(lots, 5, &task) == -1 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("MPU Planner", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Simple regions", testSimple)) ||
+            (NULL == CU_add_test(pSuite, "Subregions", testSubregions)) ||
+            (NULL == CU_add_test(pSuite, "Exhaustive", testExhaustive)) ||
+            (NULL == CU_add_test(pSuite, "Task slots", testTask))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,150 @@
+/// @file mpuplan.c
+/// @brief MPU region planner and per-task slot reload.
+/// @details
+/// An ARMv7-M MPU region is a power of two in size, aligned to its
+/// size, and at least 32 bytes.   Regions of 256 bytes and up are split
+/// into eight subregions that can be switched off one at a time.   So
+/// a buffer that isn't a nice power of two can still be mapped exactly,
+/// with a region that's bigger than it and the ends switched off, or a
+/// couple of regions.
+///
+/// mpu_plan() takes a task's list of (base, size, permissions) and
+/// works out the fewest regions that cover each one exactly - never a
+/// byte more.   The result is a table of RBAR/RASR values for slots
+/// 2-5, worked out once at task creation.
+///
+/// The context switch then does mpu_task_load(), which copies the
+/// table into the RBAR/RASR alias registers with two LDM/STM pairs.
+/// The region number is in each RBAR value, so there is no need to
+/// touch RNR, and unused slots are loaded as disabled regions.
+///
+/// Base and size must be multiples of 32.
+
+#include <stdint.h>
+
+#include "mpuplan.h"
+
+// The best region starting at or below addr, of 2^k bytes, that
+// covers from addr onwards.   Returns the end of what it covers, or
+// addr if that size won't work.
+static uint32_t candidate(uint32_t addr, uint32_t end, int k, MPUREGION *r) {
+    uint64_t size = 1ULL << k;
+    uint64_t rbase = addr & ~( size - 1 );
+    uint64_t sub = size >> 3;
+    uint64_t stop = ( rbase + size < end ) ? rbase + size : end;
+    uint32_t srd = 0;
+
+    if ( k < 8 ) { // No subregions - has to fit exactly.
+        if ( rbase != addr || stop != rbase + size ) return(addr);
+        }
+    else {
+        if ( addr & ( sub - 1 ) ) return(addr);
+
+        stop &= ~( sub - 1 );
+
+        if ( stop <= addr ) return(addr);
+
+        for ( int i = 0; i < 8; i++ ) {
+            uint64_t s = rbase + i * sub;
+
+            if ( s < addr || s >= stop ) srd |= 1 << i;
+            }
+        }
+
+    r->RBAR = (uint32_t) rbase;
+    r->RASR = ( srd << 8 ) | ( ( k - 1 ) << 1 ) | MPU_RASR_ENABLE;
+    return( (uint32_t) stop );
+    }
+
+// Depth-first search for a cover with at most max regions.
+static int search(uint32_t addr, uint32_t end, MPUREGION *out, int max) {
+    MPUREGION r;
+    int n;
+
+    if ( addr == end ) return(0);
+
+    if ( max == 0 ) return(-1);
+
+    // Smallest first, so ties go to the region with the least waste.
+    for ( int k = 5; k <= 32; k++ ) {
+        uint32_t stop = candidate(addr, end, k, &r);
+
+        if ( stop == addr ) continue;
+
+        if ( ( n = search(stop, end, out + 1, max - 1) ) >= 0 ) {
+            out[0] = r;
+            return(n + 1);
+            }
+        }
+
+    return(-1);
+    }
+
+/// @brief Work out the regions for one area.
+/// @return the number of regions, or -1 if it can't be done with max.
+/// @param base start address, multiple of 32
+/// @param size bytes, multiple of 32
+/// @param attr MPU_AP_*, MPU_MEM_* and MPU_RASR_XN bits for RASR
+/// @param out the regions.   RBAR holds just the base address.
+/// @param max room in out
+int mpu_plan_area(uint32_t base, uint32_t size, uint32_t attr, MPUREGION *out, int max) {
+    uint64_t end = (uint64_t) base + size;
+    int n = -1;
+
+    if ( size == 0 || ( base & 31 ) || ( size & 31 ) || end > 0xFFFFFFFFULL ) return(-1);
+
+    // Iterative deepening, so the first answer is the smallest.
+    for ( int depth = 1; depth <= max && n < 0; depth++ ) {
+        n = search(base, (uint32_t) end, out, depth);
+        }
+
+    for ( int i = 0; i < n; i++ ) out[i].RASR |= attr;
+
+    return(n);
+    }
+
+/// @brief Plan the task slots for a list of areas.
+/// @return the number of slots used, or -1 if they don't fit.
+/// @param areas what the task can touch
+/// @param count how many
+/// @param task the slot table to fill in
+int mpu_plan(const MPUAREA *areas, int count, MPUTASK *task) {
+    int used = 0;
+
+    for ( int i = 0; i < count; i++ ) {
+        int n = mpu_plan_area(areas[i].Base, areas[i].Size, areas[i].Attr,
+                              &task->Slot[used], MPU_SLOTS - used);
+
+        if ( n < 0 ) return(-1);
+
+        used += n;
+        }
+
+    for ( int i = used; i < MPU_SLOTS; i++ ) {
+        task->Slot[i].RBAR = 0;
+        task->Slot[i].RASR = 0; // Disabled.
+        }
+
+    for ( int i = 0; i < MPU_SLOTS; i++ ) {
+        task->Slot[i].RBAR |= MPU_RBAR_VALID | ( MPU_SLOT_FIRST + i );
+        }
+
+    return(used);
+    }
+
+#if defined(__arm__)
+/// @brief Load a task's slots.   For the context switch.
+/// Eight words to RBAR, RASR and the three alias pairs.   The exception
+/// return that follows takes care of synchronization.
+void mpu_task_load(const MPUTASK *task) {
+    const MPUTASK *src = task;
+    volatile uint32_t *dst = (volatile uint32_t *) 0xE000ED9C;
+
+    __asm__ __volatile__ (
+        "ldmia %0!, {r2, r3, r4, r5}\n\t"
+        "stmia %1!, {r2, r3, r4, r5}\n\t"
+        "ldmia %0, {r2, r3, r4, r5}\n\t"
+        "stmia %1, {r2, r3, r4, r5}\n\t"
+        : "+r" (src), "+r" (dst) : : "r2", "r3", "r4", "r5", "memory");
+    }
+#endif
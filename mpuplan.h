@@ -0,0 +1,55 @@
+//
+// MPU region planner and per-task slot reload.
+//
+
+#ifndef __MPUPLAN_H__
+#define __MPUPLAN_H__
+
+#include <stdint.h>
+
+// Task slots are regions 2-5.   0,1 and 6,7 belong to the supervisor.
+#define MPU_SLOT_FIRST 2
+#define MPU_SLOTS      4
+
+// RASR bits.
+#define MPU_RASR_ENABLE  (1 << 0)
+#define MPU_RASR_XN      (1 << 28)
+#define MPU_RBAR_VALID   (1 << 4)
+
+// Access permissions (RASR AP)
+#define MPU_AP_NONE      (0 << 24)
+#define MPU_AP_PRW       (1 << 24) // Privileged only
+#define MPU_AP_PRW_URO   (2 << 24)
+#define MPU_AP_RW        (3 << 24)
+#define MPU_AP_PRO       (5 << 24)
+#define MPU_AP_RO        (6 << 24)
+
+// Memory types (RASR TEX/S/C/B)
+#define MPU_MEM_SRAM     ( (1 << 18) | (1 << 17) ) // Shareable, cacheable
+#define MPU_MEM_FLASH    (1 << 17)
+#define MPU_MEM_DEVICE   ( (1 << 18) | (1 << 16) )
+
+typedef struct {
+    uint32_t Base;
+    uint32_t Size;
+    uint32_t Attr;  // MPU_AP_*, MPU_MEM_*, MPU_RASR_XN
+    } MPUAREA;
+
+typedef struct {
+    uint32_t RBAR;  // Includes VALID and the region number.
+    uint32_t RASR;
+    } MPUREGION;
+
+// Everything a context switch needs, in alias register order.
+typedef struct {
+    MPUREGION Slot[MPU_SLOTS];
+    } MPUTASK;
+
+int mpu_plan_area(uint32_t base, uint32_t size, uint32_t attr, MPUREGION *out, int max);
+int mpu_plan(const MPUAREA *areas, int count, MPUTASK *task);
+
+#if defined(__arm__)
+void mpu_task_load(const MPUTASK *task);
+#endif
+
+#endif
@@ -3,6 +3,9 @@
 // Copyright(C) 2012 Robert Sexton
 //
 
+#ifndef __RINGBUFFER_H__
+#define __RINGBUFFER_H__
+
 #ifndef __STDINT_H__
 #include <stdint.h>
 #endif
@@ -35,5 +38,4 @@ void    ringbuffer_bulkremove(RINGBUF*, int count);
 
 int  ringbuffer_reset_count(RINGBUF*);
 
-
-
+#endif
@@ -0,0 +1,283 @@
+// CUnit tests for the runtime link table.
+//
+// The simulation runs the supervisor and the app as two threads on one
+// table.   The app sends numbered requests on every channel, the
+// supervisor checks them and answers in place, and the app checks
+// the answers.   Any lost, duplicated or torn descriptor or buffer
+// shows up as a mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "rtlink.h"
+
+#include "CUnit/Basic.h"
+
+#define POOLSIZE  ( 16 * 1024 )
+#define BLOCK     128
+#define REQUESTS  100000
+#define INFLIGHT  ( RTLINK_SLOTS / 2 ) // Per channel.
+
+#define OP_SUM    1
+#define OP_STOP   2
+
+uint32_t shared[( sizeof(RTLINK) + POOLSIZE ) / 4];
+
+typedef struct {
+    long Requests;
+    long Errors;
+    long Full;
+    } SIMSTATS;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// The supervisor.   Sums each request's bytes into the first word.
+static void *supervisor(void *arg) {
+    RTLINK *l = (RTLINK *) shared;
+    SIMSTATS *stats = arg;
+    int running = RTLINK_CHANNELS;
+
+    while ( running ) {
+        for ( int c = 0; c < RTLINK_CHANNELS; c++ ) {
+            RTDESC d;
+            uint8_t *b;
+            uint32_t sum = 0;
+
+            if ( !rtlink_recv(&l->ToSup[c], &d) ) {
+                if ( c == RTLINK_CHANNELS - 1 ) sched_yield();
+
+                continue;
+                }
+
+            if ( d.Op == OP_STOP ) {
+                running--;
+                continue;
+                }
+
+            if ( ( b = rtlink_data(l, &d) ) == NULL || d.Op != OP_SUM ) {
+                stats->Errors++;
+                continue;
+                }
+
+            for ( uint32_t i = 0; i < d.Length; i++ ) sum += b[i];
+
+            memcpy(b, &sum, 4);
+            stats->Requests++;
+
+            while ( rtlink_reply(&l->ToApp[c], &d, d.Tag, 4) ) stats->Full++;
+            }
+        }
+
+    return(arg);
+    }
+
+// The app.   Keeps a few requests in flight on each channel.
+static void *app(void *arg) {
+    RTLINK *l = rtlink_attach(shared);
+    SIMSTATS *stats = arg;
+    long sent = 0, answered = 0;
+    uint16_t expect[RTLINK_CHANNELS] = { 0 }, tag[RTLINK_CHANNELS] = { 0 };
+
+    // Stay under the pool and the reply channels, so the supervisor
+    // never waits on us.
+
+    while ( answered < REQUESTS ) {
+        long before = answered;
+
+        for ( int c = 0; c < RTLINK_CHANNELS; c++ ) {
+            RTDESC d;
+            uint8_t *b;
+
+            if ( sent < REQUESTS && (uint16_t) ( tag[c] - expect[c] ) < INFLIGHT &&
+                 ( b = rtlink_alloc(l, BLOCK) ) != NULL ) {
+                uint32_t len = 1 + tag[c] % BLOCK;
+
+                for ( uint32_t i = 0; i < len; i++ ) b[i] = tag[c] + i;
+
+                if ( rtlink_send(l, &l->ToSup[c], OP_SUM, tag[c], b, len) == 0 ) {
+                    tag[c]++;
+                    sent++;
+                    }
+                else {
+                    rtlink_free(l, b);
+                    stats->Full++;
+                    }
+                }
+
+            while ( rtlink_recv(&l->ToApp[c], &d) ) {
+                uint32_t sum = 0, got, len = 1 + d.Tag % BLOCK;
+
+                for ( uint32_t i = 0; i < len; i++ ) sum += (uint8_t) ( d.Tag + i );
+
+                b = rtlink_data(l, &d);
+                memcpy(&got, b, 4);
+
+                // In order, and the right answer.
+                if ( d.Tag != expect[c]++ || d.Status != d.Tag || got != sum ) stats->Errors++;
+
+                rtlink_free(l, b);
+                answered++;
+                }
+            }
+
+        if ( answered == before ) sched_yield(); // One core hosts.
+        }
+
+    for ( int c = 0; c < RTLINK_CHANNELS; c++ ) {
+        while ( rtlink_send(l, &l->ToSup[c], OP_STOP, 0, NULL, 0) ) ;
+        }
+
+    return(arg);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testAttach(void) {
+    RTLINK *l;
+
+    CU_ASSERT( rtlink_attach(shared) == NULL ); // Not set up yet.
+    CU_ASSERT( rtlink_init(shared, sizeof(RTLINK) + 100, BLOCK) == NULL );
+
+    l = rtlink_init(shared, sizeof(shared), BLOCK);
+    CU_ASSERT( l == (RTLINK *) shared );
+    CU_ASSERT( rtlink_attach(shared) == l );
+    CU_ASSERT( l->Blocks == RTLINK_MAXBLOCKS );
+
+    // Newer minor version is fine, a newer major isn't.
+    l->Version = RTLINK_VERSION + 1;
+    CU_ASSERT( rtlink_attach(shared) == l );
+    l->Version = RTLINK_VERSION + 0x100;
+    CU_ASSERT( rtlink_attach(shared) == NULL );
+    l->Version = RTLINK_VERSION;
+
+    // An older supervisor with a shorter table.
+    l->Size = sizeof(RTLINK) - 4;
+    CU_ASSERT( rtlink_attach(shared) == NULL );
+    }
+
+void testPool(void) {
+    RTLINK *l = rtlink_init(shared, sizeof(RTLINK) + 3 * 100 + 50, 99);
+    uint8_t *b[4];
+
+    CU_ASSERT( l->BlockSize == 100 && l->Blocks == 3 );
+    CU_ASSERT( rtlink_alloc(l, 101) == NULL );
+
+    for ( int i = 0; i < 3; i++ ) {
+        b[i] = rtlink_alloc(l, 100);
+        CU_ASSERT( b[i] == (uint8_t *) l + sizeof(RTLINK) + i * 100 );
+        }
+
+    CU_ASSERT( rtlink_alloc(l, 1) == NULL );
+
+    rtlink_free(l, b[1] + 20); // Anywhere in it.
+    CU_ASSERT( ( b[3] = rtlink_alloc(l, 1) ) == b[1] );
+
+    rtlink_free(l, NULL);
+    rtlink_free(l, (uint8_t *) l);
+    CU_ASSERT( rtlink_alloc(l, 1) == NULL );
+    }
+
+void testChannel(void) {
+    RTLINK *l = rtlink_init(shared, sizeof(shared), BLOCK);
+    uint8_t *b = rtlink_alloc(l, BLOCK);
+    RTDESC d;
+
+    CU_ASSERT( rtlink_recv(&l->ToSup[0], &d) == 0 );
+
+    for ( int i = 0; i < RTLINK_SLOTS; i++ ) CU_ASSERT( rtlink_send(l, &l->ToSup[0], 7, i, b, 10) == 0 );
+
+    CU_ASSERT( rtlink_send(l, &l->ToSup[0], 7, 99, b, 10) == -1 );
+    CU_ASSERT( l->ToSup[0].Dropped == 1 );
+    CU_ASSERT( rtlink_pending(&l->ToSup[0]) == RTLINK_SLOTS );
+    CU_ASSERT( rtlink_pending(&l->ToSup[1]) == 0 );
+
+    CU_ASSERT( rtlink_recv(&l->ToSup[0], &d) == 1 );
+    CU_ASSERT( d.Op == 7 && d.Tag == 0 && d.Length == 10 );
+    CU_ASSERT( rtlink_data(l, &d) == b );
+
+    // The reply is the same buffer.
+    CU_ASSERT( rtlink_reply(&l->ToApp[0], &d, -5, 2) == 0 );
+    CU_ASSERT( rtlink_recv(&l->ToApp[0], &d) == 1 );
+    CU_ASSERT( d.Status == -5 && d.Length == 2 && d.Tag == 0 && rtlink_data(l, &d) == b );
+
+    // Bad descriptors.
+    d.Offset = 4;
+    CU_ASSERT( rtlink_data(l, &d) == NULL );
+    d.Offset = sizeof(RTLINK) + RTLINK_MAXBLOCKS * BLOCK - 1;
+    d.Length = 2;
+    CU_ASSERT( rtlink_data(l, &d) == NULL );
+    d.Offset = sizeof(RTLINK);
+    d.Length = 0xFFFFFFF0;
+    CU_ASSERT( rtlink_data(l, &d) == NULL );
+    }
+
+void testSimulation(void) {
+    pthread_t sup, ap;
+    SIMSTATS s = { 0, 0, 0 }, a = { 0, 0, 0 };
+    RTLINK *l = rtlink_init(shared, sizeof(shared), BLOCK);
+
+    pthread_create(&sup, NULL, supervisor, &s);
+    pthread_create(&ap, NULL, app, &a);
+    pthread_join(ap, NULL);
+    pthread_join(sup, NULL);
+
+    printf("\n%ld requests, %ld channel full, %ld errors ", s.Requests, s.Full + a.Full, s.Errors + a.Errors);
+
+    CU_ASSERT( s.Requests == REQUESTS );
+    CU_ASSERT( s.Errors == 0 && a.Errors == 0 );
+
+    // Every buffer came back.
+    for ( int i = 0; i < RTLINK_MAXBLOCKS / 32; i++ ) CU_ASSERT( l->Busy[i] == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Runtime Link", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Attach", testAttach)) ||
+            (NULL == CU_add_test(pSuite, "Pool", testPool)) ||
+            (NULL == CU_add_test(pSuite, "Channel", testChannel)) ||
+            (NULL == CU_add_test(pSuite, "Two thread simulation", testSimulation))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,201 @@
+/// @file rtlink.c
+/// @brief The runtime link table - supervisor/app IPC.
+/// @details
+/// LaunchUserApp hands the app one pointer, runtimep.   This is what
+/// it points at:
+/// - A header with a magic number and a version.   The app checks it
+///   with rtlink_attach() and refuses a major version it doesn't know.
+///   Minor versions only add to the end, and Size says how much the
+///   supervisor filled in.
+/// - RTLINK_CHANNELS descriptor channels in each direction.   ToSup
+///   carries requests from the app, ToApp the replies, and the other
+///   way round for supervisor requests.
+/// - A pool of fixed size buffers after the table.
+///
+/// Nothing gets copied but the 16 byte descriptor.   The sender fills a
+/// pool buffer and sends a descriptor that points at it.   The other
+/// side works on it in place and sends it back with rtlink_reply().
+/// Whoever ends up with it frees it.
+///
+/// Buffers are offsets from the table, not pointers, so the table means
+/// the same thing to both sides, and a bad descriptor can be caught by
+/// rtlink_data() instead of scribbling on the supervisor.
+///
+/// The channels use the ringbuffer index model.   Free running indexes,
+/// one writer each, equality means empty.   No locks and no SVC calls.
+/// The barriers are there so the slot lands before the index moves.
+/// Allocation is a CAS on the pool bitmap, so either side may do it
+/// from any context.
+///
+/// @code
+///     // Supervisor
+///     static uint32_t shared[1024];
+///     RTLINK *l = rtlink_init(shared, sizeof(shared), 256);
+///     LaunchUserApp(appaddr, shared);
+///
+///     // App
+///     RTLINK *l = rtlink_attach(runtimep);
+///     char *b = rtlink_alloc(l, 64);
+///     rtlink_send(l, &l->ToSup[0], OP_LOG, tag, b, sprintf(b, "up"));
+/// @endcode
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "barrier.h"
+#include "rtlink.h"
+
+#define RTLINK_MASK ( RTLINK_SLOTS - 1 )
+
+/// @brief Lay out the table and the pool.   Supervisor side.
+/// @return the table, or NULL if there isn't room for one block.
+/// @param mem where it goes.   Word aligned.
+/// @param size bytes
+/// @param blocksize pool buffer size.   Rounded up to a word.
+RTLINK *rtlink_init(void *mem, uint32_t size, uint32_t blocksize) {
+    RTLINK *l = mem;
+    uint32_t blocks;
+
+    blocksize = ( blocksize + 3 ) & ~3;
+
+    if ( size < sizeof(RTLINK) + blocksize || blocksize == 0 ) return(NULL);
+
+    blocks = ( size - sizeof(RTLINK) ) / blocksize;
+
+    if ( blocks > RTLINK_MAXBLOCKS ) blocks = RTLINK_MAXBLOCKS;
+
+    memset(l, 0, sizeof(RTLINK));
+    l->Version = RTLINK_VERSION;
+    l->Size = sizeof(RTLINK);
+    l->Channels = RTLINK_CHANNELS;
+    l->BlockSize = blocksize;
+    l->Blocks = blocks;
+    l->PoolOffset = sizeof(RTLINK);
+
+    // Blocks that don't exist are permanently busy.
+    for ( uint32_t i = blocks; i < RTLINK_MAXBLOCKS; i++ ) l->Busy[i / 32] |= 1u << ( i % 32 );
+
+    MEM_BARRIER();
+    l->Magic = RTLINK_MAGIC; // Last, so a half built table never looks valid.
+    return(l);
+    }
+
+/// @brief Find the table.   App side.
+/// @return the table, or NULL if runtimep isn't one we understand.
+RTLINK *rtlink_attach(uint32_t *runtimep) {
+    RTLINK *l = (RTLINK *) runtimep;
+
+    if ( l == NULL || l->Magic != RTLINK_MAGIC ) return(NULL);
+
+    if ( ( l->Version >> 8 ) != ( RTLINK_VERSION >> 8 ) ) return(NULL);
+
+    if ( l->Size < sizeof(RTLINK) || l->Channels < RTLINK_CHANNELS ) return(NULL);
+
+    return(l);
+    }
+
+/// @brief Get a pool buffer.
+/// @return the buffer, or NULL if they're all busy or len is too big.
+void *rtlink_alloc(RTLINK *l, uint32_t len) {
+    if ( len > l->BlockSize ) return(NULL);
+
+    for ( int w = 0; w < RTLINK_MAXBLOCKS / 32; w++ ) {
+        uint32_t busy;
+
+        while ( ( busy = l->Busy[w] ) != 0xFFFFFFFF ) {
+            int bit = __builtin_ctz(~busy);
+
+            if ( atomic_cas(&l->Busy[w], busy, busy | ( 1u << bit )) ) {
+                return( (uint8_t *) l + l->PoolOffset + ( w * 32 + bit ) * l->BlockSize );
+                }
+            }
+        }
+
+    return(NULL);
+    }
+
+/// @brief Give a buffer back.   Any pointer into it will do.
+void rtlink_free(RTLINK *l, void *buf) {
+    uint8_t *pool = (uint8_t *) l + l->PoolOffset;
+    uint32_t block;
+
+    if ( (uint8_t *) buf < pool ) return;
+
+    block = ( (uint8_t *) buf - pool ) / l->BlockSize;
+
+    if ( block >= l->Blocks ) return;
+
+    atomic_mask_and(&l->Busy[block / 32], ~( 1u << ( block % 32 ) ));
+    }
+
+/// @brief Where a descriptor's buffer is.
+/// @return a pointer, or NULL if the descriptor points outside the pool.
+void *rtlink_data(RTLINK *l, const RTDESC *d) {
+    uint32_t end = l->PoolOffset + l->Blocks * l->BlockSize;
+
+    if ( d->Offset < l->PoolOffset || d->Offset > end || d->Length > end - d->Offset ) return(NULL);
+
+    return( (uint8_t *) l + d->Offset );
+    }
+
+static int put(RTCHAN *c, const RTDESC *d) {
+    uint32_t w = c->iWrite;
+
+    if ( w - c->iRead >= RTLINK_SLOTS ) { // Back-pressure.
+        c->Dropped++;
+        return(-1);
+        }
+
+    c->Slot[w & RTLINK_MASK] = *d;
+    MEM_BARRIER(); // The slot must land before the index.
+    c->iWrite = w + 1;
+    return(0);
+    }
+
+/// @brief Send a buffer.
+/// @return 0, or -1 if the channel is full.   The buffer is still ours.
+/// @param c the channel - ToSup[n] from the app, ToApp[n] from the supervisor.
+/// @param buf a pool buffer, or NULL for none.
+int rtlink_send(RTLINK *l, RTCHAN *c, uint16_t op, uint16_t tag, void *buf, uint32_t len) {
+    RTDESC d;
+
+    d.Offset = buf ? (uint32_t) ( (uint8_t *) buf - (uint8_t *) l ) : 0;
+    d.Length = len;
+    d.Op = op;
+    d.Tag = tag;
+    d.Status = 0;
+    return( put(c, &d) );
+    }
+
+/// @brief Send a request's buffer back.
+/// @param c the channel going the other way.
+/// @param req what rtlink_recv() returned
+/// @param len how much of the buffer is the answer
+int rtlink_reply(RTCHAN *c, const RTDESC *req, int32_t status, uint32_t len) {
+    RTDESC d = *req;
+
+    d.Status = status;
+    d.Length = len;
+    return( put(c, &d) );
+    }
+
+/// @brief Take the next descriptor.
+/// @return 1, or 0 if there isn't one.
+int rtlink_recv(RTCHAN *c, RTDESC *d) {
+    uint32_t r = c->iRead;
+
+    if ( c->iWrite == r ) return(0);
+
+    MEM_BARRIER(); // Don't read the slot before the index.
+    *d = c->Slot[r & RTLINK_MASK];
+    MEM_BARRIER(); // Done with the slot before it can be reused.
+    c->iRead = r + 1;
+    return(1);
+    }
+
+/// @brief Descriptors waiting.
+uint32_t rtlink_pending(RTCHAN *c) {
+    return( c->iWrite - c->iRead );
+    }
@@ -0,0 +1,59 @@
+//
+// The runtime link table.   What runtimep points at when the supervisor
+// launches the app.   Versioned, with SPSC descriptor channels both
+// ways and a shared buffer pool.
+//
+
+#ifndef __RTLINK_H__
+#define __RTLINK_H__
+
+#include <stdint.h>
+
+#define RTLINK_MAGIC     0x4B4E4C52 // "RLNK"
+#define RTLINK_VERSION   0x0100     // Major.Minor.  Minor bumps only add.
+#define RTLINK_CHANNELS  4          // In each direction.
+#define RTLINK_SLOTS     16         // Descriptors per channel.  Power of two.
+#define RTLINK_MAXBLOCKS 128
+
+typedef struct {
+    uint32_t Offset;   // Buffer, from the start of the table.
+    uint32_t Length;
+    uint16_t Op;
+    uint16_t Tag;      // Copied into the response.
+    int32_t  Status;   // Response only.
+    } RTDESC;
+
+// The ringbuffer index model - free running indexes, equality is empty.
+typedef struct {
+    volatile uint32_t iWrite;
+    volatile uint32_t iRead;
+    uint32_t Dropped;
+    RTDESC Slot[RTLINK_SLOTS];
+    } RTCHAN;
+
+typedef struct {
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Size;          // sizeof(RTLINK) for the supervisor.
+    uint32_t Channels;
+    uint32_t BlockSize;     // Pool buffers.
+    uint32_t Blocks;
+    uint32_t PoolOffset;    // From the start of the table.
+    uint32_t Busy[RTLINK_MAXBLOCKS / 32];
+    RTCHAN   ToApp[RTLINK_CHANNELS];
+    RTCHAN   ToSup[RTLINK_CHANNELS];
+    } RTLINK;
+
+RTLINK  *rtlink_init(void *mem, uint32_t size, uint32_t blocksize);
+RTLINK  *rtlink_attach(uint32_t *runtimep);
+
+void    *rtlink_alloc(RTLINK*, uint32_t len);
+void     rtlink_free(RTLINK*, void *buf);
+void    *rtlink_data(RTLINK*, const RTDESC*);
+
+int      rtlink_send(RTLINK*, RTCHAN*, uint16_t op, uint16_t tag, void *buf, uint32_t len);
+int      rtlink_reply(RTCHAN*, const RTDESC *req, int32_t status, uint32_t len);
+int      rtlink_recv(RTCHAN*, RTDESC*);
+uint32_t rtlink_pending(RTCHAN*);
+
+#endif
@@ -0,0 +1,72 @@
+/// @file sched-bench.c
+/// @brief Host benchmark for the scheduler core.
+/// @details
+/// Times the work the scheduler does on each switch - make a task
+/// ready, block the current one, and pick - with 2 to 32 tasks.   The
+/// point is that the cost doesn't grow with the task count.   The
+/// register save and restore is on top of this, and only the target
+/// can measure it.   Call sched_bench() there.
+///
+/// Usage: sched-bench [-n switches]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sched.h"
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+int main(int argc, char **argv) {
+    static SCHEDTASK task[SCHED_PRIOS];
+    static uint32_t stack[SCHED_PRIOS][SCHED_FRAME + 2];
+    SCHEDULER s;
+    long switches = 10000000;
+    int opt;
+
+    while ( ( opt = getopt(argc, argv, "n:") ) != -1 ) {
+        if ( opt == 'n' ) switches = atol(optarg);
+        else {
+            fprintf(stderr, "Usage: sched-bench [-n switches]\n");
+            return(2);
+            }
+        }
+
+    for ( int tasks = 2; tasks <= SCHED_PRIOS; tasks *= 2 ) {
+        uint32_t *sp = NULL;
+        double t;
+
+        sched_init(&s, &task[0]);
+
+        for ( int i = 0; i < SCHED_PRIOS; i++ ) {
+            if ( i ) sched_add(&s, &task[i], i, "task");
+
+            task[i].SP = sched_frame(stack[i], SCHED_FRAME + 2, NULL, NULL, NULL);
+            }
+
+        // All of them ready, and the top two taking turns.
+        for ( int i = 0; i < tasks; i++ ) sched_ready(&s, i);
+
+        t = now();
+
+        for ( long i = 0; i < switches; i++ ) {
+            int me = s.Current->Prio, other = ( me == tasks - 1 ) ? tasks - 2 : tasks - 1;
+
+            sched_ready(&s, other);
+            sched_block(&s, me);
+            sp = sched_switch(&s, sp);
+            }
+
+        t = now() - t;
+        printf("%2d tasks: %6.1f ns/switch\n", tasks, t * 1e9 / switches);
+        }
+
+    return(0);
+    }
@@ -0,0 +1,206 @@
+// CUnit tests for the scheduler core.
+//
+// Everything but the register save and restore.   sched_switch() gets
+// called the way PendSVHandler calls it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sched.h"
+
+#include "CUnit/Basic.h"
+
+SCHEDULER s;
+SCHEDTASK idle, task[4];
+uint32_t stack[5][64];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void entry(void *arg) {
+    (void) arg;
+    }
+
+static void exit_here(void) {
+    }
+
+// Idle, and tasks at priorities 3, 10, 20 and 31.
+static void setup(void) {
+    static const int prio[4] = { 3, 10, 20, 31 };
+
+    sched_init(&s, &idle);
+    idle.SP = sched_frame(stack[0], 64, entry, NULL, NULL);
+
+    for ( int i = 0; i < 4; i++ ) {
+        sched_add(&s, &task[i], prio[i], "task");
+        task[i].SP = sched_frame(stack[i + 1], 64, entry, &task[i], exit_here);
+        }
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testFrame(void) {
+    uint32_t *sp = sched_frame(stack[0], 63, entry, &s, exit_here);
+
+    // 8 byte aligned at the top, and 16 words down.
+    CU_ASSERT( ( (uintptr_t) ( sp + SCHED_FRAME ) & 7 ) == 0 );
+    CU_ASSERT( sp + SCHED_FRAME <= stack[0] + 63 );
+    CU_ASSERT( sp + SCHED_FRAME > stack[0] + 61 );
+
+    CU_ASSERT( sp[0] == 0 && sp[7] == 0 );                                   // R4-R11
+    CU_ASSERT( sp[8] == (uint32_t) (uintptr_t) &s );                         // R0
+    CU_ASSERT( sp[13] == (uint32_t) (uintptr_t) exit_here );                 // LR
+    CU_ASSERT( sp[14] == ( (uint32_t) (uintptr_t) entry & ~1u ) );           // PC
+    CU_ASSERT( sp[15] == 0x01000000 );                                       // xPSR
+    }
+
+void testAdd(void) {
+    SCHEDTASK extra;
+
+    setup();
+    CU_ASSERT( s.Task[SCHED_IDLE] == &idle && s.Current == &idle );
+    CU_ASSERT( s.Ready == 1 );
+    CU_ASSERT( sched_add(&s, &extra, 10, "dup") == -1 );
+    CU_ASSERT( sched_add(&s, &extra, SCHED_PRIOS, "big") == -1 );
+    CU_ASSERT( sched_add(&s, &extra, -1, "neg") == -1 );
+    CU_ASSERT( sched_add(&s, &extra, 11, "ok") == 0 );
+    CU_ASSERT( s.Ready == 1 ); // Starts blocked.
+    }
+
+void testPick(void) {
+    setup();
+    CU_ASSERT( sched_pick(&s) == &idle );
+
+    sched_ready(&s, 10);
+    CU_ASSERT( sched_pick(&s) == &task[1] );
+
+    sched_ready(&s, 3);
+    CU_ASSERT( sched_pick(&s) == &task[1] );
+
+    sched_ready(&s, 31);
+    CU_ASSERT( sched_pick(&s) == &task[3] );
+
+    sched_block(&s, 31);
+    sched_block(&s, 10);
+    CU_ASSERT( sched_pick(&s) == &task[0] );
+
+    // Idle can't be blocked.
+    sched_block(&s, 3);
+    sched_block(&s, SCHED_IDLE);
+    CU_ASSERT( sched_pick(&s) == &idle );
+    CU_ASSERT( s.Ready == 1 );
+    }
+
+void testSwitch(void) {
+    uint32_t *sp, *fake = stack[0] + 10;
+
+    setup();
+
+    // Nothing else ready - idle keeps going.
+    CU_ASSERT( sched_switch(&s, fake) == fake );
+    CU_ASSERT( idle.SP == fake && idle.Switches == 0 );
+
+    sched_ready(&s, 20);
+    sp = sched_switch(&s, fake);
+    CU_ASSERT( s.Current == &task[2] );
+    CU_ASSERT( sp == task[2].SP && task[2].Switches == 1 );
+
+    // Task 20 blocks, and idle comes back where it left off.
+    sched_block(&s, 20);
+    CU_ASSERT( sched_switch(&s, sp - 4) == fake );
+    CU_ASSERT( task[2].SP == sp - 4 );
+    CU_ASSERT( s.Current == &idle );
+    }
+
+void testSleep(void) {
+    setup();
+    sched_ready(&s, 3);
+    sched_ready(&s, 10);
+    sched_ready(&s, 20);
+
+    sched_sleep_until(&s, 20, 1000);
+    sched_sleep_until(&s, 10, 500);
+    CU_ASSERT( sched_pick(&s) == &task[0] );
+    CU_ASSERT( s.NextWake == 500 );
+    CU_ASSERT( s.Sleeping == ( ( 1u << 20 ) | ( 1u << 10 ) ) );
+
+    CU_ASSERT( sched_tick(&s, 499) == 0 );
+    CU_ASSERT( sched_tick(&s, 500) == 1 );
+    CU_ASSERT( sched_pick(&s) == &task[1] );
+    CU_ASSERT( s.NextWake == 1000 );
+
+    // Late tick.
+    CU_ASSERT( sched_tick(&s, 1500) == 1 );
+    CU_ASSERT( sched_pick(&s) == &task[2] );
+    CU_ASSERT( s.NextWake == UINT64_MAX && s.Sleeping == 0 );
+
+    // Sleepers past 2^32 ms.
+    sched_sleep_until(&s, 31, 0x100000010ull);
+    CU_ASSERT( sched_tick(&s, 0x10) == 0 );
+    CU_ASSERT( sched_tick(&s, 0x100000010ull) == 1 );
+    CU_ASSERT( sched_pick(&s) == &task[3] );
+    }
+
+void testSameTick(void) {
+    setup();
+
+    for ( int i = 0; i < 4; i++ ) {
+        sched_ready(&s, task[i].Prio);
+        sched_sleep_until(&s, task[i].Prio, 100);
+        }
+
+    CU_ASSERT( sched_pick(&s) == &idle );
+    CU_ASSERT( sched_tick(&s, 100) == 4 );
+    CU_ASSERT( s.Ready == ( 1u | ( 1u << 3 ) | ( 1u << 10 ) | ( 1u << 20 ) | ( 1u << 31 ) ) );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Scheduler", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Task frame", testFrame)) ||
+            (NULL == CU_add_test(pSuite, "Add", testAdd)) ||
+            (NULL == CU_add_test(pSuite, "Pick", testPick)) ||
+            (NULL == CU_add_test(pSuite, "Switch", testSwitch)) ||
+            (NULL == CU_add_test(pSuite, "Sleep", testSleep)) ||
+            (NULL == CU_add_test(pSuite, "Same tick", testSameTick))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
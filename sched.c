@@ -0,0 +1,279 @@
+/// @file sched.c
+/// @brief Bitmap priority cooperative scheduler.
+/// @details
+/// A replacement for the superloop.   The superloop's worst case
+/// latency is the sum of everything in it.   Here it is the longest
+/// stretch that any one task runs without yielding.
+///
+/// Model
+/// - One task per priority, 32 priorities.   31 is the most urgent.
+///   The idle task is priority 0 and is always ready.
+/// - Ready is a bitmap, so the next task is 31 - CLZ(Ready).   O(1) no
+///   matter how many tasks there are.
+/// - Cooperative.   Tasks give up the CPU with sched_yield(),
+///   sched_sleep() or sched_wait().   Interrupts make tasks ready with
+///   sched_wake() but never switch by themselves.
+/// - Each task has its own stack, on PSP in thread mode.   Handlers
+///   keep using MSP.   The switch is done by PendSVHandler, at the
+///   lowest priority.
+/// - Sleeps are in milliseconds on the 64-bit systick.   sched_systick()
+///   goes in the SysTick handler after SysTickMSUpdate64().   It costs
+///   a compare unless a sleeper is due.
+///
+/// Everything above the ARM section is plain C, so the ready bitmap,
+/// the sleepers and the switch decision are tested on the host.
+///
+/// @code
+///    SCHEDULER sched;
+///    SCHEDTASK idle, uart;
+///    uint32_t idle_stack[64], uart_stack[256];
+///
+///    sched_init(&sched, &idle);
+///    idle.SP = sched_frame(idle_stack, 64, sched_idle, NULL, NULL);
+///    sched_add(&sched, &uart, 5, "uart");
+///    uart.SP = sched_frame(uart_stack, 256, uart_task, &port, NULL);
+///    sched_ready(&sched, 5);
+///    sched_start(&sched); // Does not return
+/// @endcode
+///
+/// No FPU context.   On an M4F, tasks that use the FPU need lazy
+/// stacking turned off, or S16-S31 added to the switch.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "sched.h"
+
+#if defined(__arm__)
+#define IRQ_SAVE(x)    __asm__ __volatile__ ( "mrs %0, primask\n\tcpsid i" : "=r" (x) : : "memory" )
+#define IRQ_RESTORE(x) __asm__ __volatile__ ( "msr primask, %0" : : "r" (x) : "memory" )
+#else
+#define IRQ_SAVE(x)    ( (x) = 0 )
+#define IRQ_RESTORE(x) ( (void) (x) )
+#endif
+
+/// @brief Set up an empty scheduler.
+/// @param idle the idle task.  Priority 0, always ready.
+void sched_init(SCHEDULER *s, SCHEDTASK *idle) {
+    memset(s, 0, sizeof(*s));
+    s->NextWake = UINT64_MAX;
+    sched_add(s, idle, SCHED_IDLE, "idle");
+    s->Ready = 1 << SCHED_IDLE;
+    s->Current = idle;
+    }
+
+/// @brief Add a task.  It starts out blocked.
+/// @return 0, or -1 if the priority is taken.
+int sched_add(SCHEDULER *s, SCHEDTASK *t, int prio, const char *name) {
+    if ( prio < 0 || prio >= SCHED_PRIOS || s->Task[prio] ) return(-1);
+
+    memset(t, 0, sizeof(*t));
+    t->Prio = prio;
+    t->Name = name;
+    s->Task[prio] = t;
+    return(0);
+    }
+
+/// @brief Build the first frame for a task, as if PendSV had saved it.
+/// @return the initial SP.
+/// @param stack lowest address
+/// @param words stack size
+/// @param entry task function.   Gets arg in R0.
+/// @param exit where entry returns to.  NULL for a task that never does.
+uint32_t *sched_frame(uint32_t *stack, uint32_t words, void (*entry)(void *), void *arg, void (*exit)(void)) {
+    // The exception frame has to be 8 byte aligned.
+    uint32_t *sp = (uint32_t *) ( (uintptr_t) ( stack + words ) & ~(uintptr_t) 7 ) - SCHED_FRAME;
+
+    memset(sp, 0, SCHED_FRAME * sizeof(uint32_t));
+    // sp[0..7] are R4-R11
+    sp[8] = (uint32_t) (uintptr_t) arg;         // R0
+    sp[13] = (uint32_t) (uintptr_t) exit;       // LR
+    sp[14] = (uint32_t) (uintptr_t) entry & ~1; // PC
+    sp[15] = 0x01000000;                        // xPSR - Thumb bit.
+    return(sp);
+    }
+
+/// @brief Make a task ready.   Safe from ISRs.
+void sched_ready(SCHEDULER *s, int prio) {
+    atomic_mask_or(&s->Ready, 1u << prio);
+    }
+
+/// @brief Take a task off the ready list.   Not the idle task.
+void sched_block(SCHEDULER *s, int prio) {
+    if ( prio != SCHED_IDLE ) atomic_mask_and(&s->Ready, ~( 1u << prio ));
+    }
+
+/// @brief Block a task until the systick reaches a time.
+void sched_sleep_until(SCHEDULER *s, int prio, uint64_t when) {
+    uint32_t primask;
+
+    IRQ_SAVE(primask);
+    sched_block(s, prio);
+    s->Task[prio]->Wake = when;
+    s->Sleeping |= 1u << prio;
+
+    if ( when < s->NextWake ) s->NextWake = when;
+
+    IRQ_RESTORE(primask);
+    }
+
+/// @brief Wake up sleepers that are due.
+/// Cheap unless one is.   Call with the systick handler's priority.
+/// @return how many woke up.
+int sched_tick(SCHEDULER *s, uint64_t now) {
+    uint32_t sleeping;
+    uint64_t next = UINT64_MAX;
+    int woke = 0;
+
+    if ( now < s->NextWake ) return(0);
+
+    for ( sleeping = s->Sleeping; sleeping; sleeping &= sleeping - 1 ) {
+        int prio = __builtin_ctz(sleeping);
+        SCHEDTASK *t = s->Task[prio];
+
+        if ( t->Wake <= now ) {
+            s->Sleeping &= ~( 1u << prio );
+            sched_ready(s, prio);
+            woke++;
+            }
+        else if ( t->Wake < next ) next = t->Wake;
+        }
+
+    s->NextWake = next;
+    return(woke);
+    }
+
+/// @brief The most urgent ready task.
+SCHEDTASK *sched_pick(SCHEDULER *s) {
+    return( s->Task[31 - __builtin_clz(s->Ready | ( 1 << SCHED_IDLE ))] );
+    }
+
+/// @brief The C half of the context switch.
+/// @return the SP of the task to run.
+/// @param sp the SP of the task that was running.
+uint32_t *sched_switch(SCHEDULER *s, uint32_t *sp) {
+    SCHEDTASK *next = sched_pick(s);
+
+    s->Current->SP = sp;
+
+    if ( next != s->Current ) {
+        next->Switches++;
+        s->Current = next;
+        }
+
+    return(next->SP);
+    }
+
+// ------------------------------------------------------------------
+// The Cortex-M3 port.
+// ------------------------------------------------------------------
+#if defined(__arm__)
+#include "bl_launcher.h"
+#include "systick64.h"
+
+#define ICSR        ( *(volatile uint32_t *) 0xE000ED04 )
+#define ICSR_PENDSV ( 1 << 28 )
+#define SHPR3       ( *(volatile uint32_t *) 0xE000ED20 )
+#define DEMCR       ( *(volatile uint32_t *) 0xE000EDFC )
+#define DWT_CTRL    ( *(volatile uint32_t *) 0xE0001000 )
+#define DWT_CYCCNT  ( *(volatile uint32_t *) 0xE0001004 )
+
+SCHEDULER *sched_active;
+
+/// @brief Save R4-R11 on the task's PSP, pick, load the next one.
+/// Runs at the lowest priority, so it never interrupts a handler.
+__attribute__ ((naked)) void PendSVHandler(void) {
+    __asm__ __volatile__ (
+        "    mrs   r1, psp\n"
+        "    stmdb r1!, { r4-r11 }\n"
+        "    ldr   r0, =sched_active\n"
+        "    ldr   r0, [ r0 ]\n"
+        "    push  { r3, lr }\n"       // EXC_RETURN, and 8 byte alignment.
+        "    bl    sched_switch\n"
+        "    pop   { r3, lr }\n"
+        "    ldmia r0!, { r4-r11 }\n"
+        "    msr   psp, r0\n"
+        "    bx    lr\n" );
+    }
+
+/// @brief Give up the CPU if anything more urgent is ready.
+void sched_yield(void) {
+    ICSR = ICSR_PENDSV;
+    __asm__ __volatile__ ( "dsb\n\tisb" : : : "memory" );
+    }
+
+/// @brief Sleep the current task.
+void sched_sleep(uint32_t ms) {
+    sched_sleep_until(sched_active, sched_active->Current->Prio, getSysTickMS64() + ms);
+    sched_yield();
+    }
+
+/// @brief Block the current task until something calls sched_wake().
+void sched_wait(void) {
+    sched_block(sched_active, sched_active->Current->Prio);
+    sched_yield();
+    }
+
+/// @brief Make a task ready.   It runs at the next yield.
+void sched_wake(int prio) {
+    sched_ready(sched_active, prio);
+    }
+
+void sched_systick(void) {
+    if ( sched_active ) sched_tick(sched_active, getSysTickMS64());
+    }
+
+/// @brief An idle task.  Sleep until an interrupt, then look around.
+void sched_idle(void *arg) {
+    (void) arg;
+
+    for ( ;; ) {
+        __asm__ __volatile__ ( "wfi" );
+        sched_yield();
+        }
+    }
+
+// Where task functions go when they return.
+static void sched_exit(void) {
+    for ( ;; ) sched_wait();
+    }
+
+/// @brief Start the most urgent ready task, in thread mode on PSP.
+/// The first task gets started by LaunchUserAppThread, the rest by
+/// PendSV.   MSP stays behind for the handlers.
+void sched_start(SCHEDULER *s) {
+    SCHEDTASK *t = sched_pick(s);
+    uint32_t vector[2];
+
+    SHPR3 |= 0xFF << 16; // PendSV lowest.
+    sched_active = s;
+    s->Current = t;
+    t->Switches++;
+
+    // Unwind the frame sched_frame() built.
+    vector[0] = (uint32_t) ( t->SP + SCHED_FRAME );
+    vector[1] = t->SP[14] | 1;
+    LaunchUserAppThread(vector, (uint32_t *) t->SP[8]);
+    sched_exit();
+    }
+
+/// @brief Switch latency, in cycles.
+/// Times a yield from the current task, with nothing more urgent
+/// ready.   That's the whole PendSV path - exception entry, save,
+/// pick, restore, exception return - less only the final SP change.
+/// @param loops how many to average over.
+uint32_t sched_bench(uint32_t loops) {
+    uint32_t start;
+
+    DEMCR |= 1 << 24; // TRCENA
+    DWT_CTRL |= 1;
+
+    start = DWT_CYCCNT;
+
+    for ( uint32_t i = 0; i < loops; i++ ) sched_yield();
+
+    return( ( DWT_CYCCNT - start ) / loops );
+    }
+#endif
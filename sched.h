@@ -0,0 +1,52 @@
+//
+// Bitmap priority cooperative scheduler.  Tasks run on PSP.
+//
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdint.h>
+
+#define SCHED_PRIOS 32  // One task per priority.  One bitmap word.
+#define SCHED_IDLE  0   // The idle task.  Always ready.
+#define SCHED_FRAME 16  // Words in a new task frame.  R4-R11 + exception frame.
+
+typedef struct {
+    uint32_t *SP;       // Saved PSP.  Must be first.
+    uint64_t Wake;      // Systick ms, while sleeping.
+    uint32_t Switches;  // Times it was switched in.
+    uint8_t Prio;
+    const char *Name;
+    } SCHEDTASK;
+
+typedef struct {
+    uint32_t Ready;                 // One bit per priority.
+    uint32_t Sleeping;
+    uint64_t NextWake;              // Earliest Wake of the sleepers.
+    SCHEDTASK *Task[SCHED_PRIOS];
+    SCHEDTASK *Current;
+    } SCHEDULER;
+
+void       sched_init(SCHEDULER*, SCHEDTASK *idle);
+int        sched_add(SCHEDULER*, SCHEDTASK*, int prio, const char *name);
+uint32_t  *sched_frame(uint32_t *stack, uint32_t words, void (*entry)(void *), void *arg, void (*exit)(void));
+
+void       sched_ready(SCHEDULER*, int prio);
+void       sched_block(SCHEDULER*, int prio);
+void       sched_sleep_until(SCHEDULER*, int prio, uint64_t when);
+int        sched_tick(SCHEDULER*, uint64_t now);
+SCHEDTASK *sched_pick(SCHEDULER*);
+uint32_t  *sched_switch(SCHEDULER*, uint32_t *sp);
+
+#if defined(__arm__)
+void     sched_start(SCHEDULER*);  // Does not return.
+void     sched_yield(void);
+void     sched_sleep(uint32_t ms);
+void     sched_wait(void);
+void     sched_wake(int prio);     // ISR safe.
+void     sched_systick(void);      // From the SysTick handler.
+void     sched_idle(void *arg);
+uint32_t sched_bench(uint32_t loops);
+#endif
+
+#endif
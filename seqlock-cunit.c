@@ -0,0 +1,228 @@
+// CUnit tests for the sequence lock.
+//
+// The torture test runs one writer thread standing in for the ISR and
+// several reader threads.   The writer fills every word of a snapshot
+// with the same generation number, so a torn read shows up as a
+// snapshot with mixed generations.   The same check is run without
+// the lock as a control, to show that the test can see tearing at all.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "seqlock.h"
+
+#include "CUnit/Basic.h"
+
+#define SNAPWORDS  16
+#define READERS    3
+#define GENERATIONS 2000000
+
+typedef struct {
+    uint32_t gen[SNAPWORDS];
+    } SNAPSHOT;
+
+SEQLOCK lock;
+SNAPSHOT shared;
+
+volatile int writer_done;
+volatile int use_lock;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static int torn(SNAPSHOT *s) {
+    for ( int i = 1; i < SNAPWORDS; i++ ) {
+        if ( s->gen[i] != s->gen[0] ) return(1);
+        }
+
+    return(0);
+    }
+
+static void *writer(void *arg) {
+    SNAPSHOT next;
+
+    for ( uint32_t g = 1; g <= GENERATIONS; g++ ) {
+        for ( int i = 0; i < SNAPWORDS; i++ ) next.gen[i] = g;
+
+        if ( use_lock ) seqlock_write(&lock, &shared, &next, sizeof(next));
+        else {
+            volatile uint32_t *d = shared.gen;
+
+            for ( int i = 0; i < SNAPWORDS; i++ ) d[i] = g;
+            }
+        }
+
+    writer_done = 1;
+    return(arg);
+    }
+
+typedef struct {
+    long reads;
+    long torn;
+    uint32_t lastgen;
+    long backwards;
+    } READSTATS;
+
+static void *reader(void *arg) {
+    READSTATS *stats = arg;
+    SNAPSHOT s;
+
+    while ( !writer_done ) {
+        if ( use_lock ) seqlock_read(&lock, &s, &shared, sizeof(s));
+        else {
+            volatile uint32_t *src = shared.gen;
+
+            for ( int i = 0; i < SNAPWORDS; i++ ) s.gen[i] = src[i];
+            }
+
+        stats->reads++;
+
+        if ( torn(&s) ) stats->torn++;
+        else {
+            if ( s.gen[0] < stats->lastgen ) stats->backwards++;
+
+            stats->lastgen = s.gen[0];
+            }
+        }
+
+    return(arg);
+    }
+
+// Run the writer against a pack of readers, and total up the results.
+static void torture(int locked, READSTATS *total) {
+    pthread_t w, r[READERS];
+    READSTATS stats[READERS] = { { 0 } };
+
+    seqlock_init(&lock);
+
+    for ( int i = 0; i < SNAPWORDS; i++ ) shared.gen[i] = 0;
+
+    writer_done = 0;
+    use_lock = locked;
+
+    for ( int i = 0; i < READERS; i++ ) pthread_create(&r[i], NULL, reader, &stats[i]);
+
+    pthread_create(&w, NULL, writer, NULL);
+
+    pthread_join(w, NULL);
+
+    for ( int i = 0; i < READERS; i++ ) pthread_join(r[i], NULL);
+
+    total->reads = total->torn = total->backwards = 0;
+
+    for ( int i = 0; i < READERS; i++ ) {
+        total->reads += stats[i].reads;
+        total->torn += stats[i].torn;
+        total->backwards += stats[i].backwards;
+        }
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    seqlock_init(&lock);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testNEW(void) {
+    uint32_t start = seqlock_read_begin(&lock);
+
+    CU_ASSERT( lock.Sequence == 0 );
+    CU_ASSERT( seqlock_read_retry(&lock, start) == 0 );
+    }
+
+// A write in progress, or a write that completed, forces a retry.
+void testRetry(void) {
+    uint32_t start = seqlock_read_begin(&lock);
+
+    seqlock_write_begin(&lock);
+    CU_ASSERT( lock.Sequence & 1 );
+    CU_ASSERT( seqlock_read_retry(&lock, start) );
+
+    uint32_t during = seqlock_read_begin(&lock);
+    CU_ASSERT( seqlock_read_retry(&lock, during) );
+
+    seqlock_write_end(&lock);
+    CU_ASSERT( ( lock.Sequence & 1 ) == 0 );
+    CU_ASSERT( seqlock_read_retry(&lock, start) );
+
+    uint32_t after = seqlock_read_begin(&lock);
+    CU_ASSERT( seqlock_read_retry(&lock, after) == 0 );
+    }
+
+// Odd sizes go through the byte copy.
+void testCopy(void) {
+    uint8_t src[7] = { 1, 2, 3, 4, 5, 6, 7 };
+    uint8_t obj[7] = { 0 };
+    uint8_t snap[7] = { 0 };
+
+    seqlock_write(&lock, obj, src, sizeof(src));
+    seqlock_read(&lock, snap, obj, sizeof(obj));
+    CU_ASSERT( memcmp(snap, src, sizeof(src)) == 0 );
+    }
+
+void testTortureControl(void) {
+    READSTATS total;
+
+    torture(0, &total);
+    printf("\n  unlocked: %ld reads, %ld torn ", total.reads, total.torn);
+    }
+
+void testTorture(void) {
+    READSTATS total;
+
+    torture(1, &total);
+    printf("\n  locked: %ld reads, %ld torn, %ld backwards ",
+           total.reads, total.torn, total.backwards);
+
+    CU_ASSERT( total.reads > 0 );
+    CU_ASSERT( total.torn == 0 );
+    CU_ASSERT( total.backwards == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Seqlock", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Test of fresh structure", testNEW)) ||
+            (NULL == CU_add_test(pSuite, "Retry on write", testRetry)) ||
+            (NULL == CU_add_test(pSuite, "Byte copy", testCopy)) ||
+            (NULL == CU_add_test(pSuite, "Torture, no lock (control)", testTortureControl)) ||
+            (NULL == CU_add_test(pSuite, "Torture, locked", testTorture))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,106 @@
+/**
+@file seqlock.c
+@brief Sequence lock for sharing a struct between an ISR and its readers.
+\copyright Copyright(C) 2016 Robert Sexton
+@details
+This is get64BitCounter generalized to any size of data.   Instead of
+reading the top half twice, we keep a sequence number that the writer
+bumps before and after each update.
+
+- One writer.   Multiple writers must arrange their own exclusion.
+- Readers never block the writer and never disable interrupts.
+- An odd sequence number means the writer is part way through.
+- If the sequence changed while we were copying, copy it again.
+
+The writer has to be able to finish.   On a single core that means
+readers must run at the same or lower priority than the writer, the same
+rule that get64BitCounter has always had.   A reader that pre-empts the
+writer will spin forever.
+*/
+
+#include <stdint.h>
+
+#include "barrier.h"
+#include "seqlock.h"
+
+/// @brief Initialization call.
+/// @param sl pointer to a seqlock structure
+void seqlock_init(SEQLOCK* sl) {
+    sl->Sequence = 0;
+    }
+
+/// @brief Mark the start of an update.   The sequence goes odd.
+/// @param sl pointer to a seqlock structure
+void seqlock_write_begin(SEQLOCK* sl) {
+    sl->Sequence++;
+    MEM_BARRIER(); // Sequence must land before the data.
+    }
+
+/// @brief Mark the end of an update.   The sequence goes even.
+/// @param sl pointer to a seqlock structure
+void seqlock_write_end(SEQLOCK* sl) {
+    MEM_BARRIER(); // Data must land before the sequence.
+    sl->Sequence++;
+    }
+
+/// @brief Start a read.
+/// @return the sequence number to hand to seqlock_read_retry()
+/// @param sl pointer to a seqlock structure
+// Don't spin here waiting for an even number - let the retry catch it.
+uint32_t seqlock_read_begin(SEQLOCK* sl) {
+    uint32_t start = sl->Sequence;
+    MEM_BARRIER();
+    return(start);
+    }
+
+/// @brief Finish a read.
+/// @return non-zero if the data must be read again.
+/// @param sl pointer to a seqlock structure
+/// @param start the value returned by seqlock_read_begin()
+int seqlock_read_retry(SEQLOCK* sl, uint32_t start) {
+    MEM_BARRIER();
+    return( (start & 1) || (sl->Sequence != start) );
+    }
+
+// A copy that the compiler can't turn into a library call or
+// reorder around the barriers.   Word at a time when we can.
+static void seqlock_copy(void *dst, const void *src, uint32_t len) {
+    if ( ( ( (uintptr_t) dst | (uintptr_t) src | len ) & 3 ) == 0 ) {
+        volatile uint32_t *d = dst;
+        const volatile uint32_t *s = src;
+
+        for ( len >>= 2; len; len-- ) *d++ = *s++;
+        }
+    else {
+        volatile uint8_t *d = dst;
+        const volatile uint8_t *s = src;
+
+        for ( ; len; len-- ) *d++ = *s++;
+        }
+    }
+
+/// @brief Update a protected object in one shot.
+/// @param sl pointer to a seqlock structure
+/// @param dst the shared object
+/// @param src the new contents
+/// @param len size in bytes
+void seqlock_write(SEQLOCK* sl, void *dst, const void *src, uint32_t len) {
+    seqlock_write_begin(sl);
+    seqlock_copy(dst, src, len);
+    seqlock_write_end(sl);
+    }
+
+/// @brief Take a consistent snapshot of a protected object.
+/// @param sl pointer to a seqlock structure
+/// @param dst where the snapshot goes
+/// @param src the shared object
+/// @param len size in bytes
+void seqlock_read(SEQLOCK* sl, void *dst, const void *src, uint32_t len) {
+    uint32_t start;
+
+    do {
+        start = seqlock_read_begin(sl);
+        seqlock_copy(dst, src, len);
+        }
+    while ( seqlock_read_retry(sl, start) );
+    }
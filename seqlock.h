@@ -0,0 +1,27 @@
+//
+// Sequence locks - one writer, many lockless readers.
+// Copyright(C) 2016 Robert Sexton
+//
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t Sequence; // Odd while a write is in progress.
+    } SEQLOCK;
+
+void seqlock_init(SEQLOCK*);
+
+// Writer side.  Only one writer, usually an ISR.
+void seqlock_write_begin(SEQLOCK*);
+void seqlock_write_end(SEQLOCK*);
+void seqlock_write(SEQLOCK*, void *dst, const void *src, uint32_t len);
+
+// Reader side.
+uint32_t seqlock_read_begin(SEQLOCK*);
+int      seqlock_read_retry(SEQLOCK*, uint32_t start);
+void     seqlock_read(SEQLOCK*, void *dst, const void *src, uint32_t len);
+
+#endif
@@ -0,0 +1,252 @@
+// CUnit tests for the stack depth analyzer.
+//
+// A little firmware image with real Thumb-2 branches in it, the .su
+// file GCC would have written for it, and a -fcallgraph-info file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "elfread.h"
+#include "elffixture.h"
+#include "stackdepth.h"
+
+#include "CUnit/Basic.h"
+
+#define TEXT 0x08000000
+
+uint8_t code[0xC0];
+uint8_t *image;
+ELFFILE elf;
+
+const char *su =
+    "main.c:10:5:main\t16\tstatic\n"
+    "main.c:20:6:foo\t24\tstatic\n"
+    "main.c:30:6:bar\t40\tdynamic\n"
+    "main.c:40:6:baz\t8\tstatic\n"
+    "HardFaultHandler.c:20:6:HardFaultHandler\t0\tstatic\n"
+    "wdt-lm3s.c:57:6:WatchdogHandler\t16\tdynamic,bounded\n";
+
+const char *ci =
+    "graph: { title: \"main.c\"\n"
+    "node: { title: \"main\" label: \"main\\nmain.c:5:5\\n32 bytes (static)\\n1 dynamic objects\" }\n"
+    "node: { title: \"work\" label: \"work\\nmain.c:9:6\\n16 bytes (dynamic,bounded)\" }\n"
+    "node: { title: \"puts\" label: \"puts\\n<built-in>\" shape : ellipse }\n"
+    "edge: { sourcename: \"main\" targetname: \"work\" label: \"main.c:6:3\" }\n"
+    "edge: { sourcename: \"work\" targetname: \"puts\" label: \"main.c:10:3\" }\n"
+    "edge: { sourcename: \"work\" targetname: \"__indirect_call\" label: \"main.c:11:3\" }\n"
+    "}\n";
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// Thumb-2 BL (link) or B.W from one address to another.
+static void branch(uint32_t from, uint32_t to, int link) {
+    int32_t off = to - ( from + 4 );
+    uint32_t s = off < 0, i1 = ( off >> 23 ) & 1, i2 = ( off >> 22 ) & 1;
+    uint32_t j1 = !i1 ^ s, j2 = !i2 ^ s;
+    uint16_t hw[2];
+
+    hw[0] = 0xF000 | ( s << 10 ) | ( ( off >> 12 ) & 0x3FF );
+    hw[1] = ( link ? 0xD000 : 0x9000 ) | ( j1 << 13 ) | ( j2 << 11 ) | ( ( off >> 1 ) & 0x7FF );
+    memcpy(&code[from - TEXT], hw, 4);
+    }
+
+static SDFUNC *find(STACKGRAPH *g, const char *name) {
+    int f = sd_func(g, name);
+    return( &g->Funcs[f] );
+    }
+
+static int calls(STACKGRAPH *g, const char *caller, const char *callee) {
+    SDFUNC *f = find(g, caller);
+    int c = sd_func(g, callee);
+
+    for ( int i = 0; i < f->NCallee; i++ ) {
+        if ( f->Callee[i] == c ) return(1);
+        }
+
+    return(0);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    ELFFIXTURE ef;
+    uint16_t blx = 0x4798; // BLX r3
+    uint16_t ldrw[2] = { 0xF8D3, 0x4780 }; // LDR.W r4, [r3, #0x780] - not BLX r0
+    uint32_t size;
+    int text;
+
+    memset(code, 0xBF, sizeof(code)); // Lots of NOPs
+
+    branch(TEXT + 0x04, TEXT + 0x20, 1);    // main: BL foo
+    branch(TEXT + 0x08, TEXT + 0x40, 1);    //       BL bar
+    memcpy(&code[0x0C], &blx, 2);           //       BLX r3
+    branch(TEXT + 0x10, TEXT + 0x60, 1);    //       literal that looks like BL baz
+    branch(TEXT + 0x20, TEXT + 0x40, 1);    // foo:  BL bar
+    branch(TEXT + 0x24, TEXT + 0x60, 0);    //       B.W baz - tail call
+    branch(TEXT + 0x44, TEXT + 0x40, 1);    // bar:  BL bar
+    branch(TEXT + 0x60, TEXT + 0x66, 0);    // baz:  B.W inside itself
+    branch(TEXT + 0x80, TEXT + 0x20, 1);    // HardFaultHandler: BL foo
+    memcpy(&code[0xA2], ldrw, 4);           // WatchdogHandler: LDR.W, off the word
+
+    elffix_init(&ef);
+    text = elffix_section(&ef, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, TEXT, sizeof(code), code);
+    elffix_symbol(&ef, "$t", TEXT, 0, STT_NOTYPE, STB_LOCAL, text);
+    elffix_symbol(&ef, "$d", TEXT + 0x10, 0, STT_NOTYPE, STB_LOCAL, text);
+    elffix_symbol(&ef, "$t", TEXT + 0x20, 0, STT_NOTYPE, STB_LOCAL, text);
+    elffix_symbol(&ef, "main", TEXT + 0x01, 0x20, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "foo", TEXT + 0x21, 0x10, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "bar", TEXT + 0x41, 0x10, STT_FUNC, STB_LOCAL, text);
+    elffix_symbol(&ef, "baz", TEXT + 0x61, 0x10, STT_FUNC, STB_LOCAL, text);
+    elffix_symbol(&ef, "HardFaultHandler", TEXT + 0x81, 0x10, STT_FUNC, STB_GLOBAL, text);
+    elffix_symbol(&ef, "WatchdogHandler", TEXT + 0xA1, 0x10, STT_FUNC, STB_GLOBAL, text);
+
+    image = elffix_build(&ef, &size);
+    return( elf_load(&elf, image, size) ? -1 : 0 );
+    }
+
+int clean_suite1(void) {
+    elf_close(&elf);
+    free(image);
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testReadSu(void) {
+    STACKGRAPH g;
+
+    sd_init(&g);
+    CU_ASSERT( sd_read_su(&g, su) == 6 );
+    CU_ASSERT( g.Count == 6 );
+    CU_ASSERT( find(&g, "foo")->Frame == 24 );
+    CU_ASSERT( find(&g, "bar")->Flags == SD_DYNAMIC );
+    CU_ASSERT( find(&g, "WatchdogHandler")->Flags == 0 ); // Bounded is fine.
+
+    // Static functions with the same name in two files - the bigger one.
+    sd_read_su(&g, "other.c:1:13:foo\t12\tstatic\nother.c:5:13:foo\t48\tstatic\n");
+    CU_ASSERT( find(&g, "foo")->Frame == 48 );
+    sd_free(&g);
+    }
+
+void testReadElf(void) {
+    STACKGRAPH g;
+
+    sd_init(&g);
+    CU_ASSERT( sd_read_elf(&g, &elf) == 6 );
+    CU_ASSERT( calls(&g, "main", "foo") && calls(&g, "main", "bar") );
+    CU_ASSERT( !calls(&g, "main", "baz") );                 // Literal pool.
+    CU_ASSERT( find(&g, "main")->Flags == SD_INDIRECT );
+    CU_ASSERT( calls(&g, "foo", "bar") && calls(&g, "foo", "baz") );
+    CU_ASSERT( calls(&g, "bar", "bar") );
+    CU_ASSERT( find(&g, "baz")->NCallee == 0 );
+    CU_ASSERT( calls(&g, "HardFaultHandler", "foo") );
+    CU_ASSERT( find(&g, "WatchdogHandler")->Flags == 0 );   // Second half isn't a BLX.
+    sd_free(&g);
+    }
+
+void testAnalyze(void) {
+    STACKGRAPH g;
+    SDFUNC *f;
+
+    sd_init(&g);
+    sd_read_su(&g, su);
+    sd_read_elf(&g, &elf);
+    sd_entries(&g);
+    sd_analyze(&g);
+
+    CU_ASSERT( find(&g, "main")->Entry == SD_THREAD );
+    CU_ASSERT( find(&g, "HardFaultHandler")->Entry == SD_ISR );
+    CU_ASSERT( find(&g, "WatchdogHandler")->Entry == SD_ISR );
+    CU_ASSERT( find(&g, "foo")->Entry == SD_NONE );
+
+    // main 16 + foo 24 + bar 40, not main + bar.
+    f = find(&g, "main");
+    CU_ASSERT( f->Worst == 80 );
+    CU_ASSERT( f->Next == sd_func(&g, "foo") );
+    CU_ASSERT( find(&g, "foo")->Next == sd_func(&g, "bar") );
+    CU_ASSERT( f->Reach == ( SD_INDIRECT | SD_RECURSIVE | SD_DYNAMIC ) );
+
+    CU_ASSERT( find(&g, "bar")->Flags == ( SD_DYNAMIC | SD_RECURSIVE ) );
+    CU_ASSERT( find(&g, "HardFaultHandler")->Worst == 64 );
+    CU_ASSERT( find(&g, "HardFaultHandler")->Reach == ( SD_RECURSIVE | SD_DYNAMIC ) );
+    CU_ASSERT( find(&g, "WatchdogHandler")->Worst == 16 );
+    CU_ASSERT( find(&g, "WatchdogHandler")->Reach == 0 );
+
+    // Both handlers nest on top of main.
+    CU_ASSERT( sd_budget(&g, 0, 32) == 80 + ( 64 + 32 ) + ( 16 + 32 ) );
+    CU_ASSERT( sd_budget(&g, 1, 32) == 80 + ( 64 + 32 ) );
+
+    // At the same priority they can't.
+    find(&g, "HardFaultHandler")->Prio = 0;
+    find(&g, "WatchdogHandler")->Prio = 0;
+    CU_ASSERT( sd_budget(&g, 0, 32) == 80 + ( 64 + 32 ) );
+
+    // The app entry.
+    find(&g, "baz")->Entry = SD_THREAD;
+    CU_ASSERT( sd_budget(&g, 0, 104) == 80 + ( 64 + 104 ) );
+    sd_free(&g);
+    }
+
+void testReadCi(void) {
+    STACKGRAPH g;
+    SDFUNC *f;
+
+    sd_init(&g);
+    CU_ASSERT( sd_read_ci(&g, ci) == 3 );
+    CU_ASSERT( find(&g, "main")->Frame == 32 );
+    CU_ASSERT( find(&g, "work")->Frame == 16 && find(&g, "work")->Flags == SD_INDIRECT );
+    CU_ASSERT( find(&g, "puts")->Frame == -1 );
+
+    sd_entries(&g);
+    sd_analyze(&g);
+    f = find(&g, "main");
+    CU_ASSERT( f->Worst == 48 );
+    CU_ASSERT( f->Reach == ( SD_INDIRECT | SD_UNKNOWN ) );
+
+    // Tell it where the indirect call goes.
+    sd_read_su(&g, "main.c:3:6:callback\t200\tstatic\n");
+    sd_call(&g, sd_func(&g, "work"), sd_func(&g, "callback"));
+    sd_analyze(&g);
+    CU_ASSERT( f->Worst == 248 );
+    sd_free(&g);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Stack Depth", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Read .su", testReadSu)) ||
+            (NULL == CU_add_test(pSuite, "Read ELF", testReadElf)) ||
+            (NULL == CU_add_test(pSuite, "Analyze", testAnalyze)) ||
+            (NULL == CU_add_test(pSuite, "Read .ci", testReadCi))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,608 @@
+/// @file stackdepth.c
+/// @brief Host tool.  Worst case stack depth per entry point.
+/// @details
+/// Stack sizes come from GCC's -fstack-usage .su files, or from the
+/// node labels in -fcallgraph-info=su .ci files.   The call graph
+/// comes from the .ci files, or from the ELF file - every Thumb BL,
+/// BLX and B.W (tail call) to the start of a function is an edge.
+/// $d mapping symbols keep literal pools out of the scan.
+///
+/// The result for each entry point is its worst case depth and the
+/// path that gets there.   Entry points are main, and everything that
+/// looks like a handler - HardFaultHandler, WatchdogHandler,
+/// SysTick_Handler, FaultISR and so on.   -e adds others, such as the
+/// app entry that LaunchUserApp jumps to.
+///
+/// Some things make the number a lower bound, and they're flagged:
+/// - recursion: the cycle is only counted once.
+/// - indirect calls: we can't tell where they go.   -c caller:callee
+///   tells us.
+/// - dynamic frames (alloca, VLAs), and functions with no .su entry.
+///
+/// Interrupts stack up on MSP.   The budget is the deepest thread
+/// entry, plus for each interrupt priority level, the deepest handler
+/// at that level and an exception frame.   Handlers at the same
+/// priority can't nest, so -p name=prio helps a lot.   -n limits the
+/// nesting depth.
+///
+/// Usage: stackdepth [-e entry] [-p isr=prio] [-c caller:callee] [-n nesting]
+///                   [-x excframe] files.su|.ci|.elf ...
+///
+/// Build with -DNO_MAIN to link the analyzer into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "elfread.h"
+#include "stackdepth.h"
+
+static uint32_t hash(const char *s) {
+    uint32_t h = 2166136261u;
+
+    while ( *s ) h = ( h ^ (uint8_t) *s++ ) * 16777619u;
+
+    return(h);
+    }
+
+static void rehash(STACKGRAPH *g) {
+    free(g->Hash);
+    g->HashSize = g->HashSize ? g->HashSize * 2 : 1024;
+    g->Hash = malloc(g->HashSize * sizeof(int));
+    memset(g->Hash, 0xFF, g->HashSize * sizeof(int));
+
+    for ( int i = 0; i < g->Count; i++ ) {
+        uint32_t h = hash(g->Funcs[i].Name) & ( g->HashSize - 1 );
+
+        while ( g->Hash[h] >= 0 ) h = ( h + 1 ) & ( g->HashSize - 1 );
+
+        g->Hash[h] = i;
+        }
+    }
+
+void sd_init(STACKGRAPH *g) {
+    memset(g, 0, sizeof(*g));
+    rehash(g);
+    }
+
+void sd_free(STACKGRAPH *g) {
+    for ( int i = 0; i < g->Count; i++ ) {
+        free(g->Funcs[i].Name);
+        free(g->Funcs[i].Callee);
+        }
+
+    free(g->Funcs);
+    free(g->Hash);
+    memset(g, 0, sizeof(*g));
+    }
+
+/// @brief Find a function, adding it if need be.
+/// @return its index
+int sd_func(STACKGRAPH *g, const char *name) {
+    uint32_t h = hash(name) & ( g->HashSize - 1 );
+    SDFUNC *f;
+
+    for ( ; g->Hash[h] >= 0; h = ( h + 1 ) & ( g->HashSize - 1 ) ) {
+        if ( strcmp(g->Funcs[g->Hash[h]].Name, name) == 0 ) return(g->Hash[h]);
+        }
+
+    if ( g->Count == g->Size ) {
+        g->Size = g->Size ? g->Size * 2 : 256;
+        g->Funcs = realloc(g->Funcs, g->Size * sizeof(SDFUNC));
+        }
+
+    f = &g->Funcs[g->Count];
+    memset(f, 0, sizeof(*f));
+    f->Name = strdup(name);
+    f->Frame = -1;
+    f->Next = -1;
+    g->Hash[h] = g->Count++;
+
+    if ( g->Count * 2 > g->HashSize ) rehash(g);
+
+    return(g->Count - 1);
+    }
+
+/// @brief Add an edge to the call graph.
+void sd_call(STACKGRAPH *g, int caller, int callee) {
+    SDFUNC *f = &g->Funcs[caller];
+
+    for ( int i = 0; i < f->NCallee; i++ ) {
+        if ( f->Callee[i] == callee ) return;
+        }
+
+    f->Callee = realloc(f->Callee, ( f->NCallee + 1 ) * sizeof(int));
+    f->Callee[f->NCallee++] = callee;
+    }
+
+static void set_frame(SDFUNC *f, int32_t bytes, const char *qual) {
+    // The same function in two files - keep the bigger one.
+    if ( bytes > f->Frame ) f->Frame = bytes;
+
+    if ( strstr(qual, "dynamic") && !strstr(qual, "bounded") ) f->Flags |= SD_DYNAMIC;
+    }
+
+/// @brief Read a .su file.
+///   foo.c:12:6:name<tab>bytes<tab>static
+/// @return the number of functions
+int sd_read_su(STACKGRAPH *g, const char *text) {
+    int n = 0;
+
+    while ( *text ) {
+        const char *eol = text + strcspn(text, "\n");
+        const char *tab = memchr(text, '\t', eol - text);
+        const char *colon;
+        char name[256], qual[64] = "";
+        long bytes;
+
+        if ( tab ) {
+            // The name is after the last colon before the tab.
+            for ( colon = tab; colon > text && colon[-1] != ':'; colon-- ) ;
+
+            if ( tab - colon < (long) sizeof(name) && sscanf(tab, "\t%ld\t%63[^\n]", &bytes, qual) >= 1 ) {
+                int f;
+
+                memcpy(name, colon, tab - colon);
+                name[tab - colon] = 0;
+                f = sd_func(g, name);   // Before g->Funcs moves.
+                set_frame(&g->Funcs[f], bytes, qual);
+                n++;
+                }
+            }
+
+        text = *eol ? eol + 1 : eol;
+        }
+
+    return(n);
+    }
+
+// Pull a quoted value out of a VCG line:  key: "value"
+static int vcg_value(const char *line, const char *key, char *out, int len) {
+    const char *p = strstr(line, key);
+    int n = 0;
+
+    if ( p == NULL || ( p = strchr(p, '"') ) == NULL ) return(0);
+
+    for ( p++; *p && *p != '"' && n < len - 1; p++ ) {
+        if ( *p == '\\' && p[1] ) {
+            p++;
+            out[n++] = ( *p == 'n' ) ? '\n' : *p;
+            }
+        else out[n++] = *p;
+        }
+
+    out[n] = 0;
+    return(1);
+    }
+
+/// @brief Read a -fcallgraph-info .ci file (VCG).
+/// @return the number of edges
+int sd_read_ci(STACKGRAPH *g, const char *text) {
+    char line[4096], a[1024], b[1024];
+    int edges = 0;
+
+    while ( *text ) {
+        size_t len = strcspn(text, "\n");
+
+        if ( len >= sizeof(line) ) len = sizeof(line) - 1;
+
+        memcpy(line, text, len);
+        line[len] = 0;
+        text += strcspn(text, "\n");
+
+        if ( *text ) text++;
+
+        if ( strncmp(line, "node:", 5) == 0 && vcg_value(line, "title:", a, sizeof(a)) ) {
+            int f = sd_func(g, a);
+            long bytes;
+            char *p;
+
+            // label: "name\nfile:line:col\n16 bytes (static)\n..."
+            if ( vcg_value(line, "label:", b, sizeof(b)) && ( p = strstr(b, " bytes (") ) != NULL ) {
+                while ( p > b && isdigit((unsigned char) p[-1]) ) p--;
+
+                bytes = strtol(p, NULL, 10);
+                p = strchr(p, '(');
+                p[strcspn(p, ")")] = 0;
+                set_frame(&g->Funcs[f], bytes, p);
+                }
+            }
+        else if ( strncmp(line, "edge:", 5) == 0 &&
+                  vcg_value(line, "sourcename:", a, sizeof(a)) &&
+                  vcg_value(line, "targetname:", b, sizeof(b)) ) {
+            int f = sd_func(g, a);
+
+            if ( strcmp(b, "__indirect_call") == 0 ) g->Funcs[f].Flags |= SD_INDIRECT;
+            else sd_call(g, f, sd_func(g, b));
+
+            edges++;
+            }
+        }
+
+    return(edges);
+    }
+
+// ------------------------------------------------------------------
+// Call graph from the ELF file.
+// ------------------------------------------------------------------
+typedef struct {
+    uint32_t Addr;
+    uint32_t Size;
+    int Func;      // Graph index, or -1 for a $d
+    int Data;      // Mapping symbol: 1 for $d, 0 for $t
+    } ELFSYM;
+
+static int elfsym_cmp(const void *a, const void *b) {
+    uint32_t x = ( (const ELFSYM *) a )->Addr, y = ( (const ELFSYM *) b )->Addr;
+    return( ( x > y ) - ( x < y ) );
+    }
+
+// The last symbol at or below addr.
+static int elfsym_find(ELFSYM *s, int n, uint32_t addr) {
+    int lo = 0, hi = n - 1, found = -1;
+
+    while ( lo <= hi ) {
+        int mid = ( lo + hi ) / 2;
+
+        if ( s[mid].Addr <= addr ) {
+            found = mid;
+            lo = mid + 1;
+            }
+        else hi = mid - 1;
+        }
+
+    return(found);
+    }
+
+// Thumb-2 BL/BLX/B.W offset.
+static int32_t branch_offset(uint16_t hw1, uint16_t hw2) {
+    uint32_t s = ( hw1 >> 10 ) & 1;
+    uint32_t i1 = !( ( ( hw2 >> 13 ) & 1 ) ^ s );
+    uint32_t i2 = !( ( ( hw2 >> 11 ) & 1 ) ^ s );
+    uint32_t off = ( s << 24 ) | ( i1 << 23 ) | ( i2 << 22 ) | ( ( hw1 & 0x3FF ) << 12 ) | ( ( hw2 & 0x7FF ) << 1 );
+
+    return( (int32_t) ( off << 7 ) >> 7 );
+    }
+
+/// @brief Get calls out of the code in an ELF file.
+/// @return the number of edges
+int sd_read_elf(STACKGRAPH *g, ELFFILE *ef) {
+    const char *strtab;
+    Elf32_Sym *es;
+    ELFSYM *funcs, *maps;
+    int count, nf = 0, nm = 0, edges = 0;
+
+    if ( ( es = elf_symbols(ef, &count, &strtab) ) == NULL ) return(-1);
+
+    funcs = malloc(( count + 1 ) * sizeof(ELFSYM));
+    maps = malloc(( count + 1 ) * sizeof(ELFSYM));
+
+    for ( int i = 0; i < count; i++ ) {
+        const char *name = strtab + es[i].st_name;
+
+        if ( es[i].st_shndx == SHN_UNDEF || es[i].st_shndx >= ef->Ehdr->e_shnum ) continue;
+
+        if ( ELF32_ST_TYPE(es[i].st_info) == STT_FUNC ) {
+            funcs[nf].Addr = es[i].st_value & ~1;
+            funcs[nf].Size = es[i].st_size;
+            funcs[nf++].Func = sd_func(g, name);
+            }
+        else if ( name[0] == '$' && ( name[1] == 'd' || name[1] == 't' ) && ( name[2] == 0 || name[2] == '.' ) ) {
+            maps[nm].Addr = es[i].st_value;
+            maps[nm++].Data = ( name[1] == 'd' );
+            }
+        }
+
+    qsort(funcs, nf, sizeof(ELFSYM), elfsym_cmp);
+    qsort(maps, nm, sizeof(ELFSYM), elfsym_cmp);
+
+    for ( int s = 0; s < ef->Ehdr->e_shnum; s++ ) {
+        Elf32_Shdr *sh = &ef->Shdr[s];
+        const uint8_t *code = elf_section_data(ef, sh);
+
+        if ( !( sh->sh_flags & SHF_EXECINSTR ) || code == NULL ) continue;
+
+        for ( uint32_t off = 0; off + 2 <= sh->sh_size; off += 2 ) {
+            uint32_t addr = sh->sh_addr + off, target;
+            uint16_t hw1, hw2 = 0;
+            int m = elfsym_find(maps, nm, addr);
+            int caller = elfsym_find(funcs, nf, addr), callee;
+
+            if ( m >= 0 && maps[m].Data ) continue; // Literal pool.
+
+            if ( caller < 0 || ( funcs[caller].Size && addr >= funcs[caller].Addr + funcs[caller].Size ) ) continue;
+
+            memcpy(&hw1, code + off, 2);
+
+            if ( ( hw1 & 0xF800 ) < 0xE800 ) { // 16 bits.
+                if ( ( hw1 & 0xFF87 ) == 0x4780 ) { // BLX Rm
+                    g->Funcs[funcs[caller].Func].Flags |= SD_INDIRECT;
+                    }
+
+                continue;
+                }
+
+            // 32 bits.   Always step over the second half, whatever it is,
+            // or it gets decoded as an instruction of its own.
+            if ( off + 4 > sh->sh_size ) break;
+
+            memcpy(&hw2, code + off + 2, 2);
+            off += 2;
+
+            if ( ( hw1 & 0xF800 ) != 0xF000 ) continue;
+
+            if ( ( hw2 & 0xD000 ) == 0xD000 ) target = addr + 4 + branch_offset(hw1, hw2);                // BL
+            else if ( ( hw2 & 0xD000 ) == 0xC000 ) target = ( ( addr + 4 ) & ~3 ) + branch_offset(hw1, hw2); // BLX
+            else if ( ( hw2 & 0xD000 ) == 0x9000 ) target = addr + 4 + branch_offset(hw1, hw2);           // B.W
+            else continue;
+
+            callee = elfsym_find(funcs, nf, target);
+
+            // B.W inside the function is just a branch.
+            if ( callee < 0 || funcs[callee].Addr != target ) continue;
+
+            if ( callee == caller && ( hw2 & 0xD000 ) == 0x9000 ) continue;
+
+            sd_call(g, funcs[caller].Func, funcs[callee].Func);
+            edges++;
+            }
+        }
+
+    free(funcs);
+    free(maps);
+    return(edges);
+    }
+
+// ------------------------------------------------------------------
+// Analysis
+// ------------------------------------------------------------------
+
+/// @brief Mark main and the handlers as entry points.
+void sd_entries(STACKGRAPH *g) {
+    for ( int i = 0; i < g->Count; i++ ) {
+        const char *n = g->Funcs[i].Name;
+        size_t len = strlen(n);
+
+        if ( g->Funcs[i].Entry ) continue;
+
+        if ( strcmp(n, "main") == 0 ) g->Funcs[i].Entry = SD_THREAD;
+        else if ( ( len > 7 && strcmp(n + len - 7, "Handler") == 0 ) ||
+                  ( len > 3 && strcmp(n + len - 3, "ISR") == 0 ) ) {
+            g->Funcs[i].Entry = SD_ISR;
+            g->Funcs[i].Prio = -1 - i; // Assume they can all nest.
+            }
+        }
+    }
+
+static void walk(STACKGRAPH *g, int i) {
+    SDFUNC *f = &g->Funcs[i];
+    int32_t deepest = 0;
+
+    f->State = 1;
+    f->Reach = f->Flags;
+
+    if ( f->Frame < 0 ) f->Reach |= SD_UNKNOWN;
+
+    for ( int c = 0; c < f->NCallee; c++ ) {
+        SDFUNC *callee = &g->Funcs[f->Callee[c]];
+
+        if ( callee->State == 1 ) { // Back to something on the path.
+            callee->Flags |= SD_RECURSIVE;
+            f->Flags |= SD_RECURSIVE;
+            f->Reach |= SD_RECURSIVE;
+            continue;
+            }
+
+        if ( callee->State == 0 ) walk(g, f->Callee[c]);
+
+        f->Reach |= callee->Reach;
+
+        if ( callee->Worst > deepest || f->Next < 0 ) {
+            deepest = callee->Worst;
+            f->Next = f->Callee[c];
+            }
+        }
+
+    f->Worst = ( f->Frame > 0 ? f->Frame : 0 ) + deepest;
+    f->State = 2;
+    }
+
+/// @brief Work out the worst case for every function.
+void sd_analyze(STACKGRAPH *g) {
+    for ( int i = 0; i < g->Count; i++ ) {
+        g->Funcs[i].State = 0;
+        g->Funcs[i].Next = -1;
+        }
+
+    for ( int i = 0; i < g->Count; i++ ) {
+        if ( g->Funcs[i].State == 0 ) walk(g, i);
+        }
+    }
+
+static int prio_cmp(const void *a, const void *b) {
+    const int32_t *x = a, *y = b;
+
+    if ( x[0] != y[0] ) return( ( x[0] > y[0] ) - ( x[0] < y[0] ) );
+
+    return( ( x[1] < y[1] ) - ( x[1] > y[1] ) ); // Deepest first.
+    }
+
+static int depth_cmp(const void *a, const void *b) {
+    int32_t x = *(const int32_t *) a, y = *(const int32_t *) b;
+    return( ( x < y ) - ( x > y ) );
+    }
+
+/// @brief Main stack budget.
+/// @return deepest thread entry + the deepest handler at each priority
+/// level, each with an exception frame.
+/// @param g analyzed graph
+/// @param nesting at most this many levels, deepest first.  0 for all.
+/// @param excframe exception frame size - 32, or 104 with the FPU.
+int32_t sd_budget(STACKGRAPH *g, int nesting, int32_t excframe) {
+    int32_t thread = 0, total, (*isr)[2] = malloc(( g->Count + 1 ) * sizeof(*isr));
+    int32_t *level = malloc(( g->Count + 1 ) * sizeof(int32_t));
+    int n = 0, levels = 0;
+
+    for ( int i = 0; i < g->Count; i++ ) {
+        if ( g->Funcs[i].Entry == SD_THREAD && g->Funcs[i].Worst > thread ) thread = g->Funcs[i].Worst;
+
+        if ( g->Funcs[i].Entry == SD_ISR ) {
+            isr[n][0] = g->Funcs[i].Prio;
+            isr[n++][1] = g->Funcs[i].Worst + excframe;
+            }
+        }
+
+    // Deepest handler at each priority.
+    qsort(isr, n, sizeof(*isr), prio_cmp);
+
+    for ( int i = 0; i < n; i++ ) {
+        if ( i == 0 || isr[i][0] != isr[i - 1][0] ) level[levels++] = isr[i][1];
+        }
+
+    // Deepest levels first, if there's a nesting limit.
+    qsort(level, levels, sizeof(int32_t), depth_cmp);
+
+    total = thread;
+
+    for ( int i = 0; i < levels && ( nesting == 0 || i < nesting ); i++ ) total += level[i];
+
+    free(isr);
+    free(level);
+    return(total);
+    }
+
+#ifndef NO_MAIN
+static char *slurp(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    char *text;
+    long len;
+
+    if ( fp == NULL ) return(NULL);
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+    text = malloc(len + 1);
+    text[fread(text, 1, len, fp)] = 0;
+    fclose(fp);
+    return(text);
+    }
+
+static const char *flags(int f) {
+    static char s[64];
+
+    s[0] = 0;
+
+    if ( f & SD_RECURSIVE ) strcat(s, " recursion");
+    if ( f & SD_INDIRECT ) strcat(s, " indirect");
+    if ( f & SD_DYNAMIC ) strcat(s, " dynamic");
+    if ( f & SD_UNKNOWN ) strcat(s, " unknown");
+
+    return(s);
+    }
+
+static void usage(void) {
+    fprintf(stderr, "Usage: stackdepth [-e entry] [-p isr=prio] [-c caller:callee] [-n nesting]\n"
+                    "                  [-x excframe] files.su|.ci|.elf ...\n");
+    exit(2);
+    }
+
+int main(int argc, char **argv) {
+    STACKGRAPH g;
+    int nesting = 0, opt, loose = 0;
+    int32_t excframe = 32;
+    char *p;
+    int f;
+
+    sd_init(&g);
+
+    while ( ( opt = getopt(argc, argv, "e:p:c:n:x:") ) != -1 ) {
+        switch ( opt ) {
+            case 'e':
+                f = sd_func(&g, optarg);
+                g.Funcs[f].Entry = SD_THREAD;
+                break;
+
+            case 'p':
+                if ( ( p = strchr(optarg, '=') ) == NULL ) usage();
+
+                *p = 0;
+                f = sd_func(&g, optarg);
+                g.Funcs[f].Entry = SD_ISR;
+                g.Funcs[f].Prio = atoi(p + 1);
+                break;
+
+            case 'c':
+                if ( ( p = strchr(optarg, ':') ) == NULL ) usage();
+
+                *p++ = 0;
+                sd_call(&g, sd_func(&g, optarg), sd_func(&g, p));
+                break;
+
+            case 'n': nesting = atoi(optarg); break;
+            case 'x': excframe = atoi(optarg); break;
+            default: usage();
+            }
+        }
+
+    if ( optind >= argc ) usage();
+
+    for ( int i = optind; i < argc; i++ ) {
+        size_t len = strlen(argv[i]);
+        ELFFILE ef;
+        char *text;
+
+        if ( len > 3 && ( strcmp(argv[i] + len - 3, ".su") == 0 || strcmp(argv[i] + len - 3, ".ci") == 0 ) ) {
+            if ( ( text = slurp(argv[i]) ) == NULL ) {
+                perror(argv[i]);
+                return(2);
+                }
+
+            if ( argv[i][len - 2] == 's' ) sd_read_su(&g, text);
+            else sd_read_ci(&g, text);
+
+            free(text);
+            }
+        else if ( elf_open(&ef, argv[i]) == 0 ) {
+            if ( sd_read_elf(&g, &ef) < 0 ) fprintf(stderr, "%s: no symbols\n", argv[i]);
+
+            elf_close(&ef);
+            }
+        else {
+            fprintf(stderr, "%s: not a .su, .ci or ELF file\n", argv[i]);
+            return(2);
+            }
+        }
+
+    sd_entries(&g);
+    sd_analyze(&g);
+
+    for ( int i = 0; i < g.Count; i++ ) {
+        SDFUNC *f = &g.Funcs[i];
+
+        if ( f->Entry == SD_NONE ) continue;
+
+        printf("%-24s %6d%s%s\n", f->Name, (int) f->Worst, f->Entry == SD_ISR ? " isr" : "", flags(f->Reach));
+
+        for ( int j = i; j >= 0; j = g.Funcs[j].Next ) {
+            SDFUNC *s = &g.Funcs[j];
+
+            if ( s->Frame < 0 ) printf("    %-20s      ?%s\n", s->Name, flags(s->Flags));
+            else printf("    %-20s %6d%s\n", s->Name, (int) s->Frame, flags(s->Flags));
+            }
+
+        loose |= f->Reach;
+        }
+
+    printf("MSP budget %d bytes, %s nesting, %d byte exception frames\n",
+           (int) sd_budget(&g, nesting, excframe), nesting ? "limited" : "full", (int) excframe);
+
+    if ( loose ) printf("Lower bound only:%s\n", flags(loose));
+
+    sd_free(&g);
+    return(0);
+    }
+#endif
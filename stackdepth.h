@@ -0,0 +1,58 @@
+//
+// Worst case stack depth from -fstack-usage and the call graph.
+//
+
+#ifndef __STACKDEPTH_H__
+#define __STACKDEPTH_H__
+
+#include <stdint.h>
+
+#include "elfread.h"
+
+// Flags - on a function, and on everything it can reach.
+#define SD_DYNAMIC   (1 << 0) // alloca or VLA - frame size is a guess.
+#define SD_INDIRECT  (1 << 1) // Calls through a pointer.
+#define SD_RECURSIVE (1 << 2) // Part of a cycle.
+#define SD_UNKNOWN   (1 << 3) // No stack usage information.
+
+// Kinds of entry point.
+#define SD_NONE   0
+#define SD_THREAD 1 // main, the app entry.
+#define SD_ISR    2
+
+typedef struct {
+    char *Name;
+    int32_t Frame;       // Bytes, from .su or .ci
+    int Flags;
+    int *Callee;         // Indexes into the graph.
+    int NCallee;
+    int Entry;           // SD_THREAD, SD_ISR
+    int Prio;            // For ISRs.  Same priority can't nest.
+
+    // Results
+    int32_t Worst;       // Frame plus the deepest callee.
+    int Next;            // Deepest callee, or -1.
+    int Reach;           // Flags of everything reachable.
+    int State;
+    } SDFUNC;
+
+typedef struct {
+    SDFUNC *Funcs;
+    int Count;
+    int Size;
+    int *Hash;
+    int HashSize;
+    } STACKGRAPH;
+
+void    sd_init(STACKGRAPH*);
+void    sd_free(STACKGRAPH*);
+int     sd_func(STACKGRAPH*, const char *name);
+void    sd_call(STACKGRAPH*, int caller, int callee);
+int     sd_read_su(STACKGRAPH*, const char *text);
+int     sd_read_ci(STACKGRAPH*, const char *text);
+int     sd_read_elf(STACKGRAPH*, ELFFILE*);
+void    sd_entries(STACKGRAPH*);
+void    sd_analyze(STACKGRAPH*);
+int32_t sd_budget(STACKGRAPH*, int nesting, int32_t excframe);
+
+#endif
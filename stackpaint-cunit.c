@@ -0,0 +1,195 @@
+// CUnit tests for stack painting.
+//
+// The stacks are plain arrays.   "Using" a stack means scribbling on
+// it from the top down, the way a real one fills.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stackpaint.h"
+#include "crashdump.h"
+#include "crashdump-decode.h"
+
+#include "CUnit/Basic.h"
+
+#define WORDS 256
+
+uint32_t stack[WORDS];
+uint32_t stack2[WORDS];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// Touch the top n words of a stack.
+static void use(uint32_t *s, uint32_t words, uint32_t n) {
+    for ( uint32_t i = words - n; i < words; i++ ) s[i] = 0x20000000 + i;
+    }
+
+// Walk up from the bottom - the obvious way.
+static uint32_t linear(const uint32_t *s, uint32_t words) {
+    uint32_t i = 0;
+
+    while ( i < words && s[i] == STACKPAINT_CANARY ) i++;
+
+    return(i);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testFill(void) {
+    memset(stack, 0, sizeof(stack));
+    stackpaint_fill(stack + 1, WORDS - 2);
+
+    CU_ASSERT( stack[0] == 0 && stack[WORDS - 1] == 0 );
+    CU_ASSERT( stack[1] == STACKPAINT_CANARY && stack[WORDS - 2] == STACKPAINT_CANARY );
+    }
+
+// Every depth, every size, against the linear scan.
+void testUnused(void) {
+    int bad = 0;
+
+    for ( uint32_t words = 0; words <= 40; words++ ) {
+        for ( uint32_t n = 0; n <= words; n++ ) {
+            stackpaint_fill(stack, words);
+            use(stack, words, n);
+
+            if ( stackpaint_unused(stack, words) != words - n ) bad++;
+            }
+        }
+
+    CU_ASSERT( bad == 0 );
+
+    stackpaint_fill(stack, WORDS);
+    CU_ASSERT( stackpaint_unused(stack, WORDS) == WORDS );
+
+    stack[0] = 0; // Overflowed.
+    CU_ASSERT( stackpaint_unused(stack, WORDS) == 0 );
+
+    // A buffer deep in the used part that was never written.
+    stackpaint_fill(stack, 256);
+    use(stack, 256, 100);
+    stackpaint_fill(stack + 192, 8);
+    CU_ASSERT( stackpaint_unused(stack, 256) == 156 );
+    }
+
+// Live data that happens to match the canary.
+void testFalseCanary(void) {
+    int bad = 0;
+
+    for ( uint32_t n = 1; n < WORDS; n++ ) {
+        stackpaint_fill(stack, WORDS);
+        use(stack, WORDS, n);
+
+        // Runs of canary-valued data in the used part.
+        for ( uint32_t i = WORDS - n + 1; i < WORDS; i += 7 ) {
+            for ( uint32_t j = i; j < i + ( n % 6 ) && j < WORDS; j++ ) {
+                stack[j] = STACKPAINT_CANARY;
+                }
+            }
+
+        if ( stackpaint_unused(stack, WORDS) != linear(stack, WORDS) ) bad++;
+        }
+
+    CU_ASSERT( bad == 0 );
+    }
+
+void testUsage(void) {
+    STACKUSAGE u;
+
+    stackpaint_register(STACK_MSP, NULL, 0);
+    stackpaint_register(STACK_PSP, NULL, 0);
+    CU_ASSERT( stackpaint_usage(STACK_MSP, &u) == -1 );
+    CU_ASSERT( stackpaint_usage(2, &u) == -1 );
+
+    stackpaint_fill(stack, WORDS);
+    stackpaint_fill(stack2, WORDS);
+    stackpaint_register(STACK_MSP, stack, WORDS);
+    stackpaint_register(STACK_PSP, stack2, WORDS);
+
+    use(stack, WORDS, 10);
+    use(stack2, WORDS, 100);
+
+    CU_ASSERT( stackpaint_usage(STACK_MSP, &u) == 0 );
+    CU_ASSERT( u.Size == WORDS * 4 && u.Used == 40 );
+    CU_ASSERT( stackpaint_usage(STACK_PSP, &u) == 0 );
+    CU_ASSERT( u.Size == WORDS * 4 && u.Used == 400 );
+
+    // The high-water mark sticks after the stack shrinks.
+    stack2[WORDS - 1] = STACKPAINT_CANARY;
+    CU_ASSERT( stackpaint_usage(STACK_PSP, &u) == 0 && u.Used == 400 );
+    }
+
+// Crash records pick up the marks.
+void testCrashDump(void) {
+    uint32_t regs[17] = { 0 }, fsr[CD_FSR_COUNT] = { 0 };
+    CRASHDUMP cd;
+    char *text;
+    size_t size;
+    FILE *f;
+
+    stackpaint_fill(stack, WORDS);
+    stackpaint_register(STACK_MSP, stack, WORDS);
+    stackpaint_register(STACK_PSP, NULL, 0);
+    use(stack, WORDS, 30);
+
+    crashdump_fill(&cd, regs, 0xFFFFFFF9, fsr, stack, 0);
+    CU_ASSERT( cd.StackSize[0] == WORDS * 4 && cd.StackUsed[0] == 120 );
+    CU_ASSERT( cd.StackSize[1] == 0 );
+
+    f = open_memstream(&text, &size);
+    CU_ASSERT( crashdump_decode(&cd, sizeof(cd), f) == CD_OK );
+    fclose(f);
+    CU_ASSERT( strstr(text, "MSP: 120 of 1024 bytes used\n") != NULL );
+    CU_ASSERT( strstr(text, "PSP:") == NULL );
+    free(text);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Stack Painting", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Fill", testFill)) ||
+            (NULL == CU_add_test(pSuite, "Unused", testUnused)) ||
+            (NULL == CU_add_test(pSuite, "False canary", testFalseCanary)) ||
+            (NULL == CU_add_test(pSuite, "Usage", testUsage)) ||
+            (NULL == CU_add_test(pSuite, "Crash dump", testCrashDump))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,112 @@
+/// @file stackpaint.c
+/// @brief Stack painting and high-water marks.
+/// @details
+/// Fill a stack with a canary pattern before it gets used, and later
+/// on, the first word that isn't the canary any more is the deepest the
+/// stack has ever been.
+///
+/// Stacks grow down, so the untouched canary is all at the bottom.   The
+/// mark is found with a walk up from the base.   A binary search won't
+/// do - the used part can hold long runs of canary too, where a local
+/// buffer was never written, and a probe landing there would report too
+/// little use.   The walk is a few microseconds for a few KiB.
+///
+/// The supervisor runs on MSP, and LaunchUserAppThread puts the app
+/// on PSP.   Register each stack once it has been painted, and
+/// stackpaint_usage() reports on it.   Crash records include both.
+///
+/// On the target:
+/// @code
+///    stackpaint_msp(&_stack_bottom, MSP_WORDS);
+///    ...
+///    stackpaint_launch(appaddr, runtime, PSP_WORDS); // Does not return
+/// @endcode
+
+#include <stdint.h>
+
+#include "stackpaint.h"
+
+static STACKREGION stacks[STACKPAINT_STACKS];
+
+/// @brief Paint a region with the canary.
+/// @param base lowest address
+/// @param words how many words
+void stackpaint_fill(uint32_t *base, uint32_t words) {
+    volatile uint32_t *p = base;
+
+    while ( words-- ) *p++ = STACKPAINT_CANARY;
+    }
+
+/// @brief How much of a painted stack has never been touched?
+/// @return the number of canary words at the bottom.
+/// @param base lowest address
+/// @param words size of the painted region
+uint32_t stackpaint_unused(const uint32_t *base, uint32_t words) {
+    uint32_t i = 0;
+
+    // The first word that isn't canary.   If that's the bottom word,
+    // it overflowed, whatever the rest looks like.
+    while ( i < words && base[i] == STACKPAINT_CANARY ) i++;
+
+    return(i);
+    }
+
+/// @brief Record where a painted stack is.
+/// @param stack STACK_MSP or STACK_PSP
+/// @param base lowest address
+/// @param words size
+void stackpaint_register(int stack, uint32_t *base, uint32_t words) {
+    if ( stack < 0 || stack >= STACKPAINT_STACKS ) return;
+
+    stacks[stack].Base = base;
+    stacks[stack].Words = words;
+    }
+
+/// @brief Report on a stack.
+/// @return 0, or -1 if that stack hasn't been registered.
+/// @param stack STACK_MSP or STACK_PSP
+/// @param usage returns the size and high-water mark
+int stackpaint_usage(int stack, STACKUSAGE *usage) {
+    STACKREGION *s;
+
+    if ( stack < 0 || stack >= STACKPAINT_STACKS || stacks[stack].Base == 0 ) return(-1);
+
+    s = &stacks[stack];
+    usage->Size = s->Words * 4;
+    usage->Used = ( s->Words - stackpaint_unused(s->Base, s->Words) ) * 4;
+    return(0);
+    }
+
+#if defined(__arm__)
+#include "bl_launcher.h"
+
+/// @brief Paint and register the main stack.
+/// Paints everything below the current frame, with some room
+/// to spare.
+/// @param base lowest address of the main stack
+/// @param words size of the main stack
+void stackpaint_msp(uint32_t *base, uint32_t words) {
+    uint32_t *sp;
+
+    __asm__ __volatile__ ( "mrs %0, msp" : "=r" (sp) );
+
+    sp -= 16;
+
+    if ( sp > base ) stackpaint_fill(base, sp - base);
+
+    stackpaint_register(STACK_MSP, base, words);
+    }
+
+/// @brief Paint the app stack and start the app in thread mode.
+/// The top of the stack comes from the app's vector table.
+/// @param appaddr the app's vector table
+/// @param runtimep runtime data for the app
+/// @param psp_words size of the app stack
+void stackpaint_launch(uint32_t *appaddr, uint32_t *runtimep, uint32_t psp_words) {
+    uint32_t *base = (uint32_t *) appaddr[0] - psp_words;
+
+    stackpaint_fill(base, psp_words);
+    stackpaint_register(STACK_PSP, base, psp_words);
+    LaunchUserAppThread(appaddr, runtimep);
+    }
+#endif
@@ -0,0 +1,37 @@
+//
+// Stack painting and high-water marks.
+//
+
+#ifndef __STACKPAINT_H__
+#define __STACKPAINT_H__
+
+#include <stdint.h>
+
+#define STACKPAINT_CANARY 0xA5A5A5A5
+
+// Stack IDs.
+#define STACK_MSP 0
+#define STACK_PSP 1
+#define STACKPAINT_STACKS 2
+
+typedef struct {
+    uint32_t *Base;   // Lowest address.
+    uint32_t Words;
+    } STACKREGION;
+
+typedef struct {
+    uint32_t Size;    // Bytes.
+    uint32_t Used;    // High-water mark, in bytes.
+    } STACKUSAGE;
+
+void     stackpaint_fill(uint32_t *base, uint32_t words);
+uint32_t stackpaint_unused(const uint32_t *base, uint32_t words);
+void     stackpaint_register(int stack, uint32_t *base, uint32_t words);
+int      stackpaint_usage(int stack, STACKUSAGE *usage);
+
+#if defined(__arm__)
+void stackpaint_msp(uint32_t *base, uint32_t words);
+void stackpaint_launch(uint32_t *appaddr, uint32_t *runtimep, uint32_t psp_words);
+#endif
+
+#endif
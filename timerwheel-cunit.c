@@ -0,0 +1,299 @@
+// CUnit tests for the timer wheel.
+//
+// Most of these check the one thing that matters - that every timer
+// fires on exactly the tick it was due, no matter how far out it was
+// or which levels it had to cascade through.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "timerwheel.h"
+
+#include "CUnit/Basic.h"
+
+#define NTIMERS 500
+
+TIMERWHEEL wheel;
+SWTIMER timers[NTIMERS];
+
+typedef struct {
+    uint32_t due;     // When we expect it.
+    uint32_t fired;   // How many times it went off.
+    uint32_t late;    // Fired on the wrong tick.
+    } TIMERSTATE;
+
+TIMERSTATE state[NTIMERS];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+// The tick being processed is one behind the wheel's clock.
+static void on_expire(SWTIMER *t) {
+    TIMERSTATE *s = t->Arg;
+
+    if ( wheel.Now - 1 != s->due ) s->late++;
+
+    s->fired++;
+
+    if ( t->Period ) s->due += t->Period;
+    }
+
+static void reset_all(uint32_t now) {
+    timerwheel_init(&wheel, now);
+
+    for ( int i = 0; i < NTIMERS; i++ ) {
+        swtimer_init(&timers[i], on_expire, &state[i]);
+        state[i].due = state[i].fired = state[i].late = 0;
+        }
+    }
+
+static void start(int i, uint32_t delay, uint32_t period) {
+    state[i].due = wheel.Now + delay;
+    timerwheel_start(&wheel, &timers[i], delay, period);
+    }
+
+static uint32_t total(int which) {
+    uint32_t sum = 0;
+
+    for ( int i = 0; i < NTIMERS; i++ ) sum += which ? state[i].late : state[i].fired;
+
+    return(sum);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    srandom(0);
+    reset_all(0);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testNEW(void) {
+    uint32_t when;
+
+    CU_ASSERT( timerwheel_next_deadline(&wheel, &when) == 0 );
+    CU_ASSERT( timerwheel_advance(&wheel, 1000) == 0 );
+    CU_ASSERT( wheel.Now == 1001 );
+    }
+
+// One timer at a time, out to a range of distances.
+void testOneShot(void) {
+    const uint32_t delays[] = { 0, 1, 31, 32, 33, 1023, 1024, 1025, 40000, 1 << 21 };
+
+    for ( unsigned d = 0; d < sizeof(delays) / sizeof(delays[0]); d++ ) {
+        reset_all(12345);
+        start(0, delays[d], 0);
+        CU_ASSERT( swtimer_active(&timers[0]) );
+
+        timerwheel_advance(&wheel, state[0].due - 1);
+        CU_ASSERT( state[0].fired == 0 );
+
+        timerwheel_advance(&wheel, state[0].due);
+        CU_ASSERT( state[0].fired == 1 );
+        CU_ASSERT( state[0].late == 0 );
+        CU_ASSERT( !swtimer_active(&timers[0]) );
+        }
+    }
+
+// Longer than the whole wheel.  It gets parked and re-filed.
+void testBeyondWheel(void) {
+    reset_all(0);
+    start(0, ( 1 << 25 ) + 1000, 0);
+
+    timerwheel_advance(&wheel, ( 1 << 25 ) + 999);
+    CU_ASSERT( state[0].fired == 0 );
+
+    timerwheel_advance(&wheel, ( 1 << 25 ) + 1000);
+    CU_ASSERT( state[0].fired == 1 );
+    CU_ASSERT( state[0].late == 0 );
+    }
+
+void testPeriodic(void) {
+    reset_all(0);
+    start(0, 7, 7);
+    start(1, 100, 300);
+
+    timerwheel_advance(&wheel, 700);
+    CU_ASSERT( state[0].fired == 100 );
+    CU_ASSERT( state[1].fired == 3 );
+    CU_ASSERT( total(1) == 0 );
+    }
+
+void testStop(void) {
+    reset_all(0);
+    start(0, 5, 0);
+    start(1, 5, 0);
+    start(2, 2000, 0);
+
+    timerwheel_stop(&wheel, &timers[0]);
+    timerwheel_stop(&wheel, &timers[2]);
+    timerwheel_stop(&wheel, &timers[2]); // Twice is OK.
+
+    CU_ASSERT( wheel.Occupied[0] == ( 1u << 5 ) );
+    CU_ASSERT( wheel.Occupied[1] == 0 );
+
+    timerwheel_stop(&wheel, &timers[1]);
+    CU_ASSERT( wheel.Occupied[0] == 0 );
+
+    CU_ASSERT( timerwheel_advance(&wheel, 5000) == 0 );
+    }
+
+// A callback that stops the next timer in the same batch.
+static void stop_neighbor(SWTIMER *t) {
+    on_expire(t);
+    timerwheel_stop(&wheel, t + 1);
+    }
+
+void testStopFromCallback(void) {
+    reset_all(0);
+    timers[0].Callback = stop_neighbor;
+    start(0, 50, 0);
+    start(1, 50, 0);
+
+    timerwheel_advance(&wheel, 100);
+    CU_ASSERT( state[0].fired == 1 );
+    CU_ASSERT( state[1].fired == 0 );
+    timers[0].Callback = on_expire;
+    }
+
+// Lots of timers, random distances, random sized jumps of the clock,
+// right across the 32-bit wrap.
+void testRandomLoad(void) {
+    uint32_t now = 0xFFFF0000;
+
+    reset_all(now);
+
+    for ( int i = 0; i < NTIMERS; i++ ) {
+        uint32_t delay = random() & ( ( i & 1 ) ? 0x3FF : 0x3FFFF );
+        uint32_t period = ( i % 5 == 0 ) ? ( random() & 0xFFF ) + 1 : 0;
+        start(i, delay, period);
+        }
+
+    while ( now - 0xFFFF0000 < 0x80000 ) {
+        now += random() & 0xFF;
+        timerwheel_advance(&wheel, now);
+        }
+
+    CU_ASSERT( total(1) == 0 );
+
+    // Every one-shot fired exactly once, and every periodic one
+    // is waiting for its next turn.
+    for ( int i = 0; i < NTIMERS; i++ ) {
+        if ( timers[i].Period == 0 ) {
+            CU_ASSERT( state[i].fired == 1 );
+            }
+        else {
+            CU_ASSERT( (int32_t) ( state[i].due - now ) > 0 );
+            }
+        }
+    }
+
+// Sleep from deadline to deadline, the way tickless idle would.
+// We should never sleep past an expiry.
+void testNextDeadline(void) {
+    uint32_t when;
+    int wakeups = 0;
+
+    reset_all(100);
+    start(0, 3, 0);
+    start(1, 40, 0);
+    start(2, 5000, 0);
+    start(3, 70000, 0);
+
+    CU_ASSERT( timerwheel_next_deadline(&wheel, &when) );
+    CU_ASSERT( when == 103 );
+
+    while ( timerwheel_next_deadline(&wheel, &when) ) {
+        CU_ASSERT( (int32_t) ( when - wheel.Now ) >= 0 );
+        timerwheel_advance(&wheel, when);
+        wakeups++;
+        }
+
+    CU_ASSERT( total(0) == 4 );
+    CU_ASSERT( total(1) == 0 );
+    printf("\n  %d wakeups for 4 timers ", wakeups);
+    }
+
+// Catch up across a huge gap in one call, with timers pending all
+// the way.   Ticking through 2^31 ticks one at a time would take
+// many seconds - this should be instant.
+void testLongGap(void) {
+    reset_all(0x10);
+    start(0, 1 << 24, 1 << 24);
+    start(1, 0x7FFFFFF0, 0);
+    start(2, 0x7FFFFFF8, 0);
+
+    CU_ASSERT( timerwheel_advance(&wheel, 0x80000000) == 128 );
+    CU_ASSERT( state[0].fired == 127 );
+    CU_ASSERT( state[1].fired == 1 );
+    CU_ASSERT( state[2].fired == 0 );
+    CU_ASSERT( wheel.Now == 0x80000001 );
+
+    CU_ASSERT( timerwheel_advance(&wheel, 0x80000020) == 2 );
+    CU_ASSERT( state[0].fired == 128 );
+    CU_ASSERT( state[2].fired == 1 );
+    CU_ASSERT( total(1) == 0 );
+    }
+
+// Delays past 2^31 can't be told from overdue.   They get clamped, and
+// parked, rather than firing straight away.
+void testHugeDelay(void) {
+    reset_all(1000);
+    timerwheel_start(&wheel, &timers[0], 0x80000000, 0);
+    state[0].due = 1000u + INT32_MAX;
+
+    CU_ASSERT( timerwheel_advance(&wheel, 1001) == 0 );
+    CU_ASSERT( timerwheel_advance(&wheel, 1000u + INT32_MAX - 1) == 0 );
+    CU_ASSERT( timerwheel_advance(&wheel, 1000u + INT32_MAX) == 1 );
+    CU_ASSERT( total(1) == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Timer Wheel", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Test of fresh structure", testNEW)) ||
+            (NULL == CU_add_test(pSuite, "One-shot timers", testOneShot)) ||
+            (NULL == CU_add_test(pSuite, "Beyond the wheel", testBeyondWheel)) ||
+            (NULL == CU_add_test(pSuite, "Periodic timers", testPeriodic)) ||
+            (NULL == CU_add_test(pSuite, "Stop", testStop)) ||
+            (NULL == CU_add_test(pSuite, "Stop from callback", testStopFromCallback)) ||
+            (NULL == CU_add_test(pSuite, "Random load", testRandomLoad)) ||
+            (NULL == CU_add_test(pSuite, "Next deadline", testNextDeadline)) ||
+            (NULL == CU_add_test(pSuite, "Long gap", testLongGap)) ||
+            (NULL == CU_add_test(pSuite, "Huge delay", testHugeDelay))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,309 @@
+/**
+@file timerwheel.c
+@brief Software timers on a hierarchical timing wheel.
+\copyright Copyright(C) 2016 Robert Sexton
+@details
+SysTickMSUpdate64 just counts.   This turns the count into timeouts
+without every subsystem scanning its own list.
+
+Basic Model - the classic Unix timer wheel
+- TW_LEVELS wheels of TW_SLOTS slots each.   Level 0 holds timers that
+  are due in the next 32 ticks, one slot per tick.  Level 1 holds the
+  next 1024 ticks, 32 ticks per slot, and so on up.
+- Start and stop are a list insert or unlink.   O(1).
+- Each tick, the slot that is due on level 0 is taken off in one
+  piece and run.   Every 32 ticks a level 1 slot gets redistributed
+  (cascaded) down to level 0, and so on up.
+- Each level keeps a bitmap of non-empty slots so that idle slots
+  cost nothing and the next deadline can be found with a CLZ.
+
+Driving it:
+@code
+    timerwheel_advance(&wheel, getSysTickMS32());
+@endcode
+from the main loop or a low priority handler.  Callbacks run from
+whatever calls timerwheel_advance(), never from the SysTick ISR itself.
+
+Timers further out than the top level get parked in the last slot
+and re-filed each time the top level comes around.
+
+Not thread safe.   Start, stop and advance must all happen at the same
+priority.
+*/
+
+#include <stdint.h>
+
+#include "timerwheel.h"
+
+#define TW_SPAN(level) ( (uint32_t) 1 << ( TW_BITS * (level) ) )
+#define TW_MAXDELTA    ( TW_SPAN(TW_LEVELS) - 1 )
+
+// -----------------------------------------------------------
+// List Handling
+// -----------------------------------------------------------
+static void link_init(SWLINK *head) {
+    head->next = head;
+    head->prev = head;
+    }
+
+static int link_empty(SWLINK *head) {
+    return( head->next == head );
+    }
+
+static void link_append(SWLINK *head, SWLINK *l) {
+    l->prev = head->prev;
+    l->next = head;
+    head->prev->next = l;
+    head->prev = l;
+    }
+
+// Unlink, and return the neighbor.   If the list went empty,
+// the neighbor is the list head.
+static SWLINK *link_remove(SWLINK *l) {
+    SWLINK *neighbor = l->next;
+
+    l->prev->next = l->next;
+    l->next->prev = l->prev;
+    link_init(l);
+    return(neighbor);
+    }
+
+// Move the whole contents of one list onto an empty one.
+static void link_take(SWLINK *to, SWLINK *from) {
+    if ( link_empty(from) ) {
+        link_init(to);
+        return;
+        }
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    link_init(from);
+    }
+
+// -----------------------------------------------------------
+// Wheel Handling
+// -----------------------------------------------------------
+
+/// @brief Initialization call.
+/// @param tw pointer to a timer wheel structure
+/// @param now The current tick count.
+void timerwheel_init(TIMERWHEEL *tw, uint32_t now) {
+    tw->Now = now;
+
+    for ( int level = 0; level < TW_LEVELS; level++ ) {
+        tw->Occupied[level] = 0;
+
+        for ( int slot = 0; slot < TW_SLOTS; slot++ ) link_init(&tw->Slot[level][slot]);
+        }
+    }
+
+/// @brief Set up a timer.
+/// @param t pointer to the timer
+/// @param callback Called on expiry, with the timer.
+/// @param arg Stored in the timer for the callback's use.
+void swtimer_init(SWTIMER *t, void (*callback)(SWTIMER *), void *arg) {
+    link_init(&t->Link);
+    t->Expires = 0;
+    t->Period = 0;
+    t->Callback = callback;
+    t->Arg = arg;
+    }
+
+/// @return non-zero if the timer is waiting to expire.
+/// @param t pointer to the timer
+int swtimer_active(SWTIMER *t) {
+    return( !link_empty(&t->Link) );
+    }
+
+// File a timer in the right slot, based on how far out it is.
+static void timerwheel_file(TIMERWHEEL *tw, SWTIMER *t) {
+    uint32_t expires = t->Expires;
+    uint32_t delta = expires - tw->Now;
+    int level, slot;
+
+    if ( (int32_t) delta < 0 ) { // Overdue.  Next tick.
+        expires = tw->Now;
+        delta = 0;
+        }
+    else if ( delta > TW_MAXDELTA ) { // Park it, try again later.
+        expires = tw->Now + TW_MAXDELTA;
+        delta = TW_MAXDELTA;
+        }
+
+    for ( level = 0; level < TW_LEVELS - 1; level++ ) {
+        if ( delta < TW_SPAN(level + 1) ) break;
+        }
+
+    slot = ( expires >> ( TW_BITS * level ) ) & TW_MASK;
+
+    link_append(&tw->Slot[level][slot], &t->Link);
+    tw->Occupied[level] |= 1u << slot;
+    }
+
+/// @brief Start a timer.   If it is already running, restart it.
+/// @param tw pointer to a timer wheel structure
+/// @param t pointer to the timer
+/// @param delay Ticks from now until the first expiry.   At most INT32_MAX,
+/// and clamped to that - past it, tick arithmetic can't tell late from early.
+/// @param period Ticks between expiries after that, or 0 for a one-shot.
+/// Clamped the same way.
+void timerwheel_start(TIMERWHEEL *tw, SWTIMER *t, uint32_t delay, uint32_t period) {
+    if ( swtimer_active(t) ) timerwheel_stop(tw, t);
+
+    if ( delay > INT32_MAX ) delay = INT32_MAX;
+    if ( period > INT32_MAX ) period = INT32_MAX;
+
+    t->Expires = tw->Now + delay;
+    t->Period = period;
+    timerwheel_file(tw, t);
+    }
+
+/// @brief Stop a timer.   Harmless if it isn't running.
+/// @param tw pointer to a timer wheel structure
+/// @param t pointer to the timer
+void timerwheel_stop(TIMERWHEEL *tw, SWTIMER *t) {
+    SWLINK *neighbor;
+
+    if ( !swtimer_active(t) ) return;
+
+    neighbor = link_remove(&t->Link);
+
+    // If that emptied a wheel slot, the neighbor is the slot itself.
+    // It may also be a batch that is being run, which isn't ours.
+    if ( link_empty(neighbor) &&
+            neighbor >= &tw->Slot[0][0] &&
+            neighbor <= &tw->Slot[TW_LEVELS - 1][TW_MASK] ) {
+        int index = neighbor - &tw->Slot[0][0];
+        tw->Occupied[index >> TW_BITS] &= ~( 1u << ( index & TW_MASK ) );
+        }
+    }
+
+// Take a slot off the wheel and re-file everything in it.
+static void timerwheel_cascade(TIMERWHEEL *tw, int level, int slot) {
+    SWLINK batch;
+
+    link_take(&batch, &tw->Slot[level][slot]);
+    tw->Occupied[level] &= ~( 1u << slot );
+
+    while ( !link_empty(&batch) ) {
+        SWTIMER *t = (SWTIMER *) batch.next;
+        link_remove(&t->Link);
+        timerwheel_file(tw, t);
+        }
+    }
+
+// Process one tick.
+static int timerwheel_tick(TIMERWHEEL *tw) {
+    uint32_t now = tw->Now;
+    int slot = now & TW_MASK;
+    int expired = 0;
+    SWLINK batch;
+
+    // Every time a level wraps, pull down the next slot from above.
+    for ( int level = 1; level < TW_LEVELS; level++ ) {
+        if ( ( now >> ( TW_BITS * ( level - 1 ) ) ) & TW_MASK ) break;
+
+        timerwheel_cascade(tw, level, ( now >> ( TW_BITS * level ) ) & TW_MASK);
+        }
+
+    // Detach the batch before running anything, and move the
+    // clock, so that callbacks that start timers put them in the future.
+    link_take(&batch, &tw->Slot[0][slot]);
+    tw->Occupied[0] &= ~( 1u << slot );
+    tw->Now = now + 1;
+
+    while ( !link_empty(&batch) ) {
+        SWTIMER *t = (SWTIMER *) batch.next;
+        link_remove(&t->Link);
+
+        if ( t->Period ) {
+            t->Expires += t->Period;
+            timerwheel_file(tw, t);
+            }
+
+        expired++;
+        t->Callback(t);
+        }
+
+    return(expired);
+    }
+
+// Find the first occupied slot at or after 'from', with wrap.
+// Return the distance in slots, or -1 if there are none.
+static int next_occupied(uint32_t bitmap, int from) {
+    uint32_t rotated;
+
+    if ( bitmap == 0 ) return(-1);
+
+    rotated = from ? ( bitmap >> from ) | ( bitmap << ( TW_SLOTS - from ) ) : bitmap;
+    return( __builtin_ctz(rotated) );
+    }
+
+/// @brief Run everything that is due, up to and including now.
+/// Ticks with nothing due and nothing to cascade are skipped, so
+/// catching up after a long sleep costs one pass per deadline,
+/// not one per tick.
+/// @return the number of timers that expired.
+/// @param tw pointer to a timer wheel structure
+/// @param now The current tick count.
+int timerwheel_advance(TIMERWHEEL *tw, uint32_t now) {
+    int expired = 0;
+    uint32_t when;
+
+    while ( (int32_t) ( now - tw->Now ) >= 0 ) {
+        if ( !timerwheel_next_deadline(tw, &when) ||
+                (int32_t) ( now - when ) < 0 ) { // Nothing more to do.   Catch up.
+            tw->Now = now + 1;
+            break;
+            }
+
+        tw->Now = when;
+        expired += timerwheel_tick(tw);
+        }
+
+    return(expired);
+    }
+
+/// @brief When does the wheel next need attention?
+/// For tickless idle.   If the answer comes from one of the upper
+/// levels, its the time of the cascade, which is no later than the
+/// first expiry.   Sleep until then, advance, and ask again.
+/// @return 0 if there are no timers, 1 if *when is valid.
+/// @param tw pointer to a timer wheel structure
+/// @param *when returns the tick of the next deadline
+int timerwheel_next_deadline(TIMERWHEEL *tw, uint32_t *when) {
+    uint32_t best = 0, dist;
+    int found = 0;
+    int k;
+
+    // Level 0 has one slot per tick, so this one is exact.
+    k = next_occupied(tw->Occupied[0], tw->Now & TW_MASK);
+
+    if ( k >= 0 ) {
+        best = k;
+        found = 1;
+        }
+
+    // The upper levels get looked at on multiples of their span.
+    for ( int level = 1; level < TW_LEVELS; level++ ) {
+        uint32_t span = TW_SPAN(level);
+        uint32_t start = ( tw->Now + span - 1 ) & ~( span - 1 );
+
+        k = next_occupied(tw->Occupied[level], ( start >> ( TW_BITS * level ) ) & TW_MASK);
+
+        if ( k < 0 ) continue;
+
+        dist = start - tw->Now + k * span;
+
+        if ( !found || dist < best ) {
+            best = dist;
+            found = 1;
+            }
+        }
+
+    if ( found ) *when = tw->Now + best;
+
+    return(found);
+    }
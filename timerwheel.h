@@ -0,0 +1,45 @@
+//
+// Software timers on a hierarchical timing wheel.
+// Copyright(C) 2016 Robert Sexton
+//
+
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+#include <stdint.h>
+
+#define TW_BITS   5  // 32 slots per level.  One bitmap word.
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 5  // 2^25 ticks - 9 hours of ms ticks.
+
+typedef struct swlink {
+    struct swlink *next;
+    struct swlink *prev;
+    } SWLINK;
+
+typedef struct swtimer {
+    SWLINK Link;     // Must be first.
+    uint32_t Expires;  // Absolute tick.
+    uint32_t Period;   // Zero for one-shot.
+    void (*Callback)(struct swtimer *);
+    void *Arg;
+    } SWTIMER;
+
+typedef struct {
+    uint32_t Now;                       // Next tick to be processed.
+    uint32_t Occupied[TW_LEVELS];       // One bit per non-empty slot.
+    SWLINK   Slot[TW_LEVELS][TW_SLOTS];
+    } TIMERWHEEL;
+
+void timerwheel_init(TIMERWHEEL*, uint32_t now);
+void swtimer_init(SWTIMER*, void (*callback)(SWTIMER *), void *arg);
+int  swtimer_active(SWTIMER*);
+
+void timerwheel_start(TIMERWHEEL*, SWTIMER*, uint32_t delay, uint32_t period);
+void timerwheel_stop(TIMERWHEEL*, SWTIMER*);
+
+int  timerwheel_advance(TIMERWHEEL*, uint32_t now);
+int  timerwheel_next_deadline(TIMERWHEEL*, uint32_t *when);
+
+#endif
@@ -0,0 +1,209 @@
+// CUnit tests for the sub-millisecond timestamps.
+//
+// The hardware is simulated.   Every register read advances a
+// simulated cycle clock, and the simulated SysTick ISR gets a chance
+// to run before each read, just as the real one could sneak in between
+// instructions.   That puts rollovers at every possible point in the
+// read sequence.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "timestamp.h"
+
+#include "CUnit/Basic.h"
+
+#define RELOAD   4999    // 5000 cycles per tick.
+#define CPUHZ    5000000 // so 1ms ticks.
+
+uint64_t sim_cycles;    // The truth.
+uint64_t sim_ticks;     // Ticks the ISR has serviced.
+uint64_t sim_ms;        // Stands in for SysTickMSVal64
+uint32_t sim_step;      // Cycles per register read.
+int      sim_irq_enabled;
+uint32_t sim_cyccnt_offset;
+
+// --------------------------------------------------
+// Simulated hardware
+// --------------------------------------------------
+
+static void sim_isr() {
+    while ( sim_ticks < sim_cycles / (RELOAD + 1) ) {
+        sim_ticks++;
+        sim_ms += 1;
+        }
+    }
+
+static void sim_advance() {
+    sim_cycles += sim_step;
+
+    if ( sim_irq_enabled ) sim_isr();
+    }
+
+static uint32_t sim_systick_val() {
+    sim_advance();
+    return( RELOAD - (uint32_t) ( sim_cycles % (RELOAD + 1) ) );
+    }
+
+static uint32_t sim_tick_pending() {
+    sim_advance();
+    return( sim_ticks < sim_cycles / (RELOAD + 1) );
+    }
+
+static uint32_t sim_cyccnt() {
+    sim_advance();
+    return( (uint32_t) sim_cycles + sim_cyccnt_offset );
+    }
+
+static void sim_reset(uint32_t step, int irq) {
+    sim_cycles = 0;
+    sim_ticks = 0;
+    sim_ms = 0;
+    sim_step = step;
+    sim_irq_enabled = irq;
+    }
+
+const TIMESTAMP_HW simhw = {
+    sim_systick_val, sim_tick_pending, sim_cyccnt,
+    &sim_ms, RELOAD, 1, CPUHZ
+    };
+
+// Read the timestamp many times and check that it is always inside
+// the window of simulated time that the read took, and never goes
+// backwards.
+static void check_cycles(int reads, int service_after_read) {
+    uint64_t last = 0;
+    int bad = 0, backwards = 0;
+
+    for ( int i = 0; i < reads; i++ ) {
+        uint64_t before = sim_cycles;
+        uint64_t ts = timestamp_cycles();
+        uint64_t after = sim_cycles;
+
+        if ( ts < before || ts > after ) bad++;
+
+        if ( ts < last ) backwards++;
+
+        last = ts;
+
+        if ( service_after_read ) sim_isr();
+        }
+
+    CU_ASSERT( bad == 0 );
+    CU_ASSERT( backwards == 0 );
+
+    if ( bad || backwards ) printf("\n  bad=%d backwards=%d ", bad, backwards);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    timestamp_init(&simhw);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+// ISR enabled.  Try a range of read speeds so that the ISR
+// lands between every pair of reads.
+void testRolloverIrq(void) {
+    for ( uint32_t step = 1; step < 40; step += 3 ) {
+        sim_reset(step, 1);
+        check_cycles(20000, 0);
+        }
+    }
+
+// Caller is blocking the SysTick ISR, which runs once we're done.
+// The pending bit has to cover for the missing tick.
+void testRolloverMasked(void) {
+    for ( uint32_t step = 1; step < 40; step += 3 ) {
+        sim_reset(step, 0);
+        check_cycles(20000, 1);
+        }
+    }
+
+void testNanoseconds(void) {
+    sim_reset(1, 1);
+    sim_cycles = 12345 * (uint64_t) (RELOAD + 1) + 2500 - 1;
+    sim_ticks = 12345;
+    sim_ms = 12345;
+
+    // The counter read itself takes a cycle.   2500 cycles into the
+    // ms is 500us.
+    uint64_t ns = timestamp_ns();
+    CU_ASSERT( ns == 12345 * (uint64_t) 1000000 + 500000 );
+    }
+
+// Jump the clock across several CYCCNT wraps, with an update
+// somewhere in each 2^32 cycles.
+void testCyccnt64(void) {
+    sim_reset(1, 0);
+    sim_cyccnt_offset = 0xFFFFF000; // Wrap early.
+    timestamp_init(&simhw);
+
+    uint64_t start = sim_cycles;
+    uint64_t last = 0;
+    int bad = 0;
+
+    for ( int i = 0; i < 64; i++ ) {
+        sim_cycles += 0x3FFFFFFF; // Just under a quarter wrap.
+
+        if ( i & 1 ) timestamp_cyccnt_update();
+
+        uint64_t before = sim_cycles - start;
+        uint64_t ts = timestamp_cyccnt64();
+        uint64_t after = sim_cycles - start;
+
+        // The value at init counts as the base.
+        ts -= 0xFFFFF000 + 1;
+
+        if ( ts < before || ts > after || ts < last ) bad++;
+
+        last = ts;
+        }
+
+    CU_ASSERT( bad == 0 );
+    CU_ASSERT( last > ( (uint64_t) 1 << 32 ) * 15 );
+    timestamp_init(&simhw);
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Timestamp", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Rollover, ISR enabled", testRolloverIrq)) ||
+            (NULL == CU_add_test(pSuite, "Rollover, ISR blocked", testRolloverMasked)) ||
+            (NULL == CU_add_test(pSuite, "Nanoseconds", testNanoseconds)) ||
+            (NULL == CU_add_test(pSuite, "64-bit CYCCNT", testCyccnt64))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,177 @@
+/// @file timestamp.c
+/// @brief Sub-millisecond 64-bit timestamps.
+/// @details
+/// getSysTickMS64() only resolves to the tick.  There are two ways to
+/// do better:
+/// - Merge the tick count with the live SysTick down-counter.  Works on
+///   every Cortex-M, resolution is one CPU cycle.
+/// - Extend DWT->CYCCNT to 64 bits.  Cheaper to read, but needs
+///   the DWT, and needs an update at least once per 2^32 cycles.
+///
+/// Both have the same problem as get64BitCounter - the parts can change
+/// while we are reading them.   The fix is the same too.   Read the slow
+/// part, read the fast part, read the slow part again and retry if it
+/// moved.
+///
+/// The SysTick flavor has one more wrinkle.   If the caller is running
+/// with the SysTick interrupt blocked (higher priority ISR, or masked)
+/// the counter can wrap without the ms count moving.   ICSR.PENDSTSET
+/// tells us when that has happened.
+
+#include <stdint.h>
+
+#include "timestamp.h"
+
+static TIMESTAMP_HW hw;
+
+static uint32_t cycles_per_ms;
+static uint64_t ns_per_cycle; // 32.32 Fixed point.
+
+// The 64-bit CYCCNT state.  Only updated with interrupts off, so
+// higher priority readers never see half of an update.
+static uint32_t cyccnt_base[2];
+
+#if defined(__arm__)
+#define IRQ_SAVE(x)    __asm__ __volatile__ ( "mrs %0, primask\n\tcpsid i" : "=r" (x) : : "memory" )
+#define IRQ_RESTORE(x) __asm__ __volatile__ ( "msr primask, %0" : : "r" (x) : "memory" )
+#else
+#define IRQ_SAVE(x)    ( (x) = 0 )
+#define IRQ_RESTORE(x) ( (void) (x) )
+#endif
+
+/// @brief Supply the hardware and set up the conversion factors.
+/// @param h description of the hardware.   Gets copied.
+void timestamp_init(const TIMESTAMP_HW *h) {
+    hw = *h;
+    cycles_per_ms = (hw.Reload + 1) / hw.TickMS;
+    ns_per_cycle = ( (uint64_t) 1000000000 << 32 ) / hw.CPUHz;
+    cyccnt_base[0] = hw.CycleCount ? hw.CycleCount() : 0;
+    cyccnt_base[1] = 0;
+    }
+
+/// @brief Read the ms count and the SysTick counter together.
+/// @param *sub returns cycles elapsed since the ms count last moved.
+/// @return the millisecond count
+static uint64_t timestamp_read(uint32_t *sub) {
+    volatile uint32_t *ms = (uint32_t *) hw.MSCounter;
+    uint32_t lo, hi, val, pending;
+
+    do {
+        hi = ms[1];
+        lo = ms[0];
+
+        // Read the counter on either side of the pending check.   If
+        // the tick was pending, the second read is after the wrap.
+        val = hw.SysTickVal();
+        pending = hw.TickPending();
+
+        if ( pending ) val = hw.SysTickVal();
+        }
+    while ( lo != ms[0] || hi != ms[1] ); // If the ISR snuck in there, try again.
+
+    *sub = hw.Reload - val;
+
+    if ( pending ) *sub += hw.Reload + 1;
+
+    return( ( (uint64_t) hi << 32 ) | lo );
+    }
+
+/// @brief Cycles since the systick started.
+/// @return 64-Bit result
+uint64_t timestamp_cycles() {
+    uint32_t sub;
+    uint64_t ms = timestamp_read(&sub);
+
+    return( ms * cycles_per_ms + sub );
+    }
+
+/// @brief Nanoseconds since the systick started.
+/// @return 64-Bit result
+uint64_t timestamp_ns() {
+    uint32_t sub;
+    uint64_t ms = timestamp_read(&sub);
+
+    return( ms * 1000000 + ( ( sub * ns_per_cycle ) >> 32 ) );
+    }
+
+/// @brief Keep the 64-bit CYCCNT current.
+/// Call from the SysTick handler, or anything else that runs at least
+/// once per 2^32 cycles.
+void timestamp_cyccnt_update() {
+    uint32_t now = hw.CycleCount();
+    uint32_t primask;
+
+    IRQ_SAVE(primask);
+
+    if ( now < cyccnt_base[0] ) cyccnt_base[1]++;
+
+    cyccnt_base[0] = now;
+    IRQ_RESTORE(primask);
+    }
+
+/// @brief DWT->CYCCNT, extended to 64 bits.
+/// @return 64-Bit result
+uint64_t timestamp_cyccnt64() {
+    volatile uint32_t *base = cyccnt_base;
+    uint32_t lo, hi, now;
+
+    do {
+        hi = base[1];
+        lo = base[0];
+        now = hw.CycleCount();
+        }
+    while ( lo != base[0] || hi != base[1] );
+
+    // Less than 2^32 cycles since the update, so the difference is right
+    // even if CYCCNT has wrapped since.
+    return( ( ( (uint64_t) hi << 32 ) | lo ) + (uint32_t) ( now - lo ) );
+    }
+
+// ------------------------------------------------------------------
+// The real hardware.
+// ------------------------------------------------------------------
+#if defined(__arm__)
+
+#define VWRAP(addr) (*((volatile uint32_t *)(addr)))
+
+#define SYST_RVR    0xE000E014
+#define SYST_CVR    0xE000E018
+#define SCB_ICSR    0xE000ED04
+#define ICSR_PENDSTSET (1 << 26)
+#define DEMCR       0xE000EDFC
+#define DEMCR_TRCENA (1 << 24)
+#define DWT_CTRL    0xE0001000
+#define DWT_CYCCNT  0xE0001004
+
+extern uint64_t SysTickMSVal64;
+
+static uint32_t cm3_systick_val() {
+    return( VWRAP(SYST_CVR) );
+    }
+
+static uint32_t cm3_tick_pending() {
+    return( VWRAP(SCB_ICSR) & ICSR_PENDSTSET );
+    }
+
+static uint32_t cm3_cyccnt() {
+    return( VWRAP(DWT_CYCCNT) );
+    }
+
+/// @brief Set up for the real hardware.   SysTick must already be running.
+/// @param cpuhz Core clock frequency
+/// @param tickms How many milliseconds the SysTick handler adds per tick.
+void timestamp_init_cm3(uint32_t cpuhz, uint32_t tickms) {
+    TIMESTAMP_HW cm3 = {
+        cm3_systick_val, cm3_tick_pending, cm3_cyccnt,
+        &SysTickMSVal64, 0, tickms, cpuhz
+        };
+
+    cm3.Reload = VWRAP(SYST_RVR) & 0x00FFFFFF;
+
+    // Turn on the cycle counter.
+    VWRAP(DEMCR) |= DEMCR_TRCENA;
+    VWRAP(DWT_CTRL) |= 1;
+
+    timestamp_init(&cm3);
+    }
+#endif
@@ -0,0 +1,37 @@
+//
+// Sub-millisecond timestamps built on the 64-bit systick.
+// Copyright(C) 2016 Robert Sexton
+//
+
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+#include <stdint.h>
+
+/// The hardware the timestamps are built from.   The target version
+/// reads the real registers, the host tests supply simulations.
+typedef struct {
+    uint32_t (*SysTickVal)(void);  // SYST_CVR - Counts down from Reload.
+    uint32_t (*TickPending)(void); // Non-zero if ICSR.PENDSTSET is set.
+    uint32_t (*CycleCount)(void);  // DWT_CYCCNT
+    uint64_t *MSCounter;           // Normally &SysTickMSVal64
+    uint32_t Reload;               // SYST_RVR - Cycles per tick, minus one.
+    uint32_t TickMS;               // Milliseconds per SysTick interrupt.
+    uint32_t CPUHz;
+    } TIMESTAMP_HW;
+
+void timestamp_init(const TIMESTAMP_HW*);
+
+// SysTick based.
+uint64_t timestamp_cycles();
+uint64_t timestamp_ns();
+
+// DWT->CYCCNT extended to 64 bits.
+void timestamp_cyccnt_update(); // At least once per 2^32 cycles.
+uint64_t timestamp_cyccnt64();
+
+#if defined(__arm__)
+void timestamp_init_cm3(uint32_t cpuhz, uint32_t tickms);
+#endif
+
+#endif
@@ -0,0 +1,300 @@
+// CUnit tests for the trace ring and the host side decoder.
+//
+// The clock is simulated, so that the durations come out exact.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "trace-decode.h"
+
+#include "CUnit/Basic.h"
+
+#define RINGSIZE 64
+
+TRACEREC ringstore[RINGSIZE];
+TRACEREC bigstore[4096];
+TRACEREC out[4096];
+
+uint32_t sim_now;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static uint32_t sim_clock(void) {
+    return(sim_now);
+    }
+
+// Each thread gets its own clock, so that its records can be
+// checked for order.
+static __thread uint32_t thread_now;
+
+static uint32_t thread_clock(void) {
+    return(++thread_now);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    trace_clock = sim_clock;
+    trace_init(&trace_ring, ringstore, RINGSIZE);
+    return(0);
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testNEW(void) {
+    CU_ASSERT( trace_ring.iWrite == 0 );
+    CU_ASSERT( trace_ring.iRead == 0 );
+    CU_ASSERT( trace_drain(&trace_ring, out, 10) == 0 );
+    }
+
+// A probe with another one and an ISR inside it.
+void testNested(void) {
+    TRACEDECODE *td = trace_decode_new();
+    PROBESTATS *s;
+    int n;
+
+    sim_now = 1000;
+    PROBE_BEGIN(1);
+    sim_now = 1100;
+    PROBE_BEGIN(2);
+    sim_now = 1150;
+    TRACE_ISR_ENTER(15);
+    sim_now = 1160;
+    TRACE_ISR_EXIT(15);
+    sim_now = 1300;
+    PROBE_END(2);
+    sim_now = 2000;
+    PROBE_END(1);
+    PROBE_MARK(7);
+
+    n = trace_drain(&trace_ring, out, 4096);
+    CU_ASSERT( n == 7 );
+    CU_ASSERT( out[0].Kind == TRACE_REC_BEGIN && out[0].Id == 1 && out[0].Stamp == 1000 );
+    CU_ASSERT( out[6].Kind == TRACE_REC_MARK && out[6].Id == 7 );
+
+    trace_decode_feed(td, out, n);
+
+    s = trace_decode_stats(td, 0, 1);
+    CU_ASSERT( s && s->Count == 1 && s->Max == 1000 );
+    s = trace_decode_stats(td, 0, 2);
+    CU_ASSERT( s && s->Count == 1 && s->Max == 200 );
+    s = trace_decode_stats(td, 1, 15);
+    CU_ASSERT( s && s->Count == 1 && s->Max == 10 && s->Log2[4] == 1 );
+    CU_ASSERT( trace_decode_stats(td, 0, 7) == NULL );
+    CU_ASSERT( td->Unmatched == 0 );
+
+    trace_decode_free(td);
+    }
+
+static void scoped(void) {
+    PROBE_SCOPE(3);
+    sim_now += 42;
+    }
+
+// IDs that are expressions, nested in one function.
+#define SCOPE_BASE 8
+
+static void scoped_expr(void) {
+    PROBE_SCOPE(SCOPE_BASE + 1);
+    sim_now += 5;
+    {
+        PROBE_SCOPE((SCOPE_BASE + 2));
+        sim_now += 7;
+        }
+    }
+
+void testScope(void) {
+    TRACEDECODE *td = trace_decode_new();
+    PROBESTATS *s;
+
+    for ( int i = 0; i < 10; i++ ) scoped();
+
+    trace_decode_feed(td, out, trace_drain(&trace_ring, out, 4096));
+    s = trace_decode_stats(td, 0, 3);
+    CU_ASSERT( s && s->Count == 10 && s->Min == 42 && s->Max == 42 );
+
+    scoped_expr();
+    trace_decode_feed(td, out, trace_drain(&trace_ring, out, 4096));
+    s = trace_decode_stats(td, 0, SCOPE_BASE + 1);
+    CU_ASSERT( s && s->Count == 1 && s->Max == 12 );
+    s = trace_decode_stats(td, 0, SCOPE_BASE + 2);
+    CU_ASSERT( s && s->Count == 1 && s->Max == 7 );
+    CU_ASSERT( td->Unmatched == 0 );
+    trace_decode_free(td);
+    }
+
+// A full ring drops, and recovers once drained.
+void testFull(void) {
+    for ( int i = 0; i < RINGSIZE + 5; i++ ) PROBE_MARK(i);
+
+    CU_ASSERT( trace_ring.Dropped == 5 );
+    CU_ASSERT( trace_drain(&trace_ring, out, 4096) == RINGSIZE );
+    CU_ASSERT( out[RINGSIZE - 1].Id == RINGSIZE - 1 );
+
+    PROBE_MARK(99);
+    CU_ASSERT( trace_drain(&trace_ring, out, 4096) == 1 );
+    trace_ring.Dropped = 0;
+    }
+
+// Half written records stay in the ring.
+void testIncomplete(void) {
+    PROBE_MARK(1);
+    PROBE_MARK(2);
+    trace_ring.Buf[( trace_ring.iRead + 1 ) & trace_ring.BufMask].Kind = TRACE_REC_EMPTY;
+
+    CU_ASSERT( trace_drain(&trace_ring, out, 4096) == 1 );
+    trace_ring.Buf[trace_ring.iRead & trace_ring.BufMask].Kind = TRACE_REC_MARK;
+    CU_ASSERT( trace_drain(&trace_ring, out, 4096) == 1 );
+    CU_ASSERT( out[0].Id == 2 );
+    }
+
+void testChrome(void) {
+    char *json = NULL;
+    size_t len;
+    FILE *f = open_memstream(&json, &len);
+    int n;
+
+    sim_now = 0xFFFFFF00; // Wrap the stamps.
+    PROBE_BEGIN(4);
+    sim_now = 0x00000100;
+    PROBE_END(4);
+    n = trace_drain(&trace_ring, out, 4096);
+
+    trace_chrome_json(out, n, 1000000, f);
+    fclose(f);
+
+    CU_ASSERT( strstr(json, "{\"traceEvents\":[") == json );
+    CU_ASSERT( strstr(json, "\"name\":\"probe 4\",\"cat\":\"probe\",\"ph\":\"B\",\"ts\":0.000") != NULL );
+    CU_ASSERT( strstr(json, "\"ph\":\"E\",\"ts\":512.000") != NULL );
+    free(json);
+    }
+
+// A partly published ring leaves gaps, which must not upset the
+// commas between events.
+void testChromeGaps(void) {
+    TRACEREC recs[3] = {
+        { .Stamp = 10, .Id = 1, .Kind = TRACE_REC_EMPTY },
+        { .Stamp = 20, .Id = 2, .Kind = TRACE_REC_MARK },
+        { .Stamp = 30, .Id = 3, .Kind = TRACE_REC_MARK }
+        };
+    char *json = NULL;
+    size_t len;
+    FILE *f = open_memstream(&json, &len);
+
+    trace_chrome_json(recs, 3, 1000000, f);
+    fclose(f);
+
+    CU_ASSERT( strstr(json, "{\"traceEvents\":[\n{\"name\":\"probe 2\"") == json );
+    CU_ASSERT( strstr(json, "\"ts\":0.000") != NULL );
+    CU_ASSERT( strstr(json, "},\n{\"name\":\"probe 3\"") != NULL );
+    CU_ASSERT( strstr(json, "\"ts\":10.000") != NULL );
+    CU_ASSERT( strstr(json, "probe 1") == NULL );
+    free(json);
+
+    recs[1].Kind = TRACE_REC_EMPTY;
+    recs[2].Kind = TRACE_REC_EMPTY;
+    f = open_memstream(&json, &len);
+    trace_chrome_json(recs, 3, 1000000, f);
+    fclose(f);
+    CU_ASSERT( strcmp(json, "{\"traceEvents\":[\n\n]}\n") == 0 );
+    free(json);
+    }
+
+// Several writers at once, and a reader draining as they go.
+#define WRITERS 3
+#define PERWRITER 200000
+
+static void *writer(void *arg) {
+    uint16_t id = (uintptr_t) arg;
+
+    for ( int i = 0; i < PERWRITER; i++ ) {
+        PROBE_MARK(id);
+
+        for ( volatile int spin = 0; spin < 100; spin++ ) { ; } // Give the reader a chance.
+        }
+
+    return(NULL);
+    }
+
+void testThreads(void) {
+    pthread_t w[WRITERS];
+    uint32_t last[WRITERS] = { 0 };
+    long got = 0, disorder = 0;
+
+    trace_clock = thread_clock;
+    trace_init(&trace_ring, bigstore, 4096);
+
+    for ( uintptr_t i = 0; i < WRITERS; i++ ) pthread_create(&w[i], NULL, writer, (void *) i);
+
+    while ( 1 ) {
+        int done = ( trace_ring.iWrite + trace_ring.Dropped ) == WRITERS * PERWRITER;
+        int n = trace_drain(&trace_ring, out, 4096);
+
+        for ( int i = 0; i < n; i++ ) {
+            if ( out[i].Stamp <= last[out[i].Id] ) disorder++;
+
+            last[out[i].Id] = out[i].Stamp;
+            }
+
+        got += n;
+
+        if ( done && n == 0 ) break;
+        }
+
+    for ( int i = 0; i < WRITERS; i++ ) pthread_join(w[i], NULL);
+
+    printf("\n  %ld drained, %u dropped ", got, trace_ring.Dropped);
+    CU_ASSERT( got + trace_ring.Dropped == WRITERS * PERWRITER );
+    CU_ASSERT( disorder == 0 );
+    trace_clock = sim_clock;
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Trace", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Test of fresh structure", testNEW)) ||
+            (NULL == CU_add_test(pSuite, "Nested probes", testNested)) ||
+            (NULL == CU_add_test(pSuite, "Scoped probes", testScope)) ||
+            (NULL == CU_add_test(pSuite, "Full ring", testFull)) ||
+            (NULL == CU_add_test(pSuite, "Incomplete records", testIncomplete)) ||
+            (NULL == CU_add_test(pSuite, "Chrome JSON", testChrome)) ||
+            (NULL == CU_add_test(pSuite, "Chrome JSON with gaps", testChromeGaps)) ||
+            (NULL == CU_add_test(pSuite, "Concurrent writers", testThreads))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,241 @@
+/// @file trace-decode.c
+/// @brief Host side decoder for trace ring records.
+/// @details
+/// Reads the raw 8-byte records that trace_drain() produces, and turns
+/// them into
+/// - Per-probe latency statistics and log2 histograms, in cycles.
+/// - A Chrome trace (chrome://tracing or Perfetto) JSON file.
+///
+/// Usage: trace-decode [-f cpuhz] [-j out.json] tracefile
+///
+/// Build with -DNO_MAIN to link the decoder into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "trace-decode.h"
+
+/// @brief Make a new, empty decoder.
+TRACEDECODE *trace_decode_new(void) {
+    return( calloc(1, sizeof(TRACEDECODE)) );
+    }
+
+void trace_decode_free(TRACEDECODE *td) {
+    for ( int isr = 0; isr < 2; isr++ ) {
+        for ( int id = 0; id < 65536; id++ ) free(td->Probe[isr][id]);
+        }
+
+    free(td);
+    }
+
+static PROBE *trace_decode_probe(TRACEDECODE *td, int isr, uint16_t id) {
+    PROBE **p = &td->Probe[isr][id];
+
+    if ( *p == NULL ) {
+        *p = calloc(1, sizeof(PROBE));
+        (*p)->Stats.Min = UINT32_MAX;
+        }
+
+    return(*p);
+    }
+
+static void probe_begin(TRACEDECODE *td, PROBE *p, uint32_t stamp) {
+    if ( p->Depth >= TRACE_NEST ) {
+        td->Unmatched++;
+        return;
+        }
+
+    p->Open[p->Depth++] = stamp;
+    }
+
+static void probe_end(TRACEDECODE *td, PROBE *p, uint32_t stamp) {
+    PROBESTATS *s = &p->Stats;
+    uint32_t cycles;
+    int bucket;
+
+    if ( p->Depth == 0 ) {
+        td->Unmatched++;
+        return;
+        }
+
+    cycles = stamp - p->Open[--p->Depth]; // Wrap is fine.
+
+    s->Count++;
+    s->Total += cycles;
+
+    if ( cycles < s->Min ) s->Min = cycles;
+
+    if ( cycles > s->Max ) s->Max = cycles;
+
+    bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+    s->Log2[bucket]++;
+    }
+
+/// @brief Add records to the statistics.
+/// Can be called repeatedly as the trace streams in.
+/// @param td decoder
+/// @param recs records, in ring order
+/// @param n how many
+void trace_decode_feed(TRACEDECODE *td, const TRACEREC *recs, int n) {
+    for ( int i = 0; i < n; i++ ) {
+        const TRACEREC *r = &recs[i];
+
+        td->Records++;
+
+        switch ( r->Kind ) {
+            case TRACE_REC_BEGIN:
+                probe_begin(td, trace_decode_probe(td, 0, r->Id), r->Stamp);
+                break;
+
+            case TRACE_REC_END:
+                probe_end(td, trace_decode_probe(td, 0, r->Id), r->Stamp);
+                break;
+
+            case TRACE_REC_ISR_ENTER:
+                probe_begin(td, trace_decode_probe(td, 1, r->Id), r->Stamp);
+                break;
+
+            case TRACE_REC_ISR_EXIT:
+                probe_end(td, trace_decode_probe(td, 1, r->Id), r->Stamp);
+                break;
+
+            default: // Marks carry no duration.
+                break;
+            }
+        }
+    }
+
+/// @return the statistics for a probe, or NULL if it never completed.
+/// @param td decoder
+/// @param isr 1 for ISR enter/exit, 0 for probes.
+/// @param id probe ID or exception number
+PROBESTATS *trace_decode_stats(TRACEDECODE *td, int isr, uint16_t id) {
+    PROBE *p = td->Probe[isr ? 1 : 0][id];
+
+    if ( p == NULL || p->Stats.Count == 0 ) return(NULL);
+
+    return(&p->Stats);
+    }
+
+/// @brief Print a table of everything that was seen, with histograms.
+void trace_decode_report(TRACEDECODE *td, FILE *out) {
+    fprintf(out, "%-10s %8s %10s %10s %10s\n", "probe", "count", "min", "mean", "max");
+
+    for ( int isr = 0; isr < 2; isr++ ) {
+        for ( int id = 0; id < 65536; id++ ) {
+            PROBESTATS *s = trace_decode_stats(td, isr, id);
+
+            if ( s == NULL ) continue;
+
+            fprintf(out, "%s%-6d %8u %10u %10llu %10u\n", isr ? "isr " : "probe ", id,
+                    s->Count, s->Min, (unsigned long long) ( s->Total / s->Count ), s->Max);
+
+            for ( int b = 0; b < 33; b++ ) {
+                if ( s->Log2[b] == 0 ) continue;
+
+                fprintf(out, "    < %10llu: %u\n", 1ULL << b, s->Log2[b]);
+                }
+            }
+        }
+
+    fprintf(out, "%u records, %u unmatched\n", td->Records, td->Unmatched);
+    }
+
+/// @brief Write the records out as a Chrome trace.
+/// The 32-bit stamps are stretched into a 64-bit timeline.  Records
+/// from nested writers can be a little out of order, so allow for
+/// steps backwards as well as forwards.
+/// @param recs records, in ring order
+/// @param n how many
+/// @param cpuhz Cycles per second, to convert to microseconds.
+/// @param out where the JSON goes
+void trace_chrome_json(const TRACEREC *recs, int n, uint32_t cpuhz, FILE *out) {
+    static const char *phase[] = { "", "B", "E", "B", "E", "i" };
+    int64_t timeline = 0;
+    uint32_t last = 0;
+    int printed = 0;
+
+    fprintf(out, "{\"traceEvents\":[\n");
+
+    for ( int i = 0; i < n; i++ ) {
+        const TRACEREC *r = &recs[i];
+        int isr = ( r->Kind == TRACE_REC_ISR_ENTER || r->Kind == TRACE_REC_ISR_EXIT );
+
+        if ( r->Kind == TRACE_REC_EMPTY || r->Kind > TRACE_REC_MARK ) continue;
+
+        if ( printed ) timeline += (int32_t) ( r->Stamp - last );
+        last = r->Stamp;
+
+        fprintf(out, "%s{\"name\":\"%s %u\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":0%s}",
+                printed++ ? ",\n" : "", isr ? "isr" : "probe", r->Id, isr ? "isr" : "probe",
+                phase[r->Kind], (double) timeline * 1000000.0 / cpuhz,
+                r->Kind == TRACE_REC_MARK ? ",\"s\":\"t\"" : "");
+        }
+
+    fprintf(out, "\n]}\n");
+    }
+
+#ifndef NO_MAIN
+int main(int argc, char **argv) {
+    uint32_t cpuhz = 50000000;
+    const char *jsonname = NULL;
+    TRACEREC *recs = NULL;
+    int n = 0, opt;
+    size_t got;
+    FILE *in;
+
+    while ( ( opt = getopt(argc, argv, "f:j:") ) != -1 ) {
+        switch ( opt ) {
+            case 'f':
+                cpuhz = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'j':
+                jsonname = optarg;
+                break;
+
+            default:
+                fprintf(stderr, "usage: %s [-f cpuhz] [-j out.json] tracefile\n", argv[0]);
+                return(1);
+            }
+        }
+
+    if ( optind >= argc || ( in = fopen(argv[optind], "rb") ) == NULL ) {
+        fprintf(stderr, "usage: %s [-f cpuhz] [-j out.json] tracefile\n", argv[0]);
+        return(1);
+        }
+
+    do {
+        recs = realloc(recs, ( n + 4096 ) * sizeof(TRACEREC));
+        got = fread(&recs[n], sizeof(TRACEREC), 4096, in);
+        n += got;
+        }
+    while ( got == 4096 );
+
+    fclose(in);
+
+    TRACEDECODE *td = trace_decode_new();
+    trace_decode_feed(td, recs, n);
+    trace_decode_report(td, stdout);
+    trace_decode_free(td);
+
+    if ( jsonname ) {
+        FILE *out = fopen(jsonname, "w");
+
+        if ( out == NULL ) {
+            perror(jsonname);
+            return(1);
+            }
+
+        trace_chrome_json(recs, n, cpuhz, out);
+        fclose(out);
+        }
+
+    free(recs);
+    return(0);
+    }
+#endif
@@ -0,0 +1,43 @@
+//
+// Host side decoding of trace ring records.
+//
+
+#ifndef __TRACE_DECODE_H__
+#define __TRACE_DECODE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+#define TRACE_NEST 16 // How deep one probe can nest inside itself.
+
+typedef struct {
+    uint32_t Count;
+    uint64_t Total;
+    uint32_t Min;
+    uint32_t Max;
+    uint32_t Log2[33]; // Bucket n holds durations of 2^(n-1) up to 2^n - 1
+    } PROBESTATS;
+
+typedef struct {
+    PROBESTATS Stats;
+    uint32_t Open[TRACE_NEST]; // Begin stamps waiting for an end.
+    int Depth;
+    } PROBE;
+
+typedef struct {
+    PROBE *Probe[2][65536]; // [0] for probes, [1] for ISRs.
+    uint32_t Unmatched;     // Ends without a begin, or too deep.
+    uint32_t Records;
+    } TRACEDECODE;
+
+TRACEDECODE *trace_decode_new(void);
+void trace_decode_free(TRACEDECODE*);
+void trace_decode_feed(TRACEDECODE*, const TRACEREC *recs, int n);
+PROBESTATS *trace_decode_stats(TRACEDECODE*, int isr, uint16_t id);
+void trace_decode_report(TRACEDECODE*, FILE *out);
+
+void trace_chrome_json(const TRACEREC *recs, int n, uint32_t cpuhz, FILE *out);
+
+#endif
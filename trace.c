@@ -0,0 +1,115 @@
+/**
+@file trace.c
+@brief Cycle-count profiling probes and the trace ring.
+\copyright Copyright(C) 2016 Robert Sexton
+@details
+A probe is a timestamp, an ID and a kind, stored as an 8-byte
+record.   No formatting, no allocation.   The records get pulled out
+with trace_drain() and shipped off the target as-is.  trace-decode
+on the host turns them into latency histograms and a Chrome trace.
+
+Same model as the ringbuffer - free running indices, power of two
+sizing, drop when full.   The difference is that probes fire from
+nested ISRs, so there can be several writers at once:
+- A writer reserves a slot by bumping iWrite with a compare and swap.
+- The record kind gets written last.  Until then, the reader treats
+  the slot as not there yet.
+- The reader clears the kind once it has the record.
+
+The timestamp is DWT->CYCCNT on the target.   Host builds supply
+trace_clock() so the tests can run on a simulated clock.
+*/
+
+#include <stdint.h>
+
+#include "atomic.h"
+#include "barrier.h"
+#include "trace.h"
+
+#if defined(__arm__)
+#define TRACE_CLOCK() (*((volatile uint32_t *) 0xE0001004)) // DWT_CYCCNT
+#else
+uint32_t (*trace_clock)(void);
+#define TRACE_CLOCK() trace_clock()
+#endif
+
+TRACERING trace_ring;
+
+/// @brief Initialization call.
+/// @param tr pointer to a trace ring structure
+/// @param buf storage for the records
+/// @param size power of two size, in records
+void trace_init(TRACERING* tr, TRACEREC* buf, int size) {
+    tr->iRead = 0;
+    tr->iWrite = 0;
+    tr->Dropped = 0;
+    tr->Buf = buf;
+    tr->BufSize = size;
+    tr->BufMask = size - 1;
+
+    for ( int i = 0; i < size; i++ ) buf[i].Kind = TRACE_REC_EMPTY;
+    }
+
+/// @brief Record a probe.
+/// @param tr pointer to a trace ring structure
+/// @param id probe ID
+/// @param kind TRACE_REC_BEGIN etc.
+void trace_record(TRACERING* tr, uint16_t id, uint16_t kind) {
+    uint32_t stamp = TRACE_CLOCK(); // As early as possible.
+    uint32_t slot;
+    TRACEREC *rec;
+
+    do {
+        slot = tr->iWrite;
+
+        if ( slot - tr->iRead >= tr->BufSize ) { // Back-pressure.
+            atomic_add(&tr->Dropped, 1);
+            return;
+            }
+        }
+    while ( !atomic_cas(&tr->iWrite, slot, slot + 1) );
+
+    rec = &tr->Buf[slot & tr->BufMask];
+    rec->Stamp = stamp;
+    rec->Id = id;
+    MEM_BARRIER();
+    rec->Kind = kind;
+    }
+
+/// @brief Copy completed records out of the ring.
+/// Stops at the first record that a writer hasn't finished.
+/// @return the number of records copied
+/// @param tr pointer to a trace ring structure
+/// @param dst where to put them
+/// @param max how many will fit
+int trace_drain(TRACERING* tr, TRACEREC *dst, int max) {
+    int count = 0;
+
+    while ( count < max && tr->iRead != tr->iWrite ) {
+        TRACEREC *rec = &tr->Buf[tr->iRead & tr->BufMask];
+
+        if ( rec->Kind == TRACE_REC_EMPTY ) break; // Still being written.
+
+        MEM_BARRIER();
+        dst[count++] = *rec;
+        rec->Kind = TRACE_REC_EMPTY;
+        MEM_BARRIER();
+        tr->iRead++;
+        }
+
+    return(count);
+    }
+
+/// @brief For PROBE_SCOPE.  Start the probe, and keep the ID for the end.
+/// @return the id
+/// @param id probe ID
+uint16_t trace_scope_begin(uint16_t id) {
+    trace_record(&trace_ring, id, TRACE_REC_BEGIN);
+    return(id);
+    }
+
+/// @brief For PROBE_SCOPE.  Called when the scope exits.
+/// @param *id pointer to the variable holding the probe ID
+void trace_scope_end(uint16_t *id) {
+    trace_record(&trace_ring, *id, TRACE_REC_END);
+    }
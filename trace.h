@@ -0,0 +1,73 @@
+//
+// Cycle-count profiling probes, recorded into a binary trace ring.
+// Copyright(C) 2016 Robert Sexton
+//
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+// Record kinds.   Zero is reserved to mark a slot that is not yet written.
+#define TRACE_REC_EMPTY     0
+#define TRACE_REC_BEGIN     1
+#define TRACE_REC_END       2
+#define TRACE_REC_ISR_ENTER 3
+#define TRACE_REC_ISR_EXIT  4
+#define TRACE_REC_MARK      5
+
+/// 8 bytes per record.   This is also the upload format.
+typedef struct {
+    uint32_t Stamp;  // Cycle count.
+    uint16_t Id;     // Probe ID, or exception number for ISRs.
+    uint16_t Kind;   // Written last - non-zero means the record is complete.
+    } TRACEREC;
+
+typedef struct {
+    uint32_t iWrite;   // Reserved by the writers.
+    uint32_t iRead;
+
+    uint32_t Dropped;  // Records lost because the ring was full.
+
+    TRACEREC* Buf;     // Pointer to the storage area.
+    uint32_t BufSize;  // Number of records, power of two.
+    uint32_t BufMask;
+    } TRACERING;
+
+extern TRACERING trace_ring;
+
+void trace_init(TRACERING*, TRACEREC*, int);
+void trace_record(TRACERING*, uint16_t id, uint16_t kind);
+int  trace_drain(TRACERING*, TRACEREC *dst, int max);
+
+uint16_t trace_scope_begin(uint16_t id);
+void     trace_scope_end(uint16_t *id);
+
+#ifndef __arm__
+extern uint32_t (*trace_clock)(void); // Supplied by the host.
+#endif
+
+#ifndef TRACE_DISABLE
+#define PROBE_BEGIN(id)      trace_record(&trace_ring, (id), TRACE_REC_BEGIN)
+#define PROBE_END(id)        trace_record(&trace_ring, (id), TRACE_REC_END)
+#define PROBE_MARK(id)       trace_record(&trace_ring, (id), TRACE_REC_MARK)
+#define TRACE_ISR_ENTER(irq) trace_record(&trace_ring, (irq), TRACE_REC_ISR_ENTER)
+#define TRACE_ISR_EXIT(irq)  trace_record(&trace_ring, (irq), TRACE_REC_ISR_EXIT)
+
+#define PROBE_CAT_(a, b) a##b
+#define PROBE_CAT(a, b)  PROBE_CAT_(a, b)
+
+// Begin now, end when the enclosing block exits.   One per line.
+#define PROBE_SCOPE(id) \
+    uint16_t PROBE_CAT(probe_scope_, __LINE__) __attribute__((cleanup(trace_scope_end))) = \
+        trace_scope_begin(id)
+#else
+#define PROBE_BEGIN(id)
+#define PROBE_END(id)
+#define PROBE_MARK(id)
+#define TRACE_ISR_ENTER(irq)
+#define TRACE_ISR_EXIT(irq)
+#define PROBE_SCOPE(id)
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+///
+/// @file uart-lm3s.c
+/// @brief Stellaris UART behind the UARTDEV interface, for uarttx.c
+///
+/// The TX interrupt fires when the FIFO drains to 2/8 full.   The
+/// Stellaris parts only say whether there's space, so Room() is 0 or 1
+/// and uarttx fills the FIFO a character at a time until it's full.
+/// No DMA here - uDMA needs a channel table that belongs to the app.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/uart.h"
+
+#include "uarttx.h"
+
+static int uart_room(void *ctx) {
+    return( UARTSpaceAvail((unsigned long) ctx) ? 1 : 0 );
+    }
+
+static void uart_write(void *ctx, const uint8_t *buf, int n) {
+    while ( n-- ) UARTCharPutNonBlocking((unsigned long) ctx, *buf++);
+    }
+
+static void uart_int_enable(void *ctx, int on) {
+    if ( on ) UARTIntEnable((unsigned long) ctx, UART_INT_TX);
+    else UARTIntDisable((unsigned long) ctx, UART_INT_TX);
+    }
+
+static int uart_busy(void *ctx) {
+    return( UARTBusy((unsigned long) ctx) ? 1 : 0 );
+    }
+
+static int uart_dma_left(void *ctx) {
+    (void) ctx;
+    return(0);
+    }
+
+/// Fill in the device for a UART that's already configured and enabled.
+void UartTxDevice(UARTDEV *dev, unsigned long base) {
+    UARTFIFOEnable(base);
+    UARTFIFOLevelSet(base, UART_FIFO_TX2_8, UART_FIFO_RX4_8);
+    UARTIntDisable(base, UART_INT_TX);
+
+    dev->Room = uart_room;
+    dev->Write = uart_write;
+    dev->IntEnable = uart_int_enable;
+    dev->Busy = uart_busy;
+    dev->DmaStart = 0;
+    dev->DmaLeft = uart_dma_left;
+    dev->Ctx = (void *) base;
+    }
+
+/// @brief The TX half of a UART ISR.   The vector belongs to the app,
+/// which may be receiving on the same UART, so this only clears TX:
+/// @code
+///     void UART0Handler(void) {
+///         uarttx_lm3s_isr(&console);
+///         ... RX ...
+///         }
+/// @endcode
+void uarttx_lm3s_isr(UARTTX *tx) {
+    unsigned long base = (unsigned long) tx->Dev->Ctx;
+
+    if ( UARTIntStatus(base, true) & UART_INT_TX ) {
+        UARTIntClear(base, UART_INT_TX);
+        uarttx_isr(tx);
+        }
+    }
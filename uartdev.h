@@ -0,0 +1,21 @@
+//
+// Minimal UART transmit interface.
+//
+
+#ifndef __UARTDEV_H__
+#define __UARTDEV_H__
+
+#include <stdint.h>
+
+// Called from thread level with the TX interrupt off, or from the ISR.
+typedef struct {
+    int  (*Room)(void *ctx);                               // Free TX FIFO slots.
+    void (*Write)(void *ctx, const uint8_t *buf, int n);   // n <= Room()
+    void (*IntEnable)(void *ctx, int on);                  // TX FIFO interrupt.
+    int  (*Busy)(void *ctx);                               // Still shifting out.
+    int  (*DmaStart)(void *ctx, const uint8_t *buf, int n); // NULL for no DMA.  Returns bytes taken.
+    int  (*DmaLeft)(void *ctx);                            // Bytes DMA has yet to move.
+    void *Ctx;
+    } UARTDEV;
+
+#endif
@@ -0,0 +1,206 @@
+/// @file uartsim.c
+/// @brief UART emulator on a pty.
+/// @details
+/// A thread plays the transmitter.   It takes a character from the
+/// FIFO every Usec, writes it to the pty, and raises the TX interrupt
+/// - calls the ISR - while the FIFO is at or below UARTSIM_LEVEL and
+/// the interrupt is enabled.   DMA moves from the buffer into the FIFO,
+/// and raises its complete interrupt when the last byte is in.   If the
+/// interrupt is off it stays pending until it's turned back on, like
+/// the NVIC.
+///
+/// Interrupt masking is a recursive mutex.   The ISRs run holding it,
+/// and the device calls take it, so thread level code that turns the
+/// interrupt off really does keep the ISR out.
+///
+/// The pty is raw, so what comes out of Master is byte for byte what
+/// went in.   The pty fills up if nobody reads it, and that holds up
+/// the wire, like flow control.
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "uartsim.h"
+
+static void *wire(void *arg) {
+    UARTSIM *u = arg;
+
+    while ( !u->Stop ) {
+        uint8_t c;
+        int got = 0;
+
+        pthread_mutex_lock(&u->Irq);
+
+        while ( u->DmaLeft && u->Count < UARTSIM_FIFO ) {
+            u->Fifo[( u->Head + u->Count++ ) % UARTSIM_FIFO] = *u->DmaBuf++;
+
+            if ( --u->DmaLeft == 0 ) u->DmaDone = 1;
+            }
+
+        if ( u->Count ) {
+            c = u->Fifo[u->Head];
+            u->Head = ( u->Head + 1 ) % UARTSIM_FIFO;
+            u->Count--;
+            got = 1;
+            }
+
+        u->Shifting = got;
+
+        if ( u->IntEnabled ) {
+            if ( u->DmaIsr && u->DmaDone ) {
+                u->DmaDone = 0;
+                u->Interrupts++;
+                u->DmaIsr(u->IsrArg);
+                }
+            else if ( u->TxIsr && !u->DmaIsr && u->Count <= UARTSIM_LEVEL ) {
+                u->Interrupts++;
+                u->TxIsr(u->IsrArg);
+                }
+            }
+
+        pthread_mutex_unlock(&u->Irq);
+
+        if ( got ) {
+            while ( write(u->Slave, &c, 1) != 1 ) { ; }
+
+            u->Sent++;
+
+            if ( u->Usec ) usleep(u->Usec);
+            }
+        else sched_yield();
+
+        __atomic_store_n(&u->Shifting, 0, __ATOMIC_SEQ_CST);
+        }
+
+    return(arg);
+    }
+
+/// @brief Make the pty and start the wire.
+/// @param usec per character, 0 for as fast as possible
+/// @return 0, or -1 if there's no pty
+int uartsim_open(UARTSIM *u, uint32_t usec) {
+    pthread_mutexattr_t attr;
+    struct termios t;
+
+    memset(u, 0, sizeof(*u));
+    u->Usec = usec;
+
+    u->Master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ( u->Master < 0 ) return(-1);
+
+    if ( grantpt(u->Master) || unlockpt(u->Master) ||
+         ( u->Slave = open(ptsname(u->Master), O_RDWR | O_NOCTTY) ) < 0 ) {
+        close(u->Master);
+        return(-1);
+        }
+
+    tcgetattr(u->Slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(u->Slave, TCSANOW, &t);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&u->Irq, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_create(&u->Wire, NULL, wire, u);
+    return(0);
+    }
+
+void uartsim_close(UARTSIM *u) {
+    u->Stop = 1;
+    pthread_join(u->Wire, NULL);
+    pthread_mutex_destroy(&u->Irq);
+    close(u->Slave);
+    close(u->Master);
+    }
+
+/// @brief Connect the interrupt handlers.
+/// @param dma NULL unless the device is being used with DMA
+void uartsim_isr(UARTSIM *u, void (*tx)(void *arg), void (*dma)(void *arg), void *arg) {
+    pthread_mutex_lock(&u->Irq);
+    u->TxIsr = tx;
+    u->DmaIsr = dma;
+    u->IsrArg = arg;
+    pthread_mutex_unlock(&u->Irq);
+    }
+
+static int dev_room(void *ctx) {
+    UARTSIM *u = ctx;
+    int room;
+
+    pthread_mutex_lock(&u->Irq);
+    room = UARTSIM_FIFO - u->Count;
+    pthread_mutex_unlock(&u->Irq);
+    return(room);
+    }
+
+static void dev_write(void *ctx, const uint8_t *buf, int n) {
+    UARTSIM *u = ctx;
+
+    pthread_mutex_lock(&u->Irq);
+
+    while ( n-- ) {
+        if ( u->Count == UARTSIM_FIFO ) u->Overruns++;
+        else u->Fifo[( u->Head + u->Count++ ) % UARTSIM_FIFO] = *buf;
+
+        buf++;
+        }
+
+    pthread_mutex_unlock(&u->Irq);
+    }
+
+static void dev_int_enable(void *ctx, int on) {
+    UARTSIM *u = ctx;
+
+    pthread_mutex_lock(&u->Irq);
+    u->IntEnabled = on;
+    pthread_mutex_unlock(&u->Irq);
+    }
+
+static int dev_busy(void *ctx) {
+    UARTSIM *u = ctx;
+    int busy;
+
+    pthread_mutex_lock(&u->Irq);
+    busy = u->Count || u->DmaLeft || __atomic_load_n(&u->Shifting, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&u->Irq);
+    return(busy);
+    }
+
+static int dev_dma_start(void *ctx, const uint8_t *buf, int n) {
+    UARTSIM *u = ctx;
+
+    pthread_mutex_lock(&u->Irq);
+    u->DmaBuf = buf;
+    u->DmaLeft = n;
+    u->DmaDone = 0;
+    pthread_mutex_unlock(&u->Irq);
+    return(n);
+    }
+
+static int dev_dma_left(void *ctx) {
+    UARTSIM *u = ctx;
+
+    return( __atomic_load_n(&u->DmaLeft, __ATOMIC_SEQ_CST) );
+    }
+
+/// @brief Fill in the device interface.
+/// @param dma non-zero to offer DMA
+void uartsim_dev(UARTSIM *u, UARTDEV *dev, int dma) {
+    dev->Room = dev_room;
+    dev->Write = dev_write;
+    dev->IntEnable = dev_int_enable;
+    dev->Busy = dev_busy;
+    dev->DmaStart = dma ? dev_dma_start : 0;
+    dev->DmaLeft = dev_dma_left;
+    dev->Ctx = u;
+    }
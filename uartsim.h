@@ -0,0 +1,47 @@
+//
+// UART emulator on a pty, for testing transmit code on the host.
+//
+
+#ifndef __UARTSIM_H__
+#define __UARTSIM_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "uartdev.h"
+
+#define UARTSIM_FIFO  16
+#define UARTSIM_LEVEL 4   // The TX interrupt is asserted at or below this.
+
+typedef struct {
+    uint8_t Fifo[UARTSIM_FIFO];
+    int Head, Count;
+    int IntEnabled;
+    int Shifting;          // A character on the wire.
+
+    const uint8_t *DmaBuf; // DMA, if it's been asked for.
+    int DmaLeft;
+    int DmaDone;           // Complete interrupt pending.
+
+    void (*TxIsr)(void *arg);
+    void (*DmaIsr)(void *arg);
+    void *IsrArg;
+
+    pthread_mutex_t Irq;   // Held by the ISRs, and anything they mustn't see half done.
+    pthread_t Wire;
+    volatile int Stop;
+    uint32_t Usec;         // Per character.  0 for as fast as the pty takes them.
+
+    int Master, Slave;     // Read what was sent from Master.
+
+    uint32_t Sent;         // Statistics
+    uint32_t Interrupts;
+    uint32_t Overruns;     // Writes to a full FIFO.
+    } UARTSIM;
+
+int  uartsim_open(UARTSIM*, uint32_t usec);
+void uartsim_close(UARTSIM*);
+void uartsim_isr(UARTSIM*, void (*tx)(void *arg), void (*dma)(void *arg), void *arg);
+void uartsim_dev(UARTSIM*, UARTDEV*, int dma);
+
+#endif
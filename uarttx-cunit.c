@@ -0,0 +1,299 @@
+// CUnit tests for the UART transmit engine, on the pty emulator.
+//
+// A reader thread plays the terminal, and collects everything that
+// comes out of the pty.   The data is a counting pattern, so anything
+// lost, repeated or out of order shows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "uarttx.h"
+#include "uartsim.h"
+
+#include "CUnit/Basic.h"
+
+#define TOTAL 200000
+
+UARTSIM sim;
+UARTDEV dev;
+UARTTX tx;
+uint8_t ringmem[256];
+
+uint8_t got[TOTAL + 1024];
+volatile int received;
+volatile int reading;
+pthread_t reader;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( ts.tv_sec + ts.tv_nsec * 1e-9 );
+    }
+
+static void relax(void) {
+    sched_yield();
+    }
+
+static void tx_isr(void *arg) {
+    uarttx_isr(arg);
+    }
+
+static void dma_isr(void *arg) {
+    uarttx_dma_done(arg);
+    }
+
+// Read until told to stop, and nothing more is coming.
+static void *terminal(void *arg) {
+    struct pollfd p = { sim.Master, POLLIN, 0 };
+
+    for (;;) {
+        int n;
+
+        if ( poll(&p, 1, 20) <= 0 ) {
+            if ( !reading ) break;
+
+            continue;
+            }
+
+        n = read(sim.Master, got + received, sizeof(got) - received);
+
+        if ( n > 0 ) received += n;
+        }
+
+    return(arg);
+    }
+
+static void start(int dma, uint32_t usec, int ringsize) {
+    CU_ASSERT_FATAL( uartsim_open(&sim, usec) == 0 );
+    uartsim_dev(&sim, &dev, dma);
+    uarttx_init(&tx, &dev, ringmem, ringsize);
+    tx.Relax = relax;
+    uartsim_isr(&sim, dma ? NULL : tx_isr, dma ? dma_isr : NULL, &tx);
+
+    received = 0;
+    reading = 1;
+    pthread_create(&reader, NULL, terminal, NULL);
+    }
+
+static void stop(void) {
+    reading = 0;
+    pthread_join(reader, NULL);
+    uartsim_close(&sim);
+    }
+
+// How many of the first n bytes don't follow the pattern.
+static int mismatches(int n, int from) {
+    int bad = 0;
+
+    for ( int i = 0; i < n; i++ ) bad += ( got[i] != (uint8_t) ( from + i ) );
+
+    return(bad);
+    }
+
+// Write the pattern in chunks of assorted sizes.
+static void stream(int total) {
+    uint8_t chunk[300];
+    int sent = 0, size = 1;
+
+    while ( sent < total ) {
+        int n = size < total - sent ? size : total - sent;
+
+        for ( int i = 0; i < n; i++ ) chunk[i] = (uint8_t) ( sent + i );
+
+        uarttx_write_all(&tx, chunk, n);
+        sent += n;
+        size = size * 7 % 293 + 1;
+        }
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+
+void testInterruptOrder(void) {
+    start(0, 0, sizeof(ringmem));
+
+    stream(TOTAL);
+    uarttx_flush(&tx);
+    stop();
+
+    CU_ASSERT( received == TOTAL );
+    CU_ASSERT( mismatches(received, 0) == 0 );
+    CU_ASSERT( sim.Overruns == 0 );
+    CU_ASSERT( sim.Interrupts > 0 );
+    CU_ASSERT( tx.Waits > 0 );   // It did push back.
+    CU_ASSERT( sim.IntEnabled == 0 ); // Off once it's empty.
+    }
+
+void testDmaOrder(void) {
+    start(1, 0, sizeof(ringmem));
+
+    stream(TOTAL);
+    uarttx_flush(&tx);
+    stop();
+
+    CU_ASSERT( received == TOTAL );
+    CU_ASSERT( mismatches(received, 0) == 0 );
+    CU_ASSERT( sim.Overruns == 0 );
+    CU_ASSERT( tx.DmaLen == 0 );
+    CU_ASSERT( sim.IntEnabled == 0 );
+    }
+
+// A slow wire and a small ring.   Writes take what fits and no more.
+void testBackPressure(void) {
+    uint8_t data[1000];
+    int taken, more;
+
+    for ( int i = 0; i < 1000; i++ ) data[i] = i;
+
+    start(0, 500, 64);
+
+    taken = uarttx_write(&tx, data, sizeof(data));
+    CU_ASSERT( taken >= 64 && taken <= 64 + UARTSIM_FIFO );
+
+    // Full up.
+    while ( ringbuffer_free(&tx.Ring) > 0 ) taken += uarttx_write(&tx, data + taken, 1);
+
+    more = uarttx_write(&tx, data + taken, 10);
+    CU_ASSERT( more <= 1 );
+    taken += more;
+
+    uarttx_flush(&tx);
+    stop();
+
+    CU_ASSERT( received == taken );
+    CU_ASSERT( mismatches(received, 0) == 0 );
+    }
+
+// Queueing takes a tiny fraction of the time the wire takes.   Polled
+// output would be stuck for all of it.
+void testThroughput(void) {
+    static uint8_t big[1024];
+    double t0, queued, flushed;
+
+    for ( int i = 0; i < 1024; i++ ) big[i] = i;
+
+    start(0, 50, 1024);
+
+    t0 = now();
+    uarttx_write_all(&tx, big, 1000);
+    queued = now() - t0;
+    uarttx_flush(&tx);
+    flushed = now() - t0;
+    stop();
+
+    printf("\n    queued 1000 bytes in %.0f us, on the wire in %.1f ms, %.0f bytes/s ", queued * 1e6, flushed * 1e3, 1000 / flushed);
+
+    CU_ASSERT( received == 1000 );
+    CU_ASSERT( mismatches(received, 0) == 0 );
+    CU_ASSERT( tx.Waits == 0 );
+    CU_ASSERT( queued < flushed / 10 );
+    }
+
+// A fault in the middle.   What was queued goes first, in order, then
+// the report, polled.
+void testPanic(void) {
+    uint8_t data[200];
+    const char *report = "Fault 3\r\n";
+
+    for ( int i = 0; i < 200; i++ ) data[i] = i;
+
+    start(0, 200, sizeof(ringmem));
+    uarttx_console = &tx;
+
+    uarttx_write_all(&tx, data, 200);
+
+    for ( const char *p = report; *p; p++ ) uarttx_panic_putc(*p);
+
+    CU_ASSERT( tx.Panic );
+    CU_ASSERT( sim.IntEnabled == 0 );
+
+    // Later writes are polled too.
+    CU_ASSERT( uarttx_write(&tx, "!", 1) == 1 );
+
+    uarttx_flush(&tx);
+    stop();
+    uarttx_console = NULL;
+
+    CU_ASSERT( received == 200 + 9 + 1 );
+    CU_ASSERT( mismatches(200, 0) == 0 );
+    CU_ASSERT( memcmp(got + 200, "Fault 3\r\n!", 10) == 0 );
+    CU_ASSERT( sim.Overruns == 0 );
+    }
+
+void testPanicDma(void) {
+    uint8_t data[200];
+
+    for ( int i = 0; i < 200; i++ ) data[i] = i;
+
+    start(1, 200, sizeof(ringmem));
+
+    uarttx_write_all(&tx, data, 200);
+    uarttx_panic(&tx);
+    CU_ASSERT( tx.DmaLen == 0 );
+    CU_ASSERT( ringbuffer_used(&tx.Ring) == 0 );
+    CU_ASSERT( uarttx_write(&tx, "xy", 2) == 2 );
+
+    uarttx_flush(&tx);
+    stop();
+
+    CU_ASSERT( received == 202 );
+    CU_ASSERT( mismatches(200, 0) == 0 );
+    CU_ASSERT( memcmp(got + 200, "xy", 2) == 0 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("UART Transmit", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Interrupt driven order", testInterruptOrder)) ||
+            (NULL == CU_add_test(pSuite, "DMA order", testDmaOrder)) ||
+            (NULL == CU_add_test(pSuite, "Back-pressure", testBackPressure)) ||
+            (NULL == CU_add_test(pSuite, "Throughput", testThroughput)) ||
+            (NULL == CU_add_test(pSuite, "Panic", testPanic)) ||
+            (NULL == CU_add_test(pSuite, "Panic with DMA", testPanicDma))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
@@ -0,0 +1,203 @@
+/// @file uarttx.c
+/// @brief Buffered UART transmit.
+/// @details
+/// UARTCharPut() waits for each byte to go out - 87us at 115200, most
+/// of a millisecond of stall for a line of text.   Instead, writers
+/// queue into a RINGBUF and go on with their work.   The queue drains
+/// one of two ways:
+/// - The TX FIFO interrupt.   uarttx_isr() fills the FIFO from the ring
+///   with the bulk pointer calls, and turns the interrupt off when the
+///   ring is empty.
+/// - DMA, if the device has it.   The largest contiguous block in the
+///   ring goes at once, and uarttx_dma_done() removes it and starts the
+///   next.
+///
+/// The ring has one writer (thread level) and one reader (the ISR), so
+/// it needs no locks.   Writes start the drain themselves, with the
+/// interrupt off, because the FIFO interrupt only fires when the level
+/// drops - an idle UART never asks.
+///
+/// Back-pressure: uarttx_write() takes what fits and says how much.
+/// uarttx_write_all() waits for room, calling Relax if there is one.
+///
+/// uarttx_panic() is for fault handlers.   Interrupts and DMA stop, the
+/// ring is written out by polling, and everything after that is polled
+/// too - so a fault report follows whatever was queued, in order.
+///
+/// The UART is behind a UARTDEV.   uart-lm3s.c is the Stellaris one,
+/// and uartsim.c emulates a UART on a pty for host tests.
+
+#include <stdint.h>
+
+#include "barrier.h"
+#include "uarttx.h"
+
+UARTTX *uarttx_console;
+
+/// @brief Set up.   Nothing is sent until the first write.
+/// @param buf queue storage
+/// @param size power of two
+void uarttx_init(UARTTX *tx, const UARTDEV *dev, uint8_t *buf, int size) {
+    ringbuffer_init(&tx->Ring, buf, size);
+    tx->Dev = dev;
+    tx->Relax = 0;
+    tx->DmaLen = 0;
+    tx->Panic = 0;
+    tx->Waits = 0;
+    tx->Isrs = 0;
+    }
+
+// Give the hardware as much as it takes.   The interrupt is off, or this
+// is the ISR.
+static void fill(UARTTX *tx) {
+    const UARTDEV *d = tx->Dev;
+    int n;
+
+    if ( d->DmaStart ) {
+        if ( tx->DmaLen == 0 && ( n = ringbuffer_getbulkcount(&tx->Ring) ) > 0 ) {
+            tx->DmaLen = d->DmaStart(d->Ctx, ringbuffer_getbulkpointer(&tx->Ring), n);
+            }
+
+        return;
+        }
+
+    // Ask again each time - some UARTs only say whether there's space.
+    while ( ( n = ringbuffer_getbulkcount(&tx->Ring) ) > 0 ) {
+        int room = d->Room(d->Ctx);
+
+        if ( room <= 0 ) break;
+
+        if ( n > room ) n = room;
+
+        d->Write(d->Ctx, ringbuffer_getbulkpointer(&tx->Ring), n);
+        ringbuffer_bulkremove(&tx->Ring, n);
+        }
+    }
+
+static void kick(UARTTX *tx) {
+    const UARTDEV *d = tx->Dev;
+
+    d->IntEnable(d->Ctx, 0);
+    fill(tx);
+
+    if ( ringbuffer_used(&tx->Ring) || tx->DmaLen ) d->IntEnable(d->Ctx, 1);
+    }
+
+static void polled(UARTTX *tx, const uint8_t *p, int n) {
+    const UARTDEV *d = tx->Dev;
+
+    while ( n-- ) {
+        while ( d->Room(d->Ctx) == 0 ) { ; }
+
+        d->Write(d->Ctx, p++, 1);
+        }
+    }
+
+/// @brief Queue what fits.   Never waits.
+/// @return bytes taken
+int uarttx_write(UARTTX *tx, const void *buf, int n) {
+    const uint8_t *p = buf;
+    uint32_t room;
+
+    if ( tx->Panic ) {
+        polled(tx, p, n);
+        return(n);
+        }
+
+    room = ringbuffer_free(&tx->Ring);
+
+    if ( (uint32_t) n > room ) n = room;
+
+    for ( int i = 0; i < n; i++ ) ringbuffer_addchar(&tx->Ring, p[i]);
+
+    MEM_BARRIER(); // The data before the drain sees it.
+
+    if ( n ) kick(tx);
+
+    return(n);
+    }
+
+/// @brief Queue all of it, waiting for room as needed.
+void uarttx_write_all(UARTTX *tx, const void *buf, int n) {
+    const uint8_t *p = buf;
+
+    for (;;) {
+        int done = uarttx_write(tx, p, n);
+
+        p += done;
+        n -= done;
+
+        if ( n == 0 ) return;
+
+        tx->Waits++;
+
+        if ( tx->Relax ) tx->Relax();
+        }
+    }
+
+/// @brief The TX FIFO interrupt.
+void uarttx_isr(UARTTX *tx) {
+    tx->Isrs++;
+
+    if ( tx->Panic ) return;
+
+    fill(tx);
+
+    if ( ringbuffer_used(&tx->Ring) == 0 ) tx->Dev->IntEnable(tx->Dev->Ctx, 0);
+    }
+
+/// @brief The DMA complete interrupt.   Take the block out and start the next.
+void uarttx_dma_done(UARTTX *tx) {
+    tx->Isrs++;
+
+    if ( tx->Panic ) return;
+
+    ringbuffer_bulkremove(&tx->Ring, tx->DmaLen);
+    tx->DmaLen = 0;
+    fill(tx);
+
+    if ( tx->DmaLen == 0 ) tx->Dev->IntEnable(tx->Dev->Ctx, 0);
+    }
+
+/// @brief Wait until everything queued is on the wire.
+void uarttx_flush(UARTTX *tx) {
+    const UARTDEV *d = tx->Dev;
+
+    while ( ringbuffer_used(&tx->Ring) || d->Busy(d->Ctx) ) {
+        if ( tx->Relax ) tx->Relax();
+        }
+    }
+
+/// @brief Stop the interrupts and DMA, and send what's queued by polling.
+/// For fault handlers.   There's no way back.
+void uarttx_panic(UARTTX *tx) {
+    const UARTDEV *d = tx->Dev;
+    int n;
+
+    tx->Panic = 1;
+    d->IntEnable(d->Ctx, 0);
+
+    // Let DMA finish its block.   Its interrupt may never come.
+    if ( tx->DmaLen ) {
+        while ( d->DmaLeft(d->Ctx) ) { ; }
+
+        ringbuffer_bulkremove(&tx->Ring, tx->DmaLen);
+        tx->DmaLen = 0;
+        }
+
+    while ( ( n = ringbuffer_getbulkcount(&tx->Ring) ) > 0 ) {
+        polled(tx, ringbuffer_getbulkpointer(&tx->Ring), n);
+        ringbuffer_bulkremove(&tx->Ring, n);
+        }
+
+    while ( d->Busy(d->Ctx) ) { ; }
+    }
+
+/// @brief Polled output to the console, for fmt_to_func() in a fault.
+void uarttx_panic_putc(char c) {
+    if ( uarttx_console ) {
+        if ( !uarttx_console->Panic ) uarttx_panic(uarttx_console);
+
+        polled(uarttx_console, (const uint8_t *) &c, 1);
+        }
+    }
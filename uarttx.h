@@ -0,0 +1,40 @@
+//
+// Buffered, interrupt or DMA driven UART transmit.
+//
+
+#ifndef __UARTTX_H__
+#define __UARTTX_H__
+
+#include <stdint.h>
+
+#include "ringbuffer.h"
+#include "uartdev.h"
+
+typedef struct {
+    RINGBUF Ring;
+    const UARTDEV *Dev;
+    void (*Relax)(void);     // Called while waiting for room.  May be NULL.
+    volatile uint32_t DmaLen; // In flight.
+    volatile int Panic;      // Polled from here on.
+
+    uint32_t Waits;          // Times a writer had to wait for room.
+    uint32_t Isrs;
+    } UARTTX;
+
+extern UARTTX *uarttx_console; // For uarttx_panic_putc().
+
+void uarttx_init(UARTTX*, const UARTDEV*, uint8_t *buf, int size);
+int  uarttx_write(UARTTX*, const void *buf, int n);
+void uarttx_write_all(UARTTX*, const void *buf, int n);
+void uarttx_isr(UARTTX*);
+void uarttx_dma_done(UARTTX*);
+void uarttx_flush(UARTTX*);
+void uarttx_panic(UARTTX*);
+void uarttx_panic_putc(char c);
+
+#if defined(__arm__)
+void UartTxDevice(UARTDEV*, unsigned long base); // uart-lm3s.c
+void uarttx_lm3s_isr(UARTTX*);
+#endif
+
+#endif
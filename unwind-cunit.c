@@ -0,0 +1,289 @@
+// CUnit tests for the offline unwinder.
+//
+// The firmware is a tiny synthetic ELF file built in memory - five
+// Thumb functions, an exception index and an extab entry.   No ARM
+// toolchain needed.
+//
+//   main  0x1000  push {r4,lr}                  exidx inline
+//   foo   0x1020  push {r4,r5,lr}; sub sp,#8    exidx inline
+//   bar   0x1040  (hand written)                EXIDX_CANTUNWIND
+//   baz   0x1060  push {r4,lr}                  extab, personality 1
+//   isr   0x1080  push {r4,lr}                  exidx inline
+//
+// main calls foo at 0x1010, foo calls bar at 0x1030, bar calls baz
+// at 0x1048.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crashdump.h"
+#include "elfread.h"
+#include "unwind.h"
+
+#include "CUnit/Basic.h"
+
+#define TEXT    0x1000
+#define EXIDX   0x2000
+#define EXTAB   0x2100
+#define STACK   0x20000000
+
+uint8_t image[0x500];
+ELFFILE ef;
+UNWINDER u;
+
+uint32_t regs[17];
+uint32_t fsr[CD_FSR_COUNT];
+uint32_t stack[CRASHDUMP_STACK_WORDS];
+CRASHDUMP cd;
+
+UNWFRAME frames[16];
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void put16(uint32_t addr, uint16_t hw) {
+    memcpy(&image[0x100 + addr - TEXT], &hw, 2);
+    }
+
+static uint32_t prel31(uint32_t target, uint32_t where) {
+    return( ( target - where ) & 0x7FFFFFFF );
+    }
+
+static void section(int i, uint32_t name, uint32_t type, uint32_t flags,
+                    uint32_t addr, uint32_t offset, uint32_t size, uint32_t link) {
+    Elf32_Shdr *sh = (Elf32_Shdr *) &image[0x380] + i;
+
+    sh->sh_name = name;
+    sh->sh_type = type;
+    sh->sh_flags = flags;
+    sh->sh_addr = addr;
+    sh->sh_offset = offset;
+    sh->sh_size = size;
+    sh->sh_link = link;
+    sh->sh_entsize = ( type == SHT_SYMTAB ) ? sizeof(Elf32_Sym) : 0;
+    }
+
+static void build_elf(void) {
+    static const char shstr[] = "\0.text\0.ARM.exidx\0.ARM.extab\0.symtab\0.strtab\0.shstrtab";
+    static const char str[] = "\0main\0foo\0bar\0baz\0isr";
+    static const uint32_t fn[] = { 0x1000, 0x1020, 0x1040, 0x1060, 0x1080 };
+    static const uint32_t name[] = { 1, 6, 10, 14, 18 };
+    Elf32_Ehdr *eh = (Elf32_Ehdr *) image;
+    uint32_t *exidx = (uint32_t *) &image[0x200];
+    uint32_t *extab = (uint32_t *) &image[0x240];
+    Elf32_Sym *sym = (Elf32_Sym *) &image[0x260];
+
+    memset(image, 0, sizeof(image));
+    memcpy(eh->e_ident, ELFMAG, SELFMAG);
+    eh->e_ident[EI_CLASS] = ELFCLASS32;
+    eh->e_ident[EI_DATA] = ELFDATA2LSB;
+    eh->e_machine = EM_ARM;
+    eh->e_shoff = 0x380;
+    eh->e_shentsize = sizeof(Elf32_Shdr);
+    eh->e_shnum = 7;
+    eh->e_shstrndx = 6;
+
+    // Code - just the calls matter.
+    put16(0x1010, 0xF000); put16(0x1012, 0xF806); // bl foo
+    put16(0x1030, 0xF000); put16(0x1032, 0xF806); // bl bar
+    put16(0x1048, 0xF000); put16(0x104A, 0xF80A); // bl baz
+
+    for ( int i = 0; i < 5; i++ ) exidx[i * 2] = prel31(fn[i], EXIDX + i * 8);
+
+    exidx[1] = 0x80A8B0B0;                      // pop {r4,lr}
+    exidx[3] = 0x8001A9B0;                      // add sp,#8; pop {r4,r5,lr}
+    exidx[5] = 1;                               // EXIDX_CANTUNWIND
+    exidx[7] = prel31(EXTAB, EXIDX + 3 * 8 + 4);
+    exidx[9] = 0x80A8B0B0;
+    extab[0] = 0x8100A8B0;                      // Personality 1, pop {r4,lr}
+
+    for ( int i = 0; i < 5; i++ ) {
+        sym[i + 1].st_name = name[i];
+        sym[i + 1].st_value = fn[i] | 1;
+        sym[i + 1].st_size = 0x20;
+        sym[i + 1].st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+        sym[i + 1].st_shndx = 1;
+        }
+
+    memcpy(&image[0x2C0], str, sizeof(str));
+    memcpy(&image[0x300], shstr, sizeof(shstr));
+
+    section(1, 1, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, TEXT, 0x100, 0xA0, 0);
+    section(2, 7, 0x70000001, SHF_ALLOC, EXIDX, 0x200, 40, 1);
+    section(3, 18, SHT_PROGBITS, SHF_ALLOC, EXTAB, 0x240, 4, 0);
+    section(4, 29, SHT_SYMTAB, 0, 0, 0x260, 6 * sizeof(Elf32_Sym), 5);
+    section(5, 37, SHT_STRTAB, 0, 0, 0x2C0, sizeof(str), 0);
+    section(6, 45, SHT_STRTAB, 0, 0, 0x300, sizeof(shstr), 0);
+    }
+
+// The stack below baz, from the top of baz's frame upwards.
+static int thread_stack(uint32_t *s) {
+    int n = 0;
+
+    s[n++] = 0x44444444; s[n++] = 0x104D;       // baz: r4, lr
+    s[n++] = 0x12345678; s[n++] = 0x1001;       // bar: junk, code but no call
+    s[n++] = 0x1035;                            //      return to foo
+    s[n++] = 0; s[n++] = 0;                     // foo: locals
+    s[n++] = 0x44; s[n++] = 0x55; s[n++] = 0x1015;  // r4, r5, lr
+    s[n++] = 0x4; s[n++] = 0;                   // main: r4, lr = end
+    return(n);
+    }
+
+static void make_dump(uint32_t pc, uint32_t lr, uint32_t exc_return, int skip, int words) {
+    memset(regs, 0, sizeof(regs));
+    regs[CD_R13_SP] = STACK + skip * 4;
+    regs[CD_R14_LR] = lr;
+    regs[CD_R15_PC] = pc;
+    regs[CD_PSR] = 0x01000000;
+
+    crashdump_fill(&cd, regs, exc_return, fsr, stack + skip, words);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    build_elf();
+
+    if ( elf_load(&ef, image, sizeof(image)) ) return(-1);
+
+    return( unwind_open(&u, &ef) );
+    }
+
+int clean_suite1(void) {
+    unwind_close(&u);
+    elf_close(&ef);
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testSymbols(void) {
+    uint32_t offset;
+
+    CU_ASSERT( u.SymCount == 5 );
+    CU_ASSERT( strcmp(unwind_symbol(&u, 0x1067, &offset), "baz") == 0 && offset == 6 );
+    CU_ASSERT( strcmp(unwind_symbol(&u, 0x1000, &offset), "main") == 0 && offset == 0 );
+    CU_ASSERT( strcmp(unwind_symbol(&u, 0x109F, &offset), "isr") == 0 );
+    CU_ASSERT( unwind_symbol(&u, 0x0FFF, &offset) == NULL );
+    CU_ASSERT( unwind_symbol(&u, 0x10A0, &offset) == NULL );
+    }
+
+// baz via extab, bar has no unwind info, so foo gets found by a scan.
+void testThread(void) {
+    int n, why, words = thread_stack(stack);
+
+    make_dump(0x1066, 0x104D, 0xFFFFFFFD, 0, words);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+
+    CU_ASSERT( n == 4 && why == UNW_END_DONE );
+    CU_ASSERT( frames[0].PC == 0x1066 && frames[0].Method == UNW_REGS );
+    CU_ASSERT( frames[1].PC == 0x104D && frames[1].Method == UNW_EXIDX );
+    CU_ASSERT( frames[1].SP == STACK + 8 );
+    CU_ASSERT( frames[2].PC == 0x1035 && frames[2].Method == UNW_SCAN );
+    CU_ASSERT( frames[2].SP == STACK + 20 );
+    CU_ASSERT( frames[3].PC == 0x1015 && frames[3].Method == UNW_EXIDX );
+    CU_ASSERT( frames[3].SP == STACK + 40 );
+    }
+
+// Fault in bar, which has no unwind info.   LR gets used.
+void testLeaf(void) {
+    int n, why, words = thread_stack(stack);
+
+    make_dump(0x1042, 0x1035, 0xFFFFFFFD, 5, words - 5);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+
+    CU_ASSERT( n == 3 && why == UNW_END_DONE );
+    CU_ASSERT( frames[1].PC == 0x1035 && frames[1].Method == UNW_LR );
+    CU_ASSERT( frames[2].PC == 0x1015 && frames[2].Method == UNW_EXIDX );
+    }
+
+// A fault in an ISR that interrupted baz, all on the main stack.
+void testException(void) {
+    uint32_t *s = stack;
+    int n, why;
+
+    *s++ = 0x4; *s++ = 0xFFFFFFF9;              // isr: r4, lr
+    *s++ = 0; *s++ = 1; *s++ = 2; *s++ = 3;     // r0-r3
+    *s++ = 12; *s++ = 0x104D; *s++ = 0x1066;    // r12, lr, pc
+    *s++ = 0x01000200;                          // xpsr, re-aligned
+    *s++ = 0xAAAAAAAA;                          // Alignment pad
+    s += thread_stack(s);
+
+    make_dump(0x1084, 0xFFFFFFF9, 0xFFFFFFF9, 0, s - stack);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+
+    CU_ASSERT( n == 5 && why == UNW_END_DONE );
+    CU_ASSERT( frames[1].PC == 0x1066 && frames[1].Method == UNW_EXCEPTION );
+    CU_ASSERT( frames[1].SP == STACK + 44 );
+    CU_ASSERT( frames[2].PC == 0x104D && frames[2].Method == UNW_EXIDX );
+    CU_ASSERT( frames[4].PC == 0x1015 );
+
+    // Same thing, but the thread was on the process stack.
+    stack[1] = 0xFFFFFFFD;
+    make_dump(0x1084, 0xFFFFFFFD, 0xFFFFFFF9, 0, s - stack);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+    CU_ASSERT( n == 1 && why == UNW_END_OTHERSTACK );
+    }
+
+// Short copies of the stack.
+void testTruncated(void) {
+    int n, why;
+
+    thread_stack(stack);
+    make_dump(0x1066, 0x104D, 0xFFFFFFFD, 0, 1);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+    CU_ASSERT( n == 1 && why == UNW_END_STACK );
+
+    // Nothing on the stack looks like a return address.
+    for ( int i = 0; i < CRASHDUMP_STACK_WORDS; i++ ) stack[i] = 0x1001;
+
+    make_dump(0x1042, 0x2001, 0xFFFFFFFD, 0, CRASHDUMP_STACK_WORDS);
+    n = unwind_backtrace(&u, &cd, frames, 16, &why);
+    CU_ASSERT( n == 1 && why == UNW_END_STACK );
+
+    // Frame limit.
+    thread_stack(stack);
+    make_dump(0x1066, 0x104D, 0xFFFFFFFD, 0, 12);
+    n = unwind_backtrace(&u, &cd, frames, 2, &why);
+    CU_ASSERT( n == 2 && why == UNW_END_DEPTH );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Unwinder", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Symbols", testSymbols)) ||
+            (NULL == CU_add_test(pSuite, "Thread stack", testThread)) ||
+            (NULL == CU_add_test(pSuite, "Leaf function", testLeaf)) ||
+            (NULL == CU_add_test(pSuite, "Exception frame", testException)) ||
+            (NULL == CU_add_test(pSuite, "Truncated stack", testTruncated))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
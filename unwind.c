@@ -0,0 +1,597 @@
+/// @file unwind.c
+/// @brief Offline stack unwinder for crash records.
+/// @details
+/// Takes a crash record and the matching ELF file, and produces a
+/// symbolized backtrace.
+///
+/// - Frames are unwound with the ARM EHABI tables (.ARM.exidx and
+///   .ARM.extab).   Build with -funwind-tables to get them for C code.
+///   Only the compact personality routines are interpreted, plus the
+///   unwind data that follows a generic personality routine.
+/// - Functions without unwind info are handled with heuristics.   The
+///   faulting function is assumed to be a leaf, and LR is used.  After
+///   that, the stack is scanned for something that looks like a return
+///   address - odd, in code, and right after a BL or BLX.
+/// - An EXC_RETURN value in the PC means an exception frame.  If it is
+///   on the stack that FH_REGISTER_SAVE captured, it gets popped and the
+///   unwind carries on into the interrupted code.   If it's on the
+///   other stack, the unwind stops there.
+///
+/// The ELF file is loaded once, and lookups are binary searches, so a
+/// batch of dumps goes quickly.
+///
+/// Usage: unwind firmware.elf dumpfile...
+///
+/// Build with -DNO_MAIN to link the unwinder into the unit tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crashdump.h"
+#include "elfread.h"
+#include "unwind.h"
+
+#ifndef SHT_ARM_EXIDX
+#define SHT_ARM_EXIDX 0x70000001
+#endif
+
+#define UNW_MAXDEPTH 64
+#define UNW_SCANWORDS 256 // How far to look for a return address.
+
+typedef struct {
+    uint32_t R[16];
+    const CRASHDUMP *cd;
+    } UNWSTATE;
+
+// --------------------------------------------------
+// Memory access.
+// --------------------------------------------------
+
+// Read a word from the stack copy.
+static int stack_read(const CRASHDUMP *cd, uint32_t addr, uint32_t *val) {
+    uint32_t off;
+
+    if ( ( addr & 3 ) || addr < cd->StackBase ) return(-1);
+
+    off = ( addr - cd->StackBase ) >> 2;
+
+    if ( off >= cd->StackWords ) return(-1);
+
+    *val = cd->Stack[off];
+    return(0);
+    }
+
+// Find the file contents for a range of target addresses.
+static const uint8_t *image_ptr(UNWINDER *u, uint32_t addr, uint32_t len, int code) {
+    ELFFILE *ef = u->Elf;
+
+    for ( int i = 0; i < ef->Ehdr->e_shnum; i++ ) {
+        Elf32_Shdr *sh = &ef->Shdr[i];
+
+        if ( !( sh->sh_flags & SHF_ALLOC ) || sh->sh_type == SHT_NOBITS ) continue;
+
+        if ( code && !( sh->sh_flags & SHF_EXECINSTR ) ) continue;
+
+        if ( addr >= sh->sh_addr && addr - sh->sh_addr + len <= sh->sh_size ) {
+            const uint8_t *data = elf_section_data(ef, sh);
+            return( data ? data + ( addr - sh->sh_addr ) : NULL );
+            }
+        }
+
+    return(NULL);
+    }
+
+static int image_word(UNWINDER *u, uint32_t addr, uint32_t *val) {
+    const uint8_t *p = image_ptr(u, addr, 4, 0);
+
+    if ( p == NULL ) return(-1);
+
+    memcpy(val, p, 4);
+    return(0);
+    }
+
+static int is_code(UNWINDER *u, uint32_t addr) {
+    return( image_ptr(u, addr & ~1, 2, 1) != NULL );
+    }
+
+static int is_exc_return(uint32_t pc) {
+    return( ( pc & 0xFFFFFFE0 ) == 0xFFFFFFE0 );
+    }
+
+// Is this return address right after a BL or BLX?
+static int after_call(UNWINDER *u, uint32_t ret) {
+    const uint8_t *p;
+    uint16_t hw1, hw2;
+
+    ret &= ~1;
+
+    if ( ( p = image_ptr(u, ret - 2, 2, 1) ) != NULL ) {
+        memcpy(&hw2, p, 2);
+
+        if ( ( hw2 & 0xFF87 ) == 0x4780 ) return(1); // BLX Rm
+        }
+
+    if ( ( p = image_ptr(u, ret - 4, 4, 1) ) != NULL ) {
+        memcpy(&hw1, p, 2);
+        memcpy(&hw2, p + 2, 2);
+
+        if ( ( hw1 & 0xF800 ) == 0xF000 && ( hw2 & 0xC000 ) == 0xC000 ) return(1); // BL/BLX imm
+        }
+
+    return(0);
+    }
+
+// --------------------------------------------------
+// EHABI
+// --------------------------------------------------
+
+static uint32_t prel31(uint32_t word, uint32_t where) {
+    return( where + ( (int32_t) ( word << 1 ) >> 1 ) );
+    }
+
+// Find the index entry for an address.   The table is sorted.
+static int exidx_find(UNWINDER *u, uint32_t addr) {
+    int lo = 0, hi = (int) u->ExidxCount - 1, found = -1;
+
+    while ( lo <= hi ) {
+        int mid = ( lo + hi ) / 2;
+        uint32_t fn = prel31(u->Exidx[mid * 2], u->ExidxAddr + mid * 8);
+
+        if ( fn <= addr ) {
+            found = mid;
+            lo = mid + 1;
+            }
+        else hi = mid - 1;
+        }
+
+    return(found);
+    }
+
+// Collect the unwind instructions for an index entry.
+// Return the count, or -1 if there is nothing usable.
+static int exidx_instructions(UNWINDER *u, int entry, uint8_t *ins, int max) {
+    uint32_t where = u->ExidxAddr + entry * 8 + 4;
+    uint32_t word = u->Exidx[entry * 2 + 1];
+    uint32_t addr, more = 0;
+    int n = 0;
+
+    if ( word == 1 ) return(-1); // EXIDX_CANTUNWIND
+
+    if ( word & 0x80000000 ) { // Inline, personality 0
+        if ( ( word >> 24 ) != 0x80 ) return(-1);
+
+        ins[n++] = word >> 16;
+        ins[n++] = word >> 8;
+        ins[n++] = word;
+        return(n);
+        }
+
+    addr = prel31(word, where);
+
+    if ( image_word(u, addr, &word) ) return(-1);
+
+    if ( word & 0x80000000 ) {
+        switch ( ( word >> 24 ) & 0x0F ) {
+            case 0:
+                ins[n++] = word >> 16;
+                ins[n++] = word >> 8;
+                ins[n++] = word;
+                return(n);
+
+            case 1:
+            case 2:
+                more = ( word >> 16 ) & 0xFF;
+                ins[n++] = word >> 8;
+                ins[n++] = word;
+                break;
+
+            default:
+                return(-1);
+            }
+        }
+    else { // Generic personality.  The instructions follow.
+        addr += 4;
+
+        if ( image_word(u, addr, &word) ) return(-1);
+
+        more = word >> 24;
+        ins[n++] = word >> 16;
+        ins[n++] = word >> 8;
+        ins[n++] = word;
+        }
+
+    while ( more-- && n + 4 <= max ) {
+        addr += 4;
+
+        if ( image_word(u, addr, &word) ) return(-1);
+
+        ins[n++] = word >> 24;
+        ins[n++] = word >> 16;
+        ins[n++] = word >> 8;
+        ins[n++] = word;
+        }
+
+    return(n);
+    }
+
+static int pop(UNWSTATE *s, uint32_t *vsp, int reg) {
+    if ( stack_read(s->cd, *vsp, &s->R[reg]) ) return(-1);
+
+    *vsp += 4;
+    return(0);
+    }
+
+// Run the unwind instructions.
+// 0 on success, -1 for refuse/spare opcodes, -2 if we ran off the stack.
+static int exidx_execute(UNWSTATE *s, const uint8_t *ins, int n) {
+    uint32_t vsp = s->R[13];
+    int pc_set = 0, sp_set = 0, i = 0;
+    uint32_t sp_popped = 0;
+
+    while ( i < n ) {
+        uint8_t op = ins[i++];
+        uint8_t b = ( i < n ) ? ins[i] : 0;
+
+        if ( ( op & 0xC0 ) == 0x00 ) vsp += ( ( op & 0x3F ) << 2 ) + 4;
+        else if ( ( op & 0xC0 ) == 0x40 ) vsp -= ( ( op & 0x3F ) << 2 ) + 4;
+        else if ( ( op & 0xF0 ) == 0x80 ) { // Pop under mask r4-r15
+            uint32_t mask = ( ( op & 0x0F ) << 8 ) | b;
+            i++;
+
+            if ( mask == 0 ) return(-1); // Refuse to unwind.
+
+            for ( int r = 0; r < 12; r++ ) {
+                if ( !( mask & ( 1 << r ) ) ) continue;
+
+                if ( pop(s, &vsp, 4 + r) ) return(-2);
+
+                if ( 4 + r == 13 ) {
+                    sp_set = 1;
+                    sp_popped = s->R[13];
+                    }
+                }
+
+            if ( mask & ( 1 << 11 ) ) pc_set = 1;
+            }
+        else if ( ( op & 0xF0 ) == 0x90 ) { // vsp = r[n]
+            if ( ( op & 0x0F ) == 13 || ( op & 0x0F ) == 15 ) return(-1);
+
+            vsp = s->R[op & 0x0F];
+            }
+        else if ( ( op & 0xF0 ) == 0xA0 ) { // Pop r4-r[4+nnn], maybe r14
+            for ( int r = 4; r <= 4 + ( op & 7 ); r++ ) {
+                if ( pop(s, &vsp, r) ) return(-2);
+                }
+
+            if ( ( op & 8 ) && pop(s, &vsp, 14) ) return(-2);
+            }
+        else if ( op == 0xB0 ) break; // Finish
+        else if ( op == 0xB1 ) { // Pop under mask r0-r3
+            i++;
+
+            if ( b == 0 || ( b & 0xF0 ) ) return(-1);
+
+            for ( int r = 0; r < 4; r++ ) {
+                if ( ( b & ( 1 << r ) ) && pop(s, &vsp, r) ) return(-2);
+                }
+            }
+        else if ( op == 0xB2 ) { // vsp += 0x204 + uleb128 << 2
+            uint32_t v = 0;
+            int shift = 0;
+
+            do {
+                if ( i >= n ) return(-1);
+
+                b = ins[i++];
+                v |= ( b & 0x7F ) << shift;
+                shift += 7;
+                }
+            while ( b & 0x80 );
+
+            vsp += 0x204 + ( v << 2 );
+            }
+        else if ( op == 0xB3 ) { // VFP FSTMFDX
+            i++;
+            vsp += ( ( b & 0x0F ) + 1 ) * 8 + 4;
+            }
+        else if ( ( op & 0xF8 ) == 0xB8 ) vsp += ( ( op & 7 ) + 1 ) * 8 + 4;
+        else if ( ( op & 0xF8 ) == 0xD0 ) vsp += ( ( op & 7 ) + 1 ) * 8;
+        else if ( op >= 0xC0 && op <= 0xC5 ) vsp += ( ( op & 7 ) + 1 ) * 8;
+        else if ( op == 0xC6 || op == 0xC8 || op == 0xC9 ) {
+            i++;
+            vsp += ( ( b & 0x0F ) + 1 ) * 8;
+            }
+        else if ( op == 0xC7 ) {
+            i++;
+
+            if ( b == 0 || ( b & 0xF0 ) ) return(-1);
+
+            vsp += 4 * __builtin_popcount(b);
+            }
+        else return(-1); // Spare
+        }
+
+    s->R[13] = sp_set ? sp_popped : vsp;
+
+    if ( !pc_set ) s->R[15] = s->R[14];
+
+    return(0);
+    }
+
+// --------------------------------------------------
+// Frame handling
+// --------------------------------------------------
+
+// Pop a hardware exception frame.
+static int pop_exception(UNWSTATE *s, uint32_t exc_return) {
+    uint32_t frame[8];
+    uint32_t sp = s->R[13];
+
+    for ( int i = 0; i < 8; i++ ) {
+        if ( stack_read(s->cd, sp + i * 4, &frame[i]) ) return(-2);
+        }
+
+    s->R[0] = frame[0];
+    s->R[1] = frame[1];
+    s->R[2] = frame[2];
+    s->R[3] = frame[3];
+    s->R[12] = frame[4];
+    s->R[14] = frame[5];
+    s->R[15] = frame[6];
+
+    sp += 32;
+
+    if ( !( exc_return & 0x10 ) ) sp += 72; // FPU state too.
+
+    if ( frame[7] & ( 1 << 9 ) ) sp += 4;   // Stack was re-aligned.
+
+    s->R[13] = sp;
+    return(0);
+    }
+
+// Look for a return address on the stack.
+static int scan(UNWINDER *u, UNWSTATE *s) {
+    uint32_t sp = s->R[13], w;
+
+    for ( int i = 0; i < UNW_SCANWORDS; i++, sp += 4 ) {
+        if ( stack_read(s->cd, sp, &w) ) return(-2);
+
+        if ( ( w & 1 ) && is_code(u, w) && after_call(u, w) ) {
+            s->R[15] = w;
+            s->R[13] = sp + 4;
+            return(0);
+            }
+        }
+
+    return(-1);
+    }
+
+static int sym_cmp(const void *a, const void *b) {
+    uint32_t x = ( (const UNWSYM *) a )->Addr, y = ( (const UNWSYM *) b )->Addr;
+    return( ( x > y ) - ( x < y ) );
+    }
+
+/// @brief Load up the unwind tables and symbols.
+/// @return 0 on success, -1 if the ELF file has no .ARM.exidx
+/// (the unwind still works, but only on heuristics.)
+int unwind_open(UNWINDER *u, ELFFILE *ef) {
+    const char *strtab;
+    Elf32_Sym *syms;
+    int count, ret = -1;
+
+    memset(u, 0, sizeof(*u));
+    u->Elf = ef;
+
+    for ( int i = 0; i < ef->Ehdr->e_shnum; i++ ) {
+        Elf32_Shdr *sh = &ef->Shdr[i];
+
+        if ( sh->sh_type == SHT_ARM_EXIDX && elf_section_data(ef, sh) ) {
+            u->Exidx = elf_section_data(ef, sh);
+            u->ExidxAddr = sh->sh_addr;
+            u->ExidxCount = sh->sh_size / 8;
+            ret = 0;
+            }
+        }
+
+    syms = elf_symbols(ef, &count, &strtab);
+    u->Syms = malloc(( count + 1 ) * sizeof(UNWSYM));
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( ELF32_ST_TYPE(syms[i].st_info) != STT_FUNC || syms[i].st_shndx == SHN_UNDEF ) continue;
+
+        u->Syms[u->SymCount].Addr = syms[i].st_value & ~1;
+        u->Syms[u->SymCount].Size = syms[i].st_size;
+        u->Syms[u->SymCount].Name = strtab + syms[i].st_name;
+        u->SymCount++;
+        }
+
+    qsort(u->Syms, u->SymCount, sizeof(UNWSYM), sym_cmp);
+    return(ret);
+    }
+
+void unwind_close(UNWINDER *u) {
+    free(u->Syms);
+    u->Syms = NULL;
+    }
+
+/// @return the function containing an address, or NULL.
+/// @param u unwinder
+/// @param addr code address
+/// @param *offset returns the offset into the function
+const char *unwind_symbol(UNWINDER *u, uint32_t addr, uint32_t *offset) {
+    int lo = 0, hi = u->SymCount - 1, found = -1;
+
+    addr &= ~1;
+
+    while ( lo <= hi ) {
+        int mid = ( lo + hi ) / 2;
+
+        if ( u->Syms[mid].Addr <= addr ) {
+            found = mid;
+            lo = mid + 1;
+            }
+        else hi = mid - 1;
+        }
+
+    if ( found < 0 ) return(NULL);
+
+    if ( u->Syms[found].Size && addr >= u->Syms[found].Addr + u->Syms[found].Size ) return(NULL);
+
+    *offset = addr - u->Syms[found].Addr;
+    return(u->Syms[found].Name);
+    }
+
+/// @brief Unwind a crash record.
+/// @return the number of frames
+/// @param u unwinder
+/// @param cd the crash record
+/// @param frames where the frames go
+/// @param max room for how many
+/// @param *why returns UNW_END_DONE etc.
+int unwind_backtrace(UNWINDER *u, const CRASHDUMP *cd, UNWFRAME *frames, int max, int *why) {
+    UNWSTATE s;
+    int n = 0;
+
+    s.cd = cd;
+
+    for ( int i = 0; i < 16; i++ ) s.R[i] = cd->Regs[i];
+
+    frames[n].PC = s.R[15];
+    frames[n].SP = s.R[13];
+    frames[n++].Method = UNW_REGS;
+
+    *why = UNW_END_DEPTH;
+
+    while ( n < max && n < UNW_MAXDEPTH ) {
+        uint32_t pc = s.R[15], sp = s.R[13];
+        uint8_t ins[64];
+        int method, rc = -1, entry, count;
+
+        // Return addresses point after the call.   Look up the call.
+        uint32_t lookup = ( pc & ~1 ) - ( frames[n - 1].Method == UNW_REGS ||
+                                          frames[n - 1].Method == UNW_EXCEPTION ? 0 : 2 );
+
+        entry = u->Exidx ? exidx_find(u, lookup) : -1;
+        count = entry >= 0 ? exidx_instructions(u, entry, ins, sizeof(ins)) : -1;
+
+        if ( count > 0 ) {
+            rc = exidx_execute(&s, ins, count);
+            method = UNW_EXIDX;
+            }
+
+        if ( rc == -1 && n == 1 && ( is_code(u, s.R[14]) || is_exc_return(s.R[14]) ) ) {
+            s.R[15] = s.R[14]; // A leaf, hopefully.
+            rc = 0;
+            method = UNW_LR;
+            }
+
+        if ( rc == -1 ) {
+            rc = scan(u, &s);
+            method = UNW_SCAN;
+            }
+
+        if ( rc == 0 && is_exc_return(s.R[15]) ) {
+            // Which stack has the frame?   Bit 2 of EXC_RETURN, same as
+            // FH_REGISTER_SAVE uses to pick MSP or PSP.
+            if ( ( s.R[15] & 4 ) != ( cd->ExcReturn & 4 ) ) {
+                *why = UNW_END_OTHERSTACK;
+                break;
+                }
+
+            rc = pop_exception(&s, s.R[15]);
+            method = UNW_EXCEPTION;
+            }
+
+        if ( rc == -2 ) {
+            *why = UNW_END_STACK;
+            break;
+            }
+
+        if ( rc == -1 ) {
+            *why = UNW_END_LOST;
+            break;
+            }
+
+        if ( s.R[15] == 0 || !is_code(u, s.R[15]) ) {
+            *why = UNW_END_DONE;
+            break;
+            }
+
+        // Stacks only unwind upwards.
+        if ( s.R[13] < sp || ( s.R[13] == sp && s.R[15] == pc ) ) {
+            *why = UNW_END_LOST;
+            break;
+            }
+
+        frames[n].PC = s.R[15];
+        frames[n].SP = s.R[13];
+        frames[n++].Method = method;
+        }
+
+    return(n);
+    }
+
+#ifndef NO_MAIN
+int main(int argc, char **argv) {
+    static const char *methods[] = { "regs", "exidx", "lr", "scan", "exception" };
+    static const char *whys[] = {
+        "end of chain", "end of stack copy", "frame is on the other stack",
+        "lost", "too deep"
+        };
+    ELFFILE ef;
+    UNWINDER u;
+    UNWFRAME frames[UNW_MAXDEPTH];
+    int status = 0;
+
+    if ( argc < 3 ) {
+        fprintf(stderr, "usage: %s firmware.elf dumpfile...\n", argv[0]);
+        return(1);
+        }
+
+    if ( elf_open(&ef, argv[1]) ) {
+        fprintf(stderr, "%s: can't read ELF file\n", argv[1]);
+        return(1);
+        }
+
+    if ( unwind_open(&u, &ef) ) fprintf(stderr, "%s: no .ARM.exidx, guessing\n", argv[1]);
+
+    for ( int i = 2; i < argc; i++ ) {
+        CRASHDUMP cd;
+        FILE *in = fopen(argv[i], "rb");
+        int n, why;
+
+        if ( in == NULL || fread(&cd, sizeof(cd), 1, in) != 1 ||
+                !crashdump_valid(&cd) ) {
+            fprintf(stderr, "%s: not a valid crash record\n", argv[i]);
+
+            if ( in ) fclose(in);
+
+            status = 1;
+            continue;
+            }
+
+        fclose(in);
+
+        printf("==== %s\n", argv[i]);
+        n = unwind_backtrace(&u, &cd, frames, UNW_MAXDEPTH, &why);
+
+        for ( int f = 0; f < n; f++ ) {
+            uint32_t offset;
+            const char *name = unwind_symbol(&u, frames[f].PC, &offset);
+
+            printf("#%-2d 0x%08x sp=0x%08x %-9s ", f, frames[f].PC, frames[f].SP, methods[frames[f].Method]);
+
+            if ( name ) printf("%s+0x%x\n", name, offset);
+            else printf("??\n");
+            }
+
+        printf("(%s)\n", whys[why]);
+        }
+
+    unwind_close(&u);
+    elf_close(&ef);
+    return(status);
+    }
+#endif
@@ -0,0 +1,53 @@
+//
+// Offline stack unwinder for crash records.
+//
+
+#ifndef __UNWIND_H__
+#define __UNWIND_H__
+
+#include <stdint.h>
+
+#include "crashdump.h"
+#include "elfread.h"
+
+// How a frame was found.
+#define UNW_REGS      0 // Straight from the saved registers.
+#define UNW_EXIDX     1 // .ARM.exidx/.ARM.extab unwind instructions.
+#define UNW_LR        2 // No unwind info - assumed a leaf, used LR.
+#define UNW_SCAN      3 // Guessed from a return address on the stack.
+#define UNW_EXCEPTION 4 // Popped a hardware exception frame.
+
+// Why the unwind stopped.
+#define UNW_END_DONE      0 // Reached a null or non-code PC.
+#define UNW_END_STACK     1 // Ran off the end of the stack copy.
+#define UNW_END_OTHERSTACK 2 // Next frame is on the stack we don't have.
+#define UNW_END_LOST      3 // No unwind info and nothing found on the stack.
+#define UNW_END_DEPTH     4 // Too many frames.
+
+typedef struct {
+    uint32_t PC;
+    uint32_t SP;
+    int Method;
+    } UNWFRAME;
+
+typedef struct {
+    uint32_t Addr;
+    uint32_t Size;
+    const char *Name;
+    } UNWSYM;
+
+typedef struct {
+    ELFFILE *Elf;
+    const uint32_t *Exidx;  // Pairs of words.
+    uint32_t ExidxAddr;
+    uint32_t ExidxCount;
+    UNWSYM *Syms;           // Functions, sorted by address.
+    int SymCount;
+    } UNWINDER;
+
+int  unwind_open(UNWINDER*, ELFFILE*);
+void unwind_close(UNWINDER*);
+int  unwind_backtrace(UNWINDER*, const CRASHDUMP*, UNWFRAME *frames, int max, int *why);
+const char *unwind_symbol(UNWINDER*, uint32_t addr, uint32_t *offset);
+
+#endif
@@ -0,0 +1,273 @@
+// CUnit tests for the software watchdog supervisor.
+//
+// The hardware is a mock that counts down a millisecond at a time and
+// raises its early warning when it gets to zero, the way the LM3S
+// watchdog does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "wdsup.h"
+
+#include "CUnit/Basic.h"
+
+#define RELOAD 100  // ms
+
+typedef struct {
+    int32_t Counter;
+    uint32_t Kicks;
+    int Fired;
+    } MOCKWDT;
+
+MOCKWDT mock;
+WDSUP sup;
+
+// --------------------------------------------------
+// Utility Functions
+// --------------------------------------------------
+
+static void mock_kick(void *ctx) {
+    MOCKWDT *m = ctx;
+
+    m->Counter = RELOAD;
+    m->Kicks++;
+    }
+
+static const WDBACKEND backend = { mock_kick, &mock };
+
+static void reset(void) {
+    memset(&mock, 0, sizeof(mock));
+    mock.Counter = RELOAD;
+    memset(&wdstall, 0, sizeof(wdstall));
+    wdsup_init(&sup, &backend);
+    }
+
+// Run the clock.   Task i checks in every period[i] ms (0 for never),
+// the supervisor polls every 10.   Stops when the mock fires.
+static uint32_t run(uint32_t start, uint32_t ms, const int *id, const uint32_t *period, int tasks) {
+    uint32_t now;
+
+    for ( now = start; now != start + ms; now++ ) {
+        for ( int i = 0; i < tasks; i++ ) {
+            if ( period[i] && now % period[i] == 0 ) wdsup_checkin(&sup, id[i]);
+            }
+
+        if ( now % 10 == 0 ) wdsup_poll(&sup, now);
+
+        if ( --mock.Counter == 0 ) {
+            mock.Fired = 1;
+            wdsup_expired(&sup, now, &wdstall);
+            break;
+            }
+        }
+
+    return(now);
+    }
+
+// ---------------------------------------------------
+// ---------------------------------------------------
+int init_suite1(void) {
+    return 0;
+    }
+
+int clean_suite1(void) {
+    return 0;
+    }
+
+// ------------------------------------------------------
+// ------------------------------------------------------
+// Tests
+// ------------------------------------------------------
+// ------------------------------------------------------
+
+void testRegister(void) {
+    reset();
+    CU_ASSERT( wdsup_active == &sup );
+
+    for ( int i = 0; i < WDSUP_TASKS; i++ ) CU_ASSERT( wdsup_register(&sup, "t", 100, 0) == i );
+
+    CU_ASSERT( wdsup_register(&sup, "t", 100, 0) == -1 );
+
+    wdsup_unregister(&sup, 7);
+    CU_ASSERT( sup.Live == ~( 1u << 7 ) );
+    CU_ASSERT( wdsup_register(&sup, "again", 100, 0) == 7 );
+    CU_ASSERT( sup.Live == 0xFFFFFFFF );
+    }
+
+void testHealthy(void) {
+    int id[3];
+    uint32_t period[3] = { 20, 150, 450 };
+
+    reset();
+    id[0] = wdsup_register(&sup, "fast", 50, 0);
+    id[1] = wdsup_register(&sup, "slow", 300, 0);
+    id[2] = wdsup_register(&sup, "slower", 1000, 0);
+
+    // Each task well inside its own timeout, even though two of them
+    // are slower than the hardware.
+    run(0, 10000, id, period, 3);
+    CU_ASSERT( !mock.Fired );
+    CU_ASSERT( sup.Overdue == 0 );
+    CU_ASSERT( mock.Kicks == 1000 );
+    }
+
+void testHung(void) {
+    int id[3];
+    uint32_t period[3] = { 20, 150, 450 }, now;
+
+    reset();
+    id[0] = wdsup_register(&sup, "fast", 50, 0);
+    id[1] = wdsup_register(&sup, "slow", 300, 0);
+    id[2] = wdsup_register(&sup, "slower", 1000, 0);
+    now = run(0, 2000, id, period, 3);
+
+    // The slow one hangs.
+    period[1] = 0;
+    now = run(now, 2000, id, period, 3);
+    CU_ASSERT( mock.Fired );
+    CU_ASSERT( wdsup_stall_valid(&wdstall) );
+    CU_ASSERT( wdstall.Stalled == 1u << id[1] );
+    CU_ASSERT( wdstall.Tick == now );
+
+    // It had a 300 ms timeout, and the hardware 100 on top.
+    CU_ASSERT( now > 2000 + 300 && now <= 2000 + 300 + 150 + 10 + RELOAD );
+
+    // Corrupt records don't count.
+    wdstall.Stalled ^= 2;
+    CU_ASSERT( !wdsup_stall_valid(&wdstall) );
+    }
+
+void testLateButBack(void) {
+    int id[1];
+    uint32_t period[1] = { 0 }, now;
+
+    reset();
+    id[0] = wdsup_register(&sup, "late", 50, 0);
+
+    now = run(0, 60, id, period, 1);
+    CU_ASSERT( sup.Overdue == 1 && !mock.Fired );
+
+    // Checks in before the hardware bites, and it's forgiven.
+    period[0] = 20;
+    run(now, 1000, id, period, 1);
+    CU_ASSERT( !mock.Fired && sup.Overdue == 0 );
+    }
+
+void testSupervisorStalled(void) {
+    int id;
+
+    reset();
+    id = wdsup_register(&sup, "t", 50, 0);
+    wdsup_poll(&sup, 0);
+
+    // Nobody polls, and nothing is overdue yet when the hardware fires.
+    wdsup_checkin(&sup, id);
+    CU_ASSERT( wdsup_expired(&sup, 30, &wdstall) == 0 );
+    CU_ASSERT( wdstall.Stalled == 0 && wdstall.Missing == 0 );
+
+    // Checked in, but the supervisor never saw it.
+    CU_ASSERT( wdsup_expired(&sup, 60, &wdstall) == 1 );
+    }
+
+void testUnregister(void) {
+    int id[2];
+    uint32_t period[2] = { 20, 0 };
+
+    reset();
+    id[0] = wdsup_register(&sup, "busy", 50, 0);
+    id[1] = wdsup_register(&sup, "asleep", 50, 0);
+
+    // A task that's off the list can't stall things.
+    wdsup_unregister(&sup, id[1]);
+    run(0, 1000, id, period, 2);
+    CU_ASSERT( !mock.Fired );
+    }
+
+void testWrap(void) {
+    int id[1];
+    uint32_t period[1] = { 20 };
+
+    reset();
+    id[0] = wdsup_register(&sup, "t", 50, 0xFFFFFF00);
+    run(0xFFFFFF00, 1000, id, period, 1);
+    CU_ASSERT( !mock.Fired );
+
+    period[0] = 0;
+    run(1000 - 256, 1000, id, period, 1);
+    CU_ASSERT( mock.Fired && wdstall.Stalled == 1 );
+    }
+
+// Checking in from several threads while the supervisor polls.
+#define THREADS 4
+#define ROUNDS  100000
+
+static void *hammer(void *arg) {
+    int id = (int) (intptr_t) arg;
+
+    for ( int i = 0; i < ROUNDS; i++ ) {
+        wdsup_checkin(&sup, id);
+        wdsup_checkin(&sup, id + THREADS);
+        }
+
+    return(arg);
+    }
+
+void testConcurrent(void) {
+    pthread_t t[THREADS];
+
+    reset();
+
+    for ( int i = 0; i < 2 * THREADS; i++ ) wdsup_register(&sup, "t", 0x10000000, 0);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_create(&t[i], NULL, hammer, (void *) (intptr_t) i);
+
+    for ( uint32_t now = 0; now < 20000; now++ ) wdsup_poll(&sup, now);
+
+    for ( int i = 0; i < THREADS; i++ ) pthread_join(t[i], NULL);
+
+    // Nothing left behind, and nothing set that nobody checked in.
+    wdsup_poll(&sup, 20000);
+    CU_ASSERT( sup.CheckIn == 0 );
+    CU_ASSERT( sup.Live == ( 1u << 2 * THREADS ) - 1 );
+    CU_ASSERT( sup.Overdue == 0 );
+    CU_ASSERT( mock.Kicks == 20001 );
+    }
+
+int main() {
+
+    int rcode;
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Watchdog Supervisor", init_suite1, clean_suite1);
+
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    rcode = (NULL == CU_add_test(pSuite, "Register", testRegister)) ||
+            (NULL == CU_add_test(pSuite, "Healthy", testHealthy)) ||
+            (NULL == CU_add_test(pSuite, "Hung task", testHung)) ||
+            (NULL == CU_add_test(pSuite, "Late but back", testLateButBack)) ||
+            (NULL == CU_add_test(pSuite, "Supervisor stalled", testSupervisorStalled)) ||
+            (NULL == CU_add_test(pSuite, "Unregister", testUnregister)) ||
+            (NULL == CU_add_test(pSuite, "Tick wrap", testWrap)) ||
+            (NULL == CU_add_test(pSuite, "Concurrent check-ins", testConcurrent))
+            ;
+
+    if ( rcode ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+        }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+    }
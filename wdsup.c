@@ -0,0 +1,156 @@
+/// @file wdsup.c
+/// @brief Software watchdog supervisor.
+/// @details
+/// Kicking the watchdog from the main loop no matter what proves that
+/// the main loop runs, and nothing else.   A task that's stuck waiting
+/// on a semaphore that never comes goes unnoticed.
+///
+/// Here each task registers with its own timeout and checks in with
+/// wdsup_checkin() - one atomic OR, from any context, no locks.   The
+/// supervisor polls from the SysTick handler or a low priority task.
+/// It pulls in the check-ins, pushes each of those tasks' deadlines
+/// out, and kicks the hardware only if no live task is overdue.   That
+/// decision is one mask compare.   Deadlines only get looked at one by
+/// one when the earliest of them has passed.
+///
+/// A task that stops checking in stops the kicks.   The hardware times
+/// out and raises its early warning interrupt first.   WatchdogHandler
+/// calls wdsup_expired(), which records which tasks missed their
+/// deadlines in wdstall, in .noinit, so that it's there to be reported
+/// after the reset.   If nothing is overdue the supervisor itself must
+/// have stopped, and Stalled is 0.
+///
+/// Ticks are 32 bit ms, compared so that they can wrap.   Register and
+/// unregister are not thread safe - do them before the tasks start, or
+/// from the same context as the poll.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "crc32.h"
+#include "wdsup.h"
+
+#define FAR_AWAY 0x7FFFFFFF
+
+WDSUP *wdsup_active;
+WDSTALL wdstall __attribute__ ((section(".noinit")));
+
+static int due(uint32_t now, uint32_t deadline) {
+    return( (int32_t) ( now - deadline ) >= 0 );
+    }
+
+/// @brief Set up a supervisor.   It becomes the one WatchdogHandler uses.
+/// @param hw the watchdog.   Gets kicked from wdsup_poll().
+void wdsup_init(WDSUP *s, const WDBACKEND *hw) {
+    memset(s, 0, sizeof(*s));
+    s->Hw = hw;
+    wdsup_active = s;
+    }
+
+/// @brief Add a task.
+/// @return its id, for wdsup_checkin(), or -1 if they're all taken.
+/// @param timeout ticks allowed between check-ins
+/// @param now the current tick.   The first deadline is now + timeout.
+int wdsup_register(WDSUP *s, const char *name, uint32_t timeout, uint32_t now) {
+    uint32_t free = ~s->Live;
+    int id;
+
+    if ( free == 0 ) return(-1);
+
+    id = __builtin_ctz(free);
+    s->Name[id] = name;
+    s->Timeout[id] = timeout;
+    s->Deadline[id] = now + timeout;
+
+    if ( (int32_t) ( s->Deadline[id] - s->NextDeadline ) < 0 || s->Live == 0 ) s->NextDeadline = s->Deadline[id];
+
+    atomic_mask_and(&s->CheckIn, ~( 1u << id ));
+    s->Overdue &= ~( 1u << id );
+    s->Live |= 1u << id;
+    return(id);
+    }
+
+/// @brief Take a task out, for good or while it sleeps.
+void wdsup_unregister(WDSUP *s, int id) {
+    s->Live &= ~( 1u << id );
+    s->Overdue &= ~( 1u << id );
+    }
+
+/// @brief I'm still alive.   Safe from anywhere.
+void wdsup_checkin(WDSUP *s, int id) {
+    atomic_mask_or(&s->CheckIn, 1u << id);
+    }
+
+// Take the check-ins, and leave zero.
+static uint32_t take(WDSUP *s) {
+    uint32_t v;
+
+    do v = s->CheckIn;
+    while ( v && !atomic_cas(&s->CheckIn, v, 0) );
+
+    return(v);
+    }
+
+// Find the overdue tasks, and the next deadline.
+static void scan(WDSUP *s, uint32_t now) {
+    uint32_t next = now + FAR_AWAY;
+
+    for ( uint32_t m = s->Live & ~s->Overdue; m; m &= m - 1 ) {
+        int i = __builtin_ctz(m);
+
+        if ( due(now, s->Deadline[i]) ) s->Overdue |= 1u << i;
+        else if ( (int32_t) ( s->Deadline[i] - next ) < 0 ) next = s->Deadline[i];
+        }
+
+    s->NextDeadline = next;
+    }
+
+/// @brief Collect check-ins, and kick the hardware if everybody is
+/// on time.
+/// @return 1 if it kicked, 0 if something is overdue.
+int wdsup_poll(WDSUP *s, uint32_t now) {
+    uint32_t fresh = take(s) & s->Live;
+
+    for ( uint32_t m = fresh; m; m &= m - 1 ) {
+        int i = __builtin_ctz(m);
+
+        s->Deadline[i] = now + s->Timeout[i];
+
+        // An overdue task wasn't in NextDeadline.
+        if ( (int32_t) ( s->Deadline[i] - s->NextDeadline ) < 0 ) s->NextDeadline = s->Deadline[i];
+        }
+
+    s->Overdue &= ~fresh;
+    s->Since |= fresh;
+
+    if ( due(now, s->NextDeadline) ) scan(s, now);
+
+    if ( s->Overdue & s->Live ) return(0);
+
+    s->Hw->Kick(s->Hw->Ctx);
+    s->Kicks++;
+    s->Since = 0;
+    return(1);
+    }
+
+/// @brief The hardware is about to bite.   Record who's to blame.
+/// For the early warning interrupt.
+/// @return the overdue tasks
+/// @param rec where to put the record, normally &wdstall
+uint32_t wdsup_expired(WDSUP *s, uint32_t now, WDSTALL *rec) {
+    scan(s, now);
+
+    rec->Magic = WDSUP_MAGIC;
+    rec->Stalled = s->Overdue & s->Live;
+    rec->Missing = s->Live & ~( s->Since | s->CheckIn );
+    rec->Tick = now;
+    rec->CRC = crc32(0, rec, offsetof(WDSTALL, CRC));
+    return(rec->Stalled);
+    }
+
+/// @brief Is there a stall record from before the reset?
+int wdsup_stall_valid(const WDSTALL *rec) {
+    return( rec->Magic == WDSUP_MAGIC && rec->CRC == crc32(0, rec, offsetof(WDSTALL, CRC)) );
+    }
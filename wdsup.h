@@ -0,0 +1,57 @@
+//
+// Software watchdog supervisor.   Many task deadlines, one hardware
+// watchdog.
+//
+
+#ifndef __WDSUP_H__
+#define __WDSUP_H__
+
+#include <stdint.h>
+
+#define WDSUP_TASKS 32          // One bit each.
+#define WDSUP_MAGIC 0x4C415453  // "STAL"
+
+// The hardware.   wdt-lm3s.c has the real one, the tests a mock.
+typedef struct {
+    void (*Kick)(void *ctx);
+    void *Ctx;
+    } WDBACKEND;
+
+// What the early warning interrupt saw.   Survives the reset.
+typedef struct {
+    uint32_t Magic;
+    uint32_t Stalled;   // Missed their deadlines.  0 if it was the supervisor.
+    uint32_t Missing;   // Hadn't checked in since the last kick.
+    uint32_t Tick;
+    uint32_t CRC;
+    } WDSTALL;
+
+typedef struct {
+    uint32_t CheckIn;                 // Set by the tasks, atomically.
+    uint32_t Live;                    // Registered.
+    uint32_t Overdue;
+    uint32_t Since;                   // Checked in since the last kick.
+    uint32_t NextDeadline;
+    uint32_t Timeout[WDSUP_TASKS];
+    uint32_t Deadline[WDSUP_TASKS];
+    const char *Name[WDSUP_TASKS];
+    uint32_t Kicks;
+    const WDBACKEND *Hw;
+    } WDSUP;
+
+extern WDSUP *wdsup_active;
+extern WDSTALL wdstall;
+
+void     wdsup_init(WDSUP*, const WDBACKEND*);
+int      wdsup_register(WDSUP*, const char *name, uint32_t timeout, uint32_t now);
+void     wdsup_unregister(WDSUP*, int id);
+void     wdsup_checkin(WDSUP*, int id);
+int      wdsup_poll(WDSUP*, uint32_t now);
+uint32_t wdsup_expired(WDSUP*, uint32_t now, WDSTALL*);
+int      wdsup_stall_valid(const WDSTALL*);
+
+#if defined(__arm__)
+void WatchdogBackend(WDBACKEND*, int reload); // wdt-lm3s.c
+#endif
+
+#endif
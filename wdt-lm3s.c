@@ -4,11 +4,15 @@
 ///
 /// Act slowly.  The intent here is to reset a system killed by user error.
 
+#include <stdint.h>
+
 #include "inc/hw_types.h"
 #include "inc/hw_memmap.h"
 #include "driverlib/watchdog.h"
 
 #include "wdt.h"
+#include "wdsup.h"
+#include "systick64.h"
 
 /// Initialize the watchdog
 void WatchdogInit(int initialval) {
@@ -51,12 +55,24 @@ void WatchdogKick(int value) {
 
 /// Watchdog ISR
 ///
-/// At the present time, this is just a stub.  In case of a hardfault,
-/// this won't be able to get any attention because hardfault is high priority
+/// The first timeout.  The reset comes with the second one, so there's
+/// time to note which task stopped checking in with the supervisor.
+/// In case of a hardfault, this won't be able to get any attention
+/// because hardfault is high priority
 
 void WatchdogHandler() {
 
+    if ( wdsup_active ) wdsup_expired(wdsup_active, getSysTickMS32(), &wdstall);
+
     while (1) { ; }
     }
-    
-    
\ No newline at end of file
+
+static void WatchdogBackendKick(void *ctx) {
+    WatchdogKick((int) (uintptr_t) ctx);
+    }
+
+/// Let the supervisor kick the watchdog, with a reload value.
+void WatchdogBackend(WDBACKEND *hw, int reload) {
+    hw->Kick = WatchdogBackendKick;
+    hw->Ctx = (void *) (uintptr_t) reload;
+    }